@@ -0,0 +1,495 @@
+#include "bcn_encoder.hpp"
+
+#include <array>
+#include <atomic>
+#include <limits>
+#include <thread>
+#include <utility>
+#include <algorithm>
+#include <functional>
+
+#include <cmath>
+#include <cassert>
+
+#include <glm/glm.hpp>
+
+namespace {
+    // 4x4 texels in row-major order, RGBA in [0, 255]
+    using Block = std::array<glm::vec4, 16>;
+
+    Block fetch_block(
+        const std::uint8_t* rgba,
+        std::uint32_t width,
+        std::uint32_t height,
+        std::uint32_t blockX,
+        std::uint32_t blockY
+    );
+
+    void encode_bc1(const Block&, std::uint8_t* out);
+
+    void encode_bc4(const Block&, std::uint32_t channel, std::uint8_t* out);
+
+    void encode_bc7(const Block&, std::uint8_t* out);
+
+    void parallel_for(std::size_t count, const std::function<void(std::size_t)>& body);
+}
+
+std::size_t block_size_in_bytes(const BlockFormat format) {
+    switch (format) {
+        case BlockFormat::BC1:
+        case BlockFormat::BC4:
+            return 8;
+        case BlockFormat::BC5:
+        case BlockFormat::BC7:
+            return 16;
+    }
+
+    assert(false);
+    return 0;
+}
+
+std::size_t compressed_size_in_bytes(const BlockFormat format, const std::uint32_t width, const std::uint32_t height) {
+    const std::size_t blocksX = (width + 3) / 4;
+    const std::size_t blocksY = (height + 3) / 4;
+    return blocksX * blocksY * block_size_in_bytes(format);
+}
+
+std::vector<std::uint8_t> encode_blocks(const std::uint8_t* rgba,
+                                        const std::uint32_t width,
+                                        const std::uint32_t height,
+                                        const BlockFormat format,
+                                        const std::uint32_t sourceChannel) {
+    assert(rgba);
+    assert(width > 0 && height > 0);
+    assert(sourceChannel < (BlockFormat::BC5 == format ? 3u : 4u));
+
+    const std::uint32_t blocksX = (width + 3) / 4;
+    const std::uint32_t blocksY = (height + 3) / 4;
+    const std::size_t blockSize = block_size_in_bytes(format);
+
+    // Zero-initialised; the BC7 encoder only sets bits
+    std::vector<std::uint8_t> blocks(compressed_size_in_bytes(format, width, height), 0);
+
+    parallel_for(blocksY, [&](const std::size_t blockY) {
+        for (std::uint32_t blockX = 0; blockX < blocksX; ++blockX) {
+            const auto block = fetch_block(rgba, width, height, blockX, static_cast<std::uint32_t>(blockY));
+            std::uint8_t* out = blocks.data() + (blockY * blocksX + blockX) * blockSize;
+
+            switch (format) {
+                case BlockFormat::BC1:
+                    encode_bc1(block, out);
+                    break;
+                case BlockFormat::BC4:
+                    encode_bc4(block, sourceChannel, out);
+                    break;
+                case BlockFormat::BC5:
+                    encode_bc4(block, sourceChannel, out);
+                    encode_bc4(block, sourceChannel + 1, out + 8);
+                    break;
+                case BlockFormat::BC7:
+                    encode_bc7(block, out);
+                    break;
+            }
+        }
+    });
+
+    return blocks;
+}
+
+namespace {
+    Block fetch_block(const std::uint8_t* rgba,
+                      const std::uint32_t width,
+                      const std::uint32_t height,
+                      const std::uint32_t blockX,
+                      const std::uint32_t blockY) {
+        Block block;
+
+        for (std::uint32_t y = 0; y < 4; ++y) {
+            const auto sy = std::min(blockY * 4 + y, height - 1);
+            for (std::uint32_t x = 0; x < 4; ++x) {
+                const auto sx = std::min(blockX * 4 + x, width - 1);
+                const std::uint8_t* texel = rgba + (static_cast<std::size_t>(sy) * width + sx) * 4;
+                block[y * 4 + x] = glm::vec4(texel[0], texel[1], texel[2], texel[3]);
+            }
+        }
+
+        return block;
+    }
+
+    // Fit a line through the texels of the block (mean + principal axis, found by power iteration) and return the
+    // two extreme points of the projected texels. These are the initial endpoints for BC1 and BC7.
+    std::pair<glm::vec4, glm::vec4> fit_endpoints(const Block& block) {
+        glm::vec4 mean(0.f), lo(255.f), hi(0.f);
+        for (const auto& texel : block) {
+            mean += texel;
+            lo = glm::min(lo, texel);
+            hi = glm::max(hi, texel);
+        }
+        mean /= 16.f;
+
+        glm::vec4 axis = hi - lo;
+        if (glm::dot(axis, axis) < 1e-6f) {
+            // Uniform block
+            return {mean, mean};
+        }
+
+        glm::mat4 covariance(0.f);
+        for (const auto& texel : block) {
+            const auto delta = texel - mean;
+            covariance += glm::outerProduct(delta, delta);
+        }
+
+        axis = glm::normalize(axis);
+        for (int i = 0; i < 8; ++i) {
+            const auto next = covariance * axis;
+            const auto length = glm::length(next);
+            if (length < 1e-6f) {
+                break;
+            }
+            axis = next / length;
+        }
+
+        float minT = std::numeric_limits<float>::max();
+        float maxT = std::numeric_limits<float>::lowest();
+        for (const auto& texel : block) {
+            const auto t = glm::dot(texel - mean, axis);
+            minT = std::min(minT, t);
+            maxT = std::max(maxT, t);
+        }
+
+        return {
+            glm::clamp(mean + axis * maxT, 0.f, 255.f),
+            glm::clamp(mean + axis * minT, 0.f, 255.f)
+        };
+    }
+
+    // Least squares refit of both endpoints, given the interpolation weight that each texel ended up with
+    // (0 = first endpoint, 1 = second endpoint). Returns false if the system is degenerate.
+    bool refine_endpoints(const Block& block, const std::array<float, 16>& weights, glm::vec4& e0, glm::vec4& e1) {
+        float aa = 0.f, ab = 0.f, bb = 0.f;
+        glm::vec4 ax(0.f), bx(0.f);
+
+        for (std::size_t i = 0; i < block.size(); ++i) {
+            const float b = weights[i];
+            const float a = 1.f - b;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            ax += a * block[i];
+            bx += b * block[i];
+        }
+
+        const float determinant = aa * bb - ab * ab;
+        if (std::abs(determinant) < 1e-6f) {
+            return false;
+        }
+
+        e0 = glm::clamp((ax * bb - bx * ab) / determinant, 0.f, 255.f);
+        e1 = glm::clamp((bx * aa - ax * ab) / determinant, 0.f, 255.f);
+        return true;
+    }
+
+    float squared_error(const glm::vec4& a, const glm::vec4& b) {
+        const auto delta = a - b;
+        return glm::dot(delta, delta);
+    }
+
+    void parallel_for(const std::size_t count, const std::function<void(std::size_t)>& body) {
+        const std::size_t workerCount = std::min<std::size_t>(std::max(1u, std::thread::hardware_concurrency()), count);
+
+        std::atomic<std::size_t> next{0};
+        const auto worker = [&] {
+            for (std::size_t i = next++; i < count; i = next++) {
+                body(i);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (std::size_t i = 1; i < workerCount; ++i) {
+            threads.emplace_back(worker);
+        }
+
+        worker();
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+}
+
+namespace {
+    // BC1 four colour mode: index i lies at kBC1Weights[i] between colour0 and colour1
+    constexpr std::array kBC1Weights = {0.f, 1.f, 1.f / 3.f, 2.f / 3.f};
+
+    std::uint16_t to_rgb565(const glm::vec4& colour) {
+        const auto r = static_cast<std::uint16_t>(std::lround(colour.r * 31.f / 255.f));
+        const auto g = static_cast<std::uint16_t>(std::lround(colour.g * 63.f / 255.f));
+        const auto b = static_cast<std::uint16_t>(std::lround(colour.b * 31.f / 255.f));
+        return static_cast<std::uint16_t>(r << 11 | g << 5 | b);
+    }
+
+    glm::vec4 from_rgb565(const std::uint16_t colour) {
+        const std::uint32_t r = colour >> 11 & 31;
+        const std::uint32_t g = colour >> 5 & 63;
+        const std::uint32_t b = colour & 31;
+        return glm::vec4(r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2, 0.f);
+    }
+
+    // Selects the closest palette entry for every texel; returns the total squared error
+    float bc1_select_indices(const Block& block,
+                             const std::uint16_t colour0,
+                             const std::uint16_t colour1,
+                             std::uint32_t& indices,
+                             std::array<float, 16>& weights) {
+        const auto e0 = from_rgb565(colour0);
+        const auto e1 = from_rgb565(colour1);
+
+        std::array<glm::vec4, 4> palette;
+        for (std::size_t i = 0; i < palette.size(); ++i) {
+            palette[i] = glm::mix(e0, e1, kBC1Weights[i]);
+        }
+
+        indices = 0;
+        float error = 0.f;
+        for (std::size_t i = 0; i < block.size(); ++i) {
+            std::uint32_t best = 0;
+            float bestError = squared_error(block[i], palette[0]);
+            for (std::uint32_t j = 1; j < palette.size(); ++j) {
+                if (const auto candidate = squared_error(block[i], palette[j]); candidate < bestError) {
+                    best = j;
+                    bestError = candidate;
+                }
+            }
+
+            indices |= best << (2 * i);
+            weights[i] = kBC1Weights[best];
+            error += bestError;
+        }
+
+        return error;
+    }
+
+    void encode_bc1(const Block& block, std::uint8_t* out) {
+        // BC1 is used for opaque colour only; ignore alpha throughout
+        Block rgb = block;
+        for (auto& texel : rgb) {
+            texel.a = 0.f;
+        }
+
+        auto [e0, e1] = fit_endpoints(rgb);
+
+        // Four colour mode requires colour0 > colour1. With colour0 == colour1 the block is uniform (up to
+        // quantization) and all indices select colour0.
+        const auto order = [](std::uint16_t& c0, std::uint16_t& c1) {
+            if (c0 < c1) {
+                std::swap(c0, c1);
+            }
+        };
+
+        std::uint16_t colour0 = to_rgb565(e0), colour1 = to_rgb565(e1);
+        order(colour0, colour1);
+
+        std::uint32_t indices = 0;
+        std::array<float, 16> weights{};
+        float error = colour0 == colour1 ? 0.f : bc1_select_indices(rgb, colour0, colour1, indices, weights);
+
+        if (colour0 != colour1 && refine_endpoints(rgb, weights, e0, e1)) {
+            std::uint16_t refined0 = to_rgb565(e0), refined1 = to_rgb565(e1);
+            order(refined0, refined1);
+
+            if (refined0 != refined1) {
+                std::uint32_t refinedIndices = 0;
+                if (const auto refinedError = bc1_select_indices(rgb, refined0, refined1, refinedIndices, weights);
+                    refinedError < error) {
+                    colour0 = refined0;
+                    colour1 = refined1;
+                    indices = refinedIndices;
+                    error = refinedError;
+                }
+            }
+        }
+
+        if (colour0 == colour1) {
+            indices = 0;
+        }
+
+        out[0] = static_cast<std::uint8_t>(colour0 & 0xff);
+        out[1] = static_cast<std::uint8_t>(colour0 >> 8);
+        out[2] = static_cast<std::uint8_t>(colour1 & 0xff);
+        out[3] = static_cast<std::uint8_t>(colour1 >> 8);
+        for (std::size_t i = 0; i < 4; ++i) {
+            out[4 + i] = static_cast<std::uint8_t>(indices >> (8 * i) & 0xff);
+        }
+    }
+}
+
+namespace {
+    void encode_bc4(const Block& block, const std::uint32_t channel, std::uint8_t* out) {
+        float lo = 255.f, hi = 0.f;
+        for (const auto& texel : block) {
+            lo = std::min(lo, texel[channel]);
+            hi = std::max(hi, texel[channel]);
+        }
+
+        // red0 > red1 selects the eight value mode: index 0 = red0, index 1 = red1 and indices 2..7 interpolate
+        // from red0 to red1 in sevenths
+        const auto red0 = static_cast<std::uint8_t>(std::lround(hi));
+        const auto red1 = static_cast<std::uint8_t>(std::lround(lo));
+
+        std::uint64_t indices = 0;
+        if (red0 > red1) {
+            const float scale = 7.f / static_cast<float>(red0 - red1);
+            for (std::size_t i = 0; i < block.size(); ++i) {
+                const auto step = std::clamp(std::lround((red0 - block[i][channel]) * scale), 0l, 7l);
+                const std::uint64_t index = 0 == step ? 0 : (7 == step ? 1 : step + 1);
+                indices |= index << (3 * i);
+            }
+        }
+
+        out[0] = red0;
+        out[1] = red1;
+        for (std::size_t i = 0; i < 6; ++i) {
+            out[2 + i] = static_cast<std::uint8_t>(indices >> (8 * i) & 0xff);
+        }
+    }
+}
+
+namespace {
+    constexpr std::array<std::int32_t, 16> kBC7Weights = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    // Mode 6 endpoint: four 7-bit components sharing one p-bit as their least significant bit
+    struct BC7Endpoint {
+        std::array<std::uint32_t, 4> components;
+        std::uint32_t pbit;
+
+        glm::ivec4 decode() const {
+            return glm::ivec4(
+                components[0] << 1 | pbit,
+                components[1] << 1 | pbit,
+                components[2] << 1 | pbit,
+                components[3] << 1 | pbit
+            );
+        }
+    };
+
+    BC7Endpoint quantize_bc7(const glm::vec4& endpoint) {
+        BC7Endpoint best{};
+        float bestError = std::numeric_limits<float>::max();
+
+        for (std::uint32_t pbit = 0; pbit < 2; ++pbit) {
+            BC7Endpoint candidate{.pbit = pbit};
+            float error = 0.f;
+            for (std::size_t c = 0; c < 4; ++c) {
+                const auto q = std::clamp(std::lround((endpoint[c] - static_cast<float>(pbit)) * 0.5f), 0l, 127l);
+                candidate.components[c] = static_cast<std::uint32_t>(q);
+                const auto delta = static_cast<float>(q * 2 + pbit) - endpoint[c];
+                error += delta * delta;
+            }
+
+            if (error < bestError) {
+                best = candidate;
+                bestError = error;
+            }
+        }
+
+        return best;
+    }
+
+    float bc7_select_indices(const Block& block,
+                             const BC7Endpoint& endpoint0,
+                             const BC7Endpoint& endpoint1,
+                             std::array<std::uint32_t, 16>& indices,
+                             std::array<float, 16>& weights) {
+        const auto d0 = endpoint0.decode();
+        const auto d1 = endpoint1.decode();
+
+        std::array<glm::vec4, 16> palette;
+        for (std::size_t i = 0; i < palette.size(); ++i) {
+            palette[i] = glm::vec4(((64 - kBC7Weights[i]) * d0 + kBC7Weights[i] * d1 + 32) >> 6);
+        }
+
+        float error = 0.f;
+        for (std::size_t i = 0; i < block.size(); ++i) {
+            std::uint32_t best = 0;
+            float bestError = squared_error(block[i], palette[0]);
+            for (std::uint32_t j = 1; j < palette.size(); ++j) {
+                if (const auto candidate = squared_error(block[i], palette[j]); candidate < bestError) {
+                    best = j;
+                    bestError = candidate;
+                }
+            }
+
+            indices[i] = best;
+            weights[i] = static_cast<float>(kBC7Weights[best]) / 64.f;
+            error += bestError;
+        }
+
+        return error;
+    }
+
+    class BitWriter {
+    public:
+        explicit BitWriter(std::uint8_t* out) : mOut(out) {
+        }
+
+        void write(const std::uint32_t value, const std::uint32_t bits) {
+            for (std::uint32_t i = 0; i < bits; ++i, ++mPosition) {
+                if (value >> i & 1) {
+                    mOut[mPosition / 8] |= static_cast<std::uint8_t>(1 << (mPosition % 8));
+                }
+            }
+        }
+
+    private:
+        std::uint8_t* mOut;
+        std::uint32_t mPosition = 0;
+    };
+
+    void encode_bc7(const Block& block, std::uint8_t* out) {
+        auto [e0, e1] = fit_endpoints(block);
+
+        auto endpoint0 = quantize_bc7(e0);
+        auto endpoint1 = quantize_bc7(e1);
+
+        std::array<std::uint32_t, 16> indices{};
+        std::array<float, 16> weights{};
+        const float error = bc7_select_indices(block, endpoint0, endpoint1, indices, weights);
+
+        if (refine_endpoints(block, weights, e0, e1)) {
+            const auto refined0 = quantize_bc7(e0);
+            const auto refined1 = quantize_bc7(e1);
+
+            std::array<std::uint32_t, 16> refinedIndices{};
+            if (bc7_select_indices(block, refined0, refined1, refinedIndices, weights) < error) {
+                endpoint0 = refined0;
+                endpoint1 = refined1;
+                indices = refinedIndices;
+            }
+        }
+
+        // The anchor (first) index is stored with its most significant bit implicitly zero. The weight table is
+        // symmetric, so swapping the endpoints and inverting all indices encodes the same block.
+        if (indices[0] & 8) {
+            std::swap(endpoint0, endpoint1);
+            for (auto& index : indices) {
+                index = 15 - index;
+            }
+        }
+
+        BitWriter writer(out);
+        writer.write(1 << 6, 7); // mode 6
+
+        for (std::size_t c = 0; c < 4; ++c) {
+            writer.write(endpoint0.components[c], 7);
+            writer.write(endpoint1.components[c], 7);
+        }
+
+        writer.write(endpoint0.pbit, 1);
+        writer.write(endpoint1.pbit, 1);
+
+        writer.write(indices[0], 3);
+        for (std::size_t i = 1; i < indices.size(); ++i) {
+            writer.write(indices[i], 4);
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Block compression formats produced by the encoder. All of them operate on
+ * blocks of 4x4 texels:
+ *
+ * - BC1: RGB with 5:6:5 endpoints, 8 bytes per block
+ * - BC4: single channel, 8 bytes per block
+ * - BC5: two channels (two BC4 blocks), 16 bytes per block
+ * - BC7: RGBA, 16 bytes per block. Only mode 6 (single subset, 7777 endpoints
+ *   with p-bits and 4-bit indices) is emitted, which is a good fit for the
+ *   smooth, mostly opaque content in the Sun Temple textures.
+ */
+enum class BlockFormat {
+    BC1,
+    BC4,
+    BC5,
+    BC7
+};
+
+std::size_t block_size_in_bytes(BlockFormat format);
+
+std::size_t compressed_size_in_bytes(BlockFormat format, std::uint32_t width, std::uint32_t height);
+
+/*
+ * Encode a tightly packed RGBA8 image. Width and height need not be multiples
+ * of four; blocks along the right and bottom edges replicate the last column
+ * and row. BC4 reads the channel given by sourceChannel, BC5 reads the channels
+ * sourceChannel and sourceChannel + 1.
+ *
+ * Rows of blocks are distributed over all hardware threads.
+ */
+std::vector<std::uint8_t> encode_blocks(
+    const std::uint8_t* rgba,
+    std::uint32_t width,
+    std::uint32_t height,
+    BlockFormat format,
+    std::uint32_t sourceChannel = 0
+);
@@ -3,10 +3,13 @@
 #include <typeinfo>
 #include <exception>
 #include <filesystem>
+#include <algorithm>
 #include <system_error>
 #include <unordered_map>
+#include <unordered_set>
 
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 
 #include <glm/glm.hpp>
@@ -15,6 +18,8 @@
 #include "indexed_mesh.hpp"
 #include "input_model.hpp"
 #include "load_model_obj.hpp"
+#include "texture_bake.hpp"
+#include "texture_budget.hpp"
 
 #include "../vkutils/error.hpp"
 
@@ -31,7 +36,13 @@ namespace {
      * from being misidentified as text.
      */
     constexpr char kFileMagic[16] = "\0\0SPICYMESH";
-    constexpr char kFileVariant[16] = "spicy";
+    constexpr char kFileVariant[16] = "spicy-aligned";
+
+    /*
+     * Mesh attribute and index arrays start at multiples of this offset in the
+     * file, so that the runtime can use them in place from a memory mapping.
+     */
+    constexpr long kSectionAlignment = 16;
 
     /*
      * Fallback textures
@@ -44,12 +55,39 @@ namespace {
     struct TextureInfo {
         std::uint32_t uniqueId;
         std::uint8_t channels;
+        TextureRecipe recipe;
         std::string newPath;
+        std::uint32_t firstLevel = 0; // see bake_texture()
+    };
+
+    /*
+     * Baked textures of a material. Source textures are packed as follows:
+     * - base colour: RGB = base colour, A = alpha mask (1 if not alpha masked)
+     * - surface: R = ambient occlusion (not available yet, 1), G = roughness,
+     *   B = metalness
+     * - normal map: RGB = normal
+     * - emissive: RGB = emissive
+     */
+    struct MaterialTextures {
+        TextureRecipe baseColour;
+        TextureRecipe surface;
+        TextureRecipe normalMap;
+        TextureRecipe emissive;
+    };
+
+    struct BakeOptions {
+        // Block compress textures (BCn) instead of writing PNGs
+        bool compressTextures = true;
+
+        TextureBudget textureBudget;
     };
 
+    BakeOptions parse_options(int argc, char** argv);
+
     void process_model(
         const char* inputObj,
         const char* output,
+        const BakeOptions& options,
         const glm::mat4& transform = glm::identity<glm::mat4>()
     );
 
@@ -66,17 +104,28 @@ namespace {
         float errorTolerance = 1e-5f
     );
 
+    MaterialTextures material_textures(const InputMaterialInfo&);
+
+    std::string recipe_key(const TextureRecipe&);
+
     std::unordered_map<std::string, TextureInfo> find_unique_textures(
         const InputModel&);
 
     std::unordered_map<std::string, TextureInfo> populate_paths(
         std::unordered_map<std::string, TextureInfo>,
-        const std::filesystem::path& textureDir
+        const std::filesystem::path& textureDir,
+        const BakeOptions& options
+    );
+
+    void fit_textures(
+        const InputModel&,
+        std::unordered_map<std::string, TextureInfo>&,
+        const BakeOptions& options
     );
 }
 
 
-int main() try {
+int main(int argc, char** argv) try {
 #	if !defined(NDEBUG)
     std::printf("Suggest running this in release mode (it appears to be running in debug)\n");
     /*
@@ -96,9 +145,12 @@ int main() try {
      * even while debugging the main CW3 program.
      */
 #	endif
+    const auto options = parse_options(argc, argv);
+
     process_model(
         "assets-src/suntemple.obj-zstd",
-        "assets/suntemple.spicymesh"
+        "assets/suntemple.spicymesh",
+        options
     );
 
     return 0;
@@ -108,7 +160,52 @@ int main() try {
 }
 
 namespace {
-    void process_model(const char* inputObj, const char* output, const glm::mat4& transform) {
+    BakeOptions parse_options(const int argc, char** argv) {
+        BakeOptions options;
+
+        // Options taking a positive integer value
+        const auto value = [&](int& i) {
+            if (i + 1 >= argc) {
+                throw vkutils::Error("Option '%s' requires a value", argv[i]);
+            }
+
+            char* end = nullptr;
+            const auto parsed = std::strtoul(argv[i + 1], &end, 10);
+            if (end == argv[i + 1] || *end != '\0' || 0 == parsed) {
+                throw vkutils::Error("Option '%s': expected a positive integer, got '%s'", argv[i], argv[i + 1]);
+            }
+
+            ++i;
+            return parsed;
+        };
+
+        for (int i = 1; i < argc; ++i) {
+            if (0 == std::strcmp(argv[i], "--no-bcn")) {
+                options.compressTextures = false;
+            } else if (0 == std::strcmp(argv[i], "--texture-budget")) {
+                options.textureBudget.budgetBytes = static_cast<std::size_t>(value(i)) * 1024 * 1024;
+            } else if (0 == std::strcmp(argv[i], "--max-colour-size")) {
+                options.textureBudget.maxColourSize = static_cast<std::uint32_t>(value(i));
+            } else if (0 == std::strcmp(argv[i], "--max-normal-size")) {
+                options.textureBudget.maxNormalMapSize = static_cast<std::uint32_t>(value(i));
+            } else if (0 == std::strcmp(argv[i], "--max-surface-size")) {
+                options.textureBudget.maxSurfaceSize = static_cast<std::uint32_t>(value(i));
+            } else {
+                throw vkutils::Error("Unknown option '%s'\n"
+                                     "Usage: %s [--no-bcn] [--texture-budget MiB] [--max-colour-size N] "
+                                     "[--max-normal-size N] [--max-surface-size N]", argv[i], argv[0]);
+            }
+        }
+
+        return options;
+    }
+}
+
+namespace {
+    void process_model(const char* inputObj,
+                       const char* output,
+                       const BakeOptions& options,
+                       const glm::mat4& transform) {
         static constexpr std::size_t vertexSize = sizeof(float) * (3 + 3 + 2);
 
         // Figure out output paths
@@ -141,10 +238,12 @@ namespace {
                     (outputVerts * vertexSize + outputIndices * sizeof(std::uint32_t)) / 1024);
 
         // Find list of unique textures
-        const auto textures = populate_paths(find_unique_textures(model), textureDir);
+        auto textures = populate_paths(find_unique_textures(model), textureDir, options);
 
         std::printf(" - unique textures: %zu\n", textures.size());
 
+        fit_textures(model, textures, options);
+
         // Ensure output directory exists
         std::filesystem::create_directories(rootdir);
 
@@ -165,36 +264,19 @@ namespace {
 
         std::fclose(fof);
 
-        // Copy textures
+        // Bake textures
         std::filesystem::create_directories(rootdir / textureDir);
 
-        std::size_t errors = 0;
+        BakedTextureSizes totals{0, 0};
         for (const auto& textureEntry : textures) {
-            const auto dest = rootdir / textureEntry.second.newPath;
-
-            std::error_code errorCode;
-            bool ret = std::filesystem::copy_file(
-                textureEntry.first,
-                dest,
-                std::filesystem::copy_options::none,
-                errorCode
-            );
-
-            if (!ret) {
-                ++errors;
-                std::fprintf(stderr, "copy_file(): '%s' failed: %s (%s)\n", dest.string().c_str(),
-                             errorCode.message().c_str(),
-                             errorCode.category().name());
-            }
+            const auto sizes = bake_texture(textureEntry.second.recipe, rootdir / textureEntry.second.newPath,
+                                            options.compressTextures, textureEntry.second.firstLevel);
+            totals.uncompressedBytes += sizes.uncompressedBytes;
+            totals.gpuBytes += sizes.gpuBytes;
         }
 
-        const auto total = textures.size();
-        std::printf("Copied %zu textures out of %zu.\n", total - errors, total);
-        if (errors) {
-            std::fprintf(
-                stderr,
-                "Some copies reported an error. Currently, the code will never overwrite existing files. The errors likely just indicate that the file was copied previously. Remove old files manually, if necessary.\n");
-        }
+        std::printf("Baked %zu textures: %zu kB as RGBA8 => %zu kB on the GPU\n", textures.size(),
+                    totals.uncompressedBytes / 1024, totals.gpuBytes / 1024);
     }
 }
 
@@ -231,6 +313,17 @@ namespace {
         }
     }
 
+    void write_padding(FILE* out, const long alignment) {
+        // Pad with zeros until the current position is a multiple of alignment
+        const long position = std::ftell(out);
+        if (position < 0) {
+            throw vkutils::Error("ftell() failed");
+        }
+
+        static constexpr char zeros[kSectionAlignment] = {};
+        checked_write(out, static_cast<std::size_t>((alignment - position % alignment) % alignment), zeros);
+    }
+
     void write_string(FILE* out, const char* string) {
         // Write a string
         // Format:
@@ -280,35 +373,30 @@ namespace {
         // Format:
         //  - uint32_t : M = number of materials
         //  - repeat M times:
-        //    - uin32_t : base color texture index
-        //    - uin32_t : roughness texture index
-        //    - uin32_t : metalness texture index
-        //    - uin32_t : alphaMask texture index (or 0xffffffff if none)
-        //    - uin32_t : normalMap texture index (or 0xffffffff if none)
+        //    - uin32_t : base color texture index (alpha mask in the alpha channel)
+        //    - uin32_t : surface texture index (R = occlusion, G = roughness, B = metalness)
+        //    - uin32_t : normalMap texture index
         //    - uin32_t : emissive texture index
+        //    - uin32_t : 1 if the material is alpha masked, 0 otherwise
         const std::uint32_t materialCount = static_cast<std::uint32_t>(model.materials.size());
         checked_write(out, sizeof(materialCount), &materialCount);
 
         for (const auto& material : model.materials) {
-            const auto writeTex = [&](const std::string& rawTexturePath) {
-                if (rawTexturePath.empty()) {
-                    static constexpr std::uint32_t sentinel = ~static_cast<std::uint32_t>(0);
-                    checked_write(out, sizeof(std::uint32_t), &sentinel);
-                    return;
-                }
-
-                const auto it = textures.find(rawTexturePath);
+            const auto writeTex = [&](const TextureRecipe& recipe) {
+                const auto it = textures.find(recipe_key(recipe));
                 assert(textures.end() != it);
 
                 checked_write(out, sizeof(std::uint32_t), &it->second.uniqueId);
             };
 
-            writeTex(material.baseColorTexturePath);
-            writeTex(material.roughnessTexturePath);
-            writeTex(material.metalnessTexturePath);
-            writeTex(material.alphaMaskTexturePath);
-            writeTex(material.normalMapTexturePath);
-            writeTex(material.emissiveTexturePath);
+            const auto materialTextures = material_textures(material);
+            writeTex(materialTextures.baseColour);
+            writeTex(materialTextures.surface);
+            writeTex(materialTextures.normalMap);
+            writeTex(materialTextures.emissive);
+
+            const std::uint32_t alphaMasked = material.alphaMaskTexturePath.empty() ? 0 : 1;
+            checked_write(out, sizeof(alphaMasked), &alphaMasked);
         }
 
         // Write mesh data
@@ -321,7 +409,9 @@ namespace {
         //    - repeat V times: vec3 position
         //    - repeat V times: vec3 normal
         //    - repeat V times: vec2 texture coordinate
+        //    - repeat V times: vec4 tangent
         //    - repeat I times: uint32_t index
+        //   Each array is preceded by zero padding to a multiple of kSectionAlignment
         const std::uint32_t meshCount = static_cast<std::uint32_t>(model.meshes.size());
         checked_write(out, sizeof(meshCount), &meshCount);
 
@@ -339,11 +429,16 @@ namespace {
             std::uint32_t indexCount = static_cast<std::uint32_t>(indexedMesh.indices.size());
             checked_write(out, sizeof(indexCount), &indexCount);
 
+            write_padding(out, kSectionAlignment);
             checked_write(out, sizeof(glm::vec3) * vertexCount, indexedMesh.vertices.data());
+            write_padding(out, kSectionAlignment);
             checked_write(out, sizeof(glm::vec3) * vertexCount, indexedMesh.normals.data());
+            write_padding(out, kSectionAlignment);
             checked_write(out, sizeof(glm::vec2) * vertexCount, indexedMesh.texCoordinates.data());
+            write_padding(out, kSectionAlignment);
             checked_write(out, sizeof(glm::vec4) * vertexCount, indexedMesh.tangent.data());
 
+            write_padding(out, kSectionAlignment);
             checked_write(out, sizeof(std::uint32_t) * indexCount, indexedMesh.indices.data());
         }
     }
@@ -381,21 +476,63 @@ namespace {
 }
 
 namespace {
+    MaterialTextures material_textures(const InputMaterialInfo& material) {
+        const ChannelSource one{.constant = 1.f};
+
+        const auto rgb = [&](const std::string& path, const TextureKind kind, const ChannelSource& alpha) {
+            return TextureRecipe{
+                .kind = kind,
+                .channels = {ChannelSource{path, 0}, ChannelSource{path, 1}, ChannelSource{path, 2}, alpha}
+            };
+        };
+
+        // See InputMaterialInfo: the alpha mask, if any, is the alpha channel of a (usually the base colour) texture
+        const bool alphaMasked = !material.alphaMaskTexturePath.empty();
+
+        return MaterialTextures{
+            .baseColour = alphaMasked
+                              ? rgb(material.baseColorTexturePath, TextureKind::colourAlpha,
+                                    ChannelSource{material.alphaMaskTexturePath, 3})
+                              : rgb(material.baseColorTexturePath, TextureKind::colour, one),
+            .surface = TextureRecipe{
+                .kind = TextureKind::surface,
+                .channels = {
+                    one, // occlusion
+                    ChannelSource{material.roughnessTexturePath, 0},
+                    ChannelSource{material.metalnessTexturePath, 0},
+                    one
+                }
+            },
+            .normalMap = rgb(material.normalMapTexturePath, TextureKind::normalMap, one),
+            .emissive = rgb(material.emissiveTexturePath, TextureKind::colour, one)
+        };
+    }
+
+    std::string recipe_key(const TextureRecipe& recipe) {
+        std::string key = std::to_string(static_cast<int>(recipe.kind));
+
+        for (const auto& channel : recipe.channels) {
+            key += '|';
+            key += channel.path.empty()
+                       ? "=" + std::to_string(channel.constant)
+                       : channel.path + ":" + std::to_string(channel.channel);
+        }
+
+        return key;
+    }
+
     std::unordered_map<std::string, TextureInfo> find_unique_textures(const InputModel& model) {
         std::unordered_map<std::string, TextureInfo> unique;
 
         std::uint32_t textureId = 0;
-        const auto addUnique = [&](const std::string& path, const std::uint8_t channels) {
-            if (path.empty()) {
-                return;
-            }
-
+        const auto addUnique = [&](const TextureRecipe& recipe) {
             const TextureInfo info{
                 .uniqueId = textureId,
-                .channels = channels
+                .channels = static_cast<std::uint8_t>(channel_count(recipe.kind)),
+                .recipe = recipe
             };
 
-            const auto [_, isNew] = unique.emplace(std::make_pair(path, info));
+            const auto [_, isNew] = unique.emplace(std::make_pair(recipe_key(recipe), info));
 
             if (isNew) {
                 ++textureId;
@@ -403,28 +540,100 @@ namespace {
         };
 
         for (const auto& material : model.materials) {
-            addUnique(material.baseColorTexturePath, 4);
-            addUnique(material.roughnessTexturePath, 1);
-            addUnique(material.metalnessTexturePath, 1);
-            addUnique(material.alphaMaskTexturePath, 4); // assume == baseColor
-            addUnique(material.normalMapTexturePath, 3); // xyz only
-            addUnique(material.emissiveTexturePath, 4);
+            const auto textures = material_textures(material);
+            addUnique(textures.baseColour);
+            addUnique(textures.surface);
+            addUnique(textures.normalMap);
+            addUnique(textures.emissive);
         }
 
         return unique;
     }
 
     std::unordered_map<std::string, TextureInfo> populate_paths(std::unordered_map<std::string, TextureInfo> textures,
-                                                               const std::filesystem::path& textureDir) {
+                                                               const std::filesystem::path& textureDir,
+                                                               const BakeOptions& options) {
+        // Name textures after their first source image. Visit them in ID order, so that the names (which have to be
+        // disambiguated if several textures share a source image) are stable across runs.
+        std::vector<TextureInfo*> ordered(textures.size());
         for (auto& entry : textures) {
-            const std::filesystem::path originalPath(entry.first);
-            const auto filename = originalPath.filename();
-            const auto newPath = textureDir / filename;
+            ordered[entry.second.uniqueId] = &entry.second;
+        }
+
+        std::unordered_set<std::string> usedNames;
+        for (auto* textureInfo : ordered) {
+            const auto& channels = textureInfo->recipe.channels;
+            const auto source = std::find_if(channels.begin(), channels.end(), [](const ChannelSource& channel) {
+                return !channel.path.empty();
+            });
+            assert(channels.end() != source);
+
+            std::string name = std::filesystem::path(source->path).stem().string();
+            if (TextureKind::surface == textureInfo->recipe.kind) {
+                name += "-orm";
+            }
+            if (!usedNames.insert(name).second) {
+                name += "-" + std::to_string(textureInfo->uniqueId);
+                usedNames.insert(name);
+            }
 
-            auto& textureInfo = entry.second;
-            textureInfo.newPath = newPath.string();
+            const auto newPath = textureDir / (name + (options.compressTextures ? ".ktx2" : ".png"));
+            textureInfo->newPath = newPath.string();
         }
 
         return textures;
     }
 }
+
+namespace {
+    void fit_textures(const InputModel& model,
+                      std::unordered_map<std::string, TextureInfo>& textures,
+                      const BakeOptions& options) {
+        const auto& budget = options.textureBudget;
+        if (0 == budget.budgetBytes && 0 == budget.maxColourSize && 0 == budget.maxNormalMapSize &&
+            0 == budget.maxSurfaceSize) {
+            return;
+        }
+
+        // Textures in ID order, with the surface area of every material that uses them
+        std::vector<TextureInfo*> ordered(textures.size());
+        std::vector<BudgetedTexture> budgeted(textures.size());
+        for (auto& entry : textures) {
+            ordered[entry.second.uniqueId] = &entry.second;
+            budgeted[entry.second.uniqueId] = BudgetedTexture{
+                .kind = entry.second.recipe.kind,
+                .extent = source_extent(entry.second.recipe)
+            };
+        }
+
+        const auto areas = material_surface_areas(model);
+        for (std::size_t i = 0; i < model.materials.size(); ++i) {
+            const auto materialTextures = material_textures(model.materials[i]);
+
+            // A texture may appear more than once in a material (e.g. the fallbacks); count its area only once
+            std::unordered_set<std::uint32_t> counted;
+            for (const auto* recipe : {
+                     &materialTextures.baseColour, &materialTextures.surface, &materialTextures.normalMap,
+                     &materialTextures.emissive
+                 }) {
+                const auto id = textures.at(recipe_key(*recipe)).uniqueId;
+                if (counted.insert(id).second) {
+                    budgeted[id].area.world += areas[i].world;
+                    budgeted[id].area.uv += areas[i].uv;
+                }
+            }
+        }
+
+        const auto levels = fit_texture_budget(budgeted, budget, options.compressTextures);
+
+        std::size_t downscaled = 0, bytes = 0;
+        for (std::size_t i = 0; i < ordered.size(); ++i) {
+            ordered[i]->firstLevel = levels[i];
+            downscaled += levels[i] > 0 ? 1 : 0;
+            bytes += baked_size_in_bytes(budgeted[i].kind, mip_extent(budgeted[i].extent, levels[i]),
+                                         options.compressTextures);
+        }
+
+        std::printf(" - texture budget: %zu textures downscaled => %zu kB on the GPU\n", downscaled, bytes / 1024);
+    }
+}
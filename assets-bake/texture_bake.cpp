@@ -0,0 +1,511 @@
+#include "texture_bake.hpp"
+
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <unordered_map>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+#include <stb_image.h>
+#include <stb_image_write.h>
+#include <glm/glm.hpp>
+#include <vulkan/vulkan_core.h>
+
+#include "bcn_encoder.hpp"
+
+#include "../vkutils/error.hpp"
+#include "../vkutils/ktx2.hpp"
+
+namespace {
+    // RGBA8, flipped vertically (first scanline is the bottom-most one)
+    struct SourceImage {
+        std::uint32_t width;
+        std::uint32_t height;
+        std::vector<std::uint8_t> rgba;
+    };
+
+    // Texels in linear space, RGBA in [0, 1]
+    struct Level {
+        std::uint32_t width;
+        std::uint32_t height;
+        std::vector<glm::vec4> texels;
+    };
+
+    struct TargetFormat {
+        BlockFormat blockFormat;
+        VkFormat vkFormat;
+        std::uint32_t sourceChannel;
+    };
+
+    TargetFormat target_format(TextureKind);
+
+    SourceImage load_source(const std::string& path);
+
+    SourceImage assemble(const TextureRecipe&);
+
+    std::size_t chain_size(std::uint32_t width, std::uint32_t height, std::uint32_t bytesPerTexel);
+
+    std::uint32_t uploaded_bytes_per_texel(std::uint32_t channels);
+
+    bool is_srgb(TextureKind);
+
+    Level decode_source(const stbi_uc* data, std::uint32_t width, std::uint32_t height, TextureKind);
+
+    std::vector<std::uint8_t> encode_rgba8(const Level&, TextureKind);
+
+    Level downsample(const Level&, TextureKind);
+
+    std::vector<std::uint8_t> data_format_descriptor(BlockFormat, bool srgb);
+
+    void checked_write(FILE* out, std::size_t bytes, const void* data);
+}
+
+std::uint32_t channel_count(const TextureKind kind) {
+    switch (kind) {
+        case TextureKind::colour:
+        case TextureKind::surface:
+            return 3;
+        case TextureKind::colourAlpha:
+            return 4;
+        case TextureKind::normalMap:
+            return 2; // xy only
+    }
+
+    throw vkutils::Error("channel_count(): unknown texture kind %d", static_cast<int>(kind));
+}
+
+TextureExtent source_extent(const TextureRecipe& recipe) {
+    TextureExtent extent{0, 0};
+
+    for (const auto& channel : recipe.channels) {
+        if (channel.path.empty()) {
+            continue;
+        }
+
+        int widthi, heighti, channelsi;
+        if (!stbi_info(channel.path.c_str(), &widthi, &heighti, &channelsi)) {
+            throw vkutils::Error("%s: unable to read texture header (%s)", channel.path.c_str(),
+                                 stbi_failure_reason());
+        }
+
+        extent.width = std::max(extent.width, static_cast<std::uint32_t>(widthi));
+        extent.height = std::max(extent.height, static_cast<std::uint32_t>(heighti));
+    }
+
+    return extent;
+}
+
+TextureExtent mip_extent(const TextureExtent extent, const std::uint32_t level) {
+    return TextureExtent{
+        .width = std::max(1u, extent.width >> std::min(level, 31u)),
+        .height = std::max(1u, extent.height >> std::min(level, 31u))
+    };
+}
+
+std::size_t baked_size_in_bytes(const TextureKind kind, const TextureExtent extent, const bool compress) {
+    if (!compress) {
+        return chain_size(extent.width, extent.height, uploaded_bytes_per_texel(channel_count(kind)));
+    }
+
+    const auto blockFormat = target_format(kind).blockFormat;
+    auto levelExtent = extent;
+    std::size_t size = compressed_size_in_bytes(blockFormat, levelExtent.width, levelExtent.height);
+    while (levelExtent.width > 1 || levelExtent.height > 1) {
+        levelExtent = mip_extent(levelExtent, 1);
+        size += compressed_size_in_bytes(blockFormat, levelExtent.width, levelExtent.height);
+    }
+    return size;
+}
+
+BakedTextureSizes bake_texture(const TextureRecipe& recipe,
+                               const std::filesystem::path& outputPath,
+                               const bool compress,
+                               const std::uint32_t firstLevel) {
+    const auto kind = recipe.kind;
+    auto source = assemble(recipe);
+
+    if (!compress) {
+        if (firstLevel > 0) {
+            // Downscale with the same (linear space) filter as the mip chain
+            auto level = decode_source(source.rgba.data(), source.width, source.height, kind);
+            for (std::uint32_t i = 0; i < firstLevel && (level.width > 1 || level.height > 1); ++i) {
+                level = downsample(level, kind);
+            }
+
+            source = SourceImage{
+                .width = level.width,
+                .height = level.height,
+                .rgba = encode_rgba8(level, kind)
+            };
+        }
+
+        // Plain image with only the channels the runtime reads; the runtime generates the mip chain
+        const auto channels = channel_count(kind);
+        const auto texelCount = static_cast<std::size_t>(source.width) * source.height;
+
+        std::vector<std::uint8_t> texels(texelCount * channels);
+        for (std::size_t i = 0; i < texelCount; ++i) {
+            std::memcpy(&texels[i * channels], &source.rgba[i * 4], channels);
+        }
+
+        stbi_flip_vertically_on_write(1);
+        if (!stbi_write_png(outputPath.string().c_str(), static_cast<int>(source.width),
+                            static_cast<int>(source.height), static_cast<int>(channels), texels.data(),
+                            static_cast<int>(source.width * channels))) {
+            throw vkutils::Error("Unable to write '%s'", outputPath.string().c_str());
+        }
+
+        return BakedTextureSizes{
+            chain_size(source.width, source.height, 4),
+            chain_size(source.width, source.height, uploaded_bytes_per_texel(channels))
+        };
+    }
+
+    std::vector<Level> levels;
+    levels.emplace_back(decode_source(source.rgba.data(), source.width, source.height, kind));
+
+    // Generate the full mip chain, down to 1x1. Every level is filtered from the previous one at full precision, and
+    // only quantized to 8 bits right before block compression.
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        levels.emplace_back(downsample(levels.back(), kind));
+    }
+
+    // Dropped levels are never encoded
+    levels.erase(levels.begin(), levels.begin() + std::min<std::size_t>(firstLevel, levels.size() - 1));
+
+    const auto target = target_format(kind);
+
+    std::vector<std::vector<std::uint8_t>> blocks(levels.size());
+    BakedTextureSizes sizes{0, 0};
+    for (std::size_t i = 0; i < levels.size(); ++i) {
+        const auto rgba = encode_rgba8(levels[i], kind);
+        blocks[i] = encode_blocks(rgba.data(), levels[i].width, levels[i].height,
+                                  target.blockFormat, target.sourceChannel);
+
+        sizes.uncompressedBytes += rgba.size();
+        sizes.gpuBytes += blocks[i].size();
+    }
+
+    // Lay out the file: header, level index, DFD, then level data from the smallest to the largest level
+    const auto levelCount = static_cast<std::uint32_t>(levels.size());
+    const std::uint64_t alignment = std::lcm<std::uint64_t>(block_size_in_bytes(target.blockFormat), 4);
+    const auto dfd = data_format_descriptor(target.blockFormat, is_srgb(kind));
+
+    // Both the header and the level index entries are multiples of 4 bytes, as the DFD must be aligned to 4
+    const std::uint64_t dfdOffset = sizeof(vkutils::ktx2::Header) + sizeof(vkutils::ktx2::LevelIndex) * levelCount;
+
+    std::vector<vkutils::ktx2::LevelIndex> levelIndex(levelCount);
+    std::uint64_t offset = dfdOffset + dfd.size();
+    for (std::uint32_t i = levelCount; i-- > 0;) {
+        offset = (offset + alignment - 1) / alignment * alignment;
+
+        levelIndex[i] = vkutils::ktx2::LevelIndex{
+            .byteOffset = offset,
+            .byteLength = blocks[i].size(),
+            .uncompressedByteLength = blocks[i].size()
+        };
+
+        offset += blocks[i].size();
+    }
+
+    vkutils::ktx2::Header header{
+        .vkFormat = static_cast<std::uint32_t>(target.vkFormat),
+        .typeSize = 1,
+        .pixelWidth = levels.front().width,
+        .pixelHeight = levels.front().height,
+        .pixelDepth = 0,
+        .layerCount = 0,
+        .faceCount = 1,
+        .levelCount = levelCount,
+        .supercompressionScheme = vkutils::ktx2::SUPERCOMPRESSION_NONE,
+        .dfdByteOffset = static_cast<std::uint32_t>(dfdOffset),
+        .dfdByteLength = static_cast<std::uint32_t>(dfd.size())
+    };
+    std::memcpy(header.identifier, vkutils::ktx2::kIdentifier, sizeof(header.identifier));
+
+    FILE* out = std::fopen(outputPath.string().c_str(), "wb");
+    if (!out) {
+        throw vkutils::Error("Unable to open '%s' for writing", outputPath.string().c_str());
+    }
+
+    try {
+        checked_write(out, sizeof(header), &header);
+        checked_write(out, sizeof(vkutils::ktx2::LevelIndex) * levelIndex.size(), levelIndex.data());
+        checked_write(out, dfd.size(), dfd.data());
+
+        std::uint64_t position = dfdOffset + dfd.size();
+        for (std::uint32_t i = levelCount; i-- > 0;) {
+            static constexpr std::uint8_t padding[16] = {};
+            checked_write(out, levelIndex[i].byteOffset - position, padding);
+
+            checked_write(out, blocks[i].size(), blocks[i].data());
+            position = levelIndex[i].byteOffset + blocks[i].size();
+        }
+    } catch (...) {
+        std::fclose(out);
+        throw;
+    }
+
+    std::fclose(out);
+
+    return sizes;
+}
+
+namespace {
+    TargetFormat target_format(const TextureKind kind) {
+        switch (kind) {
+            case TextureKind::colour:
+                return {BlockFormat::BC1, VK_FORMAT_BC1_RGB_SRGB_BLOCK, 0};
+            case TextureKind::colourAlpha:
+                return {BlockFormat::BC7, VK_FORMAT_BC7_SRGB_BLOCK, 0};
+            case TextureKind::surface:
+                return {BlockFormat::BC7, VK_FORMAT_BC7_UNORM_BLOCK, 0};
+            case TextureKind::normalMap:
+                return {BlockFormat::BC5, VK_FORMAT_BC5_UNORM_BLOCK, 0};
+        }
+
+        throw vkutils::Error("target_format(): unknown texture kind %d", static_cast<int>(kind));
+    }
+
+    SourceImage load_source(const std::string& path) {
+        // Flip images vertically. Vulkan expects the first scanline to be the bottom-most scanline. PNG et al.
+        // instead define the first scanline to be the top-most one.
+        stbi_set_flip_vertically_on_load(1);
+
+        int widthi, heighti, channelsi;
+        stbi_uc* data = stbi_load(path.c_str(), &widthi, &heighti, &channelsi, 4 /* want 4 channels = RGBA */);
+        if (!data) {
+            throw vkutils::Error("%s: unable to load texture (%s)", path.c_str(), stbi_failure_reason());
+        }
+
+        SourceImage image{
+            .width = static_cast<std::uint32_t>(widthi),
+            .height = static_cast<std::uint32_t>(heighti),
+            .rgba = std::vector<std::uint8_t>(data, data + static_cast<std::size_t>(widthi) * heighti * 4)
+        };
+
+        stbi_image_free(data);
+
+        return image;
+    }
+
+    SourceImage assemble(const TextureRecipe& recipe) {
+        std::unordered_map<std::string, SourceImage> sources;
+        for (const auto& channel : recipe.channels) {
+            if (!channel.path.empty() && !sources.contains(channel.path)) {
+                sources.emplace(channel.path, load_source(channel.path));
+            }
+        }
+
+        SourceImage image{.width = 1, .height = 1};
+        for (const auto& [_, source] : sources) {
+            image.width = std::max(image.width, source.width);
+            image.height = std::max(image.height, source.height);
+        }
+        image.rgba.resize(static_cast<std::size_t>(image.width) * image.height * 4);
+
+        for (std::size_t c = 0; c < recipe.channels.size(); ++c) {
+            const auto& channel = recipe.channels[c];
+
+            if (channel.path.empty()) {
+                const auto value = static_cast<std::uint8_t>(std::lround(std::clamp(channel.constant, 0.f, 1.f) * 255.f));
+                for (std::size_t i = c; i < image.rgba.size(); i += 4) {
+                    image.rgba[i] = value;
+                }
+                continue;
+            }
+
+            // Nearest neighbour for sources smaller than the output; typically these are the 1x1 fallbacks
+            const auto& source = sources.at(channel.path);
+            for (std::uint32_t y = 0; y < image.height; ++y) {
+                const std::size_t sy = static_cast<std::size_t>(y) * source.height / image.height;
+                for (std::uint32_t x = 0; x < image.width; ++x) {
+                    const std::size_t sx = static_cast<std::size_t>(x) * source.width / image.width;
+                    image.rgba[(static_cast<std::size_t>(y) * image.width + x) * 4 + c] =
+                        source.rgba[(sy * source.width + sx) * 4 + channel.channel];
+                }
+            }
+        }
+
+        return image;
+    }
+
+    std::size_t chain_size(std::uint32_t width, std::uint32_t height, const std::uint32_t bytesPerTexel) {
+        std::size_t size = static_cast<std::size_t>(width) * height * bytesPerTexel;
+        while (width > 1 || height > 1) {
+            width = std::max(1u, width / 2);
+            height = std::max(1u, height / 2);
+            size += static_cast<std::size_t>(width) * height * bytesPerTexel;
+        }
+        return size;
+    }
+
+    std::uint32_t uploaded_bytes_per_texel(const std::uint32_t channels) {
+        // Three channel images are expanded to RGBA8 by the runtime, as RGB8 formats are rarely sampleable
+        return 3 == channels ? 4 : channels;
+    }
+
+    bool is_srgb(const TextureKind kind) {
+        return TextureKind::colour == kind || TextureKind::colourAlpha == kind;
+    }
+
+    // sRGB transfer functions, see https://registry.khronos.org/DataFormat/specs/1.3/dataformat.1.3.html#TRANSFER_SRGB
+    float srgb_to_linear(const float value) {
+        return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+    }
+
+    float linear_to_srgb(const float value) {
+        return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+    }
+
+    Level decode_source(const stbi_uc* data, const std::uint32_t width, const std::uint32_t height,
+                        const TextureKind kind) {
+        // Decoding table for 8-bit channels; alpha is always linear
+        float toLinear[256];
+        for (int i = 0; i < 256; ++i) {
+            const float value = static_cast<float>(i) / 255.f;
+            toLinear[i] = is_srgb(kind) ? srgb_to_linear(value) : value;
+        }
+
+        Level level{
+            .width = width,
+            .height = height
+        };
+        level.texels.resize(static_cast<std::size_t>(width) * height);
+
+        for (std::size_t i = 0; i < level.texels.size(); ++i) {
+            const stbi_uc* texel = data + i * 4;
+            level.texels[i] = glm::vec4(toLinear[texel[0]], toLinear[texel[1]], toLinear[texel[2]],
+                                        static_cast<float>(texel[3]) / 255.f);
+        }
+
+        return level;
+    }
+
+    std::vector<std::uint8_t> encode_rgba8(const Level& level, const TextureKind kind) {
+        std::vector<std::uint8_t> rgba(level.texels.size() * 4);
+
+        const auto quantize = [](const float value) {
+            return static_cast<std::uint8_t>(std::lround(std::clamp(value, 0.f, 1.f) * 255.f));
+        };
+
+        for (std::size_t i = 0; i < level.texels.size(); ++i) {
+            const auto& texel = level.texels[i];
+            for (int c = 0; c < 3; ++c) {
+                rgba[i * 4 + c] = quantize(is_srgb(kind) ? linear_to_srgb(texel[c]) : texel[c]);
+            }
+            rgba[i * 4 + 3] = quantize(texel.a);
+        }
+
+        return rgba;
+    }
+
+    // 2x2 box filter. Odd dimensions clamp to the last row/column. Normal maps are renormalized after averaging so
+    // that the smaller levels do not shorten the normals.
+    Level downsample(const Level& source, const TextureKind kind) {
+        Level level{
+            .width = std::max(1u, source.width / 2),
+            .height = std::max(1u, source.height / 2),
+        };
+        level.texels.resize(static_cast<std::size_t>(level.width) * level.height);
+
+        const auto fetch = [&](const std::uint32_t x, const std::uint32_t y) {
+            return source.texels[static_cast<std::size_t>(std::min(y, source.height - 1)) * source.width +
+                                 std::min(x, source.width - 1)];
+        };
+
+        for (std::uint32_t y = 0; y < level.height; ++y) {
+            for (std::uint32_t x = 0; x < level.width; ++x) {
+                glm::vec4 average = (fetch(2 * x, 2 * y) + fetch(2 * x + 1, 2 * y) +
+                                     fetch(2 * x, 2 * y + 1) + fetch(2 * x + 1, 2 * y + 1)) * 0.25f;
+
+                if (TextureKind::normalMap == kind) {
+                    const glm::vec3 normal = glm::vec3(average) * 2.f - 1.f;
+                    if (glm::dot(normal, normal) > 1e-8f) {
+                        average = glm::vec4(glm::normalize(normal) * 0.5f + 0.5f, average.a);
+                    }
+                }
+
+                level.texels[static_cast<std::size_t>(y) * level.width + x] = average;
+            }
+        }
+
+        return level;
+    }
+
+    std::vector<std::uint8_t> data_format_descriptor(const BlockFormat format, const bool srgb) {
+        // Every BCn channel covers the whole block, with the full range of UNORM values
+        const auto sample = [](const std::uint16_t bitOffset, const std::uint16_t bitLength,
+                               const std::uint8_t channel) {
+            return vkutils::ktx2::DfdSample{
+                .bitOffset = bitOffset,
+                .bitLength = static_cast<std::uint8_t>(bitLength - 1),
+                .channelType = channel,
+                .samplePosition = {0, 0, 0, 0},
+                .sampleLower = 0,
+                .sampleUpper = 0xFFFFFFFF
+            };
+        };
+
+        std::uint8_t colorModel = 0;
+        std::vector<vkutils::ktx2::DfdSample> samples;
+        switch (format) {
+            case BlockFormat::BC1:
+                // Opaque BC1: the colour sample only, no alpha sample
+                colorModel = vkutils::ktx2::DF_MODEL_BC1A;
+                samples.emplace_back(sample(0, 64, vkutils::ktx2::DF_CHANNEL_BC_COLOR));
+                break;
+            case BlockFormat::BC4:
+                colorModel = vkutils::ktx2::DF_MODEL_BC4;
+                samples.emplace_back(sample(0, 64, vkutils::ktx2::DF_CHANNEL_BC_COLOR));
+                break;
+            case BlockFormat::BC5:
+                colorModel = vkutils::ktx2::DF_MODEL_BC5;
+                samples.emplace_back(sample(0, 64, vkutils::ktx2::DF_CHANNEL_BC5_RED));
+                samples.emplace_back(sample(64, 64, vkutils::ktx2::DF_CHANNEL_BC5_GREEN));
+                break;
+            case BlockFormat::BC7:
+                colorModel = vkutils::ktx2::DF_MODEL_BC7;
+                samples.emplace_back(sample(0, 128, vkutils::ktx2::DF_CHANNEL_BC_COLOR));
+                break;
+        }
+
+        if (samples.empty()) {
+            throw vkutils::Error("data_format_descriptor(): unknown block format %d", static_cast<int>(format));
+        }
+
+        const auto blockSize = sizeof(vkutils::ktx2::DfdBasicBlock) + sizeof(vkutils::ktx2::DfdSample) * samples.size();
+        const auto totalSize = static_cast<std::uint32_t>(sizeof(std::uint32_t) + blockSize);
+
+        const vkutils::ktx2::DfdBasicBlock block{
+            .vendorIdAndType = 0,
+            .versionNumber = vkutils::ktx2::DF_VERSION_1_3,
+            .descriptorBlockSize = static_cast<std::uint16_t>(blockSize),
+            .colorModel = colorModel,
+            .colorPrimaries = vkutils::ktx2::DF_PRIMARIES_BT709,
+            .transferFunction = srgb ? vkutils::ktx2::DF_TRANSFER_SRGB : vkutils::ktx2::DF_TRANSFER_LINEAR,
+            .flags = 0, // Straight alpha
+            .texelBlockDimension = {3, 3, 0, 0},
+            .bytesPlane = {static_cast<std::uint8_t>(block_size_in_bytes(format)), 0, 0, 0, 0, 0, 0, 0}
+        };
+
+        std::vector<std::uint8_t> dfd(totalSize);
+        std::memcpy(dfd.data(), &totalSize, sizeof(totalSize));
+        std::memcpy(dfd.data() + sizeof(totalSize), &block, sizeof(block));
+        std::memcpy(dfd.data() + sizeof(totalSize) + sizeof(block), samples.data(),
+                    sizeof(vkutils::ktx2::DfdSample) * samples.size());
+
+        return dfd;
+    }
+
+    void checked_write(FILE* out, const std::size_t bytes, const void* data) {
+        if (const auto ret = std::fwrite(data, 1, bytes, out);
+            ret != bytes) {
+            throw vkutils::Error("fwrite() failed: %zu instead of %zu", ret, bytes);
+        }
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <filesystem>
+
+#include <cstddef>
+#include <cstdint>
+
+// How a texture is used by the materials. This determines the block format it is baked to.
+enum class TextureKind {
+    colour,      // sRGB colour => BC1
+    colourAlpha, // sRGB colour with the alpha mask in its alpha channel => BC7
+    surface,     // linear R = occlusion, G = roughness, B = metalness => BC7
+    normalMap    // tangent space normal, XY only (Z is reconstructed in the shaders) => BC5
+};
+
+// Channels of a baked texture either copy one channel of a source image, or are set to a constant
+struct ChannelSource {
+    std::string path; // empty => constant
+    std::uint32_t channel = 0;
+    float constant = 1.f;
+};
+
+// Describes how to assemble a baked texture from one or more source images
+struct TextureRecipe {
+    TextureKind kind;
+    std::array<ChannelSource, 4> channels;
+};
+
+// Number of channels the runtime needs from a texture of the given kind; uncompressed textures are written with this
+// many channels
+std::uint32_t channel_count(TextureKind kind);
+
+struct TextureExtent {
+    std::uint32_t width;
+    std::uint32_t height;
+};
+
+// Size of the texture assembled from recipe, i.e. the largest of its source images. Only reads the image headers.
+TextureExtent source_extent(const TextureRecipe& recipe);
+
+// Extent of mip level of a texture whose base level is extent
+TextureExtent mip_extent(TextureExtent extent, std::uint32_t level);
+
+// GPU memory used by a texture of the given kind baked at extent, including its full mip chain
+std::size_t baked_size_in_bytes(TextureKind kind, TextureExtent extent, bool compress);
+
+struct BakedTextureSizes {
+    std::size_t uncompressedBytes; // full mip chain as uncompressed 8-bit texels
+    std::size_t gpuBytes;          // full mip chain as stored on the GPU
+};
+
+/*
+ * Assembles the texture described by recipe from its source images (sources
+ * of different sizes are resampled to the largest one), generates its full
+ * mip chain, block compresses every level and writes the result to
+ * outputPath.
+ *
+ * Mip levels are filtered in linear space: colour textures are decoded from
+ * sRGB before filtering and re-encoded afterwards, normal maps are
+ * renormalized.
+ *
+ * The output is a KTX 2.0 file (see vkutils/ktx2.hpp) with the following
+ * restrictions:
+ *  - a basic data format descriptor describing the BCn blocks, and no
+ *    key/value data. The runtime reader only relies on the VkFormat.
+ *  - always the full mip chain
+ *  - supercompressionScheme is NONE, on purpose: no zstd compressor is
+ *    bundled with this project. The runtime reader rejects supercompressed
+ *    files.
+ *
+ * If compress is false, only the assembled base level is written as a PNG with
+ * channel_count(recipe.kind) channels.
+ *
+ * firstLevel drops the largest mip levels: mip level firstLevel of the
+ * assembled texture becomes the base level of the baked texture. This is how
+ * textures are downscaled to fit a budget (see texture_budget.hpp), reusing the
+ * filtering of the mip chain.
+ */
+BakedTextureSizes bake_texture(
+    const TextureRecipe& recipe,
+    const std::filesystem::path& outputPath,
+    bool compress,
+    std::uint32_t firstLevel = 0
+);
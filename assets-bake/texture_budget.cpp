@@ -0,0 +1,125 @@
+#include "texture_budget.hpp"
+
+#include <queue>
+#include <limits>
+#include <utility>
+#include <algorithm>
+
+#include <cmath>
+#include <cstdio>
+
+#include <glm/glm.hpp>
+
+namespace {
+    std::uint32_t max_size(TextureKind kind, const TextureBudget& budget);
+
+    double texel_density(const BudgetedTexture& texture, TextureExtent extent);
+
+    bool is_reducible(TextureExtent extent);
+}
+
+std::vector<SurfaceArea> material_surface_areas(const InputModel& model) {
+    std::vector<SurfaceArea> areas(model.materials.size());
+
+    for (const auto& mesh : model.meshes) {
+        auto& area = areas[mesh.materialIndex];
+
+        // Meshes are triangle soups, see InputMeshInfo
+        for (std::size_t i = mesh.vertexStartIndex; i + 2 < mesh.vertexStartIndex + mesh.vertexCount; i += 3) {
+            const auto& p0 = model.positions[i];
+            const auto& p1 = model.positions[i + 1];
+            const auto& p2 = model.positions[i + 2];
+            area.world += 0.5 * glm::length(glm::cross(p1 - p0, p2 - p0));
+
+            const auto uv1 = model.texCoordinates[i + 1] - model.texCoordinates[i];
+            const auto uv2 = model.texCoordinates[i + 2] - model.texCoordinates[i];
+            area.uv += 0.5 * std::abs(uv1.x * uv2.y - uv1.y * uv2.x);
+        }
+    }
+
+    return areas;
+}
+
+std::vector<std::uint32_t> fit_texture_budget(const std::vector<BudgetedTexture>& textures,
+                                              const TextureBudget& budget,
+                                              const bool compress) {
+    std::vector<std::uint32_t> levels(textures.size(), 0);
+
+    const auto extent = [&](const std::size_t i) {
+        return mip_extent(textures[i].extent, levels[i]);
+    };
+
+    // Per class limits first; these are hard limits, independent of the other textures
+    for (std::size_t i = 0; i < textures.size(); ++i) {
+        const auto limit = max_size(textures[i].kind, budget);
+        while (0 != limit && std::max(extent(i).width, extent(i).height) > limit) {
+            ++levels[i];
+        }
+    }
+
+    if (0 == budget.budgetBytes) {
+        return levels;
+    }
+
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < textures.size(); ++i) {
+        total += baked_size_in_bytes(textures[i].kind, extent(i), compress);
+    }
+
+    // Highest density first. Ties are broken by index, which keeps the result stable across runs.
+    std::priority_queue<std::pair<double, std::size_t>> candidates;
+    for (std::size_t i = 0; i < textures.size(); ++i) {
+        if (is_reducible(extent(i))) {
+            candidates.emplace(texel_density(textures[i], extent(i)), i);
+        }
+    }
+
+    while (total > budget.budgetBytes && !candidates.empty()) {
+        const auto i = candidates.top().second;
+        candidates.pop();
+
+        total -= baked_size_in_bytes(textures[i].kind, extent(i), compress);
+        ++levels[i];
+        total += baked_size_in_bytes(textures[i].kind, extent(i), compress);
+
+        if (is_reducible(extent(i))) {
+            candidates.emplace(texel_density(textures[i], extent(i)), i);
+        }
+    }
+
+    if (total > budget.budgetBytes) {
+        std::printf("Warning: textures need %zu kB, which exceeds the budget of %zu kB\n",
+                    total / 1024, budget.budgetBytes / 1024);
+    }
+
+    return levels;
+}
+
+namespace {
+    std::uint32_t max_size(const TextureKind kind, const TextureBudget& budget) {
+        switch (kind) {
+            case TextureKind::colour:
+            case TextureKind::colourAlpha:
+                return budget.maxColourSize;
+            case TextureKind::normalMap:
+                return budget.maxNormalMapSize;
+            case TextureKind::surface:
+                return budget.maxSurfaceSize;
+        }
+
+        return 0;
+    }
+
+    double texel_density(const BudgetedTexture& texture, const TextureExtent extent) {
+        // Textures that cover no area, or are sampled at a single point, lose nothing when reduced
+        if (texture.area.world <= 0.0 || texture.area.uv <= 0.0) {
+            return std::numeric_limits<double>::infinity();
+        }
+
+        return static_cast<double>(extent.width) * extent.height * texture.area.uv / texture.area.world;
+    }
+
+    bool is_reducible(const TextureExtent extent) {
+        return std::max(extent.width, extent.height) >= 2 * kMinBudgetedSize;
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "input_model.hpp"
+#include "texture_bake.hpp"
+
+/*
+ * Limits applied to the baked textures. Zero means unlimited.
+ *
+ * Maximum sizes apply to the larger dimension of a texture, per class of
+ * texture: colour (base colour and emissive), normal maps and surface (the
+ * packed scalar maps).
+ */
+struct TextureBudget {
+    std::size_t budgetBytes = 0;
+
+    std::uint32_t maxColourSize = 0;
+    std::uint32_t maxNormalMapSize = 0;
+    std::uint32_t maxSurfaceSize = 0;
+};
+
+// Surface area covered by the meshes of a material, in world space and in texture space ([0, 1]^2 = 1)
+struct SurfaceArea {
+    double world = 0.0;
+    double uv = 0.0;
+};
+
+// Indexed by material
+std::vector<SurfaceArea> material_surface_areas(const InputModel& model);
+
+struct BudgetedTexture {
+    TextureKind kind;
+    TextureExtent extent; // as assembled from the sources
+    SurfaceArea area;     // of all the materials using the texture
+};
+
+/*
+ * Picks the first mip level to bake for each texture (see bake_texture), such
+ * that:
+ *  - every texture fits the maximum size of its class, then
+ *  - the total GPU size of all textures fits budget.budgetBytes.
+ *
+ * To fit the budget, textures are halved one at a time starting with the one
+ * with the highest texel density on screen, estimated as texels per unit of
+ * world space area: (width * height * uv area) / world area. Detail is thus
+ * removed where it is least likely to be visible. Textures are never reduced
+ * below kMinBudgetedSize, so a budget may be impossible to meet; in that case
+ * a warning is printed and the smallest result is returned.
+ *
+ * Returns one level per texture, in the order of textures.
+ */
+std::vector<std::uint32_t> fit_texture_budget(
+    const std::vector<BudgetedTexture>& textures,
+    const TextureBudget& budget,
+    bool compress
+);
+
+constexpr std::uint32_t kMinBudgetedSize = 16;
@@ -0,0 +1,196 @@
+#include "cull.hpp"
+
+#include <bit>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#   include <immintrin.h>
+#endif
+
+namespace {
+    constexpr std::size_t planeCount = std::tuple_size_v<decltype(culling::Frustum::planes)>;
+
+    // Index of the first box of bounds not tested yet, and where the next visible index is written
+    struct CullCursor {
+        std::size_t next;
+        std::uint32_t* out;
+    };
+
+    // Test the boxes from cursor on, as many as fit the vector width, and leave the rest to the narrower kernels
+    void cull_avx(const culling::BoundsSoA& bounds, const culling::Frustum& frustum, CullCursor& cursor);
+
+    void cull_sse(const culling::BoundsSoA& bounds, const culling::Frustum& frustum, CullCursor& cursor);
+
+    void cull_remaining(const culling::BoundsSoA& bounds, const culling::Frustum& frustum, CullCursor& cursor);
+
+    // A box is outside of a plane when its corner furthest along the normal is behind it
+    bool is_outside(const glm::vec4& plane, float cx, float cy, float cz, float ex, float ey, float ez);
+}
+
+namespace culling {
+    void cull(const BoundsSoA& bounds, const Frustum& frustum, std::vector<std::uint32_t>& visible) {
+        // Written through a pointer and trimmed afterwards, so that the kernels store unconditionally
+        visible.resize(bounds.size());
+
+        CullCursor cursor{
+            .next = 0,
+            .out = visible.data()
+        };
+
+        cull_avx(bounds, frustum, cursor);
+        cull_sse(bounds, frustum, cursor);
+        cull_remaining(bounds, frustum, cursor);
+
+        visible.resize(static_cast<std::size_t>(cursor.out - visible.data()));
+    }
+
+    void cull_scalar(const BoundsSoA& bounds, const Frustum& frustum, std::vector<std::uint32_t>& visible) {
+        visible.resize(bounds.size());
+
+        CullCursor cursor{
+            .next = 0,
+            .out = visible.data()
+        };
+
+        cull_remaining(bounds, frustum, cursor);
+
+        visible.resize(static_cast<std::size_t>(cursor.out - visible.data()));
+    }
+}
+
+namespace {
+    void cull_avx(const culling::BoundsSoA& bounds, const culling::Frustum& frustum, CullCursor& cursor) {
+#if defined(__AVX__)
+        // Per plane: normal, absolute value of the normal, and distance
+        __m256 nx[planeCount], ny[planeCount], nz[planeCount], ax[planeCount], ay[planeCount], az[planeCount],
+               d[planeCount];
+        for (std::size_t p = 0; p < planeCount; ++p) {
+            const auto& plane = frustum.planes[p];
+            nx[p] = _mm256_set1_ps(plane.x);
+            ny[p] = _mm256_set1_ps(plane.y);
+            nz[p] = _mm256_set1_ps(plane.z);
+            ax[p] = _mm256_set1_ps(std::abs(plane.x));
+            ay[p] = _mm256_set1_ps(std::abs(plane.y));
+            az[p] = _mm256_set1_ps(std::abs(plane.z));
+            d[p] = _mm256_set1_ps(plane.w);
+        }
+
+        const __m256 zero = _mm256_setzero_ps();
+        const std::size_t count = bounds.size();
+
+        for (std::size_t i = cursor.next; i + 8 <= count; i += 8) {
+            const __m256 cx = _mm256_loadu_ps(bounds.centerX.data() + i);
+            const __m256 cy = _mm256_loadu_ps(bounds.centerY.data() + i);
+            const __m256 cz = _mm256_loadu_ps(bounds.centerZ.data() + i);
+            const __m256 ex = _mm256_loadu_ps(bounds.extentX.data() + i);
+            const __m256 ey = _mm256_loadu_ps(bounds.extentY.data() + i);
+            const __m256 ez = _mm256_loadu_ps(bounds.extentZ.data() + i);
+
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (std::size_t p = 0; p < planeCount; ++p) {
+                // Same order of operations as is_outside()
+                __m256 distance = _mm256_mul_ps(nx[p], cx);
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(ny[p], cy));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(nz[p], cz));
+                distance = _mm256_add_ps(distance, d[p]);
+
+                __m256 radius = _mm256_mul_ps(ax[p], ex);
+                radius = _mm256_add_ps(radius, _mm256_mul_ps(ay[p], ey));
+                radius = _mm256_add_ps(radius, _mm256_mul_ps(az[p], ez));
+
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_GE_OQ));
+            }
+
+            for (auto mask = static_cast<std::uint32_t>(_mm256_movemask_ps(inside)); 0 != mask; mask &= mask - 1) {
+                *cursor.out++ = static_cast<std::uint32_t>(i) + static_cast<std::uint32_t>(std::countr_zero(mask));
+            }
+
+            cursor.next = i + 8;
+        }
+#else
+        (void) bounds;
+        (void) frustum;
+        (void) cursor;
+#endif
+    }
+
+    void cull_sse(const culling::BoundsSoA& bounds, const culling::Frustum& frustum, CullCursor& cursor) {
+#if defined(__SSE2__) || defined(_M_X64)
+        __m128 nx[planeCount], ny[planeCount], nz[planeCount], ax[planeCount], ay[planeCount], az[planeCount],
+               d[planeCount];
+        for (std::size_t p = 0; p < planeCount; ++p) {
+            const auto& plane = frustum.planes[p];
+            nx[p] = _mm_set1_ps(plane.x);
+            ny[p] = _mm_set1_ps(plane.y);
+            nz[p] = _mm_set1_ps(plane.z);
+            ax[p] = _mm_set1_ps(std::abs(plane.x));
+            ay[p] = _mm_set1_ps(std::abs(plane.y));
+            az[p] = _mm_set1_ps(std::abs(plane.z));
+            d[p] = _mm_set1_ps(plane.w);
+        }
+
+        const __m128 zero = _mm_setzero_ps();
+        const std::size_t count = bounds.size();
+
+        for (std::size_t i = cursor.next; i + 4 <= count; i += 4) {
+            const __m128 cx = _mm_loadu_ps(bounds.centerX.data() + i);
+            const __m128 cy = _mm_loadu_ps(bounds.centerY.data() + i);
+            const __m128 cz = _mm_loadu_ps(bounds.centerZ.data() + i);
+            const __m128 ex = _mm_loadu_ps(bounds.extentX.data() + i);
+            const __m128 ey = _mm_loadu_ps(bounds.extentY.data() + i);
+            const __m128 ez = _mm_loadu_ps(bounds.extentZ.data() + i);
+
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (std::size_t p = 0; p < planeCount; ++p) {
+                __m128 distance = _mm_mul_ps(nx[p], cx);
+                distance = _mm_add_ps(distance, _mm_mul_ps(ny[p], cy));
+                distance = _mm_add_ps(distance, _mm_mul_ps(nz[p], cz));
+                distance = _mm_add_ps(distance, d[p]);
+
+                __m128 radius = _mm_mul_ps(ax[p], ex);
+                radius = _mm_add_ps(radius, _mm_mul_ps(ay[p], ey));
+                radius = _mm_add_ps(radius, _mm_mul_ps(az[p], ez));
+
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+            }
+
+            for (auto mask = static_cast<std::uint32_t>(_mm_movemask_ps(inside)); 0 != mask; mask &= mask - 1) {
+                *cursor.out++ = static_cast<std::uint32_t>(i) + static_cast<std::uint32_t>(std::countr_zero(mask));
+            }
+
+            cursor.next = i + 4;
+        }
+#else
+        (void) bounds;
+        (void) frustum;
+        (void) cursor;
+#endif
+    }
+
+    void cull_remaining(const culling::BoundsSoA& bounds, const culling::Frustum& frustum, CullCursor& cursor) {
+        for (std::size_t i = cursor.next; i < bounds.size(); ++i) {
+            bool outside = false;
+            for (const auto& plane : frustum.planes) {
+                if (is_outside(plane, bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i],
+                               bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i])) {
+                    outside = true;
+                    break;
+                }
+            }
+
+            if (!outside) {
+                *cursor.out++ = static_cast<std::uint32_t>(i);
+            }
+        }
+
+        cursor.next = bounds.size();
+    }
+
+    bool is_outside(const glm::vec4& plane,
+                    const float cx, const float cy, const float cz,
+                    const float ex, const float ey, const float ez) {
+        const float distance = plane.x * cx + plane.y * cy + plane.z * cz + plane.w;
+        const float radius = std::abs(plane.x) * ex + std::abs(plane.y) * ey + std::abs(plane.z) * ez;
+        return distance + radius < 0.0f;
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "../vksuntemple/culling.hpp"
+
+/*
+ * CPU implementations of the frustum test of shaders/cull.comp, which culls the draws of vksuntemple on the GPU.
+ * Only benchmarked here, see main.cpp.
+ */
+namespace culling {
+    // Replaces the contents of visible with the indices of the boxes that intersect frustum, in increasing order.
+    // Conservative: boxes near the edges of the frustum may be kept while outside of it.
+    // Tests 8 boxes at a time with AVX, 4 with SSE, otherwise one at a time.
+    void cull(const BoundsSoA& bounds, const Frustum& frustum, std::vector<std::uint32_t>& visible);
+
+    // Reference implementation of cull(), one box at a time
+    void cull_scalar(const BoundsSoA& bounds, const Frustum& frustum, std::vector<std::uint32_t>& visible);
+}
@@ -0,0 +1,108 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <random>
+#include <typeinfo>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+
+#include "cull.hpp"
+
+/*
+ * Microbenchmark of culling::cull() against culling::cull_scalar().
+ *
+ * Boxes are scattered around a camera, which looks at about a quarter of them. Every frustum is tested against the
+ * same boxes; times are the best of several runs.
+ */
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    constexpr std::size_t objectCounts[] = {10'000, 100'000, 1'000'000};
+    constexpr int runs = 20;
+
+    culling::BoundsSoA scatter_boxes(std::size_t count, std::mt19937& random);
+
+    // Best time of runs calls, in nanoseconds per box
+    template <typename Cull>
+    double time_per_box(const culling::BoundsSoA& bounds, Cull&& cull);
+}
+
+int main() try {
+#	if !defined(NDEBUG)
+    std::printf("Suggest running this in release mode (it appears to be running in debug)\n");
+#	endif
+
+    std::mt19937 random(42);
+
+    // Vulkan clip space, like scene::create_uniform()
+    const glm::mat4 projection = glm::perspectiveRH_ZO(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 200.0f);
+    const glm::mat4 view = glm::lookAtRH(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    const culling::Frustum frustum = culling::extract_frustum(projection * view);
+
+    std::printf("%10s %10s %14s %14s %8s\n", "objects", "visible", "scalar ns/obj", "simd ns/obj", "speedup");
+
+    for (const auto count : objectCounts) {
+        const auto bounds = scatter_boxes(count, random);
+
+        std::vector<std::uint32_t> scalarVisible, simdVisible;
+
+        const double scalarTime = time_per_box(bounds, [&] {
+            culling::cull_scalar(bounds, frustum, scalarVisible);
+        });
+        const double simdTime = time_per_box(bounds, [&] {
+            culling::cull(bounds, frustum, simdVisible);
+        });
+
+        if (scalarVisible != simdVisible) {
+            std::fprintf(stderr, "Mismatch at %zu objects: %zu visible with scalar, %zu with SIMD\n",
+                         count, scalarVisible.size(), simdVisible.size());
+            return EXIT_FAILURE;
+        }
+
+        std::printf("%10zu %10zu %14.3f %14.3f %7.1fx\n", count, simdVisible.size(), scalarTime, simdTime,
+                    scalarTime / simdTime);
+    }
+
+    return EXIT_SUCCESS;
+} catch (const std::exception& e) {
+    std::fprintf(stderr, "Top-level exception [%s]:\n%s\nExiting.\n", typeid(e).name(), e.what());
+    return EXIT_FAILURE;
+}
+
+namespace {
+    culling::BoundsSoA scatter_boxes(const std::size_t count, std::mt19937& random) {
+        std::uniform_real_distribution<float> position(-150.0f, 150.0f);
+        std::uniform_real_distribution<float> size(0.1f, 4.0f);
+
+        culling::BoundsSoA bounds;
+        for (std::size_t i = 0; i < count; ++i) {
+            const glm::vec3 center(position(random), position(random), position(random));
+            const glm::vec3 extent(size(random), size(random), size(random));
+            bounds.push_back(center - extent, center + extent);
+        }
+
+        return bounds;
+    }
+
+    template <typename Cull>
+    double time_per_box(const culling::BoundsSoA& bounds, Cull&& cull) {
+        double best = 0.0;
+        for (int run = 0; run < runs; ++run) {
+            const auto start = Clock::now();
+            cull();
+            const double nanoseconds = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+            if (0 == run || nanoseconds < best) {
+                best = nanoseconds;
+            }
+        }
+
+        return best / static_cast<double>(bounds.size());
+    }
+}
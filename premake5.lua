@@ -117,10 +117,26 @@ project "assets-bake"
 	links "vkutils" -- for vkutils::Error
 	links "x-tgen"
 	links "x-zstd"
+	links "x-stb"
 
 	dependson "x-glm" 
 	dependson "x-rapidobj"
 
+project "culling-bench"
+	local sources = { 
+		"culling-bench/**.cpp",
+		"culling-bench/**.hpp",
+		"vksuntemple/culling.cpp",
+		"vksuntemple/culling.hpp"
+	}
+
+	kind "ConsoleApp"
+	location "culling-bench"
+
+	files( sources )
+
+	dependson "x-glm" 
+
 project "vkutils"
 	local sources = { 
 		"vkutils/**.cpp",
@@ -8,40 +8,71 @@
 namespace baked {
     // See assets-bake/main.cpp for more info
     constexpr char kFileMagic[16] = "\0\0SPICYMESH";
-    constexpr char kFileVariant[16] = "spicy";
+    constexpr char kFileVariant[16] = "spicy-aligned";
 
     constexpr std::uint32_t kMaxString = 32 * 1024;
 
-    void checked_read(FILE* input, const std::size_t bytes, void* buffer) {
-        const auto ret = std::fread(buffer, 1, bytes, input);
+    constexpr std::size_t kSectionAlignment = 16;
 
-        if (bytes != ret) {
-            throw vkutils::Error("checked_read_(): expected %zu bytes, got %zu", bytes, ret);
+    // Sequential reads from the mapped file. Every read is bounds checked.
+    struct Reader {
+        std::span<const std::byte> bytes;
+        std::size_t offset = 0;
+
+        const std::byte* take(const std::size_t count) {
+            if (count > bytes.size() - offset) {
+                throw vkutils::Error("read(): expected %zu bytes at offset %zu, file has %zu", count, offset,
+                                     bytes.size());
+            }
+
+            const auto* ret = bytes.data() + offset;
+            offset += count;
+            return ret;
         }
-    }
 
-    std::uint32_t read_uint32(FILE* input) {
-        std::uint32_t ret;
-        checked_read(input, sizeof(std::uint32_t), &ret);
-        return ret;
-    }
+        void checked_read(const std::size_t count, void* buffer) {
+            std::memcpy(buffer, take(count), count);
+        }
 
-    std::string read_string(FILE* input) {
-        const auto length = read_uint32(input);
+        std::uint32_t read_uint32() {
+            std::uint32_t ret;
+            checked_read(sizeof(std::uint32_t), &ret);
+            return ret;
+        }
+
+        std::string read_string() {
+            const auto length = read_uint32();
+
+            if (length >= kMaxString) {
+                throw vkutils::Error("read_string_(): unexpectedly long string (%u bytes)", length);
+            }
+
+            std::string ret;
+            ret.resize(length);
 
-        if (length >= kMaxString) {
-            throw vkutils::Error("read_string_(): unexpectedly long string (%u bytes)", length);
+            checked_read(length, ret.data());
+            return ret;
         }
 
-        std::string ret;
-        ret.resize(length);
+        // Array stored in place, after the padding to the next section
+        template<typename T>
+        std::span<const T> read_section(const std::uint32_t count) {
+            static_assert(kSectionAlignment % alignof(T) == 0);
 
-        checked_read(input, length, ret.data());
-        return ret;
-    }
+            offset = (offset + kSectionAlignment - 1) / kSectionAlignment * kSectionAlignment;
+            if (offset > bytes.size()) {
+                throw vkutils::Error("read_section(): section starts past the end of the file");
+            }
 
-    BakedModel load_baked_model_from_file(FILE* input, char const* inputName) {
+            // The mapping is page aligned, so aligned file offsets are aligned addresses
+            const auto* data = reinterpret_cast<const T*>(take(sizeof(T) * count));
+            return {data, count};
+        }
+    };
+
+    BakedModel load_baked_model_from_bytes(const std::span<const std::byte> bytes, char const* inputName) {
         BakedModel bakedModel;
+        Reader input{.bytes = bytes};
 
         // Figure out base path
         char const* pathBeg = inputName;
@@ -51,30 +82,31 @@ namespace baked {
 
         // Read header and verify file magic and variant
         char magic[16];
-        checked_read(input, 16, magic);
+        input.checked_read(16, magic);
 
         if (0 != std::memcmp(magic, kFileMagic, 16)) {
             throw vkutils::Error("loadBakedModelFromFile(): %s: invalid file signature!", inputName);
         }
 
         char variant[16];
-        checked_read(input, 16, variant);
+        input.checked_read(16, variant);
 
         if (0 != std::memcmp(variant, kFileVariant, 16)) {
+            variant[15] = '\0';
             throw vkutils::Error("loadBakedModelFromFile(): %s: file variant is '%s', expected '%s'", inputName,
                                  variant,
                                  kFileVariant);
         }
 
         // Read texture info
-        const auto textureCount = read_uint32(input);
+        const auto textureCount = input.read_uint32();
         for (std::uint32_t i = 0; i < textureCount; ++i) {
-            const std::string name = read_string(input);
+            const std::string name = input.read_string();
             std::uint8_t channels;
-            checked_read(input, sizeof(std::uint8_t), &channels);
+            input.checked_read(sizeof(std::uint8_t), &channels);
 
             BakedTextureInfo info{
-                .path = prefix + name,
+                .path = prefix + name.c_str(),
                 .channels = channels
             };
 
@@ -82,58 +114,49 @@ namespace baked {
         }
 
         // Read material info
-        const auto materialCount = read_uint32(input);
+        const auto materialCount = input.read_uint32();
         for (std::uint32_t i = 0; i < materialCount; ++i) {
             BakedMaterialInfo info{
-                .baseColorTextureId = read_uint32(input),
-                .roughnessTextureId = read_uint32(input),
-                .metalnessTextureId = read_uint32(input),
-                .alphaMaskTextureId = read_uint32(input),
-                .normalMapTextureId = read_uint32(input),
-                .emissiveTextureId = read_uint32(input)
+                .baseColorTextureId = input.read_uint32(),
+                .surfaceTextureId = input.read_uint32(),
+                .normalMapTextureId = input.read_uint32(),
+                .emissiveTextureId = input.read_uint32(),
+                .alphaMasked = 0 != input.read_uint32()
             };
 
-            assert(info.baseColorTextureId < bakedModel.textures.size());
-            assert(info.roughnessTextureId < bakedModel.textures.size());
-            assert(info.metalnessTextureId < bakedModel.textures.size());
-            assert(info.emissiveTextureId < bakedModel.textures.size());
+            if (info.baseColorTextureId >= textureCount || info.surfaceTextureId >= textureCount ||
+                info.normalMapTextureId >= textureCount || info.emissiveTextureId >= textureCount) {
+                throw vkutils::Error("loadBakedModelFromFile(): %s: material %u references a missing texture",
+                                     inputName, i);
+            }
 
             bakedModel.materials.emplace_back(std::move(info));
         }
 
         // Read mesh data
-        const auto meshCount = read_uint32(input);
+        const auto meshCount = input.read_uint32();
         for (std::uint32_t i = 0; i < meshCount; ++i) {
             BakedMeshData data;
-            data.materialId = read_uint32(input);
-            assert(data.materialId < bakedModel.materials.size());
-
-            const auto V = read_uint32(input);
-            const auto I = read_uint32(input);
-
-            data.positions.resize(V);
-            checked_read(input, V * sizeof(glm::vec3), data.positions.data());
-
-            data.normals.resize(V);
-            checked_read(input, V * sizeof(glm::vec3), data.normals.data());
-
-            data.texcoords.resize(V);
-            checked_read(input, V * sizeof(glm::vec2), data.texcoords.data());
-
-            data.tangents.resize(V);
-            checked_read(input, V * sizeof(glm::vec4), data.tangents.data());
-
-            data.indices.resize(I);
-            checked_read(input, I * sizeof(std::uint32_t), data.indices.data());
-
-            bakedModel.meshes.emplace_back(std::move(data));
+            data.materialId = input.read_uint32();
+            if (data.materialId >= materialCount) {
+                throw vkutils::Error("loadBakedModelFromFile(): %s: mesh %u references a missing material",
+                                     inputName, i);
+            }
+
+            const auto V = input.read_uint32();
+            const auto I = input.read_uint32();
+
+            data.positions = input.read_section<glm::vec3>(V);
+            data.normals = input.read_section<glm::vec3>(V);
+            data.texcoords = input.read_section<glm::vec2>(V);
+            data.tangents = input.read_section<glm::vec4>(V);
+            data.indices = input.read_section<std::uint32_t>(I);
+
+            bakedModel.meshes.emplace_back(data);
         }
 
         // Check
-        char byte;
-        const auto check = std::fread(&byte, 1, 1, input);
-
-        if (0 != check) {
+        if (input.offset != bytes.size()) {
             std::fprintf(stderr, "Note: '%s' contains trailing bytes\n", inputName);
         }
 
@@ -141,18 +164,10 @@ namespace baked {
     }
 
     BakedModel load_baked_model(char const* modelPath) {
-        FILE* modelFile = std::fopen(modelPath, "rb");
-        if (!modelFile) {
-            throw vkutils::Error("loadBakedModel(): unable to open '%s' for reading", modelPath);
-        }
+        mapped_file::MappedFile file(modelPath);
 
-        try {
-            auto ret = load_baked_model_from_file(modelFile, modelPath);
-            std::fclose(modelFile);
-            return ret;
-        } catch (...) {
-            std::fclose(modelFile);
-            throw;
-        }
+        auto ret = load_baked_model_from_bytes(file.bytes(), modelPath);
+        ret.file = std::move(file);
+        return ret;
     }
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <span>
 #include <string>
 #include <vector>
 
@@ -9,12 +10,14 @@
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 
+#include "mapped_file.hpp"
+
 
 /* Baked file format:
  *
  *  1. Header:
  *    - 16*char: file magic = "\0\0SPICYMESH"
- *    - 16*char: variant = "spicy" (changes later)
+ *    - 16*char: variant = "spicy-aligned"
  *
  *  2. Textures
  *    - 1*uint32_t: U = number of (unique) textures
@@ -25,12 +28,12 @@
  *  3. Material information
  *    - 1*uint32_t: M = number of materials
  *    - repeat M times:
- *      - uint32_t: base color texture index
- *      - uint32_t: roughness texture index
- *      - uint32_t: metalness texture index
- *      - uint32_t: alpha mask texture index; set to 0xffffffff if not available
- *      - uint32_t: normal map texture index; set to 0xffffffff if not available
- *      - uint32_t: emissive texture index;
+ *      - uint32_t: base color texture index; alpha mask in the alpha channel
+ *      - uint32_t: surface texture index; R = occlusion, G = roughness,
+ *                  B = metalness
+ *      - uint32_t: normal map texture index
+ *      - uint32_t: emissive texture index
+ *      - uint32_t: 1 if the material is alpha masked, 0 otherwise
  *
  *  4. Mesh data
  *    - 1*uint32_t: M = number of meshes
@@ -43,6 +46,8 @@
  *      - repeat V times: vec2 texture coordinate
  *      - repeat V times: vec4 tangent
  *      - repeat I times: uint32_t index
+ *      Each of the five arrays is preceded by zero padding, such that it starts
+ *      at a multiple of 16 bytes from the beginning of the file.
  *
  * Strings are stored as
  *   - 1*uint32_t: N = length of string in chars, including terminating \0
@@ -58,8 +63,8 @@
  *   VkImage + VmaAllocation) and VkImageViews. We only need to keep these
  *   around -- place them in a vector.
  *
- * - Create a Descriptor Set Layout for material information only. Initially,
- *   this would include three textures (base color, metalness, roughness).
+ * - Create a Descriptor Set Layout for material information only. This
+ *   includes three textures (base color, surface, normal map).
  *
  * - Create a Descriptor Set for each material. You can easily get the
  *   VkImageViews from the list in the first step by the index in the
@@ -79,30 +84,33 @@ namespace baked {
     };
 
     struct BakedMaterialInfo {
-        std::uint32_t baseColorTextureId;
-        std::uint32_t roughnessTextureId;
-        std::uint32_t metalnessTextureId;
-        std::uint32_t alphaMaskTextureId; // May be set to 0xffffffff if no alpha mask
+        std::uint32_t baseColorTextureId; // Alpha mask in the alpha channel
+        std::uint32_t surfaceTextureId;   // R = occlusion, G = roughness, B = metalness
         std::uint32_t normalMapTextureId;
         std::uint32_t emissiveTextureId;
+        bool alphaMasked;
     };
 
+    // Arrays point into the memory mapped file owned by BakedModel; they can be copied to staging memory as they are
     struct BakedMeshData {
         std::uint32_t materialId;
 
-        std::vector<glm::vec3> positions;
-        std::vector<glm::vec2> texcoords;
-        std::vector<glm::vec3> normals;
-        std::vector<glm::vec4> tangents;
+        std::span<const glm::vec3> positions;
+        std::span<const glm::vec2> texcoords;
+        std::span<const glm::vec3> normals;
+        std::span<const glm::vec4> tangents;
 
-        std::vector<std::uint32_t> indices;
+        std::span<const std::uint32_t> indices;
     };
 
     struct BakedModel {
+        mapped_file::MappedFile file;
+
         std::vector<BakedTextureInfo> textures;
         std::vector<BakedMaterialInfo> materials;
         std::vector<BakedMeshData> meshes;
     };
 
+    // Maps the file into memory and validates it. Mesh data is not copied, see BakedMeshData.
     BakedModel load_baked_model(char const* modelPath);
 }
@@ -4,7 +4,11 @@
 #	define GLM_FORCE_RADIANS
 #endif
 
+#include <algorithm>
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
 #include <vulkan/vulkan_core.h>
 
 #include <glm/glm.hpp>
@@ -22,11 +26,17 @@ namespace cfg {
     constexpr const char* opaqueShadowFragPath = SHADERDIR_ "opaque_shadow_map.frag.spv";
     constexpr const char* alphaShadowVertPath = SHADERDIR_ "alpha_shadow_map.vert.spv";
     constexpr const char* alphaShadowFragPath = SHADERDIR_ "alpha_shadow_map.frag.spv";
+    // The depth prepass shares the fragment shaders of the shadow pass
+    constexpr const char* depthPrepassVertPath = SHADERDIR_ "depth_prepass.vert.spv";
+    constexpr const char* depthPrepassAlphaVertPath = SHADERDIR_ "depth_prepass_alpha.vert.spv";
     constexpr const char* offscreenVertPath = SHADERDIR_ "offscreen.vert.spv";
     constexpr const char* offscreenOpaqueFragPath = SHADERDIR_ "offscreen_opaque.frag.spv";
     constexpr const char* offscreenAlphaFragPath = SHADERDIR_ "offscreen_alpha.frag.spv";
     constexpr const char* fullscreenVertPath = SHADERDIR_ "fullscreen.vert.spv";
     constexpr const char* fullscreenFragPath = SHADERDIR_ "fullscreen.frag.spv";
+    // Compute mip generation of uncompressed textures
+    constexpr const char* mipgenCompPath = SHADERDIR_ "mipgen.comp.spv";
+    constexpr const char* cullCompPath = SHADERDIR_ "cull.comp.spv";
 #	undef SHADERDIR_
 
     // Models
@@ -70,6 +80,45 @@ namespace cfg {
 
     constexpr VkExtent2D shadowMapExtent = {.width = 2048, .height = 2048};
 
+    // Upper bound of the staging memory used while loading, regardless of the size of the scene
+    // Must hold the largest single texture (uncompressed base level, or compressed mip chain)
+    constexpr VkDeviceSize stagingRingSize = 64 * 1024 * 1024;
+
+    // Background loading of the scene, see streaming.hpp
+    // One worker per hardware thread, leaving one for the render loop. hardware_concurrency() may return 0.
+    const unsigned int streamingWorkerCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    // Uploads issued per frame while streaming; at least one mesh and one texture are uploaded regardless
+    constexpr std::size_t streamingBytesPerFrame = 16 * 1024 * 1024;
+
+    // Block compressed textures are first uploaded from the first level at most this large (in texels)
+    constexpr std::uint32_t streamingInitialMipSize = 64;
+    // Upper bound of the device memory used by streamed textures. Lowered further to what is left of the device budget.
+    constexpr VkDeviceSize textureMemoryBudget = 512 * 1024 * 1024;
+    // Levels that may be dropped from every streamed texture to fit the budget
+    constexpr std::uint32_t maxMipBias = 8;
+    // Texture memory freed by streaming before the texture pool is compacted (once loading completes, and after that)
+    constexpr VkDeviceSize defragmentationChurn = 64 * 1024 * 1024;
+
+    // Recording of the draws of the shadow and offscreen passes into secondary command buffers, see parallel_recording.hpp
+    // Separate from the streaming workers, so that frames do not wait behind decoding
+    const unsigned int recordingWorkerCount = std::max(1u, std::thread::hardware_concurrency() / 2);
+    // Draws recorded per secondary command buffer, when the draws of a list can be split
+    constexpr std::uint32_t recordingChunkSize = 256;
+    // Keep the secondary command buffers of the draws for the following frames, until the draws, the material table,
+    // the pipelines or the framebuffers change. Culling happens on the GPU, so the visible set changes nothing.
+    // Otherwise, they are recorded every frame.
+    constexpr bool cacheDrawCommands = true;
+
+    // Lay the depth of the camera view down before the offscreen pass, so that it shades each pixel once, see
+    // prepass.hpp. Initial value, toggled at runtime.
+    constexpr bool depthPrepass = true;
+
+    // Frames recorded by the CPU while the GPU executes the previous ones, see frames.hpp
+    constexpr std::uint32_t framesInFlight = 2;
+
+    // Memory report written on demand and at exit, as <memoryReportPath>.json and <memoryReportPath>.csv
+    constexpr const char* memoryReportPath = "memory_report";
+
     // Bias matrix to transform coordinates from [-1, 1] to [0, 1]
     // Only (x, y) is shifted and scaled
     // textureProj uses position_lcs.zw as-is for depth comparison and perspective divide respectively
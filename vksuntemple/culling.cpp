@@ -0,0 +1,51 @@
+#include "culling.hpp"
+
+namespace culling {
+    std::size_t BoundsSoA::size() const {
+        return centerX.size();
+    }
+
+    void BoundsSoA::push_back(const glm::vec3& min, const glm::vec3& max) {
+        const glm::vec3 center = 0.5f * (min + max);
+        const glm::vec3 extent = 0.5f * (max - min);
+
+        centerX.emplace_back(center.x);
+        centerY.emplace_back(center.y);
+        centerZ.emplace_back(center.z);
+        extentX.emplace_back(extent.x);
+        extentY.emplace_back(extent.y);
+        extentZ.emplace_back(extent.z);
+    }
+
+    void BoundsSoA::clear() {
+        centerX.clear();
+        centerY.clear();
+        centerZ.clear();
+        extentX.clear();
+        extentY.clear();
+        extentZ.clear();
+    }
+
+    Frustum extract_frustum(const glm::mat4& viewProjection) {
+        // Rows of the matrix; a clip space position p is inside when -w <= x <= w, -w <= y <= w and 0 <= z <= w
+        const glm::mat4 rows = glm::transpose(viewProjection);
+
+        Frustum frustum{
+            .planes = {
+                rows[3] + rows[0],
+                rows[3] - rows[0],
+                rows[3] + rows[1],
+                rows[3] - rows[1],
+                rows[2],
+                rows[3] - rows[2]
+            }
+        };
+
+        // Normalised, so that the distances of the kernels are in world units
+        for (auto& plane : frustum.planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+
+        return frustum;
+    }
+}
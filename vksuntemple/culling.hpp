@@ -0,0 +1,32 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace culling {
+    /*
+     * Axis aligned boxes as centres and half extents, one array per component, so that several boxes are tested
+     * against a plane at once.
+     */
+    struct BoundsSoA {
+        std::vector<float> centerX, centerY, centerZ;
+        std::vector<float> extentX, extentY, extentZ;
+
+        std::size_t size() const;
+
+        void push_back(const glm::vec3& min, const glm::vec3& max);
+
+        void clear();
+    };
+
+    // Planes (a, b, c, d) of a view volume, with a * x + b * y + c * z + d >= 0 inside
+    struct Frustum {
+        std::array<glm::vec4, 6> planes;
+    };
+
+    // Frustum of a view-projection matrix with Vulkan clip space, i.e. depth in [0, 1]
+    Frustum extract_frustum(const glm::mat4& viewProjection);
+}
@@ -0,0 +1,85 @@
+#include "draw_order.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+
+namespace {
+    constexpr unsigned int depthBits = 16;
+    constexpr unsigned int materialBits = 16;
+
+    constexpr unsigned int radixBits = 8;
+    constexpr std::size_t radixSize = 1u << radixBits;
+}
+
+namespace draw_order {
+    std::uint64_t make_key(const float depth, const std::uint32_t materialId, const std::uint32_t drawIndex) {
+        // Behind the viewer counts as nearest; the sign bit is thus always clear
+        const auto depthKey = std::bit_cast<std::uint32_t>(std::max(depth, 0.0f)) >> (32 - depthBits);
+
+        // Materials past the bits of the key share theirs, which only loosens their grouping
+        const std::uint32_t materialKey = materialId & ((1u << materialBits) - 1);
+
+        const std::uint64_t sorted = (static_cast<std::uint64_t>(depthKey) << materialBits) | materialKey;
+        return (sorted << 32) | drawIndex;
+    }
+
+    std::uint32_t draw_index(const std::uint64_t key) {
+        return static_cast<std::uint32_t>(key);
+    }
+
+    void radix_sort(std::vector<std::uint64_t>& keys, std::vector<std::uint64_t>& scratch) {
+        scratch.resize(keys.size());
+
+        for (unsigned int shift = 32; shift < 64; shift += radixBits) {
+            std::array<std::size_t, radixSize> offsets{};
+            for (const auto key : keys) {
+                ++offsets[(key >> shift) & (radixSize - 1)];
+            }
+
+            // Every key has the same digit; the pass would not change the order
+            if (std::ranges::find(offsets, keys.size()) != offsets.end()) {
+                continue;
+            }
+
+            std::size_t offset = 0;
+            for (auto& count : offsets) {
+                const std::size_t digitCount = count;
+                count = offset;
+                offset += digitCount;
+            }
+
+            for (const auto key : keys) {
+                scratch[offsets[(key >> shift) & (radixSize - 1)]++] = key;
+            }
+
+            keys.swap(scratch);
+        }
+    }
+
+    void DrawListBuilder::build(const culling::BoundsSoA& bounds,
+                                const std::vector<std::uint32_t>& materialIds,
+                                const glm::mat4& viewProjection,
+                                std::vector<std::uint32_t>& order) {
+        assert(bounds.size() == materialIds.size());
+
+        // w of the clip space position, which is the view space depth for perspective projections
+        const glm::vec4 depthRow = glm::transpose(viewProjection)[3];
+
+        mKeys.resize(bounds.size());
+        for (std::size_t i = 0; i < bounds.size(); ++i) {
+            const float depth = depthRow.x * bounds.centerX[i] + depthRow.y * bounds.centerY[i] +
+                                depthRow.z * bounds.centerZ[i] + depthRow.w;
+            mKeys[i] = make_key(depth, materialIds[i], static_cast<std::uint32_t>(i));
+        }
+
+        radix_sort(mKeys, mScratch);
+
+        order.resize(mKeys.size());
+        for (std::size_t i = 0; i < mKeys.size(); ++i) {
+            order[i] = draw_index(mKeys[i]);
+        }
+    }
+}
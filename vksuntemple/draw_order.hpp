@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "culling.hpp"
+
+namespace draw_order {
+    /*
+     * 64-bit sort key of a draw. The upper 32 bits are sorted on: the
+     * quantised view space depth of the draw, then its material. The lower
+     * 32 bits carry the index of the draw.
+     *
+     * Depth is quantised to the upper bits of its IEEE 754 representation,
+     * which order like the (non-negative) floats they come from, with a
+     * precision relative to the depth.
+     */
+    std::uint64_t make_key(float depth, std::uint32_t materialId, std::uint32_t drawIndex);
+
+    std::uint32_t draw_index(std::uint64_t key);
+
+    // Sorts keys on their upper 32 bits, 8 bits per pass, keeping the order of equal keys. Passes over digits that
+    // all keys share are skipped. scratch is resized to the size of keys.
+    void radix_sort(std::vector<std::uint64_t>& keys, std::vector<std::uint64_t>& scratch);
+
+    /*
+     * Orders the draws of a list front to back, by the depth of the centres of their bounds as seen through
+     * viewProjection, so that the nearer draws fill the depth buffer first and hide the farther ones early.
+     * Draws at about the same depth are grouped by material.
+     */
+    class DrawListBuilder {
+    public:
+        // Replaces the contents of order with the indices of the draws, in drawing order. materialIds[i] is the
+        // material of the draw with bounds i.
+        void build(const culling::BoundsSoA& bounds,
+                   const std::vector<std::uint32_t>& materialIds,
+                   const glm::mat4& viewProjection,
+                   std::vector<std::uint32_t>& order);
+
+    private:
+        // Kept between frames, so that building does not allocate once their sizes settle
+        std::vector<std::uint64_t> mKeys;
+        std::vector<std::uint64_t> mScratch;
+    };
+}
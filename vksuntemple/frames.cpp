@@ -0,0 +1,52 @@
+#include "frames.hpp"
+
+#include <limits>
+
+#include "../vkutils/error.hpp"
+#include "../vkutils/to_string.hpp"
+#include "../vkutils/vkutil.hpp"
+
+namespace frames {
+    std::vector<Frame> create_frames(const vkutils::VulkanContext& context,
+                                     const VkCommandPool commandPool,
+                                     const std::uint32_t frameCount) {
+        std::vector<Frame> frames;
+        frames.reserve(frameCount);
+
+        for (std::uint32_t i = 0; i < frameCount; ++i) {
+            frames.emplace_back(Frame{
+                .offscreenCommandBuffer = vkutils::alloc_command_buffer(context, commandPool),
+                .fullscreenCommandBuffer = vkutils::alloc_command_buffer(context, commandPool),
+                .fence = vkutils::create_fence(context, VK_FENCE_CREATE_SIGNALED_BIT),
+                .offscreenFinished = vkutils::create_semaphore(context),
+                .swapchainImageAvailable = vkutils::create_semaphore(context),
+                .renderFinished = vkutils::create_semaphore(context)
+            });
+        }
+
+        return frames;
+    }
+
+    void wait_for_other_frames(const vkutils::VulkanContext& context,
+                               const std::vector<Frame>& frames,
+                               const std::size_t current) {
+        std::vector<VkFence> fences;
+        for (std::size_t i = 0; i < frames.size(); ++i) {
+            if (i != current) {
+                fences.emplace_back(frames[i].fence.handle);
+            }
+        }
+
+        if (fences.empty()) {
+            return;
+        }
+
+        if (const auto res = vkWaitForFences(context.device, static_cast<std::uint32_t>(fences.size()), fences.data(),
+                                             VK_TRUE, std::numeric_limits<std::uint64_t>::max());
+            VK_SUCCESS != res) {
+            throw vkutils::Error("Unable to wait for the frames in flight\n"
+                                 "vkWaitForFences() returned %s", vkutils::to_string(res).c_str()
+            );
+        }
+    }
+}
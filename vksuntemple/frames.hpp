@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <volk/volk.h>
+
+#include "../vkutils/vkobject.hpp"
+#include "../vkutils/vulkan_context.hpp"
+
+namespace frames {
+    /*
+     * Resources of one of the frames in flight, see cfg::framesInFlight.
+     *
+     * The CPU records frame N + 1 while the GPU executes frame N: a frame
+     * only waits for the frame that used the same resources
+     * cfg::framesInFlight frames earlier. Everything the CPU writes while
+     * recording a frame, command buffers and host visible buffers, thus has
+     * one copy per frame in flight. What only the GPU writes is shared, and
+     * ordered by the barriers of the commands, which execute in submission
+     * order on the graphics queue.
+     */
+    struct Frame {
+        VkCommandBuffer offscreenCommandBuffer;
+        VkCommandBuffer fullscreenCommandBuffer;
+
+        // Signalled once all commands of the frame have completed, by its last submission
+        vkutils::Fence fence;
+
+        vkutils::Semaphore offscreenFinished;
+        vkutils::Semaphore swapchainImageAvailable;
+        vkutils::Semaphore renderFinished;
+
+        // Draws of the shadow pass, depth prepass if any and offscreen pass, in this order, and the versions of what they
+        // use. Kept across the uses of the frame, see cfg::cacheDrawCommands.
+        std::span<const VkCommandBuffer> drawCommands;
+        std::size_t shadowJobCount = 0;
+        std::size_t prepassJobCount = 0;
+        bool depthPrepass = false;
+        bool drawCommandsStale = true;
+        std::uint64_t drawsVersion = 0;
+        std::uint64_t materialTableVersion = 0;
+    };
+
+    std::vector<Frame> create_frames(const vkutils::VulkanContext& context,
+                                     VkCommandPool commandPool,
+                                     std::uint32_t frameCount);
+
+    // Waits for the commands of every frame but current, whose fence is reset while it is being recorded. Resources
+    // shared by all frames may be replaced afterwards.
+    void wait_for_other_frames(const vkutils::VulkanContext& context,
+                               const std::vector<Frame>& frames,
+                               std::size_t current);
+}
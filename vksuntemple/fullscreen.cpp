@@ -97,25 +97,8 @@ namespace fullscreen {
         return vkutils::PipelineLayout(context.device, layout);
     }
 
-    void prepare_frame_command_buffer(const vkutils::VulkanWindow& vulkanWindow,
-                                      const vkutils::Fence& frameFence,
-                                      const VkCommandBuffer frameCommandBuffer) {
-        // Wait for frame fence
-        if (const auto res = vkWaitForFences(vulkanWindow.device, 1, &frameFence.handle, VK_TRUE,
-                                             std::numeric_limits<std::uint64_t>::max());
-            VK_SUCCESS != res) {
-            throw vkutils::Error("Unable to wait for frame command buffer fence\n"
-                                 "vkWaitForFences() returned %s", vkutils::to_string(res).c_str()
-            );
-        }
-
-        if (const auto res = vkResetFences(vulkanWindow.device, 1, &frameFence.handle);
-            VK_SUCCESS != res) {
-            throw vkutils::Error("Unable to reset frame command buffer fence\n"
-                                 "vkResetFences() returned %s", vkutils::to_string(res).c_str()
-            );
-        }
-
+    void prepare_frame_command_buffer(const VkCommandBuffer frameCommandBuffer) {
+        // The frame fence was waited for by offscreen::prepare_offscreen_command_buffer()
         // Begin command recording
         constexpr VkCommandBufferBeginInfo beginInfo{
             .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
@@ -270,9 +253,8 @@ namespace fullscreen {
                          VkPipelineLayout pipelineLayout,
                          VkPipeline fullscreenPipeline,
                          const VkExtent2D& imageExtent,
-                         const glsl::ScreenEffectsUniform& screeEffectsUniform,
                          VkDescriptorSet fullscreenDescriptor,
-                         VkBuffer screenEffectsUBO) {
+                         const std::uint32_t screenEffectsOffset) {
         // Begin render pass
         constexpr std::array clearValues{
             // Clear to dark gray background
@@ -288,13 +270,10 @@ namespace fullscreen {
             }
         };
 
-        // Prepare uniforms
-        screen::update_screen_effects_ubo(commandBuffer, screenEffectsUBO, screeEffectsUniform);
-
-        // Bind scene descriptor set into layout(set = 0, ...)
+        // Bind scene descriptor set into layout(set = 0, ...), at the screen effects of the frame
         vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
                                 pipelineLayout, 0, 1,
-                                &fullscreenDescriptor, 0, nullptr);
+                                &fullscreenDescriptor, 1, &screenEffectsOffset);
 
         // Create render pass command
         const VkRenderPassBeginInfo passInfo{
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
 
 #include "../vkutils/vulkan_context.hpp"
 #include "../vkutils/vulkan_window.hpp"
@@ -17,9 +18,7 @@ namespace fullscreen {
                                                   VkRenderPass renderPass,
                                                   VkPipelineLayout pipelineLayout);
 
-    void prepare_frame_command_buffer(const vkutils::VulkanWindow& vulkanWindow,
-                                      const vkutils::Fence& frameFence,
-                                      VkCommandBuffer frameCommandBuffer);
+    void prepare_frame_command_buffer(VkCommandBuffer frameCommandBuffer);
 
     void record_commands(VkCommandBuffer commandBuffer,
                          VkRenderPass renderPass,
@@ -27,10 +26,10 @@ namespace fullscreen {
                          VkPipelineLayout pipelineLayout,
                          VkPipeline fullscreenPipeline,
                          const VkExtent2D& imageExtent,
-                         const glsl::ScreenEffectsUniform& screeEffectsUniform,
                          VkDescriptorSet fullscreenDescriptor,
-                         VkBuffer screenEffectsUBO);
+                         std::uint32_t screenEffectsOffset);
 
+    // Last submission of the frame, signals frameFence
     void submit_frame_command_buffer(const vkutils::VulkanContext& context,
                                      VkCommandBuffer frameCommandBuffer,
                                      const std::array<VkSemaphore, 2>& waitSemaphores,
@@ -150,6 +150,21 @@ namespace glfw {
             case GLFW_KEY_T:
                 state->toneMappingEnabled = !state->toneMappingEnabled;
                 break;
+            case GLFW_KEY_M:
+                state->memoryReportRequested = true;
+                break;
+            default:
+                break;
+        }
+
+        // Update passes
+        switch (keyCode) {
+            case GLFW_KEY_Z:
+                state->depthPrepassEnabled = !state->depthPrepassEnabled;
+                break;
+            case GLFW_KEY_B:
+                state->passStatsRequested = true;
+                break;
             default:
                 break;
         }
@@ -0,0 +1,500 @@
+#include "gpu_culling.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+#include "../vkutils/error.hpp"
+#include "../vkutils/to_string.hpp"
+#include "../vkutils/vkutil.hpp"
+
+#include "config.hpp"
+
+namespace {
+    constexpr std::uint32_t workgroupSize = 64;
+
+    // Matches struct Draw of shaders/cull.comp (std430)
+    struct GpuDraw {
+        glm::vec3 center;
+        std::uint32_t materialId;
+        glm::vec3 extent;
+        std::uint32_t padding0;
+        std::uint32_t indexCount;
+        std::uint32_t firstIndex;
+        std::int32_t vertexOffset;
+        std::uint32_t padding1;
+    };
+
+    static_assert(sizeof(GpuDraw) == 48, "GpuDraw must match the std430 layout of shaders/cull.comp");
+
+    // Matches the push constant block of shaders/cull.comp
+    struct Culling {
+        std::array<glm::vec4, 6> planes;
+        std::uint32_t drawCount;
+        std::uint32_t compact;
+        std::uint32_t pass;
+    };
+
+    // Passes of shaders/cull.comp. Compacting runs all three, in order, otherwise only writePass runs.
+    constexpr std::uint32_t countPass = 0;
+    constexpr std::uint32_t scanPass = 1;
+    constexpr std::uint32_t writePass = 2;
+
+    constexpr VkDeviceSize commandStride = sizeof(VkDrawIndexedIndirectCommand);
+
+    std::uint32_t group_count(std::uint32_t drawCount);
+
+    vkutils::DescriptorSetLayout create_descriptor_layout(const vkutils::VulkanContext& context);
+
+    vkutils::PipelineLayout create_pipeline_layout(const vkutils::VulkanContext& context,
+                                                   const vkutils::DescriptorSetLayout& descriptorLayout);
+
+    vkutils::Pipeline create_pipeline(const vkutils::VulkanContext& context, VkPipelineLayout pipelineLayout);
+}
+
+namespace gpu_culling {
+    std::vector<DrawRange> split_draws(const IndirectDraws& draws, const std::uint32_t chunkSize) {
+        if (0 == draws.drawCount) {
+            return {};
+        }
+
+        if (draws.compact) {
+            return {DrawRange{.first = 0, .count = draws.drawCount}};
+        }
+
+        std::vector<DrawRange> ranges;
+        for (std::uint32_t first = 0; first < draws.drawCount; first += chunkSize) {
+            ranges.emplace_back(DrawRange{.first = first, .count = std::min(chunkSize, draws.drawCount - first)});
+        }
+
+        return ranges;
+    }
+
+    void draw(const VkCommandBuffer commandBuffer, const IndirectDraws& draws, const DrawRange range) {
+        if (0 == range.count) {
+            return;
+        }
+
+        const VkDeviceSize offset = range.first * commandStride;
+
+        if (draws.compact) {
+            assert(0 == range.first && draws.drawCount == range.count);
+            vkCmdDrawIndexedIndirectCount(commandBuffer,
+                                          draws.commands, 0,
+                                          draws.count, 0,
+                                          draws.drawCount, commandStride
+            );
+        } else if (draws.multiDraw) {
+            vkCmdDrawIndexedIndirect(commandBuffer, draws.commands, offset, range.count, commandStride);
+        } else {
+            // Without multiDrawIndirect, drawCount must be at most 1
+            for (std::uint32_t i = 0; i < range.count; ++i) {
+                vkCmdDrawIndexedIndirect(commandBuffer, draws.commands, offset + i * commandStride, 1, commandStride);
+            }
+        }
+    }
+
+    GpuCuller::GpuCuller(const vkutils::VulkanContext& context,
+                         const vkutils::Allocator& allocator,
+                         std::function<void()> waitForFrames)
+        : mContext(context),
+          mAllocator(allocator),
+          mWaitForFrames(std::move(waitForFrames)),
+          mDescriptorLayout(create_descriptor_layout(context)),
+          mPipelineLayout(create_pipeline_layout(context, mDescriptorLayout)),
+          mPipeline(create_pipeline(context, mPipelineLayout.handle)),
+          // One set of 5 storage buffers per list, view and frame in flight
+          mDescriptorPool(vkutils::create_descriptor_pool(context, 4 * 5 * cfg::framesInFlight,
+                                                          4 * cfg::framesInFlight)) {
+        // Both enabled by the device whenever supported
+        VkPhysicalDeviceVulkan12Features features12{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES
+        };
+        VkPhysicalDeviceFeatures2 features{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &features12
+        };
+        vkGetPhysicalDeviceFeatures2(context.physicalDevice, &features);
+
+        mCompact = VK_TRUE == features12.drawIndirectCount;
+        mMultiDraw = VK_TRUE == features.features.multiDrawIndirect;
+    }
+
+    void GpuCuller::update(const std::vector<mesh::Mesh>& opaqueMeshes,
+                           const culling::BoundsSoA& opaqueBounds,
+                           const std::vector<mesh::Mesh>& alphaMaskedMeshes,
+                           const culling::BoundsSoA& alphaMaskedBounds) {
+        // Meshes are only ever appended
+        if (opaqueMeshes.size() == mLists[static_cast<std::size_t>(List::opaque)].drawCount &&
+            alphaMaskedMeshes.size() == mLists[static_cast<std::size_t>(List::alphaMasked)].drawCount) {
+            return;
+        }
+
+        // The previous draws, and the sets referring to them, may be in use by the frames in flight
+        mWaitForFrames();
+
+        if (const auto res = vkResetDescriptorPool(mContext.device, mDescriptorPool.handle, 0); VK_SUCCESS != res) {
+            throw vkutils::Error("Unable to reset culling descriptor pool\n"
+                                 "vkResetDescriptorPool() returned %s", vkutils::to_string(res).c_str()
+            );
+        }
+
+        build_list(List::opaque, opaqueMeshes, opaqueBounds);
+        build_list(List::alphaMasked, alphaMaskedMeshes, alphaMaskedBounds);
+
+        for (const auto view : {View::camera, View::light}) {
+            for (const auto list : {List::opaque, List::alphaMasked}) {
+                build_view(view, list);
+            }
+        }
+
+        ++mVersion;
+    }
+
+    void GpuCuller::record_culling(const VkCommandBuffer commandBuffer,
+                                   const std::size_t frame,
+                                   const glm::mat4& cameraViewProjection,
+                                   const glm::mat4& lightViewProjection) {
+        assert(frame < cfg::framesInFlight);
+        if (0 == mLists[0].drawCount && 0 == mLists[1].drawCount) {
+            return;
+        }
+
+        for (const auto list : {List::opaque, List::alphaMasked}) {
+            write_order(frame, View::camera, list, cameraViewProjection);
+            write_order(frame, View::light, list, lightViewProjection);
+        }
+
+        // The draws of the previous frame, which may still be executing, read the shared commands and counts
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                             0, nullptr,
+                             0, nullptr,
+                             0, nullptr
+        );
+
+        const culling::Frustum camera = culling::extract_frustum(cameraViewProjection);
+        const culling::Frustum light = culling::extract_frustum(lightViewProjection);
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipeline.handle);
+
+        // Each pass reads what the previous one wrote
+        const VkMemoryBarrier passed{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+        };
+
+        const std::uint32_t firstPass = mCompact ? countPass : writePass;
+        for (std::uint32_t pass = firstPass; pass <= writePass; ++pass) {
+            if (firstPass != pass) {
+                vkCmdPipelineBarrier(commandBuffer,
+                                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                                     1, &passed,
+                                     0, nullptr,
+                                     0, nullptr
+                );
+            }
+
+            for (const auto view : {View::camera, View::light}) {
+                const auto& frustum = View::camera == view ? camera : light;
+
+                for (const auto list : {List::opaque, List::alphaMasked}) {
+                    const auto& listDraws = mLists[static_cast<std::size_t>(list)];
+                    const auto& viewDraws = mViews[static_cast<std::size_t>(view)][static_cast<std::size_t>(list)];
+                    if (0 == listDraws.drawCount) {
+                        continue;
+                    }
+
+                    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipelineLayout.handle,
+                                            0, 1, &viewDraws.descriptorSets[frame],
+                                            0, nullptr
+                    );
+
+                    const Culling culling{
+                        .planes = frustum.planes,
+                        .drawCount = listDraws.drawCount,
+                        .compact = mCompact ? 1u : 0u,
+                        .pass = pass
+                    };
+
+                    vkCmdPushConstants(commandBuffer, mPipelineLayout.handle, VK_SHADER_STAGE_COMPUTE_BIT,
+                                       0, sizeof(Culling), &culling);
+
+                    // One invocation per draw, but for the scan of the counts of the workgroups
+                    vkCmdDispatch(commandBuffer, scanPass == pass ? 1 : group_count(listDraws.drawCount), 1, 1);
+                }
+            }
+        }
+
+        const VkMemoryBarrier culled{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT
+        };
+
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0,
+                             1, &culled,
+                             0, nullptr,
+                             0, nullptr
+        );
+    }
+
+    const IndirectDraws& GpuCuller::draws(const View view, const List list) const {
+        return mViews[static_cast<std::size_t>(view)][static_cast<std::size_t>(list)].indirect;
+    }
+
+    std::uint64_t GpuCuller::version() const {
+        return mVersion;
+    }
+
+    void GpuCuller::build_list(const List list, const std::vector<mesh::Mesh>& meshes,
+                               const culling::BoundsSoA& bounds) {
+        auto& listDraws = mLists[static_cast<std::size_t>(list)];
+        listDraws.drawCount = static_cast<std::uint32_t>(meshes.size());
+        listDraws.bounds = bounds;
+        listDraws.materialIds.clear();
+
+        std::vector<GpuDraw> draws;
+        draws.reserve(meshes.size());
+
+        for (std::size_t i = 0; i < meshes.size(); ++i) {
+            const auto& mesh = meshes[i];
+            listDraws.materialIds.emplace_back(mesh.materialId);
+            draws.emplace_back(GpuDraw{
+                .center = {bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]},
+                .materialId = mesh.materialId,
+                .extent = {bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]},
+                .padding0 = 0,
+                .indexCount = mesh.indexCount,
+                .firstIndex = mesh.firstIndex,
+                .vertexOffset = mesh.vertexOffset,
+                .padding1 = 0
+            });
+        }
+
+        // Rewritten only when meshes are published, so kept in host visible memory
+        listDraws.draws = vkutils::create_buffer(
+            mAllocator,
+            std::max<std::size_t>(1, draws.size()) * sizeof(GpuDraw),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT
+        );
+
+        if (!draws.empty()) {
+            if (const auto res = vmaCopyMemoryToAllocation(mAllocator.allocator, draws.data(),
+                                                           listDraws.draws.allocation, 0,
+                                                           draws.size() * sizeof(GpuDraw));
+                VK_SUCCESS != res) {
+                throw vkutils::Error("Unable to write culling draws\n"
+                                     "vmaCopyMemoryToAllocation() returned %s", vkutils::to_string(res).c_str()
+                );
+            }
+        }
+    }
+
+    void GpuCuller::build_view(const View view, const List list) {
+        const auto& listDraws = mLists[static_cast<std::size_t>(list)];
+        auto& viewDraws = mViews[static_cast<std::size_t>(view)][static_cast<std::size_t>(list)];
+
+        viewDraws.commands = vkutils::create_buffer(
+            mAllocator,
+            std::max<std::size_t>(1, listDraws.drawCount) * commandStride,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            0
+        );
+        viewDraws.count = vkutils::create_buffer(
+            mAllocator,
+            sizeof(std::uint32_t),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            0
+        );
+        viewDraws.groups = vkutils::create_buffer(
+            mAllocator,
+            std::max<std::uint32_t>(1, group_count(listDraws.drawCount)) * sizeof(std::uint32_t),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            0
+        );
+        for (std::size_t frame = 0; frame < cfg::framesInFlight; ++frame) {
+            // Rewritten every frame
+            auto& order = viewDraws.orders[frame];
+            order = vkutils::create_buffer(
+                mAllocator,
+                std::max<std::size_t>(1, listDraws.drawCount) * sizeof(std::uint32_t),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT
+            );
+
+            auto& descriptorSet = viewDraws.descriptorSets[frame];
+            descriptorSet = vkutils::allocate_descriptor_set(mContext, mDescriptorPool.handle,
+                                                             mDescriptorLayout.handle);
+
+            const std::array bufferInfos{
+                VkDescriptorBufferInfo{.buffer = listDraws.draws.buffer, .range = VK_WHOLE_SIZE},
+                VkDescriptorBufferInfo{.buffer = viewDraws.commands.buffer, .range = VK_WHOLE_SIZE},
+                VkDescriptorBufferInfo{.buffer = viewDraws.count.buffer, .range = VK_WHOLE_SIZE},
+                VkDescriptorBufferInfo{.buffer = order.buffer, .range = VK_WHOLE_SIZE},
+                VkDescriptorBufferInfo{.buffer = viewDraws.groups.buffer, .range = VK_WHOLE_SIZE}
+            };
+
+            const VkWriteDescriptorSet write{
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = descriptorSet,
+                .dstBinding = 0,
+                .descriptorCount = bufferInfos.size(),
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pBufferInfo = bufferInfos.data()
+            };
+
+            vkUpdateDescriptorSets(mContext.device, 1, &write, 0, nullptr);
+        }
+
+        viewDraws.indirect = IndirectDraws{
+            .commands = viewDraws.commands.buffer,
+            .count = viewDraws.count.buffer,
+            .drawCount = listDraws.drawCount,
+            .compact = mCompact,
+            .multiDraw = mMultiDraw
+        };
+    }
+
+    void GpuCuller::write_order(const std::size_t frame,
+                                const View view,
+                                const List list,
+                                const glm::mat4& viewProjection) {
+        const auto& listDraws = mLists[static_cast<std::size_t>(list)];
+        const auto& viewDraws = mViews[static_cast<std::size_t>(view)][static_cast<std::size_t>(list)];
+        if (0 == listDraws.drawCount) {
+            return;
+        }
+
+        mDrawListBuilder.build(listDraws.bounds, listDraws.materialIds, viewProjection, mOrder);
+
+        if (const auto res = vmaCopyMemoryToAllocation(mAllocator.allocator, mOrder.data(),
+                                                       viewDraws.orders[frame].allocation, 0,
+                                                       mOrder.size() * sizeof(std::uint32_t));
+            VK_SUCCESS != res) {
+            throw vkutils::Error("Unable to write culling order\n"
+                                 "vmaCopyMemoryToAllocation() returned %s", vkutils::to_string(res).c_str()
+            );
+        }
+    }
+}
+
+namespace {
+    std::uint32_t group_count(const std::uint32_t drawCount) {
+        return (drawCount + workgroupSize - 1) / workgroupSize;
+    }
+
+    vkutils::DescriptorSetLayout create_descriptor_layout(const vkutils::VulkanContext& context) {
+        constexpr std::array bindings = {
+            // Draws
+            VkDescriptorSetLayoutBinding{
+                .binding = 0, // layout(set = ..., binding = 0)
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+            },
+            // Commands
+            VkDescriptorSetLayoutBinding{
+                .binding = 1, // layout(set = ..., binding = 1)
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+            },
+            // Count
+            VkDescriptorSetLayoutBinding{
+                .binding = 2, // layout(set = ..., binding = 2)
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+            },
+            // Order
+            VkDescriptorSetLayoutBinding{
+                .binding = 3, // layout(set = ..., binding = 3)
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+            },
+            // Groups
+            VkDescriptorSetLayoutBinding{
+                .binding = 4, // layout(set = ..., binding = 4)
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+            }
+        };
+
+        const VkDescriptorSetLayoutCreateInfo layoutInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .bindingCount = bindings.size(),
+            .pBindings = bindings.data()
+        };
+
+        VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+        if (const auto res = vkCreateDescriptorSetLayout(context.device, &layoutInfo, nullptr, &layout);
+            VK_SUCCESS != res) {
+            throw vkutils::Error("Unable to create culling descriptor set layout\n"
+                                 "vkCreateDescriptorSetLayout() returned %s", vkutils::to_string(res).c_str()
+            );
+        }
+
+        return vkutils::DescriptorSetLayout(context.device, layout);
+    }
+
+    vkutils::PipelineLayout create_pipeline_layout(const vkutils::VulkanContext& context,
+                                                   const vkutils::DescriptorSetLayout& descriptorLayout) {
+        const std::array layouts = {
+            descriptorLayout.handle, // set 0
+        };
+
+        constexpr VkPushConstantRange pushConstantRange{
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(Culling)
+        };
+
+        const VkPipelineLayoutCreateInfo layoutInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = layouts.size(),
+            .pSetLayouts = layouts.data(),
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange
+        };
+
+        VkPipelineLayout layout = VK_NULL_HANDLE;
+        if (const auto res = vkCreatePipelineLayout(context.device, &layoutInfo, nullptr, &layout);
+            VK_SUCCESS != res) {
+            throw vkutils::Error("Unable to create culling pipeline layout\n"
+                                 "vkCreatePipelineLayout() returned %s", vkutils::to_string(res).c_str());
+        }
+
+        return vkutils::PipelineLayout(context.device, layout);
+    }
+
+    vkutils::Pipeline create_pipeline(const vkutils::VulkanContext& context, const VkPipelineLayout pipelineLayout) {
+        const vkutils::ShaderModule comp = vkutils::load_shader_module(context, cfg::cullCompPath);
+
+        const VkComputePipelineCreateInfo pipelineInfo{
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .stage = VkPipelineShaderStageCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = comp.handle,
+                .pName = "main"
+            },
+            .layout = pipelineLayout
+        };
+
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        if (const auto res = vkCreateComputePipelines(context.device, VK_NULL_HANDLE,
+                                                      1, &pipelineInfo, nullptr, &pipeline);
+            VK_SUCCESS != res) {
+            throw vkutils::Error("Unable to create culling pipeline\n"
+                                 "vkCreateComputePipelines() returned %s", vkutils::to_string(res).c_str());
+        }
+
+        return vkutils::Pipeline(context.device, pipeline);
+    }
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <volk/volk.h>
+
+#include "../vkutils/allocator.hpp"
+#include "../vkutils/vkbuffer.hpp"
+#include "../vkutils/vkobject.hpp"
+#include "../vkutils/vulkan_context.hpp"
+
+#include "config.hpp"
+#include "culling.hpp"
+#include "draw_order.hpp"
+#include "mesh.hpp"
+
+namespace gpu_culling {
+    // Commands of one list of meshes culled against one frustum, see GpuCuller::record_culling()
+    struct IndirectDraws {
+        VkBuffer commands = VK_NULL_HANDLE; // VkDrawIndexedIndirectCommand, firstInstance = Mesh::materialId
+        VkBuffer count = VK_NULL_HANDLE;    // Single std::uint32_t, when compact
+        std::uint32_t drawCount = 0;        // Maximum number of commands
+        bool compact = false;
+        bool multiDraw = false;
+    };
+
+    // Commands [first, first + count) of IndirectDraws
+    struct DrawRange {
+        std::uint32_t first;
+        std::uint32_t count;
+    };
+
+    // Splits the commands of draws into ranges of at most chunkSize commands, which may be recorded separately.
+    // Compacted commands are only counted as a whole, and thus form a single range.
+    std::vector<DrawRange> split_draws(const IndirectDraws& draws, std::uint32_t chunkSize);
+
+    // Records the indirect draws of range: a single vkCmdDrawIndexedIndirectCount() when the commands are compacted,
+    // otherwise range.count fixed indirect draws of which the culled ones have no instance
+    void draw(VkCommandBuffer commandBuffer, const IndirectDraws& draws, DrawRange range);
+
+    /*
+     * Culls the meshes on the GPU (see shaders/cull.comp), into indexed indirect commands.
+     *
+     * Materials are selected by the shaders through the instance index,
+     * from the material table (see material::create_descriptor_layout()),
+     * so each list is drawn with a single indirect draw: the cost of
+     * recording a pass does not depend on the number of meshes or materials.
+     *
+     * Every frame, the draws of each view are ordered front to back (see
+     * draw_order::DrawListBuilder), so that early depth testing rejects the
+     * fragments of the farther meshes.
+     *
+     * With drawIndirectCount, the visible commands are compacted and
+     * counted, in that order; otherwise, every mesh keeps its command, and
+     * the culled ones are drawn with no instance.
+     *
+     * The orders are written by the CPU, so every frame in flight has its
+     * own. The commands are only written by the GPU, and shared.
+     */
+    class GpuCuller {
+    public:
+        enum class View : std::uint32_t {
+            camera,
+            light,
+            count
+        };
+
+        enum class List : std::uint32_t {
+            opaque,
+            alphaMasked,
+            count
+        };
+
+        // waitForFrames waits for the frames in flight, before the draws are rebuilt, see update()
+        GpuCuller(const vkutils::VulkanContext& context,
+                  const vkutils::Allocator& allocator,
+                  std::function<void()> waitForFrames);
+
+        GpuCuller(const GpuCuller&) = delete;
+
+        GpuCuller& operator=(const GpuCuller&) = delete;
+
+        // Rebuilds the draws when meshes were published since the previous call. bounds[i] is the box of meshes[i].
+        // The buffers of the previous draws are released, after waiting for the frames in flight.
+        // The commands of the current frame must not use them yet.
+        void update(const std::vector<mesh::Mesh>& opaqueMeshes,
+                    const culling::BoundsSoA& opaqueBounds,
+                    const std::vector<mesh::Mesh>& alphaMaskedMeshes,
+                    const culling::BoundsSoA& alphaMaskedBounds);
+
+        // Orders the draws of both lists for both views, and records their culling against the view frusta, outside of
+        // a render pass. The commands are visible to VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT afterwards.
+        // The orders of frame are written in place, so the previous commands of frame must have completed.
+        void record_culling(VkCommandBuffer commandBuffer,
+                            std::size_t frame,
+                            const glm::mat4& cameraViewProjection,
+                            const glm::mat4& lightViewProjection);
+
+        const IndirectDraws& draws(View view, List list) const;
+
+        // Changes whenever update() rebuilds the draws, and thus the buffers of IndirectDraws
+        std::uint64_t version() const;
+
+    private:
+        struct ListDraws {
+            std::uint32_t drawCount = 0;
+            vkutils::Buffer draws; // GpuDraw, in the order of the meshes
+            // Host copies, for ordering the draws
+            culling::BoundsSoA bounds;
+            std::vector<std::uint32_t> materialIds;
+        };
+
+        struct ViewDraws {
+            vkutils::Buffer commands;
+            vkutils::Buffer count;
+            vkutils::Buffer groups; // Visible draws, then offsets, of the workgroups of shaders/cull.comp
+            // Indices of the draws in drawing order, and the set using them, per frame in flight
+            std::array<vkutils::Buffer, cfg::framesInFlight> orders;
+            std::array<VkDescriptorSet, cfg::framesInFlight> descriptorSets{};
+            IndirectDraws indirect;
+        };
+
+        void build_list(List list, const std::vector<mesh::Mesh>& meshes, const culling::BoundsSoA& bounds);
+
+        void build_view(View view, List list);
+
+        void write_order(std::size_t frame, View view, List list, const glm::mat4& viewProjection);
+
+        const vkutils::VulkanContext& mContext;
+        const vkutils::Allocator& mAllocator;
+        std::function<void()> mWaitForFrames;
+
+        bool mCompact;
+        bool mMultiDraw;
+        std::uint64_t mVersion = 0;
+
+        vkutils::DescriptorSetLayout mDescriptorLayout;
+        vkutils::PipelineLayout mPipelineLayout;
+        vkutils::Pipeline mPipeline;
+        vkutils::DescriptorPool mDescriptorPool;
+
+        draw_order::DrawListBuilder mDrawListBuilder;
+        std::vector<std::uint32_t> mOrder;
+
+        std::array<ListDraws, static_cast<std::size_t>(List::count)> mLists;
+        std::array<std::array<ViewDraws, static_cast<std::size_t>(List::count)>,
+                   static_cast<std::size_t>(View::count)> mViews;
+    };
+}
@@ -0,0 +1,70 @@
+// Replaces the global operator new and delete, so that host allocations are counted per subsystem in the memory
+// report. Only in the application: the other users of vkutils do not link VMA, which the report depends on.
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include "../vkutils/memory_report.hpp"
+
+namespace {
+    // Precedes every block returned by operator new
+    struct alignas(std::max_align_t) AllocationHeader {
+        std::size_t size;
+        vkutils::HostSubsystem subsystem;
+    };
+
+    void* allocate(std::size_t size);
+
+    void deallocate(void* memory) noexcept;
+}
+
+void* operator new(const std::size_t size) {
+    return allocate(size);
+}
+
+void* operator new[](const std::size_t size) {
+    return allocate(size);
+}
+
+void operator delete(void* memory) noexcept {
+    deallocate(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    deallocate(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    deallocate(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+    deallocate(memory);
+}
+
+namespace {
+    void* allocate(const std::size_t size) {
+        auto* header = static_cast<AllocationHeader*>(std::malloc(sizeof(AllocationHeader) + size));
+        if (!header) {
+            throw std::bad_alloc();
+        }
+
+        // Frees are counted under the subsystem that allocated, whichever thread releases the memory
+        header->size = size;
+        header->subsystem = vkutils::current_host_subsystem();
+        vkutils::record_host_allocation(header->subsystem, size);
+
+        return header + 1;
+    }
+
+    void deallocate(void* memory) noexcept {
+        if (!memory) {
+            return;
+        }
+
+        auto* header = static_cast<AllocationHeader*>(memory) - 1;
+        vkutils::record_host_free(header->subsystem, header->size);
+        std::free(header);
+    }
+}
@@ -1,31 +1,44 @@
 #include <chrono>
 #include <cstdint>
 #include <cstdio>
+#include <span>
 #include <tuple>
 #include <vector>
 #include <volk/volk.h>
 
+#include "../vkutils/memory_report.hpp"
+#include "../vkutils/staging_ring.hpp"
 #include "../vkutils/vkbuffer.hpp"
 #include "../vkutils/vkimage.hpp"
 #include "../vkutils/vkobject.hpp"
 #include "../vkutils/vkutil.hpp"
 #include "../vkutils/vulkan_window.hpp"
 
-#include "baked_model.hpp"
 #include "config.hpp"
+#include "frames.hpp"
 #include "fullscreen.hpp"
+#include "gpu_culling.hpp"
 #include "glfw.hpp"
 #include "material.hpp"
-#include "mesh.hpp"
 #include "offscreen.hpp"
+#include "parallel_recording.hpp"
+#include "pass_stats.hpp"
+#include "prepass.hpp"
 #include "scene.hpp"
 #include "screen.hpp"
 #include "shade.hpp"
 #include "shadow.hpp"
 #include "state.hpp"
+#include "streaming.hpp"
 #include "swapchain.hpp"
+#include "uniforms.hpp"
 
 int main() try {
+    // Loading metrics are measured from here
+    const auto startClock = cfg::Clock::now();
+    bool firstFramePresented = false;
+    bool fullyLoadedReported = false;
+
     // Prepare Vulkan window
     vkutils::VulkanWindow vulkanWindow = vkutils::make_vulkan_window();
 
@@ -37,6 +50,9 @@ int main() try {
     // Create VMA allocator
     const vkutils::Allocator allocator = vkutils::create_allocator(vulkanWindow);
 
+    // Staging memory shared by all uploads
+    vkutils::StagingRing stagingRing(vulkanWindow, allocator, cfg::stagingRingSize);
+
     // Create descriptor layouts reused across shadow & offscreen passes
     const vkutils::DescriptorSetLayout sceneLayout = scene::create_descriptor_layout(vulkanWindow);
     const vkutils::DescriptorSetLayout materialLayout = material::create_descriptor_layout(vulkanWindow);
@@ -54,20 +70,34 @@ int main() try {
     const vkutils::Framebuffer shadowFramebuffer = shadow::create_shadow_framebuffer(
         vulkanWindow, shadowPass.handle, shadowView.handle);
 
-    // Intialise Offscreen Pipeline
-    const vkutils::RenderPass offscreenPass = offscreen::create_render_pass(vulkanWindow);
+    // Intialise Offscreen Pipeline, without and with the depth prepass (equal depth test, no depth writes)
+    const vkutils::RenderPass offscreenPass = offscreen::create_render_pass(vulkanWindow, false);
+    const vkutils::RenderPass offscreenAfterPrepassPass = offscreen::create_render_pass(vulkanWindow, true);
     const vkutils::DescriptorSetLayout shadeLayout = shade::create_descriptor_layout(vulkanWindow);
     const vkutils::PipelineLayout offscreenLayout = offscreen::create_pipeline_layout(
         vulkanWindow, sceneLayout, shadeLayout, materialLayout);
     vkutils::Pipeline offscreenOpaquePipeline = offscreen::create_opaque_pipeline(vulkanWindow, offscreenPass.handle,
-        offscreenLayout.handle);
+        offscreenLayout.handle, false);
     vkutils::Pipeline offscreenAlphaPipeline = offscreen::create_alpha_pipeline(vulkanWindow, offscreenPass.handle,
-        offscreenLayout.handle);
+        offscreenLayout.handle, false);
+    vkutils::Pipeline offscreenOpaqueEqualPipeline = offscreen::create_opaque_pipeline(
+        vulkanWindow, offscreenAfterPrepassPass.handle, offscreenLayout.handle, true);
+    vkutils::Pipeline offscreenAlphaEqualPipeline = offscreen::create_alpha_pipeline(
+        vulkanWindow, offscreenAfterPrepassPass.handle, offscreenLayout.handle, true);
     auto [depthBuffer, depthBufferView] = offscreen::create_depth_buffer(vulkanWindow, allocator);
     auto [offscreenImage, offscreenView] = offscreen::create_offscreen_target(vulkanWindow, allocator);
     vkutils::Framebuffer offscreenFramebuffer = offscreen::create_offscreen_framebuffer(
         vulkanWindow, offscreenPass.handle, offscreenView.handle, depthBufferView.handle);
 
+    // Initialise Depth Prepass, into the depth buffer of the offscreen pass. Shares the shadow pipeline layouts.
+    const vkutils::RenderPass depthPrepassPass = prepass::create_render_pass(vulkanWindow);
+    vkutils::Pipeline depthPrepassOpaquePipeline = prepass::create_opaque_pipeline(
+        vulkanWindow, depthPrepassPass.handle, opaqueShadowLayout.handle);
+    vkutils::Pipeline depthPrepassAlphaPipeline = prepass::create_alpha_pipeline(
+        vulkanWindow, depthPrepassPass.handle, alphaShadowLayout.handle);
+    vkutils::Framebuffer depthPrepassFramebuffer = prepass::create_framebuffer(
+        vulkanWindow, depthPrepassPass.handle, depthBufferView.handle);
+
     // Intialise Fullscreen Pipeline
     vkutils::RenderPass fullscreenPass = fullscreen::create_render_pass(vulkanWindow);
     const vkutils::DescriptorSetLayout screenDescriptorLayout = screen::create_descriptor_layout(vulkanWindow);
@@ -80,26 +110,18 @@ int main() try {
     const vkutils::CommandPool commandPool = vkutils::create_command_pool(
         vulkanWindow, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 
-    // Initialise per-frame Framebuffers and Synchronisation resources
+    // Initialise per-image Framebuffers
     std::vector<vkutils::Framebuffer> framebuffers = swapchain::create_swapchain_framebuffers(
         vulkanWindow, fullscreenPass.handle);
 
-    std::vector<VkCommandBuffer> commandBuffers;
-    std::vector<vkutils::Fence> fences;
-
-    for (std::size_t i = 0; i < framebuffers.size(); ++i) {
-        commandBuffers.emplace_back(vkutils::alloc_command_buffer(vulkanWindow, commandPool.handle));
-        fences.emplace_back(vkutils::create_fence(vulkanWindow, VK_FENCE_CREATE_SIGNALED_BIT));
-    }
+    // Initialise the command buffers and synchronisation resources of the frames in flight
+    std::vector<frames::Frame> frames = frames::create_frames(vulkanWindow, commandPool.handle, cfg::framesInFlight);
+    std::size_t frameIndex = 0;
 
-    // Initialise offscreen synchronisation resources
-    const vkutils::Fence offscreenFence = vkutils::create_fence(vulkanWindow, VK_FENCE_CREATE_SIGNALED_BIT);
-    const VkCommandBuffer offscreenCommandBuffer = vkutils::alloc_command_buffer(vulkanWindow, commandPool.handle);
-
-    // Initialise semaphores
-    vkutils::Semaphore offscreenFinished = vkutils::create_semaphore(vulkanWindow);
-    const vkutils::Semaphore swapchainImageAvailable = vkutils::create_semaphore(vulkanWindow);
-    const vkutils::Semaphore renderFinished = vkutils::create_semaphore(vulkanWindow);
+    // Called before replacing the resources shared by all frames, while recording the current one
+    const auto waitForOtherFrames = [&] {
+        frames::wait_for_other_frames(vulkanWindow, frames, frameIndex);
+    };
 
     // Initialise descriptor pool
     const vkutils::DescriptorPool descriptorPool = vkutils::create_descriptor_pool(vulkanWindow);
@@ -110,47 +132,41 @@ int main() try {
     const vkutils::Sampler screenSampler = vkutils::create_screen_sampler(vulkanWindow);
     const vkutils::Sampler shadowSampler = vkutils::create_shadow_sampler(vulkanWindow);
 
+    // Uniforms of every pass, written once per frame. The descriptor sets below select the frame by dynamic offsets.
+    uniforms::UniformRing uniformRing(vulkanWindow, allocator, cfg::framesInFlight);
+
     // Load scene data
-    vkutils::Buffer sceneUBO = scene::create_scene_ubo(allocator);
     const VkDescriptorSet sceneDescriptorSet = vkutils::allocate_descriptor_set(
         vulkanWindow, descriptorPool.handle, sceneLayout.handle);
-    scene::update_descriptor_set(vulkanWindow, sceneUBO, sceneDescriptorSet);
+    scene::update_descriptor_set(vulkanWindow, uniformRing.buffer(), sceneDescriptorSet);
 
     // Load shade descriptor
-    vkutils::Buffer shadeUbo = shade::create_shade_ubo(allocator);
     const VkDescriptorSet shadeDescriptorSet = vkutils::allocate_descriptor_set(vulkanWindow, descriptorPool.handle,
         shadeLayout.handle);
-    shade::update_descriptor_set(vulkanWindow, shadeUbo, shadeDescriptorSet, shadowSampler, shadowView.handle);
+    shade::update_descriptor_set(vulkanWindow, uniformRing.buffer(), shadeDescriptorSet, shadowSampler,
+                                 shadowView.handle);
 
     // Load screen descriptor
     const VkDescriptorSet screenDescriptorSet = vkutils::allocate_descriptor_set(vulkanWindow, descriptorPool.handle,
         screenDescriptorLayout.handle);
-    vkutils::Buffer screenEffectsUBO = screen::create_screen_effects_ubo(allocator);
     screen::update_descriptor_set(vulkanWindow, screenDescriptorSet, screenSampler, offscreenView.handle,
-                                  screenEffectsUBO);
+                                  uniformRing.buffer());
 
-    // Load model
-    const baked::BakedModel model = baked::load_baked_model(cfg::sunTempleObjZstdPath);
+    // Load the model, materials and meshes in the background. Until then, frames draw whatever is resident.
+    streaming::SceneStreamer sceneStreamer(vulkanWindow, allocator, stagingRing,
+                                           materialLayout.handle, anisotropySampler, pointSampler,
+                                           cfg::sunTempleObjZstdPath, waitForOtherFrames);
 
-    // Load materials
-    // Keeps both Images and ImageViews alive for the duration of the render loop
-    const material::MaterialStore materialStore = material::extract_materials(model, vulkanWindow, allocator);
+    // Culls the meshes into the indirect draws of the shadow and offscreen passes
+    gpu_culling::GpuCuller gpuCuller(vulkanWindow, allocator, waitForOtherFrames);
 
-    // Load 1 DescriptorSet per material
-    const std::vector<VkDescriptorSet> materialDescriptorSets = vkutils::allocate_descriptor_sets(
-        vulkanWindow, descriptorPool.handle, materialLayout.handle,
-        static_cast<std::uint32_t>(materialStore.materials.size()));
+    // GPU time and fragment shader invocations of the depth prepass and offscreen pass
+    pass_stats::PassStats passStats(vulkanWindow, cfg::framesInFlight);
 
-    for (std::size_t m = 0; m < materialStore.materials.size(); ++m) {
-        const auto& material = materialStore.materials[m];
-        const auto& materialDescriptorSet = materialDescriptorSets[m];
-
-        material::update_descriptor_set(vulkanWindow, materialDescriptorSet, material, anisotropySampler, pointSampler);
-    }
-
-    // Categorise meshes into opaque & alpha masked
-    const auto [opaqueMeshes, alphaMaskedMeshes] =
-            mesh::extract_meshes(vulkanWindow, allocator, model, materialStore.materials);
+    // Records the draws of the passes on worker threads, see frames::Frame::drawCommands
+    parallel_recording::SecondaryRecorder secondaryRecorder(vulkanWindow, cfg::recordingWorkerCount,
+                                                            cfg::framesInFlight, passStats.pipeline_statistics());
+    std::vector<parallel_recording::SecondaryJob> recordingJobs;
 
     // Render loop
     bool recreateSwapchain = false;
@@ -186,22 +202,37 @@ int main() try {
                 std::tie(offscreenImage, offscreenView) = offscreen::create_offscreen_target(vulkanWindow, allocator);
 
                 offscreenOpaquePipeline = offscreen::create_opaque_pipeline(vulkanWindow, offscreenPass.handle,
-                                                                            offscreenLayout.handle);
+                                                                            offscreenLayout.handle, false);
                 offscreenAlphaPipeline = offscreen::create_alpha_pipeline(vulkanWindow, offscreenPass.handle,
-                                                                          offscreenLayout.handle);
+                                                                          offscreenLayout.handle, false);
+                offscreenOpaqueEqualPipeline = offscreen::create_opaque_pipeline(
+                    vulkanWindow, offscreenAfterPrepassPass.handle, offscreenLayout.handle, true);
+                offscreenAlphaEqualPipeline = offscreen::create_alpha_pipeline(
+                    vulkanWindow, offscreenAfterPrepassPass.handle, offscreenLayout.handle, true);
+                depthPrepassOpaquePipeline = prepass::create_opaque_pipeline(
+                    vulkanWindow, depthPrepassPass.handle, opaqueShadowLayout.handle);
+                depthPrepassAlphaPipeline = prepass::create_alpha_pipeline(
+                    vulkanWindow, depthPrepassPass.handle, alphaShadowLayout.handle);
                 fullscreenPipeline = fullscreen::create_fullscreen_pipeline(
                     vulkanWindow, fullscreenPass.handle, fullscreenLayout.handle);
 
                 screen::update_descriptor_set(vulkanWindow, screenDescriptorSet, screenSampler,
-                                              offscreenView.handle, screenEffectsUBO);
-                shade::update_descriptor_set(vulkanWindow, shadeUbo, shadeDescriptorSet, shadowSampler,
+                                              offscreenView.handle, uniformRing.buffer());
+                shade::update_descriptor_set(vulkanWindow, uniformRing.buffer(), shadeDescriptorSet, shadowSampler,
                                              shadowView.handle);
             }
 
             offscreenFramebuffer = offscreen::create_offscreen_framebuffer(
                 vulkanWindow, offscreenPass.handle, offscreenView.handle, depthBufferView.handle);
+            depthPrepassFramebuffer = prepass::create_framebuffer(
+                vulkanWindow, depthPrepassPass.handle, depthBufferView.handle);
             framebuffers = swapchain::create_swapchain_framebuffers(vulkanWindow, fullscreenPass.handle);
 
+            // The draw commands refer to the framebuffers and pipelines
+            for (auto& frame : frames) {
+                frame.drawCommandsStale = true;
+            }
+
             recreateSwapchain = false;
             // Swapchain image has not been acquired yet, proceed with the loop
         }
@@ -219,76 +250,174 @@ int main() try {
         const glsl::ShadeUniform shadeUniform = shade::create_uniform(state);
         const glsl::ScreenEffectsUniform screenEffectsUniform = screen::create_uniform(state);
 
-        // Prepare Offscreen command buffer
-        offscreen::prepare_offscreen_command_buffer(vulkanWindow, offscreenFence, offscreenCommandBuffer);
+        // Prepare Offscreen command buffer, once the previous use of the frame has completed
+        auto& frame = frames[frameIndex];
+        const VkCommandBuffer offscreenCommandBuffer = frame.offscreenCommandBuffer;
+        offscreen::prepare_offscreen_command_buffer(vulkanWindow, frame.fence, offscreenCommandBuffer);
+
+        // Write the uniforms of the frame into its region of the ring, no longer read by the GPU
+        uniformRing.write(frameIndex, sceneUniform, shadeUniform, screenEffectsUniform);
+        const uniforms::FrameOffsets uniformOffsets = uniformRing.offsets(frameIndex);
+
+        // Whether the frame draws the depth prepass. Accumulate the pass statistics of the previous use of the frame.
+        const bool depthPrepassEnabled = state.depthPrepassEnabled;
+        passStats.begin_frame(offscreenCommandBuffer, frameIndex, depthPrepassEnabled);
+
+        // Publish what was streamed in since the previous frame. Waits for the other frames in flight before
+        // replacing the scene resources they use.
+        sceneStreamer.update(state, vulkanWindow.swapchainExtent);
+
+        if (!fullyLoadedReported && sceneStreamer.is_fully_loaded()) {
+            std::printf("Time to fully loaded: %.1f ms\n", std::chrono::duration<float, std::milli>(
+                            cfg::Clock::now() - startClock).count());
+            fullyLoadedReported = true;
+        }
+
+        if (state.memoryReportRequested) {
+            vkutils::write_memory_report(allocator, cfg::memoryReportPath);
+            std::printf("Memory report written to %s.json and %s.csv\n", cfg::memoryReportPath, cfg::memoryReportPath);
+            state.memoryReportRequested = false;
+        }
+
+        if (state.passStatsRequested) {
+            passStats.print_report();
+            state.passStatsRequested = false;
+        }
+
+        // Cull the meshes against the camera and light frusta on the GPU, into the indirect draws of each pass
+        gpuCuller.update(sceneStreamer.opaque_meshes(), sceneStreamer.opaque_bounds(),
+                         sceneStreamer.alpha_masked_meshes(), sceneStreamer.alpha_masked_bounds());
+        gpuCuller.record_culling(offscreenCommandBuffer, frameIndex, sceneUniform.VP, sceneUniform.LP);
+
+        using View = gpu_culling::GpuCuller::View;
+        using List = gpu_culling::GpuCuller::List;
+
+        // Record the draws of all passes in parallel, in the order of the passes. Kept by the frame as long as what they
+        // use is unchanged.
+        if (!cfg::cacheDrawCommands || frame.drawCommandsStale || gpuCuller.version() != frame.drawsVersion ||
+            sceneStreamer.material_table_version() != frame.materialTableVersion ||
+            depthPrepassEnabled != frame.depthPrepass) {
+            recordingJobs.clear();
+            shadow::append_draw_jobs(
+                recordingJobs,
+                shadowPass.handle,
+                shadowFramebuffer.handle,
+                opaqueShadowLayout.handle,
+                opaqueShadowPipeline.handle,
+                alphaShadowLayout.handle,
+                alphaShadowPipeline.handle,
+                sceneDescriptorSet,
+                uniformOffsets.scene,
+                sceneStreamer.geometry(),
+                gpuCuller.draws(View::light, List::opaque),
+                gpuCuller.draws(View::light, List::alphaMasked),
+                sceneStreamer.material_descriptor_set()
+            );
+            frame.shadowJobCount = recordingJobs.size();
+            if (depthPrepassEnabled) {
+                // Same draws as the shadow pass, from the camera
+                shadow::append_draw_jobs(
+                    recordingJobs,
+                    depthPrepassPass.handle,
+                    depthPrepassFramebuffer.handle,
+                    opaqueShadowLayout.handle,
+                    depthPrepassOpaquePipeline.handle,
+                    alphaShadowLayout.handle,
+                    depthPrepassAlphaPipeline.handle,
+                    sceneDescriptorSet,
+                    uniformOffsets.scene,
+                    sceneStreamer.geometry(),
+                    gpuCuller.draws(View::camera, List::opaque),
+                    gpuCuller.draws(View::camera, List::alphaMasked),
+                    sceneStreamer.material_descriptor_set()
+                );
+            }
+            frame.prepassJobCount = recordingJobs.size() - frame.shadowJobCount;
+            offscreen::append_draw_jobs(
+                recordingJobs,
+                depthPrepassEnabled ? offscreenAfterPrepassPass.handle : offscreenPass.handle,
+                offscreenFramebuffer.handle,
+                offscreenLayout.handle,
+                depthPrepassEnabled ? offscreenOpaqueEqualPipeline.handle : offscreenOpaquePipeline.handle,
+                depthPrepassEnabled ? offscreenAlphaEqualPipeline.handle : offscreenAlphaPipeline.handle,
+                sceneDescriptorSet,
+                shadeDescriptorSet,
+                uniformOffsets,
+                sceneStreamer.geometry(),
+                gpuCuller.draws(View::camera, List::opaque),
+                gpuCuller.draws(View::camera, List::alphaMasked),
+                sceneStreamer.material_descriptor_set()
+            );
+
+            frame.drawCommands = secondaryRecorder.record(
+                frameIndex, recordingJobs, cfg::cacheDrawCommands ? 0 : VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+            frame.drawCommandsStale = false;
+            frame.depthPrepass = depthPrepassEnabled;
+            frame.drawsVersion = gpuCuller.version();
+            frame.materialTableVersion = sceneStreamer.material_table_version();
+        }
 
         // Record Shadow commands
         shadow::record_commands(
             offscreenCommandBuffer,
             shadowPass.handle,
             shadowFramebuffer.handle,
-            opaqueShadowLayout.handle,
-            opaqueShadowPipeline.handle,
-            alphaShadowLayout.handle,
-            alphaShadowPipeline.handle,
-            sceneUBO.buffer,
-            sceneUniform,
-            sceneDescriptorSet,
-            opaqueMeshes,
-            alphaMaskedMeshes,
-            materialDescriptorSets
+            frame.drawCommands.first(frame.shadowJobCount)
         );
 
         // No need for explicity synchronisation here as Subpass dependencies guarantee it implicitly
         // See https://github.com/SaschaWillems/Vulkan/blob/master/examples/shadowmapping/shadowmapping.cpp#L312C1-L312C39
 
+        using pass_stats::Pass;
+
+        // Record Depth Prepass commands
+        if (depthPrepassEnabled) {
+            passStats.begin_pass(offscreenCommandBuffer, frameIndex, Pass::depthPrepass);
+            prepass::record_commands(
+                offscreenCommandBuffer,
+                depthPrepassPass.handle,
+                depthPrepassFramebuffer.handle,
+                vulkanWindow.swapchainExtent,
+                frame.drawCommands.subspan(frame.shadowJobCount, frame.prepassJobCount)
+            );
+            passStats.end_pass(offscreenCommandBuffer, frameIndex, Pass::depthPrepass);
+        }
+
         // Record Offscreen commands
+        passStats.begin_pass(offscreenCommandBuffer, frameIndex, Pass::offscreen);
         offscreen::record_commands(
             offscreenCommandBuffer,
-            offscreenPass.handle,
+            depthPrepassEnabled ? offscreenAfterPrepassPass.handle : offscreenPass.handle,
             offscreenFramebuffer.handle,
-            offscreenLayout.handle,
-            offscreenOpaquePipeline.handle,
-            offscreenAlphaPipeline.handle,
             vulkanWindow.swapchainExtent,
-            sceneUBO.buffer,
-            sceneUniform,
-            sceneDescriptorSet,
-            shadeUbo.buffer,
-            shadeUniform,
-            shadeDescriptorSet,
-            opaqueMeshes,
-            alphaMaskedMeshes,
-            materialDescriptorSets
+            frame.drawCommands.subspan(frame.shadowJobCount + frame.prepassJobCount)
         );
+        passStats.end_pass(offscreenCommandBuffer, frameIndex, Pass::offscreen);
 
         // Submit Offscreen commands
-        offscreen::submit_commands(vulkanWindow, offscreenCommandBuffer, offscreenFinished, offscreenFence);
+        offscreen::submit_commands(vulkanWindow, offscreenCommandBuffer, frame.offscreenFinished);
 
         // Acquire next swap chain image, without waiting for offscreen commands to finish
-        const std::uint32_t imageIndex = swapchain::acquire_swapchain_image(vulkanWindow, swapchainImageAvailable,
+        const std::uint32_t imageIndex = swapchain::acquire_swapchain_image(vulkanWindow, frame.swapchainImageAvailable,
                                                                             recreateSwapchain);
 
         if (recreateSwapchain) {
             // Offscreen pass was submitted but offscreenFinished is not waited for
             // Need to wait on all semaphores that were started
             // Otherwise there is a validation error in the next loop iteration
-            offscreen::wait_offscreen_early(vulkanWindow, offscreenFinished);
+            offscreen::wait_offscreen_early(vulkanWindow, frame.offscreenFinished, frame.fence);
             continue;
         }
 
-        // Retrieve per-frame pipeline resources
-        assert(static_cast<std::size_t>(imageIndex) < fences.size());
-        const vkutils::Fence& frameFence = fences[imageIndex];
-
-        assert(static_cast<std::size_t>(imageIndex) < commandBuffers.size());
+        // Retrieve per-image pipeline resources
         assert(static_cast<std::size_t>(imageIndex) < framebuffers.size());
 
-        const VkCommandBuffer frameCommandBuffer = commandBuffers[imageIndex];
+        const VkCommandBuffer frameCommandBuffer = frame.fullscreenCommandBuffer;
         const vkutils::Framebuffer& fullscreenFramebuffer = framebuffers[imageIndex];
 
         // Begin Fullscreen command buffer
-        fullscreen::prepare_frame_command_buffer(vulkanWindow, frameFence, frameCommandBuffer);
+        fullscreen::prepare_frame_command_buffer(frameCommandBuffer);
 
         // Record Fullscreen commands
         fullscreen::record_commands(
@@ -298,26 +427,40 @@ int main() try {
             fullscreenLayout.handle,
             fullscreenPipeline.handle,
             vulkanWindow.swapchainExtent,
-            screenEffectsUniform,
             screenDescriptorSet,
-            screenEffectsUBO.buffer
+            uniformOffsets.screen
         );
 
         // Submit fullscreen commands, waits for both offscreenFinished and swapchainImageAvailable
         const std::array waitSemaphores = {
-            offscreenFinished.handle, swapchainImageAvailable.handle
+            frame.offscreenFinished.handle, frame.swapchainImageAvailable.handle
         };
         fullscreen::submit_frame_command_buffer(vulkanWindow, frameCommandBuffer,
-                                                waitSemaphores, renderFinished.handle, frameFence);
+                                                waitSemaphores, frame.renderFinished.handle, frame.fence);
 
         // Present the results after renderFinished is signalled
         swapchain::present_results(vulkanWindow.presentQueue, vulkanWindow.swapchain, imageIndex,
-                                   renderFinished.handle, recreateSwapchain);
+                                   frame.renderFinished.handle, recreateSwapchain);
+
+        // The next frame records while this one executes
+        frameIndex = (frameIndex + 1) % frames.size();
+
+        if (!firstFramePresented) {
+            std::printf("Time to first frame: %.1f ms\n", std::chrono::duration<float, std::milli>(
+                            cfg::Clock::now() - startClock).count());
+            firstFramePresented = true;
+        }
     }
 
     // Cleanup takes place automatically in the destructors, but we sill need
     // to ensure that all Vulkan commands have finished before that.
     vkDeviceWaitIdle(vulkanWindow.device);
+
+    vkutils::write_memory_report(allocator, cfg::memoryReportPath);
+    std::printf("Memory report written to %s.json and %s.csv\n", cfg::memoryReportPath, cfg::memoryReportPath);
+
+    passStats.print_report();
+
     return EXIT_SUCCESS;
 } catch (std::exception const& exception) {
     std::fprintf(stderr, "\n");
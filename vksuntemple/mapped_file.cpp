@@ -0,0 +1,112 @@
+#include "mapped_file.hpp"
+
+#include <utility>
+
+#if defined(_WIN32)
+#	define WIN32_LEAN_AND_MEAN
+#	define NOMINMAX
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#endif
+
+#include "../vkutils/error.hpp"
+
+namespace mapped_file {
+#	if defined(_WIN32)
+    MappedFile::MappedFile(const std::string& path) {
+        const HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                        FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (INVALID_HANDLE_VALUE == file) {
+            throw vkutils::Error("%s: unable to open for reading", path.c_str());
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize)) {
+            CloseHandle(file);
+            throw vkutils::Error("%s: unable to query file size", path.c_str());
+        }
+
+        size = static_cast<std::size_t>(fileSize.QuadPart);
+        if (0 == size) {
+            CloseHandle(file);
+            return;
+        }
+
+        // The view keeps the mapping (and the file) alive, so the handles can be closed right away
+        const HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (!mapping) {
+            throw vkutils::Error("%s: CreateFileMapping() failed", path.c_str());
+        }
+
+        data = static_cast<const std::byte*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        CloseHandle(mapping);
+        if (!data) {
+            throw vkutils::Error("%s: MapViewOfFile() failed", path.c_str());
+        }
+    }
+
+    MappedFile::~MappedFile() {
+        if (data) {
+            UnmapViewOfFile(data);
+        }
+    }
+#	else // POSIX
+    MappedFile::MappedFile(const std::string& path) {
+        const int file = open(path.c_str(), O_RDONLY);
+        if (-1 == file) {
+            throw vkutils::Error("%s: unable to open for reading", path.c_str());
+        }
+
+        struct stat fileStat{};
+        if (0 != fstat(file, &fileStat)) {
+            close(file);
+            throw vkutils::Error("%s: unable to query file size", path.c_str());
+        }
+
+        size = static_cast<std::size_t>(fileStat.st_size);
+        if (0 == size) {
+            close(file);
+            return;
+        }
+
+        // The mapping keeps the file alive, so the descriptor can be closed right away
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+        close(file);
+        if (MAP_FAILED == mapping) {
+            throw vkutils::Error("%s: mmap() failed", path.c_str());
+        }
+
+        // The whole file is read front to back once while loading
+        madvise(mapping, size, MADV_SEQUENTIAL);
+
+        data = static_cast<const std::byte*>(mapping);
+    }
+
+    MappedFile::~MappedFile() {
+        if (data) {
+            munmap(const_cast<std::byte*>(data), size);
+        }
+    }
+#	endif // ~ POSIX
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept : data(std::exchange(other.data, nullptr)),
+                                                          size(std::exchange(other.size, 0)) {
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            std::swap(data, other.data);
+            std::swap(size, other.size);
+        }
+        return *this;
+    }
+
+    std::span<const std::byte> MappedFile::bytes() const {
+        return {data, data ? size : 0};
+    }
+}
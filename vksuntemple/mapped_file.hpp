@@ -0,0 +1,33 @@
+#pragma once
+
+#include <span>
+#include <string>
+
+#include <cstddef>
+
+namespace mapped_file {
+    // Read-only memory mapping of a whole file; the mapping lives as long as the object
+    class MappedFile {
+    public:
+        MappedFile() noexcept = default;
+
+        explicit MappedFile(const std::string& path);
+
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        MappedFile(MappedFile&& other) noexcept;
+
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+        // Page aligned
+        std::span<const std::byte> bytes() const;
+
+    private:
+        const std::byte* data = nullptr;
+        std::size_t size = 0;
+    };
+}
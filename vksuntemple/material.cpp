@@ -1,6 +1,8 @@
 #include "material.hpp"
 
+#include <algorithm>
 #include <array>
+#include <cassert>
 
 #include "config.hpp"
 #include "texture.hpp"
@@ -9,129 +11,183 @@
 
 namespace material {
     bool Material::is_alpha_masked() const {
-        return alphaMask.has_value();
+        return alphaMasked;
     }
 
-    void load_material_texture(const baked::BakedModel& model,
-                               const std::uint32_t textureId,
-                               const VkFormat format,
-                               const vkutils::VulkanContext& context,
-                               const vkutils::Allocator& allocator,
-                               const vkutils::CommandPool& loadCommandPool,
-                               std::vector<vkutils::Image>& textures) {
-        if (textures[textureId].image != VK_NULL_HANDLE) {
-            return;
+    DecodedTexture decode_texture(const baked::BakedTextureInfo& bakedTexture) {
+        if (texture::is_compressed_texture(bakedTexture.path)) {
+            return texture::CompressedTexture(bakedTexture.path);
         }
 
-        const auto bakedTexture = model.textures[textureId];
-        textures[textureId] = texture_to_image(
-            context, texture::Texture(bakedTexture.path), format, allocator, loadCommandPool);
+        // Only the channels recorded by the baker are decoded, e.g. R8G8 for normal maps
+        return texture::Texture(bakedTexture.path, bakedTexture.channels);
     }
 
-    MaterialStore extract_materials(const baked::BakedModel& model,
-                                    const vkutils::VulkanContext& context,
-                                    const vkutils::Allocator& allocator) {
-        std::vector<vkutils::Image> textures;
-        textures.resize(model.textures.size());
-        std::vector<Material> materials;
-        materials.reserve(model.materials.size());
-        const vkutils::CommandPool loadCommandPool = vkutils::create_command_pool(
-            context, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
-
-        for (const auto& modelMaterial : model.materials) {
-            load_material_texture(model, modelMaterial.baseColorTextureId, Material::COLOUR_FORMAT,
-                                  context, allocator, loadCommandPool, textures);
-            load_material_texture(model, modelMaterial.roughnessTextureId, Material::LINEAR_FORMAT,
-                                  context, allocator, loadCommandPool, textures);
-            load_material_texture(model, modelMaterial.metalnessTextureId, Material::LINEAR_FORMAT,
-                                  context, allocator, loadCommandPool, textures);
-            load_material_texture(model, modelMaterial.normalMapTextureId, Material::LINEAR_FORMAT,
-                                  context, allocator, loadCommandPool, textures);
-            if (modelMaterial.alphaMaskTextureId != baked::NO_ID) {
-                load_material_texture(model, modelMaterial.alphaMaskTextureId, Material::COLOUR_FORMAT,
-                                      context, allocator, loadCommandPool, textures);
-            }
+    std::size_t decoded_size_in_bytes(const DecodedTexture& decoded) {
+        if (const auto* compressed = std::get_if<texture::CompressedTexture>(&decoded)) {
+            return compressed->data.size();
+        }
 
-            assert(textures[modelMaterial.baseColorTextureId].image != VK_NULL_HANDLE);
-            assert(textures[modelMaterial.roughnessTextureId].image != VK_NULL_HANDLE);
-            assert(textures[modelMaterial.metalnessTextureId].image != VK_NULL_HANDLE);
-            assert(textures[modelMaterial.normalMapTextureId].image != VK_NULL_HANDLE);
-            if (modelMaterial.alphaMaskTextureId != baked::NO_ID) {
-                assert(textures[modelMaterial.alphaMaskTextureId].image != VK_NULL_HANDLE);
-            }
+        return std::get<texture::Texture>(decoded).sizeInBytes();
+    }
 
-            // Marked as [[maybe_unused]] to avoid generating warnings in release mode
-            // Variable is only accessed by assert(...) calls, only relevant in debug mode
-            [[maybe_unused]] const auto& material = materials.emplace_back(Material{
-                .baseColour = vkutils::image_to_view(context, textures[modelMaterial.baseColorTextureId].image,
-                                                     Material::COLOUR_FORMAT),
-                .roughness = vkutils::image_to_view(context, textures[modelMaterial.roughnessTextureId].image,
-                                                    Material::LINEAR_FORMAT),
-                .metalness = vkutils::image_to_view(context, textures[modelMaterial.metalnessTextureId].image,
-                                                    Material::LINEAR_FORMAT),
-                .normalMap = vkutils::image_to_view(context, textures[modelMaterial.normalMapTextureId].image,
-                                                    Material::LINEAR_FORMAT),
-                .alphaMask = modelMaterial.alphaMaskTextureId != baked::NO_ID
-                                 ? std::make_optional(
-                                     vkutils::image_to_view(context, textures[modelMaterial.alphaMaskTextureId].image,
-                                                            Material::COLOUR_FORMAT))
-                                 : std::nullopt
-            });
-
-            assert(material.baseColour.handle != VK_NULL_HANDLE);
-            assert(material.roughness.handle != VK_NULL_HANDLE);
-            assert(material.metalness.handle != VK_NULL_HANDLE);
-            assert(material.normalMap.handle != VK_NULL_HANDLE);
-            assert(material.alphaMask.has_value() == (modelMaterial.alphaMaskTextureId != baked::NO_ID));
+    std::pair<vkutils::Image, VkFormat> upload_texture(const vkutils::VulkanContext& context,
+                                                       const DecodedTexture& decoded,
+                                                       const bool srgb,
+                                                       const vkutils::Allocator& allocator,
+                                                       vkutils::UploadBatch& batch,
+                                                       mipgen::MipGenerator& mipGenerator,
+                                                       const vkutils::CommandPool& loadCommandPool) {
+        if (const auto* compressed = std::get_if<texture::CompressedTexture>(&decoded)) {
+            // Block compressed textures carry their own format. They only need copies, done on the transfer queue.
+            return {compressed_texture_to_image(context, *compressed, allocator, batch), compressed->format};
         }
 
-        return MaterialStore{
-            .textures = std::move(textures),
-            .materials = std::move(materials)
+        // Mip generation runs on the graphics queue, with a compute shader or blits
+        const auto& texture = std::get<texture::Texture>(decoded);
+        const auto format = texture::texture_format(texture, srgb);
+        return {texture_to_image(context, texture, format, allocator, batch, mipGenerator, loadCommandPool), format};
+    }
+
+    Material create_material(const vkutils::VulkanContext& context,
+                             const baked::BakedMaterialInfo& bakedMaterial,
+                             const std::vector<vkutils::Image>& textures,
+                             const std::vector<VkFormat>& formats) {
+        assert(textures[bakedMaterial.baseColorTextureId].image != VK_NULL_HANDLE);
+        assert(textures[bakedMaterial.surfaceTextureId].image != VK_NULL_HANDLE);
+        assert(textures[bakedMaterial.normalMapTextureId].image != VK_NULL_HANDLE);
+
+        const auto view = [&](const std::uint32_t textureId) {
+            return vkutils::image_to_view(context, textures[textureId].image, formats[textureId],
+                                          texture::texture_swizzle(formats[textureId]));
         };
+
+        Material material{
+            .baseColour = view(bakedMaterial.baseColorTextureId),
+            .surface = view(bakedMaterial.surfaceTextureId),
+            .normalMap = view(bakedMaterial.normalMapTextureId),
+            .alphaMasked = bakedMaterial.alphaMasked
+        };
+
+        assert(material.baseColour.handle != VK_NULL_HANDLE);
+        assert(material.surface.handle != VK_NULL_HANDLE);
+        assert(material.normalMap.handle != VK_NULL_HANDLE);
+
+        return material;
+    }
+
+    MaterialStore create_fallback_material(const vkutils::VulkanContext& context,
+                                           const vkutils::Allocator& allocator,
+                                           vkutils::UploadBatch& batch) {
+        struct FallbackTexture {
+            std::array<std::uint8_t, 4> texel;
+            std::size_t size;
+            VkFormat format;
+        };
+
+        // Same order as Material
+        constexpr std::array fallbackTextures = {
+            // Base colour: opaque white
+            FallbackTexture{{255, 255, 255, 255}, 4, VK_FORMAT_R8G8B8A8_SRGB},
+            // Surface: unoccluded, fully rough, dielectric
+            FallbackTexture{{255, 255, 0, 255}, 4, VK_FORMAT_R8G8B8A8_UNORM},
+            // Normal map: +Z in tangent space
+            FallbackTexture{{128, 128, 0, 0}, 2, VK_FORMAT_R8G8_UNORM}
+        };
+
+        MaterialStore fallback;
+        std::vector<vkutils::ImageView> views;
+
+        for (const auto& fallbackTexture : fallbackTextures) {
+            const auto& image = fallback.textures.emplace_back(
+                vkutils::create_texture_image(allocator, 1, 1, fallbackTexture.format));
+
+            batch.upload(image.image, fallbackTexture.texel.data(), fallbackTexture.size,
+                         {
+                             VkBufferImageCopy{
+                                 .imageSubresource = VkImageSubresourceLayers{VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+                                 .imageExtent = VkExtent3D{1, 1, 1}
+                             }
+                         },
+                         VkImageSubresourceRange{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}
+            );
+
+            views.emplace_back(vkutils::image_to_view(context, image.image, fallbackTexture.format));
+        }
+
+        fallback.materials.emplace_back(Material{
+            .baseColour = std::move(views[0]),
+            .surface = std::move(views[1]),
+            .normalMap = std::move(views[2]),
+            .alphaMasked = false
+        });
+
+        return fallback;
+    }
+
+    std::uint32_t material_slot(const std::uint32_t materialId) {
+        return materialId + 1;
+    }
+
+    glsl::MaterialTextures texture_slots(const std::uint32_t slot) {
+        const std::uint32_t first = slot * texturesPerSlot;
+        return glsl::MaterialTextures{
+            .baseColour = first,
+            .surface = first + 1,
+            .normalMap = first + 2,
+            .padding = 0
+        };
+    }
+
+    std::uint32_t max_slot_count(const vkutils::VulkanContext& context) {
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(context.physicalDevice, &props);
+
+        // The fragment shaders also sample the shadow map
+        const std::uint32_t maxTextures = std::min({
+            props.limits.maxPerStageDescriptorSampledImages,
+            props.limits.maxPerStageDescriptorSamplers,
+            props.limits.maxDescriptorSetSampledImages,
+            props.limits.maxDescriptorSetSamplers
+        }) - 1;
+
+        return maxTextures / texturesPerSlot;
     }
 
     vkutils::DescriptorSetLayout create_descriptor_layout(const vkutils::VulkanContext& context) {
-        constexpr std::array bindings = {
-            // Base Colour
+        const std::array bindings = {
+            // Texture slots of each material
             VkDescriptorSetLayoutBinding{
                 .binding = 0, // layout(set = ..., binding = 0)
-                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                 .descriptorCount = 1,
                 .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
             },
-            // Roughness
+            // Base Colour, Surface and Normal Map of every slot, see texture_slots()
             VkDescriptorSetLayoutBinding{
                 .binding = 1, // layout(set = ..., binding = 1)
                 .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                .descriptorCount = 1,
+                .descriptorCount = texturesPerSlot * max_slot_count(context), // Upper bound of the sets
                 .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
-            },
-            // Metalness
-            VkDescriptorSetLayoutBinding{
-                .binding = 2, // layout(set = ..., binding = 2)
-                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                .descriptorCount = 1,
-                .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
-            },
-            // Normal Map
-            VkDescriptorSetLayoutBinding{
-                .binding = 3, // layout(set = ..., binding = 3)
-                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                .descriptorCount = 1,
-                .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
-            },
-            // Alpha Mask - Only for alpha_mask.frag
-            VkDescriptorSetLayoutBinding{
-                .binding = 4, // layout(set = ..., binding = 4)
-                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                .descriptorCount = 1,
-                .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
             }
         };
 
+        // Slots of materials that are not resident, and the table before the model is loaded, are never written. The
+        // textures are allocated per set, for the materials of its model, see allocate_descriptor_set().
+        constexpr std::array<VkDescriptorBindingFlags, bindings.size()> bindingFlags = {
+            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,
+            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT
+        };
+
+        const VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+            .bindingCount = bindingFlags.size(),
+            .pBindingFlags = bindingFlags.data()
+        };
+
         const VkDescriptorSetLayoutCreateInfo layoutInfo{
             .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .pNext = &bindingFlagsInfo,
             .bindingCount = bindings.size(),
             .pBindings = bindings.data()
         };
@@ -147,82 +203,93 @@ namespace material {
         return vkutils::DescriptorSetLayout(context.device, layout);
     }
 
-    template<size_t N>
-    void update_material_descriptor_set(const vkutils::VulkanContext& context,
-                                        const VkDescriptorSet materialDescriptorSet,
-                                        const std::array<const VkDescriptorImageInfo, N>& textureDescriptors) {
-        std::array<VkWriteDescriptorSet, N> writeDescriptor{};
-
-        for (unsigned int i = 0; i < writeDescriptor.size(); ++i) {
-            writeDescriptor[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            writeDescriptor[i].dstSet = materialDescriptorSet;
-            writeDescriptor[i].dstBinding = i;
-            writeDescriptor[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            writeDescriptor[i].descriptorCount = 1;
-            writeDescriptor[i].pImageInfo = &textureDescriptors[i];
+    VkDescriptorSet allocate_descriptor_set(const vkutils::VulkanContext& context,
+                                            const VkDescriptorPool pool,
+                                            const VkDescriptorSetLayout materialLayout,
+                                            const std::uint32_t slotCount) {
+        assert(slotCount <= max_slot_count(context));
+
+        const std::uint32_t textureCount = texturesPerSlot * slotCount;
+        const VkDescriptorSetVariableDescriptorCountAllocateInfo countInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO,
+            .descriptorSetCount = 1,
+            .pDescriptorCounts = &textureCount
+        };
+
+        const VkDescriptorSetAllocateInfo allocInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .pNext = &countInfo,
+            .descriptorPool = pool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &materialLayout
+        };
+
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        if (const auto res = vkAllocateDescriptorSets(context.device, &allocInfo, &descriptorSet);
+            VK_SUCCESS != res) {
+            throw vkutils::Error("Unable to allocate material descriptor set\n"
+                                 "vkAllocateDescriptorSets() returned %s", vkutils::to_string(res).c_str()
+            );
         }
 
-        vkUpdateDescriptorSets(context.device, writeDescriptor.size(), writeDescriptor.data(), 0, nullptr);
+        return descriptorSet;
+    }
+
+    void update_table_descriptor(const vkutils::VulkanContext& context,
+                                 const VkDescriptorSet materialDescriptorSet,
+                                 const vkutils::Buffer& materialTextures) {
+        const VkDescriptorBufferInfo bufferInfo{
+            .buffer = materialTextures.buffer,
+            .range = VK_WHOLE_SIZE
+        };
+
+        const VkWriteDescriptorSet writeDescriptor{
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = materialDescriptorSet,
+            .dstBinding = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo = &bufferInfo
+        };
+
+        vkUpdateDescriptorSets(context.device, 1, &writeDescriptor, 0, nullptr);
     }
 
     void update_descriptor_set(const vkutils::VulkanContext& context,
                                const VkDescriptorSet materialDescriptorSet,
+                               const std::uint32_t slot,
                                const material::Material& material,
                                const vkutils::Sampler& anisotropySampler,
                                const vkutils::Sampler& pointSampler) {
-        if (material.is_alpha_masked()) {
-            const std::array<const VkDescriptorImageInfo, 5> textureDescriptors = {
-                VkDescriptorImageInfo{
-                    .sampler = anisotropySampler.handle,
-                    .imageView = material.baseColour.handle,
-                    .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-                },
-                VkDescriptorImageInfo{
-                    .sampler = pointSampler.handle,
-                    .imageView = material.roughness.handle,
-                    .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-                },
-                VkDescriptorImageInfo{
-                    .sampler = pointSampler.handle,
-                    .imageView = material.metalness.handle,
-                    .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-                },
-                VkDescriptorImageInfo{
-                    .sampler = anisotropySampler.handle,
-                    .imageView = material.normalMap.handle,
-                    .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-                },
-                VkDescriptorImageInfo{
-                    .sampler = pointSampler.handle,
-                    .imageView = material.alphaMask.value().handle,
-                    .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-                }
-            };
-            update_material_descriptor_set(context, materialDescriptorSet, textureDescriptors);
-        } else {
-            const std::array<const VkDescriptorImageInfo, 4> textureDescriptors = {
-                VkDescriptorImageInfo{
-                    .sampler = anisotropySampler.handle,
-                    .imageView = material.baseColour.handle,
-                    .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-                },
-                VkDescriptorImageInfo{
-                    .sampler = pointSampler.handle,
-                    .imageView = material.roughness.handle,
-                    .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-                },
-                VkDescriptorImageInfo{
-                    .sampler = pointSampler.handle,
-                    .imageView = material.metalness.handle,
-                    .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-                },
-                VkDescriptorImageInfo{
-                    .sampler = anisotropySampler.handle,
-                    .imageView = material.normalMap.handle,
-                    .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-                }
-            };
-            update_material_descriptor_set(context, materialDescriptorSet, textureDescriptors);
-        }
+        // Consecutive elements of the texture array, in the order of glsl::MaterialTextures
+        const std::array<const VkDescriptorImageInfo, texturesPerSlot> textureDescriptors = {
+            VkDescriptorImageInfo{
+                .sampler = anisotropySampler.handle,
+                .imageView = material.baseColour.handle,
+                .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+            },
+            VkDescriptorImageInfo{
+                .sampler = pointSampler.handle,
+                .imageView = material.surface.handle,
+                .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+            },
+            VkDescriptorImageInfo{
+                .sampler = anisotropySampler.handle,
+                .imageView = material.normalMap.handle,
+                .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+            }
+        };
+
+        const VkWriteDescriptorSet writeDescriptor{
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = materialDescriptorSet,
+            .dstBinding = 1,
+            .dstArrayElement = texture_slots(slot).baseColour,
+            .descriptorCount = textureDescriptors.size(),
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .pImageInfo = textureDescriptors.data()
+        };
+
+        vkUpdateDescriptorSets(context.device, 1, &writeDescriptor, 0, nullptr);
     }
 }
@@ -1,26 +1,39 @@
 #pragma once
 
-#include <optional>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <variant>
+#include <vector>
 
+#include "../vkutils/upload_batch.hpp"
+#include "../vkutils/vkbuffer.hpp"
 #include "../vkutils/vkimage.hpp"
 #include "../vkutils/vkutil.hpp"
 #include "../vkutils/vulkan_context.hpp"
 
 #include "baked_model.hpp"
-#include "material.hpp"
+#include "texture.hpp"
+
+namespace glsl {
+    // Slots of the textures of a material in the texture array of the material table. Matches struct MaterialTextures
+    // of the offscreen and alpha shadow shaders (std430).
+    struct MaterialTextures {
+        std::uint32_t baseColour;
+        std::uint32_t surface;
+        std::uint32_t normalMap;
+        std::uint32_t padding;
+    };
+}
 
 namespace material {
     struct Material {
-        vkutils::ImageView baseColour;
-        vkutils::ImageView roughness;
-        vkutils::ImageView metalness;
+        vkutils::ImageView baseColour; // Alpha mask in .a
+        vkutils::ImageView surface;    // .r = occlusion, .g = roughness, .b = metalness
         vkutils::ImageView normalMap;
-        std::optional<vkutils::ImageView> alphaMask;
+        bool alphaMasked;
 
         bool is_alpha_masked() const;
-
-        static constexpr VkFormat COLOUR_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
-        static constexpr VkFormat LINEAR_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
     };
 
     struct MaterialStore {
@@ -28,14 +41,70 @@ namespace material {
         std::vector<Material> materials;
     };
 
-    MaterialStore extract_materials(const baked::BakedModel& model,
-                                    const vkutils::VulkanContext& context,
-                                    const vkutils::Allocator& allocator);
+    // Baked texture decoded into host memory, possibly on a worker thread
+    using DecodedTexture = std::variant<texture::CompressedTexture, texture::Texture>;
+
+    DecodedTexture decode_texture(const baked::BakedTextureInfo& bakedTexture);
+
+    std::size_t decoded_size_in_bytes(const DecodedTexture& decoded);
+
+    // Queues the upload of decoded into batch. Returns the image and the format of its views. srgb only applies to
+    // uncompressed textures; compressed ones carry their own format.
+    // batch must make its uploads visible to sampling, compute mip generation and blits, see
+    // texture::texture_to_image(). Mips generated by mipGenerator are only valid once it has run.
+    std::pair<vkutils::Image, VkFormat> upload_texture(const vkutils::VulkanContext& context,
+                                                       const DecodedTexture& decoded,
+                                                       bool srgb,
+                                                       const vkutils::Allocator& allocator,
+                                                       vkutils::UploadBatch& batch,
+                                                       mipgen::MipGenerator& mipGenerator,
+                                                       const vkutils::CommandPool& loadCommandPool);
+
+    // Views of the textures of bakedMaterial, which must all have been created
+    Material create_material(const vkutils::VulkanContext& context,
+                             const baked::BakedMaterialInfo& bakedMaterial,
+                             const std::vector<vkutils::Image>& textures,
+                             const std::vector<VkFormat>& formats);
 
+    // Single material made of 1x1 textures, sampled in place of the materials whose textures are not resident yet
+    MaterialStore create_fallback_material(const vkutils::VulkanContext& context,
+                                           const vkutils::Allocator& allocator,
+                                           vkutils::UploadBatch& batch);
+
+    // Slots of the material table: the fallback material first, then one per material of the model. Every slot holds
+    // the textures of a material, in the order of Material.
+    constexpr std::uint32_t fallbackSlot = 0;
+    constexpr std::uint32_t texturesPerSlot = 3;
+
+    // Slots the material table has room for on the device, bounded by the textures its fragment shaders may sample
+    std::uint32_t max_slot_count(const vkutils::VulkanContext& context);
+
+    std::uint32_t material_slot(std::uint32_t materialId);
+
+    glsl::MaterialTextures texture_slots(std::uint32_t slot);
+
+    // Material table, bound once for all draws:
+    // - binding 0: glsl::MaterialTextures per material of the model, indexed by Mesh::materialId
+    // - binding 1: texturesPerSlot textures per slot, of which only those of resident materials are written. Its
+    //   count is variable, up to max_slot_count() slots: each set has the slots it is allocated with.
+    // Draws select their material through their instance index, see gpu_culling::GpuCuller.
     vkutils::DescriptorSetLayout create_descriptor_layout(const vkutils::VulkanContext&);
 
+    // Material table with slotCount slots, which must not exceed max_slot_count()
+    VkDescriptorSet allocate_descriptor_set(const vkutils::VulkanContext& context,
+                                            VkDescriptorPool pool,
+                                            VkDescriptorSetLayout materialLayout,
+                                            std::uint32_t slotCount);
+
+    // Points binding 0 of materialDescriptorSet to materialTextures
+    void update_table_descriptor(const vkutils::VulkanContext& context,
+                                 VkDescriptorSet materialDescriptorSet,
+                                 const vkutils::Buffer& materialTextures);
+
+    // Points the textures of slot to those of material
     void update_descriptor_set(const vkutils::VulkanContext& context,
                                VkDescriptorSet materialDescriptorSet,
+                               std::uint32_t slot,
                                const material::Material& material,
                                const vkutils::Sampler& anisotropySampler,
                                const vkutils::Sampler& pointSampler);
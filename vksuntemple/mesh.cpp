@@ -1,292 +1,140 @@
 #include "mesh.hpp"
 
-#include <cstring> // for std::memcpy()
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
 #include <limits>
 
-#include "config.hpp"
+#include <glm/glm.hpp>
+
 #include "../vkutils/error.hpp"
-#include "../vkutils/to_string.hpp"
 #include "../vkutils/vkutil.hpp"
 
 namespace {
-    // Map positions from Host -> Staging -> Device memory
-    void map_vertices_to_gpu_memory(const vkutils::VulkanContext& context,
-                                    const vkutils::Allocator& allocator,
-                                    const vkutils::CommandPool& uploadPool,
-                                    const baked::BakedMeshData& mesh,
-                                    const vkutils::Buffer& positionsStaging, const vkutils::Buffer& positionsGPU,
-                                    const vkutils::Buffer& uvsStaging, const vkutils::Buffer& uvsGPU,
-                                    const vkutils::Buffer& normalsStaging, const vkutils::Buffer& normalsGPU,
-                                    const vkutils::Buffer& tangentsStaging, const vkutils::Buffer& tangentsGPU,
-                                    const vkutils::Buffer& indicesStaging, const vkutils::Buffer& indicesGPU) {
-        // Copy positions Host -> Staging
-        const auto positionsSizeInBytes = sizeof(glm::vec3) * mesh.positions.size();
-        void* positionsPointer = nullptr;
-        if (const auto res = vmaMapMemory(allocator.allocator, positionsStaging.allocation, &positionsPointer);
-            VK_SUCCESS != res) {
-            throw vkutils::Error("Mapping memory for writing positions\n"
-                                 "vmaMapMemory() returned %s", vkutils::to_string(res).c_str()
-            );
-        }
-        std::memcpy(positionsPointer, mesh.positions.data(), positionsSizeInBytes);
-        vmaUnmapMemory(allocator.allocator, positionsStaging.allocation);
-
-        // Copy normals Host -> Staging
-        const auto normalsSizeInBytes = sizeof(glm::vec3) * mesh.normals.size();
-        void* normalsPointer = nullptr;
-        if (const auto res = vmaMapMemory(allocator.allocator, normalsStaging.allocation, &normalsPointer);
-            VK_SUCCESS != res) {
-            throw vkutils::Error("Mapping memory for writing normals\n"
-                                 "vmaMapMemory() returned %s", vkutils::to_string(res).c_str()
-            );
-        }
-        std::memcpy(normalsPointer, mesh.normals.data(), normalsSizeInBytes);
-        vmaUnmapMemory(allocator.allocator, normalsStaging.allocation);
-
-        // Copy normals Host -> Staging
-        const auto tangentsSizeInBytes = sizeof(glm::vec4) * mesh.tangents.size();
-        void* tangentsPointer = nullptr;
-        if (const auto res = vmaMapMemory(allocator.allocator, tangentsStaging.allocation, &tangentsPointer);
-            VK_SUCCESS != res) {
-            throw vkutils::Error("Mapping memory for writing tangents\n"
-                                 "vmaMapMemory() returned %s", vkutils::to_string(res).c_str()
-            );
-        }
-        std::memcpy(tangentsPointer, mesh.tangents.data(), tangentsSizeInBytes);
-        vmaUnmapMemory(allocator.allocator, tangentsStaging.allocation);
+    vkutils::Buffer create_gpu_buffer(const vkutils::VulkanContext& context,
+                                      const vkutils::Allocator& allocator,
+                                      const std::size_t size,
+                                      const VkBufferUsageFlags bufferUsage) {
+        return vkutils::create_buffer(
+            allocator,
+            size,
+            bufferUsage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            0, // no additional VmaAllocationCreateFlags
+            VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, // or just VMA MEMORY USAGE AUTO
+            vkutils::upload_queue_families(context),
+            vkutils::MemoryClass::Geometry
+        );
+    }
+}
 
-        // Copy uvs Host -> Staging
-        const auto uvsSizeInBytes = sizeof(glm::vec2) * mesh.texcoords.size();
-        void* uvsPointer = nullptr;
-        if (const auto res = vmaMapMemory(allocator.allocator, uvsStaging.allocation, &uvsPointer);
-            VK_SUCCESS != res) {
-            throw vkutils::Error("Mapping memory for writing uvs\n"
-                                 "vmaMapMemory() returned %s", vkutils::to_string(res).c_str()
-            );
+namespace mesh {
+    Geometry create_geometry(const vkutils::VulkanContext& context,
+                             const vkutils::Allocator& allocator,
+                             const baked::BakedModel& model) {
+        // Size the scene-wide buffers
+        GeometryCursor total;
+        for (const auto& modelMesh : model.meshes) {
+            total.vertexCount += modelMesh.positions.size();
+            total.indexCount += modelMesh.indices.size();
         }
-        std::memcpy(uvsPointer, mesh.texcoords.data(), uvsSizeInBytes);
-        vmaUnmapMemory(allocator.allocator, uvsStaging.allocation);
 
-        // Copy indices Host -> Staging
-        const auto indicesSizeInBytes = sizeof(std::uint32_t) * mesh.indices.size();
-        void* indicesPointer = nullptr;
-        if (const auto res = vmaMapMemory(allocator.allocator, indicesStaging.allocation, &indicesPointer);
-            VK_SUCCESS != res) {
-            throw vkutils::Error("Mapping memory for writing indices\n"
-                                 "vmaMapMemory() returned %s", vkutils::to_string(res).c_str()
-            );
+        if (total.vertexCount > static_cast<std::size_t>(std::numeric_limits<std::int32_t>::max()) ||
+            total.indexCount > std::numeric_limits<std::uint32_t>::max()) {
+            throw vkutils::Error("Scene geometry does not fit 32-bit vertex offsets and indices");
         }
-        std::memcpy(indicesPointer, mesh.indices.data(), indicesSizeInBytes);
-        vmaUnmapMemory(allocator.allocator, indicesStaging.allocation);
 
-        // We need to ensure that the Vulkan resources are alive until all the transfers have completed. For simplicity,
-        // we will just wait for the operations to complete with a fence. A more complex solution might want to queue
-        // transfers, let these take place in the background while performing other tasks.
-        vkutils::Fence uploadComplete = vkutils::create_fence(context);
-
-        // Queue data uploads from staging buffers to the final buffers.
-        VkCommandBuffer uploadCommand = vkutils::alloc_command_buffer(context, uploadPool.handle);
-
-        constexpr VkCommandBufferBeginInfo beginInfo{
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-            .flags = 0,
-            .pInheritanceInfo = nullptr
+        // Empty buffers are not allowed
+        total.vertexCount = std::max<std::size_t>(1, total.vertexCount);
+        total.indexCount = std::max<std::size_t>(1, total.indexCount);
+
+        return Geometry{
+            .positions = create_gpu_buffer(context, allocator, total.vertexCount * sizeof(glm::vec3),
+                                           VK_BUFFER_USAGE_VERTEX_BUFFER_BIT),
+            .uvs = create_gpu_buffer(context, allocator, total.vertexCount * sizeof(glm::vec2),
+                                     VK_BUFFER_USAGE_VERTEX_BUFFER_BIT),
+            .normals = create_gpu_buffer(context, allocator, total.vertexCount * sizeof(glm::vec3),
+                                         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT),
+            .tangents = create_gpu_buffer(context, allocator, total.vertexCount * sizeof(glm::vec4),
+                                          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT),
+            .indices = create_gpu_buffer(context, allocator, total.indexCount * sizeof(std::uint32_t),
+                                         VK_BUFFER_USAGE_INDEX_BUFFER_BIT)
         };
-        if (const auto res = vkBeginCommandBuffer(uploadCommand, &beginInfo);
-            VK_SUCCESS != res) {
-            throw vkutils::Error("Beginning command buffer recording\n"
-                                 "vkBeginCommandBuffer() returned %s", vkutils::to_string(res).c_str()
-            );
-        }
-
-        // Copy positions Staging -> GPU
-        const VkBufferCopy positionsCopy{
-            .size = positionsSizeInBytes
-        };
-
-        vkCmdCopyBuffer(uploadCommand, positionsStaging.buffer, positionsGPU.buffer, 1, &positionsCopy);
-
-        vkutils::buffer_barrier(uploadCommand,
-                                positionsGPU.buffer,
-                                VK_ACCESS_TRANSFER_WRITE_BIT,
-                                VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-                                VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
-        );
+    }
 
-        // Copy normals Staging -> GPU
-        const VkBufferCopy normalsCopy{
-            .size = normalsSizeInBytes
+    Mesh upload_mesh(vkutils::UploadBatch& batch,
+                     const Geometry& geometry,
+                     GeometryCursor& cursor,
+                     const baked::BakedMeshData& mesh) {
+        batch.upload(geometry.positions.buffer, mesh.positions.data(), mesh.positions.size_bytes(),
+                     cursor.vertexCount * sizeof(glm::vec3));
+        batch.upload(geometry.uvs.buffer, mesh.texcoords.data(), mesh.texcoords.size_bytes(),
+                     cursor.vertexCount * sizeof(glm::vec2));
+        batch.upload(geometry.normals.buffer, mesh.normals.data(), mesh.normals.size_bytes(),
+                     cursor.vertexCount * sizeof(glm::vec3));
+        batch.upload(geometry.tangents.buffer, mesh.tangents.data(), mesh.tangents.size_bytes(),
+                     cursor.vertexCount * sizeof(glm::vec4));
+        batch.upload(geometry.indices.buffer, mesh.indices.data(), mesh.indices.size_bytes(),
+                     cursor.indexCount * sizeof(std::uint32_t));
+
+        const Mesh ret{
+            .materialId = mesh.materialId,
+            .indexCount = static_cast<std::uint32_t>(mesh.indices.size()),
+            .firstIndex = static_cast<std::uint32_t>(cursor.indexCount),
+            .vertexOffset = static_cast<std::int32_t>(cursor.vertexCount)
         };
 
-        vkCmdCopyBuffer(uploadCommand, normalsStaging.buffer, normalsGPU.buffer, 1, &normalsCopy);
+        cursor.vertexCount += mesh.positions.size();
+        cursor.indexCount += mesh.indices.size();
 
-        vkutils::buffer_barrier(uploadCommand,
-                                normalsGPU.buffer,
-                                VK_ACCESS_TRANSFER_WRITE_BIT,
-                                VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-                                VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
-        );
-
-        // Copy uvs Staging -> GPU
-        const VkBufferCopy uvsCopy{
-            .size = uvsSizeInBytes
-        };
-
-        vkCmdCopyBuffer(uploadCommand, uvsStaging.buffer, uvsGPU.buffer, 1, &uvsCopy);
+        return ret;
+    }
 
-        vkutils::buffer_barrier(uploadCommand,
-                                uvsGPU.buffer,
-                                VK_ACCESS_TRANSFER_WRITE_BIT,
-                                VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-                                VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
-        );
+    std::size_t mesh_size_in_bytes(const baked::BakedMeshData& mesh) {
+        return mesh.positions.size_bytes() + mesh.texcoords.size_bytes() + mesh.normals.size_bytes() +
+               mesh.tangents.size_bytes() + mesh.indices.size_bytes();
+    }
 
-        // Copy tangents Staging -> GPU
-        const VkBufferCopy tangentsCopy{
-            .size = tangentsSizeInBytes
+    MeshBounds compute_bounds(const baked::BakedMeshData& mesh) {
+        MeshBounds bounds{
+            .min = glm::vec3(std::numeric_limits<float>::max()),
+            .max = glm::vec3(std::numeric_limits<float>::lowest()),
+            .surfaceArea = 0.0f,
+            .uvArea = 0.0f
         };
 
-        vkCmdCopyBuffer(uploadCommand, tangentsStaging.buffer, tangentsGPU.buffer, 1, &tangentsCopy);
-
-        vkutils::buffer_barrier(uploadCommand,
-                                tangentsGPU.buffer,
-                                VK_ACCESS_TRANSFER_WRITE_BIT,
-                                VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-                                VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
-        );
-
-        // Copy indices Staging -> GPU
-        VkBufferCopy indicesCopy{};
-        indicesCopy.size = indicesSizeInBytes;
-
-        vkCmdCopyBuffer(uploadCommand, indicesStaging.buffer, indicesGPU.buffer, 1, &indicesCopy);
-
-        vkutils::buffer_barrier(uploadCommand,
-                                indicesGPU.buffer,
-                                VK_ACCESS_TRANSFER_WRITE_BIT,
-                                VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-                                VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
-        );
-
-        if (const auto res = vkEndCommandBuffer(uploadCommand); VK_SUCCESS != res) {
-            throw vkutils::Error("Ending command buffer recording\n"
-                                 "vkEndCommandBuffer() returned %s", vkutils::to_string(res).c_str()
-            );
+        for (const auto& position : mesh.positions) {
+            bounds.min = glm::min(bounds.min, position);
+            bounds.max = glm::max(bounds.max, position);
         }
 
-        // Submit transfer commands
-        const VkSubmitInfo submitInfo{
-            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            .commandBufferCount = 1,
-            .pCommandBuffers = &uploadCommand
-        };
+        for (std::size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            const auto a = mesh.indices[i], b = mesh.indices[i + 1], c = mesh.indices[i + 2];
 
-        if (const auto res = vkQueueSubmit(context.graphicsQueue, 1, &submitInfo, uploadComplete.handle);
-            VK_SUCCESS != res) {
-            throw vkutils::Error("Submitting commands\n"
-                                 "vkQueueSubmit() returned %s", vkutils::to_string(res).c_str()
-            );
-        }
+            const auto& p0 = mesh.positions[a];
+            bounds.surfaceArea += 0.5f * glm::length(glm::cross(mesh.positions[b] - p0, mesh.positions[c] - p0));
 
-        // Wait for commands to finish before we destroy the temporary resources required for the transfers (staging
-        // buffers, command pool, ...)
-        //
-        // The code doesn’t destory the resources implicitly – the resources are destroyed by the destructors of the
-        // vkutils wrappers for the various objects once we leave the function’s scope.
-        if (const auto res = vkWaitForFences(context.device, 1, &uploadComplete.handle, VK_TRUE,
-                                             std::numeric_limits<std::uint64_t>::max());
-            VK_SUCCESS != res) {
-            throw vkutils::Error("Waiting for upload to complete\n"
-                                 "vkWaitForFences() returned %s", vkutils::to_string(res).c_str()
-            );
+            const auto& t0 = mesh.texcoords[a];
+            const auto e1 = mesh.texcoords[b] - t0, e2 = mesh.texcoords[c] - t0;
+            bounds.uvArea += 0.5f * std::abs(e1.x * e2.y - e1.y * e2.x);
         }
-    }
 
-    std::pair<vkutils::Buffer, vkutils::Buffer> stage_to_gpu_buffers(const vkutils::Allocator& allocator,
-                                                                     const std::size_t size,
-                                                                     const VkBufferUsageFlagBits bufferUsage) {
-        return {
-            vkutils::create_buffer(
-                allocator,
-                size,
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT
-            ),
-            vkutils::create_buffer(
-                allocator,
-                size,
-                bufferUsage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                0, // no additional VmaAllocationCreateFlags
-                VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE // or just VMA MEMORY USAGE AUTO
-            )
-        };
+        return bounds;
     }
 
-    mesh::Mesh allocate(const vkutils::VulkanContext& context,
-                        const vkutils::Allocator& allocator,
-                        const vkutils::CommandPool& uploadPool,
-                        const baked::BakedMeshData& mesh) {
-        auto [positionsStaging, positionsGPU] = stage_to_gpu_buffers(
-            allocator, sizeof(glm::vec3) * mesh.positions.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-
-        auto [normalsStaging, normalsGPU] = stage_to_gpu_buffers(
-            allocator, sizeof(glm::vec3) * mesh.normals.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-
-        auto [uvsStaging, uvsGPU] = stage_to_gpu_buffers(
-            allocator, sizeof(glm::vec2) * mesh.texcoords.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-
-        auto [tangentsStaging, tangentsGPU] = stage_to_gpu_buffers(
-            allocator, sizeof(glm::vec4) * mesh.tangents.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-
-        auto [indicesStaging, indicesGPU] = stage_to_gpu_buffers(
-            allocator, sizeof(std::uint32_t) * mesh.indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
-
-        map_vertices_to_gpu_memory(context,
-                                   allocator,
-                                   uploadPool,
-                                   mesh,
-                                   positionsStaging, positionsGPU,
-                                   uvsStaging, uvsGPU,
-                                   normalsStaging, normalsGPU,
-                                   tangentsStaging, tangentsGPU,
-                                   indicesStaging, indicesGPU);
+    void bind_geometry(const VkCommandBuffer commandBuffer, const Geometry& geometry, const std::uint32_t attributeCount) {
+        if (VK_NULL_HANDLE == geometry.indices.buffer) {
+            // Not created yet; there is nothing to draw either
+            return;
+        }
 
-        return mesh::Mesh{
-            .positions = std::move(positionsGPU),
-            .uvs = std::move(uvsGPU),
-            .normals = std::move(normalsGPU),
-            .tangents = std::move(tangentsGPU),
-            .indices = std::move(indicesGPU),
-            .pushConstants = {.colour = {1.0f, 1.0f, 1.0f}},
-            .materialId = mesh.materialId,
-            .indexCount = static_cast<std::uint32_t>(mesh.indices.size())
+        const std::array vertexBuffers = {
+            geometry.positions.buffer, geometry.uvs.buffer, geometry.normals.buffer, geometry.tangents.buffer
         };
-    }
-}
-
-namespace mesh {
-    std::tuple<std::vector<Mesh>, std::vector<Mesh>> extract_meshes(const vkutils::VulkanContext& context,
-                                                                    const vkutils::Allocator& allocator,
-                                                                    const baked::BakedModel& model,
-                                                                    const std::vector<material::Material>& materials) {
-        std::vector<Mesh> opaqueMeshes;
-        std::vector<Mesh> alphaMaskedMeshes;
-        // This uses a separate command pool for simplicity
-        const vkutils::CommandPool uploadPool = vkutils::create_command_pool(context);
-
-        for (const auto& modelMesh : model.meshes) {
-            if (materials[modelMesh.materialId].is_alpha_masked()) {
-                alphaMaskedMeshes.emplace_back(allocate(context, allocator, uploadPool, modelMesh));
-            } else {
-                opaqueMeshes.emplace_back(allocate(context, allocator, uploadPool, modelMesh));
-            }
-        }
+        constexpr std::array<VkDeviceSize, vertexBuffers.size()> offsets{};
+        assert(attributeCount <= vertexBuffers.size());
 
-        return {std::move(opaqueMeshes), std::move(alphaMaskedMeshes)};
+        vkCmdBindVertexBuffers(commandBuffer, 0, attributeCount, vertexBuffers.data(), offsets.data());
+        vkCmdBindIndexBuffer(commandBuffer, geometry.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
     }
 }
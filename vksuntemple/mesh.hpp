@@ -1,15 +1,14 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
-#include <vector>
-#include <tuple>
 
 #include "../vkutils/allocator.hpp"
+#include "../vkutils/upload_batch.hpp"
 #include "../vkutils/vkbuffer.hpp"
 #include "../vkutils/vulkan_context.hpp"
 
 #include "baked_model.hpp"
-#include "material.hpp"
 
 namespace glsl {
     struct MeshPushConstants {
@@ -18,20 +17,54 @@ namespace glsl {
 }
 
 namespace mesh {
-    struct Mesh {
+    // Vertex attributes and indices of all meshes in the scene, one buffer each. Meshes are suballocated back to back.
+    struct Geometry {
         vkutils::Buffer positions;
         vkutils::Buffer uvs;
         vkutils::Buffer normals;
         vkutils::Buffer tangents;
         vkutils::Buffer indices;
-        glsl::MeshPushConstants pushConstants;
+    };
+
+    // Range of Geometry drawn by a single indexed draw, see gpu_culling.hpp
+    struct Mesh {
         std::uint32_t materialId;
 
         std::uint32_t indexCount;
+        std::uint32_t firstIndex;
+        std::int32_t vertexOffset;
+    };
+
+    // Counts of vertices and indices suballocated from a Geometry so far
+    struct GeometryCursor {
+        std::size_t vertexCount = 0;
+        std::size_t indexCount = 0;
     };
 
-    std::tuple<std::vector<Mesh>, std::vector<Mesh>> extract_meshes(const vkutils::VulkanContext&,
-                                                                    const vkutils::Allocator&,
-                                                                    const baked::BakedModel& model,
-                                                                    const std::vector<material::Material>& materials);
+    // Creates buffers large enough for all meshes of model. Their content is uploaded one mesh at a time with
+    // upload_mesh().
+    Geometry create_geometry(const vkutils::VulkanContext&, const vkutils::Allocator&, const baked::BakedModel& model);
+
+    // Queues the upload of mesh into batch, at cursor, and advances cursor past it
+    Mesh upload_mesh(vkutils::UploadBatch& batch,
+                     const Geometry& geometry,
+                     GeometryCursor& cursor,
+                     const baked::BakedMeshData& mesh);
+
+    std::size_t mesh_size_in_bytes(const baked::BakedMeshData& mesh);
+
+    // World space extent and surface of a mesh, and the surface it covers in texture space
+    struct MeshBounds {
+        glm::vec3 min;
+        glm::vec3 max;
+        float surfaceArea;
+        float uvArea; // 1 covers a whole texture once; larger with tiling
+    };
+
+    MeshBounds compute_bounds(const baked::BakedMeshData& mesh);
+
+    // Binds the index buffer and the first attributeCount vertex buffers, in the order positions, uvs, normals,
+    // tangents, into bindings 0...attributeCount-1. Bindings persist across pipeline changes, so this is done once per
+    // pass.
+    void bind_geometry(VkCommandBuffer, const Geometry&, std::uint32_t attributeCount);
 }
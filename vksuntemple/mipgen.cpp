@@ -0,0 +1,429 @@
+#include "mipgen.hpp"
+
+#include <algorithm>
+#include <array>
+
+#include "../vkutils/error.hpp"
+#include "../vkutils/to_string.hpp"
+#include "../vkutils/vkimage.hpp"
+#include "../vkutils/vkutil.hpp"
+
+#include "config.hpp"
+#include "texture.hpp"
+
+namespace {
+    // Levels written by one dispatch, see shaders/mipgen.comp
+    constexpr std::uint32_t levelsPerPass = 4;
+    constexpr std::uint32_t workgroupSize = 8;
+
+    // Matches the push constant block of shaders/mipgen.comp
+    struct MipGeneration {
+        std::uint32_t levelCount;
+        std::uint32_t srgb;
+    };
+
+    // Format of the storage views. sRGB formats can rarely be written as storage images.
+    VkFormat storage_format(VkFormat format);
+
+    bool is_srgb(VkFormat format);
+
+    // Dispatch writing levelCount levels after sourceLevel
+    struct Pass {
+        std::uint32_t sourceLevel;
+        std::uint32_t levelCount;
+    };
+
+    // Passes generating the mip chain of a width x height image. Shared memory only halves even sizes (or sizes of 1),
+    // so a pass ends before a level with another odd size, which the next pass samples bilinearly.
+    std::vector<Pass> plan_passes(std::uint32_t width, std::uint32_t height);
+
+    VkImageMemoryBarrier level_barrier(VkImage image,
+                                       std::uint32_t firstLevel, std::uint32_t levelCount,
+                                       VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask,
+                                       VkImageLayout srcLayout, VkImageLayout dstLayout);
+
+    vkutils::DescriptorSetLayout create_descriptor_layout(const vkutils::VulkanContext& context);
+
+    vkutils::PipelineLayout create_pipeline_layout(const vkutils::VulkanContext& context,
+                                                   const vkutils::DescriptorSetLayout& descriptorLayout);
+
+    vkutils::Pipeline create_pipeline(const vkutils::VulkanContext& context, VkPipelineLayout pipelineLayout);
+
+    // Bilinear, clamped to the edge, like the filtering of vkCmdBlitImage()
+    vkutils::Sampler create_sampler(const vkutils::VulkanContext& context);
+}
+
+namespace mipgen {
+    MipGenerator::MipGenerator(const vkutils::VulkanContext& context)
+        : mContext(context),
+          mDescriptorLayout(create_descriptor_layout(context)),
+          mPipelineLayout(create_pipeline_layout(context, mDescriptorLayout)),
+          mPipeline(create_pipeline(context, mPipelineLayout.handle)),
+          mSampler(create_sampler(context)) {
+        // Enabled by the device whenever supported
+        VkPhysicalDeviceFeatures features;
+        vkGetPhysicalDeviceFeatures(context.physicalDevice, &features);
+        mStorageWithoutFormat = VK_TRUE == features.shaderStorageImageWriteWithoutFormat;
+    }
+
+    bool MipGenerator::supports(const VkFormat format) const {
+        if (!mStorageWithoutFormat) {
+            return false;
+        }
+
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(mContext.physicalDevice, storage_format(format), &formatProperties);
+        return formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+    }
+
+    void MipGenerator::add(const VkImage image,
+                           const VkFormat format,
+                           const std::uint32_t width,
+                           const std::uint32_t height) {
+        mPending.emplace_back(PendingImage{image, format, width, height});
+    }
+
+    bool MipGenerator::has_pending() const {
+        return !mPending.empty();
+    }
+
+    void MipGenerator::generate(const vkutils::CommandPool& commandPool) {
+        std::erase_if(mPending, [](const PendingImage& pending) {
+            return vkutils::compute_mip_level_count(pending.width, pending.height) < 2;
+        });
+
+        if (mPending.empty()) {
+            return;
+        }
+
+        // One descriptor set per image and pass, alive until the commands complete
+        std::vector<std::vector<Pass>> passes;
+        std::size_t setCount = 0, passCount = 0;
+        for (const auto& pending : mPending) {
+            const auto& imagePasses = passes.emplace_back(plan_passes(pending.width, pending.height));
+            setCount += imagePasses.size();
+            passCount = std::max(passCount, imagePasses.size());
+        }
+
+        const vkutils::DescriptorPool descriptorPool = vkutils::create_descriptor_pool(
+            mContext, static_cast<std::uint32_t>(setCount * levelsPerPass), static_cast<std::uint32_t>(setCount));
+        std::vector<vkutils::ImageView> views;
+
+        VkCommandBuffer commandBuffer = texture::begin_upload_commands(mContext, commandPool);
+
+        // All levels but the base one are written before being read
+        std::vector<VkImageMemoryBarrier> barriers;
+        for (const auto& pending : mPending) {
+            const auto mipLevels = vkutils::compute_mip_level_count(pending.width, pending.height);
+            barriers.emplace_back(level_barrier(pending.image, 1, mipLevels - 1,
+                                                0, VK_ACCESS_SHADER_WRITE_BIT,
+                                                VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL));
+        }
+
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                             0, nullptr,
+                             0, nullptr,
+                             static_cast<std::uint32_t>(barriers.size()), barriers.data()
+        );
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipeline.handle);
+
+        // Each pass of an image reads the last level written by the previous one, and writes the next levels.
+        // The dispatches of all images in a pass are independent, so they are separated by a single barrier.
+        for (std::size_t pass = 0; pass < passCount; ++pass) {
+            barriers.clear();
+
+            for (std::size_t i = 0; i < mPending.size(); ++i) {
+                const auto& pending = mPending[i];
+                if (pass >= passes[i].size()) {
+                    continue;
+                }
+
+                const auto [sourceLevel, levelCount] = passes[i][pass];
+
+                const auto& sourceView = views.emplace_back(
+                    vkutils::image_level_to_view(mContext, pending.image, pending.format, sourceLevel));
+                const VkDescriptorImageInfo sourceDescriptor{
+                    .sampler = mSampler.handle,
+                    .imageView = sourceView.handle,
+                    .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                };
+
+                // Bindings past levelCount repeat the last level, and are not written by the shader
+                std::array<VkDescriptorImageInfo, levelsPerPass> destinationDescriptors{};
+                for (std::uint32_t i = 0; i < levelsPerPass; ++i) {
+                    if (i < levelCount) {
+                        const auto& view = views.emplace_back(
+                            vkutils::image_level_to_view(mContext, pending.image, storage_format(pending.format),
+                                                         sourceLevel + 1 + i));
+                        destinationDescriptors[i] = VkDescriptorImageInfo{
+                            .imageView = view.handle,
+                            .imageLayout = VK_IMAGE_LAYOUT_GENERAL
+                        };
+                    } else {
+                        destinationDescriptors[i] = destinationDescriptors[levelCount - 1];
+                    }
+                }
+
+                const VkDescriptorSet descriptorSet = vkutils::allocate_descriptor_set(
+                    mContext, descriptorPool.handle, mDescriptorLayout.handle);
+
+                const std::array writeDescriptors{
+                    VkWriteDescriptorSet{
+                        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                        .dstSet = descriptorSet,
+                        .dstBinding = 0,
+                        .descriptorCount = 1,
+                        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                        .pImageInfo = &sourceDescriptor
+                    },
+                    VkWriteDescriptorSet{
+                        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                        .dstSet = descriptorSet,
+                        .dstBinding = 1,
+                        .descriptorCount = levelsPerPass,
+                        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                        .pImageInfo = destinationDescriptors.data()
+                    }
+                };
+
+                vkUpdateDescriptorSets(mContext.device, writeDescriptors.size(), writeDescriptors.data(), 0, nullptr);
+
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipelineLayout.handle,
+                                        0, 1, &descriptorSet,
+                                        0, nullptr
+                );
+
+                const MipGeneration mipGeneration{
+                    .levelCount = levelCount,
+                    .srgb = is_srgb(pending.format) ? 1u : 0u
+                };
+
+                vkCmdPushConstants(commandBuffer, mPipelineLayout.handle, VK_SHADER_STAGE_COMPUTE_BIT,
+                                   0, sizeof(MipGeneration), &mipGeneration);
+
+                // One invocation per texel of the first level written
+                const auto width = std::max(1u, pending.width >> (sourceLevel + 1));
+                const auto height = std::max(1u, pending.height >> (sourceLevel + 1));
+                vkCmdDispatch(commandBuffer,
+                              (width + workgroupSize - 1) / workgroupSize,
+                              (height + workgroupSize - 1) / workgroupSize,
+                              1
+                );
+
+                // Read by the next pass, or sampled by the renderer
+                barriers.emplace_back(level_barrier(pending.image, sourceLevel + 1, levelCount,
+                                                    VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                                                    VK_IMAGE_LAYOUT_GENERAL,
+                                                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+            }
+
+            vkCmdPipelineBarrier(commandBuffer,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                                 0, nullptr,
+                                 0, nullptr,
+                                 static_cast<std::uint32_t>(barriers.size()), barriers.data()
+            );
+        }
+
+        texture::submit_upload_commands(mContext, commandPool, commandBuffer);
+
+        mPending.clear();
+    }
+}
+
+namespace {
+    VkFormat storage_format(const VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_R8_SRGB:
+                return VK_FORMAT_R8_UNORM;
+            case VK_FORMAT_R8G8_SRGB:
+                return VK_FORMAT_R8G8_UNORM;
+            case VK_FORMAT_R8G8B8A8_SRGB:
+                return VK_FORMAT_R8G8B8A8_UNORM;
+            default:
+                return format;
+        }
+    }
+
+    bool is_srgb(const VkFormat format) {
+        return storage_format(format) != format;
+    }
+
+    std::vector<Pass> plan_passes(const std::uint32_t width, const std::uint32_t height) {
+        const auto mipLevels = vkutils::compute_mip_level_count(width, height);
+        const auto halves_exactly = [&](const std::uint32_t level) {
+            const auto levelWidth = std::max(1u, width >> level);
+            const auto levelHeight = std::max(1u, height >> level);
+            return (1 == levelWidth || 0 == levelWidth % 2) && (1 == levelHeight || 0 == levelHeight % 2);
+        };
+
+        std::vector<Pass> passes;
+        for (std::uint32_t sourceLevel = 0; sourceLevel + 1 < mipLevels;) {
+            std::uint32_t levelCount = 1;
+            while (levelCount < levelsPerPass && sourceLevel + levelCount + 1 < mipLevels &&
+                   halves_exactly(sourceLevel + levelCount)) {
+                ++levelCount;
+            }
+
+            passes.emplace_back(Pass{.sourceLevel = sourceLevel, .levelCount = levelCount});
+            sourceLevel += levelCount;
+        }
+
+        return passes;
+    }
+
+    VkImageMemoryBarrier level_barrier(const VkImage image,
+                                       const std::uint32_t firstLevel, const std::uint32_t levelCount,
+                                       const VkAccessFlags srcAccessMask, const VkAccessFlags dstAccessMask,
+                                       const VkImageLayout srcLayout, const VkImageLayout dstLayout) {
+        return VkImageMemoryBarrier{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = srcAccessMask,
+            .dstAccessMask = dstAccessMask,
+            .oldLayout = srcLayout,
+            .newLayout = dstLayout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image,
+            .subresourceRange = VkImageSubresourceRange{
+                VK_IMAGE_ASPECT_COLOR_BIT,
+                firstLevel, levelCount,
+                0, 1
+            }
+        };
+    }
+
+    vkutils::DescriptorSetLayout create_descriptor_layout(const vkutils::VulkanContext& context) {
+        constexpr std::array bindings = {
+            // Source level
+            VkDescriptorSetLayoutBinding{
+                .binding = 0, // layout(set = ..., binding = 0)
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+            },
+            // Destination levels, one binding each: layout(set = ..., binding = 1 to 4)
+            VkDescriptorSetLayoutBinding{
+                .binding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+            },
+            VkDescriptorSetLayoutBinding{
+                .binding = 2,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+            },
+            VkDescriptorSetLayoutBinding{
+                .binding = 3,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+            },
+            VkDescriptorSetLayoutBinding{
+                .binding = 4,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+            }
+        };
+
+        const VkDescriptorSetLayoutCreateInfo layoutInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .bindingCount = bindings.size(),
+            .pBindings = bindings.data()
+        };
+
+        VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+        if (const auto res = vkCreateDescriptorSetLayout(context.device, &layoutInfo, nullptr, &layout);
+            VK_SUCCESS != res) {
+            throw vkutils::Error("Unable to create mip generation descriptor set layout\n"
+                                 "vkCreateDescriptorSetLayout() returned %s", vkutils::to_string(res).c_str()
+            );
+        }
+
+        return vkutils::DescriptorSetLayout(context.device, layout);
+    }
+
+    vkutils::PipelineLayout create_pipeline_layout(const vkutils::VulkanContext& context,
+                                                   const vkutils::DescriptorSetLayout& descriptorLayout) {
+        const std::array layouts = {
+            descriptorLayout.handle, // set 0
+        };
+
+        constexpr VkPushConstantRange pushConstantRange{
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(MipGeneration)
+        };
+
+        const VkPipelineLayoutCreateInfo layoutInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = layouts.size(),
+            .pSetLayouts = layouts.data(),
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange
+        };
+
+        VkPipelineLayout layout = VK_NULL_HANDLE;
+        if (const auto res = vkCreatePipelineLayout(context.device, &layoutInfo, nullptr, &layout);
+            VK_SUCCESS != res) {
+            throw vkutils::Error("Unable to create mip generation pipeline layout\n"
+                                 "vkCreatePipelineLayout() returned %s", vkutils::to_string(res).c_str());
+        }
+
+        return vkutils::PipelineLayout(context.device, layout);
+    }
+
+    vkutils::Pipeline create_pipeline(const vkutils::VulkanContext& context, const VkPipelineLayout pipelineLayout) {
+        const vkutils::ShaderModule comp = vkutils::load_shader_module(context, cfg::mipgenCompPath);
+
+        const VkComputePipelineCreateInfo pipelineInfo{
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .stage = VkPipelineShaderStageCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = comp.handle,
+                .pName = "main"
+            },
+            .layout = pipelineLayout
+        };
+
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        if (const auto res = vkCreateComputePipelines(context.device, VK_NULL_HANDLE,
+                                                      1, &pipelineInfo, nullptr, &pipeline);
+            VK_SUCCESS != res) {
+            throw vkutils::Error("Unable to create mip generation pipeline\n"
+                                 "vkCreateComputePipelines() returned %s", vkutils::to_string(res).c_str());
+        }
+
+        return vkutils::Pipeline(context.device, pipeline);
+    }
+
+    vkutils::Sampler create_sampler(const vkutils::VulkanContext& context) {
+        constexpr VkSamplerCreateInfo samplerInfo{
+            .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+            .magFilter = VK_FILTER_LINEAR,
+            .minFilter = VK_FILTER_LINEAR,
+            .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+            .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .minLod = 0.0f,
+            .maxLod = 0.0f
+        };
+
+        VkSampler sampler = VK_NULL_HANDLE;
+        if (const auto res = vkCreateSampler(context.device, &samplerInfo, nullptr, &sampler);
+            VK_SUCCESS != res) {
+            throw vkutils::Error("Unable to create mip generation sampler\n"
+                                 "vkCreateSampler() returned %s", vkutils::to_string(res).c_str()
+            );
+        }
+
+        return vkutils::Sampler(context.device, sampler);
+    }
+}
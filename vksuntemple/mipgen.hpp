@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "../vkutils/vkobject.hpp"
+#include "../vkutils/vulkan_context.hpp"
+
+namespace mipgen {
+    /*
+     * Generates the mip chains of uncompressed textures with a compute
+     * shader (see shaders/mipgen.comp).
+     *
+     * Each dispatch reduces one level into up to the next 4, through shared
+     * memory, instead of one blit and one barrier per level. The levels match
+     * those of the blits, including odd sizes. The images added since
+     * the previous call to generate() are processed together: one dispatch
+     * per image and pass, and a single barrier between passes.
+     *
+     * Images are written through UNORM storage views. sRGB images must be
+     * created with VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT and
+     * VK_IMAGE_CREATE_EXTENDED_USAGE_BIT; the shader averages their texels in
+     * linear space.
+     */
+    class MipGenerator {
+    public:
+        explicit MipGenerator(const vkutils::VulkanContext& context);
+
+        MipGenerator(const MipGenerator&) = delete;
+
+        MipGenerator& operator=(const MipGenerator&) = delete;
+
+        // Whether images of format can be processed. Others must generate their mips with blits.
+        bool supports(VkFormat format) const;
+
+        // image must have the usage VK_IMAGE_USAGE_STORAGE_BIT and a full mip chain, and be submitted for upload
+        // before generate() is called. Its base level must be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL and
+        // visible to VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT by then; the other levels are left in the same layout.
+        void add(VkImage image, VkFormat format, std::uint32_t width, std::uint32_t height);
+
+        bool has_pending() const;
+
+        // Records all passes of the added images into one command buffer, submitted to the graphics queue. Blocks
+        // until they are complete.
+        void generate(const vkutils::CommandPool& commandPool);
+
+    private:
+        struct PendingImage {
+            VkImage image;
+            VkFormat format;
+            std::uint32_t width;
+            std::uint32_t height;
+        };
+
+        const vkutils::VulkanContext& mContext;
+
+        bool mStorageWithoutFormat;
+
+        vkutils::DescriptorSetLayout mDescriptorLayout;
+        vkutils::PipelineLayout mPipelineLayout;
+        vkutils::Pipeline mPipeline;
+        vkutils::Sampler mSampler;
+
+        std::vector<PendingImage> mPending;
+    };
+}
@@ -11,8 +11,9 @@
 #include "shade.hpp"
 
 namespace offscreen {
-    vkutils::RenderPass create_render_pass(const vkutils::VulkanWindow& window) {
-        constexpr std::array attachments{
+    vkutils::RenderPass create_render_pass(const vkutils::VulkanWindow& window, const bool depthPrepass) {
+        // After the depth prepass, the depth buffer holds the depth of the visible fragments
+        const std::array attachments{
             VkAttachmentDescription{
                 .format = cfg::offscreenFormat,
                 .samples = VK_SAMPLE_COUNT_1_BIT,
@@ -24,9 +25,11 @@ namespace offscreen {
             VkAttachmentDescription{
                 .format = cfg::depthFormat,
                 .samples = VK_SAMPLE_COUNT_1_BIT,
-                .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                .loadOp = depthPrepass ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR,
                 .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .initialLayout = depthPrepass
+                                     ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+                                     : VK_IMAGE_LAYOUT_UNDEFINED,
                 .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
             }
         };
@@ -55,11 +58,13 @@ namespace offscreen {
         // Requires a subpass dependency to ensure that the first transition happens after the presentation engine is
         // done with it.
         // https://github.com/KhronosGroup/Vulkan-Docs/wiki/Synchronization-Examples-(Legacy-synchronization-APIs)#swapchain-image-acquire-and-present
+        // The fullscreen pass of the previous frame, which may still be executing, samples the target.
+        // The depth buffer is written by the depth prepass, or by the offscreen pass of the previous frame.
         constexpr std::array subpassDependencies{
             VkSubpassDependency{
                 .srcSubpass = VK_SUBPASS_EXTERNAL,
                 .dstSubpass = 0,
-                .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
                 .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
                 .srcAccessMask = 0,
                 .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
@@ -68,7 +73,8 @@ namespace offscreen {
             VkSubpassDependency{
                 .srcSubpass = VK_SUBPASS_EXTERNAL,
                 .dstSubpass = 0,
-                .srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                .srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
                 .dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
                                 VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
                 .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
@@ -139,7 +145,8 @@ namespace offscreen {
 
     vkutils::Pipeline create_opaque_pipeline(const vkutils::VulkanWindow& window,
                                              const VkRenderPass renderPass,
-                                             const VkPipelineLayout pipelineLayout) {
+                                             const VkPipelineLayout pipelineLayout,
+                                             const bool depthPrepass) {
         // Load only vertex and fragment shader modules
         const vkutils::ShaderModule vert = vkutils::load_shader_module(window, cfg::offscreenVertPath);
         const vkutils::ShaderModule frag = vkutils::load_shader_module(window, cfg::offscreenOpaqueFragPath);
@@ -296,12 +303,12 @@ namespace offscreen {
             .pAttachments = blendStates.data()
         };
 
-        // Define depth info
-        constexpr VkPipelineDepthStencilStateCreateInfo depthInfo{
+        // Define depth info. After the depth prepass, only the fragments it kept are shaded.
+        const VkPipelineDepthStencilStateCreateInfo depthInfo{
             .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
             .depthTestEnable = VK_TRUE,
-            .depthWriteEnable = VK_TRUE,
-            .depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL,
+            .depthWriteEnable = depthPrepass ? VK_FALSE : VK_TRUE,
+            .depthCompareOp = depthPrepass ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS_OR_EQUAL,
             .minDepthBounds = 0.0f,
             .maxDepthBounds = 1.0f
         };
@@ -338,7 +345,8 @@ namespace offscreen {
 
     vkutils::Pipeline create_alpha_pipeline(const vkutils::VulkanWindow& window,
                                             const VkRenderPass renderPass,
-                                            const VkPipelineLayout pipelineLayout) {
+                                            const VkPipelineLayout pipelineLayout,
+                                            const bool depthPrepass) {
         // Load only vertex and fragment shader modules
         const vkutils::ShaderModule vert = vkutils::load_shader_module(window, cfg::offscreenVertPath);
         const vkutils::ShaderModule frag = vkutils::load_shader_module(window, cfg::offscreenAlphaFragPath);
@@ -497,12 +505,12 @@ namespace offscreen {
             .pAttachments = blendStates.data()
         };
 
-        // Define depth info
-        constexpr VkPipelineDepthStencilStateCreateInfo depthInfo{
+        // Define depth info. After the depth prepass, only the fragments it kept are shaded.
+        const VkPipelineDepthStencilStateCreateInfo depthInfo{
             .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
             .depthTestEnable = VK_TRUE,
-            .depthWriteEnable = VK_TRUE,
-            .depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL,
+            .depthWriteEnable = depthPrepass ? VK_FALSE : VK_TRUE,
+            .depthCompareOp = depthPrepass ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS_OR_EQUAL,
             .minDepthBounds = 0.0f,
             .maxDepthBounds = 1.0f
         };
@@ -557,21 +565,7 @@ namespace offscreen {
             .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
         };
 
-        constexpr VmaAllocationCreateInfo allocInfo{
-            .usage = VMA_MEMORY_USAGE_GPU_ONLY
-        };
-
-        VkImage image = VK_NULL_HANDLE;
-        VmaAllocation allocation = VK_NULL_HANDLE;
-
-        if (const auto res = vmaCreateImage(allocator.allocator, &imageInfo, &allocInfo, &image, &allocation, nullptr);
-            VK_SUCCESS != res) {
-            throw vkutils::Error("Unable to allocate depth buffer image\n"
-                                 "vmaCreateImage() returned %s", vkutils::to_string(res).c_str()
-            );
-        }
-
-        vkutils::Image depthImage(allocator.allocator, image, allocation);
+        vkutils::Image depthImage = vkutils::create_image(allocator, imageInfo, vkutils::MemoryClass::RenderTarget);
 
         // Create the image view
         const VkImageViewCreateInfo viewInfo{
@@ -618,21 +612,7 @@ namespace offscreen {
             .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
         };
 
-        constexpr VmaAllocationCreateInfo allocInfo{
-            .usage = VMA_MEMORY_USAGE_GPU_ONLY
-        };
-
-        VkImage image = VK_NULL_HANDLE;
-        VmaAllocation allocation = VK_NULL_HANDLE;
-
-        if (const auto res = vmaCreateImage(allocator.allocator, &imageInfo, &allocInfo, &image, &allocation, nullptr);
-            VK_SUCCESS != res) {
-            throw vkutils::Error("Unable to allocate offscreen target image\n"
-                                 "vmaCreateImage() returned %s", vkutils::to_string(res).c_str()
-            );
-        }
-
-        vkutils::Image offscreenImage(allocator.allocator, image, allocation);
+        vkutils::Image offscreenImage = vkutils::create_image(allocator, imageInfo, vkutils::MemoryClass::RenderTarget);
 
         // Create the image view
         const VkImageViewCreateInfo viewInfo{
@@ -689,20 +669,20 @@ namespace offscreen {
     }
 
     void prepare_offscreen_command_buffer(const vkutils::VulkanContext& context,
-                                          const vkutils::Fence& offscreenFence,
+                                          const vkutils::Fence& frameFence,
                                           const VkCommandBuffer offscreenCommandBuffer) {
-        // Wait for frame fence
-        if (const auto res = vkWaitForFences(context.device, 1, &offscreenFence.handle, VK_TRUE,
+        // Wait for the previous use of the frame, offscreen and fullscreen commands alike
+        if (const auto res = vkWaitForFences(context.device, 1, &frameFence.handle, VK_TRUE,
                                              std::numeric_limits<std::uint64_t>::max());
             VK_SUCCESS != res) {
-            throw vkutils::Error("Unable to wait for offscreen command buffer fence\n"
+            throw vkutils::Error("Unable to wait for frame fence\n"
                                  "vkWaitForFences() returned %s", vkutils::to_string(res).c_str()
             );
         }
 
-        if (const auto res = vkResetFences(context.device, 1, &offscreenFence.handle);
+        if (const auto res = vkResetFences(context.device, 1, &frameFence.handle);
             VK_SUCCESS != res) {
-            throw vkutils::Error("Unable to reset offscreen command buffer fence\n"
+            throw vkutils::Error("Unable to reset frame fence\n"
                                  "vkResetFences() returned %s", vkutils::to_string(res).c_str()
             );
         }
@@ -721,22 +701,66 @@ namespace offscreen {
         }
     }
 
+    void append_draw_jobs(std::vector<parallel_recording::SecondaryJob>& jobs,
+                          const VkRenderPass renderPass,
+                          const VkFramebuffer framebuffer,
+                          const VkPipelineLayout pipelineLayout,
+                          const VkPipeline opaquePipeline,
+                          const VkPipeline alphaMaskPipeline,
+                          const VkDescriptorSet sceneDescriptorSet,
+                          const VkDescriptorSet shadeDescriptorSet,
+                          const uniforms::FrameOffsets& uniformOffsets,
+                          const mesh::Geometry& geometry,
+                          const gpu_culling::IndirectDraws& opaqueDraws,
+                          const gpu_culling::IndirectDraws& alphaMaskedDraws,
+                          const VkDescriptorSet materialDescriptorSet) {
+        // Scene and shade uniforms of the frame, in the order of the sets
+        const std::array dynamicOffsets = {uniformOffsets.scene, uniformOffsets.shade};
+
+        const auto append = [&](const gpu_culling::IndirectDraws& draws, const VkPipeline pipeline) {
+            for (const auto range : gpu_culling::split_draws(draws, cfg::recordingChunkSize)) {
+                jobs.emplace_back(parallel_recording::SecondaryJob{
+                    .renderPass = renderPass,
+                    .framebuffer = framebuffer,
+                    .record = [=, &geometry, &draws](const VkCommandBuffer commandBuffer) {
+                        // Bind scene, shade and material table descriptor sets into layout(set = {0, 1, 2}, ...).
+                        // Draws index the material table with their instance.
+                        const std::array descriptorSets = {
+                            sceneDescriptorSet, shadeDescriptorSet, materialDescriptorSet
+                        };
+                        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                                pipelineLayout, 0, descriptorSets.size(),
+                                                descriptorSets.data(), dynamicOffsets.size(), dynamicOffsets.data());
+
+                        // Bind scene vertex buffers into layout(location = {1, 2, 3, 4}), and indices
+                        mesh::bind_geometry(commandBuffer, geometry, 4);
+
+                        // Push the constants to the command buffer. Indirect draws share them: all meshes are drawn
+                        // white.
+                        const glsl::MeshPushConstants pushConstants{
+                            .colour = {1.0f, 1.0f, 1.0f}
+                        };
+                        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                                           sizeof(glsl::MeshPushConstants), &pushConstants);
+
+                        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+                        gpu_culling::draw(commandBuffer, draws, range);
+                    }
+                });
+            }
+        };
+
+        // First draw the visible opaque meshes, then the alpha masked ones
+        append(opaqueDraws, opaquePipeline);
+        append(alphaMaskedDraws, alphaMaskPipeline);
+    }
+
     void record_commands(const VkCommandBuffer commandBuffer,
                          const VkRenderPass renderPass,
                          const VkFramebuffer framebuffer,
-                         const VkPipelineLayout pipelineLayout,
-                         const VkPipeline opaquePipeline,
-                         const VkPipeline alphaMaskPipeline,
                          const VkExtent2D& imageExtent,
-                         const VkBuffer sceneUBO,
-                         const glsl::SceneUniform& sceneUniform,
-                         const VkDescriptorSet sceneDescriptorSet,
-                         const VkBuffer shadeUBO,
-                         const glsl::ShadeUniform& shadeUniform,
-                         const VkDescriptorSet shadeDescriptorSet,
-                         const std::vector<mesh::Mesh>& opaqueMeshes,
-                         const std::vector<mesh::Mesh>& alphaMaskedMeshes,
-                         const std::vector<VkDescriptorSet>& materialDescriptorSets) {
+                         const std::span<const VkCommandBuffer> drawCommands) {
         // Begin render pass
         constexpr std::array clearValues{
             // Clear to dark gray background
@@ -758,20 +782,6 @@ namespace offscreen {
             }
         };
 
-        // Prepare uniforms
-        scene::update_scene_ubo(commandBuffer, sceneUBO, sceneUniform);
-        shade::update_shade_ubo(commandBuffer, shadeUBO, shadeUniform);
-
-        // Bind scene descriptor set into layout(set = 0, ...)
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                pipelineLayout, 0, 1,
-                                &sceneDescriptorSet, 0, nullptr);
-
-        // Bind screen descriptor set into layout(set = 1, ...)
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                pipelineLayout, 1, 1,
-                                &shadeDescriptorSet, 0, nullptr);
-
         // Create render pass command
         const VkRenderPassBeginInfo passInfo{
             .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
@@ -785,63 +795,11 @@ namespace offscreen {
             .pClearValues = clearValues.data()
         };
 
-        // Begin render pass
-        vkCmdBeginRenderPass(commandBuffer, &passInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-        // First draw opaque pipeline
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, opaquePipeline);
-
-        // Draw opaque meshes
-        for (const auto& mesh : opaqueMeshes) {
-            // Push the constants to the command buffer
-            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0,
-                               sizeof(glsl::MeshPushConstants), &mesh.pushConstants);
-
-            // Bind mesh descriptor set into layout(set = 2, ...)
-            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                    pipelineLayout, 2, 1,
-                                    &materialDescriptorSets[mesh.materialId], 0, nullptr);
-
-            // Bind mesh vertex buffers into layout(location = {1, 2, 3, 4})
-            const std::array vertexBuffers = {
-                mesh.positions.buffer, mesh.uvs.buffer, mesh.normals.buffer, mesh.tangents.buffer
-            };
-            constexpr std::array<VkDeviceSize, vertexBuffers.size()> offsets{};
-            vkCmdBindVertexBuffers(commandBuffer, 0, vertexBuffers.size(), vertexBuffers.data(), offsets.data());
-
-            // Bind mesh vertex indices
-            vkCmdBindIndexBuffer(commandBuffer, mesh.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-
-            // Draw mesh vertices
-            vkCmdDrawIndexed(commandBuffer, mesh.indexCount, 1, 0, 0, 0);
-        }
-
-        // Second draw alpha masked pipeline
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, alphaMaskPipeline);
-
-        // Draw meshes
-        for (const auto& mesh : alphaMaskedMeshes) {
-            // Push the constants to the command buffer
-            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0,
-                               sizeof(glsl::MeshPushConstants), &mesh.pushConstants);
-
-            // Bind mesh descriptor set into layout(set = 2, ...)
-            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                    pipelineLayout, 2, 1,
-                                    &materialDescriptorSets[mesh.materialId], 0, nullptr);
-
-            // Bind mesh vertex buffers into layout(location = {1, 2, 3, 4})
-            const std::array vertexBuffers = {
-                mesh.positions.buffer, mesh.uvs.buffer, mesh.normals.buffer, mesh.tangents.buffer
-            };
-            constexpr std::array<VkDeviceSize, vertexBuffers.size()> offsets{};
-            vkCmdBindVertexBuffers(commandBuffer, 0, vertexBuffers.size(), vertexBuffers.data(), offsets.data());
-
-            // Bind mesh vertex indices
-            vkCmdBindIndexBuffer(commandBuffer, mesh.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+        // Begin render pass, whose draws were recorded by append_draw_jobs()
+        vkCmdBeginRenderPass(commandBuffer, &passInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-            // Draw mesh vertices
-            vkCmdDrawIndexed(commandBuffer, mesh.indexCount, 1, 0, 0, 0);
+        if (!drawCommands.empty()) {
+            vkCmdExecuteCommands(commandBuffer, static_cast<std::uint32_t>(drawCommands.size()), drawCommands.data());
         }
 
         // End the render pass
@@ -850,8 +808,7 @@ namespace offscreen {
 
     void submit_commands(const vkutils::VulkanContext& context,
                          const VkCommandBuffer offscreenCommandBuffer,
-                         const vkutils::Semaphore& signalSemaphore,
-                         const vkutils::Fence& offscreenFence) {
+                         const vkutils::Semaphore& signalSemaphore) {
         // End command recording
         if (const auto res = vkEndCommandBuffer(offscreenCommandBuffer); VK_SUCCESS != res) {
             throw vkutils::Error("Unable to end recording offscreen command buffer\n"
@@ -859,7 +816,7 @@ namespace offscreen {
             );
         }
 
-        // Submit command buffer, with signal semaphore only
+        // Submit command buffer, with signal semaphore only. The fence of the frame is signalled by its last submission.
         const VkSubmitInfo submitInfo{
             .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
             .waitSemaphoreCount = 0,
@@ -871,7 +828,7 @@ namespace offscreen {
             .pSignalSemaphores = &signalSemaphore.handle
         };
 
-        if (const auto res = vkQueueSubmit(context.graphicsQueue, 1, &submitInfo, offscreenFence.handle);
+        if (const auto res = vkQueueSubmit(context.graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
             VK_SUCCESS != res) {
             throw vkutils::Error("Unable to submit offscreen command buffer to queue\n"
                                  "vkQueueSubmit() returned %s", vkutils::to_string(res).c_str()
@@ -880,10 +837,12 @@ namespace offscreen {
     }
 
     void wait_offscreen_early(const vkutils::VulkanWindow& vulkanWindow,
-                              const vkutils::Semaphore& waitSemaphore) {
+                              const vkutils::Semaphore& waitSemaphore,
+                              const vkutils::Fence& frameFence) {
         // Wait for offscreen finished pass to complete
         // Needed in cases in which the offscreen pass was submitted but not waited upon
         // Occurs when swapchain is recreated
+        // Being the last submission of the frame, it signals the frame fence
 
         // TODO: Determine whether this approach is better than acquiring swapchain earlier
         constexpr VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
@@ -894,6 +853,11 @@ namespace offscreen {
             .pWaitDstStageMask = &waitStage,
             .commandBufferCount = 0 // No command buffers to execute
         };
-        vkQueueSubmit(vulkanWindow.graphicsQueue, 1, &waitSubmitInfo, VK_NULL_HANDLE);
+        if (const auto res = vkQueueSubmit(vulkanWindow.graphicsQueue, 1, &waitSubmitInfo, frameFence.handle);
+            VK_SUCCESS != res) {
+            throw vkutils::Error("Unable to submit offscreen wait to queue\n"
+                                 "vkQueueSubmit() returned %s", vkutils::to_string(res).c_str()
+            );
+        }
     }
 }
@@ -1,28 +1,39 @@
 #pragma once
 
+#include <span>
+#include <vector>
+
 #include "../vkutils/vkimage.hpp"
 #include "../vkutils/vkobject.hpp"
 #include "../vkutils/vulkan_window.hpp"
 
+#include "gpu_culling.hpp"
 #include "mesh.hpp"
+#include "parallel_recording.hpp"
 #include "scene.hpp"
 #include "shade.hpp"
+#include "uniforms.hpp"
 
 namespace offscreen {
-    vkutils::RenderPass create_render_pass(const vkutils::VulkanWindow& window);
+    // With depthPrepass, the depth buffer is loaded from the depth prepass instead of cleared, see prepass.hpp. Both
+    // render passes are compatible.
+    vkutils::RenderPass create_render_pass(const vkutils::VulkanWindow& window, bool depthPrepass);
 
     vkutils::PipelineLayout create_pipeline_layout(const vkutils::VulkanContext& context,
                                                    const vkutils::DescriptorSetLayout& sceneLayout,
                                                    const vkutils::DescriptorSetLayout& shadeLayout,
                                                    const vkutils::DescriptorSetLayout& materialLayout);
 
+    // With depthPrepass, fragments pass the depth test if they are those the depth prepass kept, and do not write depth
     vkutils::Pipeline create_opaque_pipeline(const vkutils::VulkanWindow& window,
                                              VkRenderPass renderPass,
-                                             VkPipelineLayout pipelineLayout);
+                                             VkPipelineLayout pipelineLayout,
+                                             bool depthPrepass);
 
     vkutils::Pipeline create_alpha_pipeline(const vkutils::VulkanWindow& window,
                                             VkRenderPass renderPass,
-                                            VkPipelineLayout pipelineLayout);
+                                            VkPipelineLayout pipelineLayout,
+                                            bool depthPrepass);
 
     std::tuple<vkutils::Image, vkutils::ImageView> create_depth_buffer(
         const vkutils::VulkanWindow&, const vkutils::Allocator&);
@@ -35,32 +46,38 @@ namespace offscreen {
                                                       VkImageView offscreenView,
                                                       VkImageView depthView);
 
+    // Waits for the previous use of the frame, see frames::Frame::fence
     void prepare_offscreen_command_buffer(const vkutils::VulkanContext& context,
-                                          const vkutils::Fence& offscreenFence,
+                                          const vkutils::Fence& frameFence,
                                           VkCommandBuffer offscreenCommandBuffer);
 
+    // Appends the jobs recording the draws of the offscreen pass, cfg::recordingChunkSize draws at most per job
+    void append_draw_jobs(std::vector<parallel_recording::SecondaryJob>& jobs,
+                          VkRenderPass renderPass,
+                          VkFramebuffer framebuffer,
+                          VkPipelineLayout graphicsLayout,
+                          VkPipeline opaquePipeline,
+                          VkPipeline alphaMaskPipeline,
+                          VkDescriptorSet sceneDescriptors,
+                          VkDescriptorSet screenDescriptors,
+                          const uniforms::FrameOffsets& uniformOffsets,
+                          const mesh::Geometry& geometry,
+                          const gpu_culling::IndirectDraws& opaqueDraws,
+                          const gpu_culling::IndirectDraws& alphaMaskedDraws,
+                          VkDescriptorSet materialDescriptorSet);
+
+    // Records the offscreen pass, which executes drawCommands, the command buffers of the jobs of append_draw_jobs()
     void record_commands(VkCommandBuffer commandBuffer,
                          VkRenderPass renderPass,
                          VkFramebuffer framebuffer,
-                         VkPipelineLayout graphicsLayout,
-                         VkPipeline opaquePipeline,
-                         VkPipeline alphaMaskPipeline,
                          const VkExtent2D& imageExtent,
-                         VkBuffer sceneUBO,
-                         const glsl::SceneUniform& sceneUniform,
-                         VkDescriptorSet sceneDescriptors,
-                         VkBuffer shadeUBO,
-                         const glsl::ShadeUniform& shadeUniform,
-                         VkDescriptorSet screenDescriptors,
-                         const std::vector<mesh::Mesh>& opaqueMeshes,
-                         const std::vector<mesh::Mesh>& alphaMaskedMeshes,
-                         const std::vector<VkDescriptorSet>& materialDescriptorSets);
+                         std::span<const VkCommandBuffer> drawCommands);
 
     void submit_commands(const vkutils::VulkanContext& context,
                          VkCommandBuffer offscreenCommandBuffer,
-                         const vkutils::Semaphore& signalSemaphore,
-                         const vkutils::Fence& offscreenFence);
+                         const vkutils::Semaphore& signalSemaphore);
 
     void wait_offscreen_early(const vkutils::VulkanWindow& vulkanWindow,
-                              const vkutils::Semaphore& waitSemaphore);
+                              const vkutils::Semaphore& waitSemaphore,
+                              const vkutils::Fence& frameFence);
 }
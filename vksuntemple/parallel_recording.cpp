@@ -0,0 +1,138 @@
+#include "parallel_recording.hpp"
+
+#include <cassert>
+
+#include "../vkutils/error.hpp"
+#include "../vkutils/to_string.hpp"
+#include "../vkutils/vkutil.hpp"
+
+namespace {
+    VkCommandBuffer alloc_secondary_command_buffer(const vkutils::VulkanContext& context, VkCommandPool commandPool);
+}
+
+namespace parallel_recording {
+    SecondaryRecorder::SecondaryRecorder(const vkutils::VulkanContext& context,
+                                         const std::size_t workerCount,
+                                         const std::size_t frameCount,
+                                         const VkQueryPipelineStatisticFlags pipelineStatistics)
+        : mContext(context),
+          mPipelineStatistics(pipelineStatistics),
+          mFrames(frameCount),
+          mWorkers(workerCount) {
+    }
+
+    const std::vector<VkCommandBuffer>& SecondaryRecorder::record(const std::size_t frame,
+                                                                  const std::vector<SecondaryJob>& jobs,
+                                                                  const VkCommandBufferUsageFlags usage) {
+        assert(frame < mFrames.size());
+        auto& commands = mFrames[frame];
+        while (commands.pools.size() < jobs.size()) {
+            const auto& pool = commands.pools.emplace_back(vkutils::create_command_pool(mContext));
+            commands.commandBuffers.emplace_back(alloc_secondary_command_buffer(mContext, pool.handle));
+        }
+
+        mPending = jobs.size();
+        mError = nullptr;
+
+        for (std::size_t i = 0; i < jobs.size(); ++i) {
+            mWorkers.submit([this, &commands, i, &job = jobs[i], usage] {
+                std::exception_ptr error;
+                try {
+                    run_job(commands, i, job, usage);
+                } catch (...) {
+                    error = std::current_exception();
+                }
+
+                {
+                    std::lock_guard lock(mMutex);
+                    if (error && !mError) {
+                        mError = error;
+                    }
+                    --mPending;
+                }
+
+                mDone.notify_one();
+            });
+        }
+
+        {
+            std::unique_lock lock(mMutex);
+            mDone.wait(lock, [this] {
+                return 0 == mPending;
+            });
+        }
+
+        if (mError) {
+            std::rethrow_exception(mError);
+        }
+
+        // Only the command buffers of this call
+        commands.recorded.assign(commands.commandBuffers.begin(),
+                                 commands.commandBuffers.begin() + static_cast<std::ptrdiff_t>(jobs.size()));
+        return commands.recorded;
+    }
+
+    void SecondaryRecorder::run_job(FrameCommands& commands,
+                                    const std::size_t index,
+                                    const SecondaryJob& job,
+                                    const VkCommandBufferUsageFlags usage) {
+        const VkCommandBuffer commandBuffer = commands.commandBuffers[index];
+
+        if (const auto res = vkResetCommandPool(mContext.device, commands.pools[index].handle, 0);
+            VK_SUCCESS != res) {
+            throw vkutils::Error("Unable to reset secondary command pool\n"
+                                 "vkResetCommandPool() returned %s", vkutils::to_string(res).c_str()
+            );
+        }
+
+        const VkCommandBufferInheritanceInfo inheritanceInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+            .renderPass = job.renderPass,
+            .subpass = 0,
+            .framebuffer = job.framebuffer,
+            .pipelineStatistics = mPipelineStatistics
+        };
+
+        const VkCommandBufferBeginInfo beginInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = usage | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+            .pInheritanceInfo = &inheritanceInfo
+        };
+
+        if (const auto res = vkBeginCommandBuffer(commandBuffer, &beginInfo); VK_SUCCESS != res) {
+            throw vkutils::Error("Unable to begin recording secondary command buffer\n"
+                                 "vkBeginCommandBuffer() returned %s", vkutils::to_string(res).c_str()
+            );
+        }
+
+        job.record(commandBuffer);
+
+        if (const auto res = vkEndCommandBuffer(commandBuffer); VK_SUCCESS != res) {
+            throw vkutils::Error("Unable to end recording secondary command buffer\n"
+                                 "vkEndCommandBuffer() returned %s", vkutils::to_string(res).c_str()
+            );
+        }
+    }
+}
+
+namespace {
+    VkCommandBuffer alloc_secondary_command_buffer(const vkutils::VulkanContext& context,
+                                                   const VkCommandPool commandPool) {
+        const VkCommandBufferAllocateInfo commandBufferInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = commandPool,
+            .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+            .commandBufferCount = 1
+        };
+
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        if (const auto res = vkAllocateCommandBuffers(context.device, &commandBufferInfo, &commandBuffer);
+            VK_SUCCESS != res) {
+            throw vkutils::Error("Unable to allocate secondary command buffer\n"
+                                 "vkAllocateCommandBuffers() returned %s", vkutils::to_string(res).c_str()
+            );
+        }
+
+        return commandBuffer;
+    }
+}
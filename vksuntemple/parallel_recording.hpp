@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <exception>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include <volk/volk.h>
+
+#include "../vkutils/vkobject.hpp"
+#include "../vkutils/vulkan_context.hpp"
+
+#include "thread_pool.hpp"
+
+namespace parallel_recording {
+    // Commands recorded into a secondary command buffer, which continues subpass 0 of renderPass within framebuffer.
+    // Secondary command buffers inherit no state: the job binds everything it draws with.
+    struct SecondaryJob {
+        VkRenderPass renderPass;
+        VkFramebuffer framebuffer;
+        std::function<void(VkCommandBuffer)> record;
+    };
+
+    /*
+     * Records the draws of the render passes on worker threads, into
+     * secondary command buffers which the primary command buffer executes.
+     *
+     * Command pools are externally synchronised, so every job of a call has
+     * a command pool of its own, reset by the job before recording. Pools
+     * are created as needed, and kept for the following calls.
+     *
+     * Each frame in flight records into command buffers of its own, so that
+     * recording a frame does not wait for the previous one to execute.
+     *
+     * The command buffers may be executed while a pipeline statistics query
+     * counting pipelineStatistics is active, see pass_stats.hpp.
+     */
+    class SecondaryRecorder {
+    public:
+        SecondaryRecorder(const vkutils::VulkanContext& context, std::size_t workerCount, std::size_t frameCount,
+                          VkQueryPipelineStatisticFlags pipelineStatistics);
+
+        SecondaryRecorder(const SecondaryRecorder&) = delete;
+
+        SecondaryRecorder& operator=(const SecondaryRecorder&) = delete;
+
+        // Records jobs in parallel, and returns once all have completed, with their command buffers in the order of
+        // jobs. Rethrows the first exception thrown by a job.
+        // usage is VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, unless the command buffers are executed by several
+        // uses of the frame. The command buffers of the previous call for frame are reused, so the commands executing
+        // them must have completed.
+        // frame is in [0, frameCount).
+        const std::vector<VkCommandBuffer>& record(std::size_t frame,
+                                                   const std::vector<SecondaryJob>& jobs,
+                                                   VkCommandBufferUsageFlags usage);
+
+    private:
+        struct FrameCommands {
+            std::vector<vkutils::CommandPool> pools;
+            std::vector<VkCommandBuffer> commandBuffers; // One per pool
+            std::vector<VkCommandBuffer> recorded;       // Those of the last call
+        };
+
+        void run_job(FrameCommands& commands, std::size_t index, const SecondaryJob& job,
+                     VkCommandBufferUsageFlags usage);
+
+        const vkutils::VulkanContext& mContext;
+        const VkQueryPipelineStatisticFlags mPipelineStatistics;
+
+        std::vector<FrameCommands> mFrames;
+
+        // Jobs of the current call that have not completed yet
+        std::mutex mMutex;
+        std::condition_variable mDone;
+        std::size_t mPending = 0;
+        std::exception_ptr mError;
+
+        // Declared last, so that the workers are joined before the rest is destroyed
+        thread_pool::ThreadPool mWorkers;
+    };
+}
@@ -0,0 +1,241 @@
+#include "pass_stats.hpp"
+
+#include <cassert>
+#include <cstdio>
+#include <vector>
+
+#include "../vkutils/error.hpp"
+#include "../vkutils/to_string.hpp"
+
+namespace {
+    constexpr VkQueryPipelineStatisticFlags countedStatistics =
+            VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+    vkutils::QueryPool create_query_pool(const vkutils::VulkanContext& context,
+                                         VkQueryType type,
+                                         std::uint32_t queryCount,
+                                         VkQueryPipelineStatisticFlags pipelineStatistics);
+
+    // Results of count queries from first, or an empty vector if they are not all available
+    std::vector<std::uint64_t> get_results(const vkutils::VulkanContext& context,
+                                           VkQueryPool pool,
+                                           std::uint32_t first,
+                                           std::uint32_t count);
+}
+
+namespace pass_stats {
+    PassStats::PassStats(const vkutils::VulkanContext& context, const std::uint32_t frameCount)
+        : mContext(context),
+          mFrames(frameCount) {
+        std::uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(context.physicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(context.physicalDevice, &familyCount, families.data());
+
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(context.physicalDevice, &properties);
+
+        const std::uint32_t validBits = families[context.graphicsFamilyIndex].timestampValidBits;
+        if (validBits > 0) {
+            mTimestamps = true;
+            mTimestampPeriod = properties.limits.timestampPeriod;
+            mTimestampMask = validBits >= 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << validBits) - 1;
+            mTimestampPool = create_query_pool(context, VK_QUERY_TYPE_TIMESTAMP,
+                                               frameCount * passCount * 2, 0);
+        }
+
+        if (context.hasPipelineStatistics) {
+            mStatisticsPool = create_query_pool(context, VK_QUERY_TYPE_PIPELINE_STATISTICS,
+                                                frameCount * passCount, countedStatistics);
+        }
+    }
+
+    VkQueryPipelineStatisticFlags PassStats::pipeline_statistics() const {
+        return mContext.hasPipelineStatistics ? countedStatistics : 0;
+    }
+
+    void PassStats::begin_frame(const VkCommandBuffer commandBuffer, const std::size_t frame, const bool depthPrepass) {
+        assert(frame < mFrames.size());
+        collect(frame);
+
+        const auto first = static_cast<std::uint32_t>(frame * passCount);
+        if (mTimestamps) {
+            vkCmdResetQueryPool(commandBuffer, mTimestampPool.handle, first * 2, passCount * 2);
+        }
+        if (mContext.hasPipelineStatistics) {
+            vkCmdResetQueryPool(commandBuffer, mStatisticsPool.handle, first, passCount);
+        }
+
+        mFrames[frame] = FrameQueries{
+            .recorded = true,
+            .depthPrepass = depthPrepass
+        };
+    }
+
+    void PassStats::begin_pass(const VkCommandBuffer commandBuffer, const std::size_t frame, const Pass pass) {
+        const auto query = static_cast<std::uint32_t>(frame * passCount + static_cast<std::size_t>(pass));
+        if (mTimestamps) {
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, mTimestampPool.handle, query * 2);
+        }
+        if (mContext.hasPipelineStatistics) {
+            vkCmdBeginQuery(commandBuffer, mStatisticsPool.handle, query, 0);
+        }
+    }
+
+    void PassStats::end_pass(const VkCommandBuffer commandBuffer, const std::size_t frame, const Pass pass) {
+        const auto query = static_cast<std::uint32_t>(frame * passCount + static_cast<std::size_t>(pass));
+        if (mContext.hasPipelineStatistics) {
+            vkCmdEndQuery(commandBuffer, mStatisticsPool.handle, query);
+        }
+        if (mTimestamps) {
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mTimestampPool.handle,
+                                query * 2 + 1);
+        }
+    }
+
+    void PassStats::print_report() {
+        constexpr std::array passNames = {"depth prepass", "offscreen"};
+
+        // Sums of the passes of each mode, indexed like mTotals
+        std::array<double, 2> frameMilliseconds{};
+        std::array<std::uint64_t, 2> frameInvocations{};
+
+        for (const bool depthPrepass : {false, true}) {
+            const Totals& totals = mTotals[depthPrepass];
+            if (0 == totals.frames) {
+                continue;
+            }
+
+            std::printf("GPU passes %s depth prepass, average of %llu frames:\n", depthPrepass ? "with" : "without",
+                        static_cast<unsigned long long>(totals.frames));
+
+            double totalMilliseconds = 0.0;
+            std::uint64_t totalInvocations = 0;
+            for (std::size_t pass = depthPrepass ? 0 : 1; pass < passCount; ++pass) {
+                const double milliseconds = totals.milliseconds[pass] / static_cast<double>(totals.frames);
+                const std::uint64_t invocations = totals.fragmentInvocations[pass] / totals.frames;
+                std::printf("  %-14s %8.3f ms %12llu fragment shader invocations\n", passNames[pass],
+                            milliseconds, static_cast<unsigned long long>(invocations));
+
+                totalMilliseconds += milliseconds;
+                totalInvocations += invocations;
+            }
+            std::printf("  %-14s %8.3f ms %12llu fragment shader invocations\n", "total",
+                        totalMilliseconds, static_cast<unsigned long long>(totalInvocations));
+
+            frameMilliseconds[depthPrepass] = totalMilliseconds;
+            frameInvocations[depthPrepass] = totalInvocations;
+        }
+
+        // Both modes were measured, presumably on the same view
+        if (mTotals[false].frames > 0 && mTotals[true].frames > 0) {
+            std::printf("Depth prepass:");
+            if (mTimestamps && frameMilliseconds[false] > 0.0) {
+                std::printf(" %+.1f%% GPU time", 100.0 * (frameMilliseconds[true] / frameMilliseconds[false] - 1.0));
+            }
+            if (mContext.hasPipelineStatistics && frameInvocations[false] > 0) {
+                std::printf(" %+.1f%% fragment shader invocations",
+                            100.0 * (static_cast<double>(frameInvocations[true]) /
+                                     static_cast<double>(frameInvocations[false]) - 1.0));
+            }
+            std::printf("\n");
+        }
+
+        if (!mTimestamps) {
+            std::printf("  (timestamps unsupported by the graphics queue)\n");
+        }
+        if (!mContext.hasPipelineStatistics) {
+            std::printf("  (pipeline statistics unsupported by the device)\n");
+        }
+
+        mTotals = {};
+    }
+
+    void PassStats::collect(const std::size_t frame) {
+        FrameQueries& queries = mFrames[frame];
+        if (!queries.recorded) {
+            return;
+        }
+        queries.recorded = false;
+
+        const auto first = static_cast<std::uint32_t>(frame * passCount);
+        // Passes the frame recorded
+        const std::uint32_t firstPass = queries.depthPrepass ? 0 : 1;
+
+        std::vector<std::uint64_t> timestamps;
+        if (mTimestamps) {
+            timestamps = get_results(mContext, mTimestampPool.handle, (first + firstPass) * 2,
+                                     (passCount - firstPass) * 2);
+            if (timestamps.empty()) {
+                return;
+            }
+        }
+
+        std::vector<std::uint64_t> invocations;
+        if (mContext.hasPipelineStatistics) {
+            invocations = get_results(mContext, mStatisticsPool.handle, first + firstPass, passCount - firstPass);
+            if (invocations.empty()) {
+                return;
+            }
+        }
+
+        Totals& totals = mTotals[queries.depthPrepass];
+        ++totals.frames;
+        for (std::uint32_t pass = firstPass; pass < passCount; ++pass) {
+            const std::uint32_t i = pass - firstPass;
+            if (mTimestamps) {
+                const std::uint64_t ticks = (timestamps[i * 2 + 1] - timestamps[i * 2]) & mTimestampMask;
+                totals.milliseconds[pass] += static_cast<double>(ticks) * mTimestampPeriod * 1e-6;
+            }
+            if (mContext.hasPipelineStatistics) {
+                totals.fragmentInvocations[pass] += invocations[i];
+            }
+        }
+    }
+}
+
+namespace {
+    vkutils::QueryPool create_query_pool(const vkutils::VulkanContext& context,
+                                         const VkQueryType type,
+                                         const std::uint32_t queryCount,
+                                         const VkQueryPipelineStatisticFlags pipelineStatistics) {
+        const VkQueryPoolCreateInfo poolInfo{
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = type,
+            .queryCount = queryCount,
+            .pipelineStatistics = pipelineStatistics
+        };
+
+        VkQueryPool pool = VK_NULL_HANDLE;
+        if (const auto res = vkCreateQueryPool(context.device, &poolInfo, nullptr, &pool);
+            VK_SUCCESS != res) {
+            throw vkutils::Error("Unable to create query pool\n"
+                                 "vkCreateQueryPool() returned %s", vkutils::to_string(res).c_str()
+            );
+        }
+
+        return vkutils::QueryPool(context.device, pool);
+    }
+
+    std::vector<std::uint64_t> get_results(const vkutils::VulkanContext& context,
+                                           const VkQueryPool pool,
+                                           const std::uint32_t first,
+                                           const std::uint32_t count) {
+        std::vector<std::uint64_t> results(count);
+
+        // Without VK_QUERY_RESULT_WAIT_BIT: the fence of the frame has been waited for
+        const auto res = vkGetQueryPoolResults(context.device, pool, first, count,
+                                               results.size() * sizeof(std::uint64_t), results.data(),
+                                               sizeof(std::uint64_t), VK_QUERY_RESULT_64_BIT);
+        if (VK_NOT_READY == res) {
+            return {};
+        }
+        if (VK_SUCCESS != res) {
+            throw vkutils::Error("Unable to read query results\n"
+                                 "vkGetQueryPoolResults() returned %s", vkutils::to_string(res).c_str()
+            );
+        }
+
+        return results;
+    }
+}
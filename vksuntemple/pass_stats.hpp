@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <volk/volk.h>
+
+#include "../vkutils/vkobject.hpp"
+#include "../vkutils/vulkan_context.hpp"
+
+namespace pass_stats {
+    // Passes measured by PassStats, in recording order
+    enum class Pass : std::uint32_t {
+        depthPrepass = 0,
+        offscreen = 1,
+        max
+    };
+
+    /*
+     * GPU time and fragment shader invocations of the depth prepass and
+     * offscreen pass, averaged separately for the frames with and without
+     * the depth prepass.
+     *
+     * Each frame in flight has queries of its own: a timestamp before and
+     * after each pass, and a pipeline statistics query over each pass. Their
+     * results are read when the frame is recorded again, once its fence has
+     * been waited for, so reading them never stalls.
+     *
+     * Timestamps are skipped on queues without timestamp support, and
+     * pipeline statistics without vkutils::VulkanContext::hasPipelineStatistics.
+     */
+    class PassStats {
+    public:
+        PassStats(const vkutils::VulkanContext& context, std::uint32_t frameCount);
+
+        PassStats(const PassStats&) = delete;
+
+        PassStats& operator=(const PassStats&) = delete;
+
+        // Statistics counted over the passes, which their secondary command buffers must inherit
+        VkQueryPipelineStatisticFlags pipeline_statistics() const;
+
+        // Accumulates the results of the previous use of frame, whose commands must have completed, and resets its
+        // queries. depthPrepass tells whether frame records the depth prepass this time.
+        void begin_frame(VkCommandBuffer commandBuffer, std::size_t frame, bool depthPrepass);
+
+        // Both are recorded outside of render passes, around the render pass of pass
+        void begin_pass(VkCommandBuffer commandBuffer, std::size_t frame, Pass pass);
+
+        void end_pass(VkCommandBuffer commandBuffer, std::size_t frame, Pass pass);
+
+        // Prints the averages since the previous report, and the relative change the depth prepass makes to their totals
+        // when frames were measured in both modes. Then starts over.
+        void print_report();
+
+    private:
+        static constexpr std::size_t passCount = static_cast<std::size_t>(Pass::max);
+
+        struct Totals {
+            std::uint64_t frames = 0;
+            std::array<double, passCount> milliseconds{};
+            std::array<std::uint64_t, passCount> fragmentInvocations{};
+        };
+
+        struct FrameQueries {
+            bool recorded = false;
+            bool depthPrepass = false;
+        };
+
+        void collect(std::size_t frame);
+
+        const vkutils::VulkanContext& mContext;
+
+        bool mTimestamps = false;
+        double mTimestampPeriod = 0.0; // Nanoseconds per tick
+        std::uint64_t mTimestampMask = 0;
+
+        vkutils::QueryPool mTimestampPool; // 2 timestamps per pass, per frame
+        vkutils::QueryPool mStatisticsPool; // 1 query per pass, per frame
+
+        std::vector<FrameQueries> mFrames;
+
+        // Indexed by whether the frames recorded the depth prepass
+        std::array<Totals, 2> mTotals{};
+    };
+}
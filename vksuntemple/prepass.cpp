@@ -0,0 +1,439 @@
+#include "prepass.hpp"
+
+#include <array>
+
+#include "../vkutils/to_string.hpp"
+#include "../vkutils/error.hpp"
+#include "../vkutils/vkutil.hpp"
+
+#include "config.hpp"
+
+namespace prepass {
+    vkutils::RenderPass create_render_pass(const vkutils::VulkanWindow& window) {
+        // Same attachment as the depth buffer of the offscreen pass, which loads it
+        constexpr std::array attachments{
+            VkAttachmentDescription{
+                .format = cfg::depthFormat,
+                .samples = VK_SAMPLE_COUNT_1_BIT,
+                .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+            }
+        };
+
+        constexpr VkAttachmentReference depthAttachment{
+            .attachment = 0, // attachments[0]
+            .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+        };
+
+        const std::array subpasses{
+            VkSubpassDescription{
+                .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+                .colorAttachmentCount = 0,
+                .pColorAttachments = nullptr,
+                .pDepthStencilAttachment = &depthAttachment
+            }
+        };
+
+        // The offscreen pass of the previous frame, which may still be executing, tests against the depth buffer
+        constexpr std::array subpassDependencies{
+            VkSubpassDependency{
+                .srcSubpass = VK_SUBPASS_EXTERNAL,
+                .dstSubpass = 0,
+                .srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                .dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                 VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+                .dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT
+            }
+        };
+
+        // https://www.khronos.org/registry/vulkan/specs/1.2-extensions/man/html/VkRenderPassCreateInfo.html
+        const VkRenderPassCreateInfo passInfo{
+            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+            .attachmentCount = attachments.size(),
+            .pAttachments = attachments.data(),
+            .subpassCount = subpasses.size(),
+            .pSubpasses = subpasses.data(),
+            .dependencyCount = subpassDependencies.size(),
+            .pDependencies = subpassDependencies.data()
+        };
+
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        if (const auto res = vkCreateRenderPass(window.device, &passInfo, nullptr, &renderPass);
+            VK_SUCCESS != res) {
+            throw vkutils::Error("Unable to create depth prepass render pass\n"
+                                 "vkCreateRenderPass() returned %s", vkutils::to_string(res).c_str()
+            );
+        }
+
+        return vkutils::RenderPass(window.device, renderPass);
+    }
+
+    vkutils::Pipeline create_opaque_pipeline(const vkutils::VulkanWindow& window,
+                                             const VkRenderPass renderPass,
+                                             const VkPipelineLayout pipelineLayout) {
+        // Load only vertex and fragment shader modules
+        const vkutils::ShaderModule vert = vkutils::load_shader_module(window, cfg::depthPrepassVertPath);
+        const vkutils::ShaderModule frag = vkutils::load_shader_module(window, cfg::opaqueShadowFragPath);
+
+        // Define shader stages in the pipeline
+        const std::array stages = {
+            // Vertex shader
+            VkPipelineShaderStageCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_VERTEX_BIT,
+                .module = vert.handle,
+                .pName = "main"
+            },
+            // Fragment shader
+            VkPipelineShaderStageCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+                .module = frag.handle,
+                .pName = "main"
+            }
+        };
+
+        // Create vertex inputs
+        constexpr std::array vertexBindings = {
+            // Positions Binding
+            VkVertexInputBindingDescription{
+                .binding = 0,
+                .stride = sizeof(glm::vec3),
+                .inputRate = VK_VERTEX_INPUT_RATE_VERTEX
+            }
+        };
+
+        // Create vertex attributes
+        constexpr std::array vertexAttributes = {
+            // Positions attribute
+            VkVertexInputAttributeDescription{
+                .location = 0, // must match shader
+                .binding = vertexBindings[0].binding,
+                .format = VK_FORMAT_R32G32B32_SFLOAT, // (x, y, z)
+                .offset = 0
+            }
+        };
+
+        // Create Pipeline with Vertex input
+        const VkPipelineVertexInputStateCreateInfo inputInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+            .vertexBindingDescriptionCount = vertexBindings.size(),
+            .pVertexBindingDescriptions = vertexBindings.data(),
+            .vertexAttributeDescriptionCount = vertexAttributes.size(),
+            .pVertexAttributeDescriptions = vertexAttributes.data()
+        };
+
+        // Define which primitive (point, line, triangle, ...) the input is assembled into for rasterization.
+        constexpr VkPipelineInputAssemblyStateCreateInfo assemblyInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+            .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+            .primitiveRestartEnable = VK_FALSE
+        };
+
+        // Define viewport and scissor regions, those of the offscreen pass
+        const VkViewport viewport{
+            .x = 0.0f,
+            .y = 0.0f,
+            .width = static_cast<float>(window.swapchainExtent.width),
+            .height = static_cast<float>(window.swapchainExtent.height),
+            .minDepth = 0.0f,
+            .maxDepth = 1.0f
+        };
+
+        const VkRect2D scissor{
+            .offset = VkOffset2D{0, 0},
+            .extent = window.swapchainExtent
+        };
+
+        const VkPipelineViewportStateCreateInfo viewportInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+            .viewportCount = 1,
+            .pViewports = &viewport,
+            .scissorCount = 1,
+            .pScissors = &scissor
+        };
+
+        // Define rasterisation options. Must match the offscreen opaque pipeline: no depth bias, same culling.
+        constexpr VkPipelineRasterizationStateCreateInfo rasterInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+            .depthClampEnable = VK_FALSE,
+            .rasterizerDiscardEnable = VK_FALSE,
+            .polygonMode = VK_POLYGON_MODE_FILL,
+            .cullMode = VK_CULL_MODE_BACK_BIT,
+            .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+            .depthBiasEnable = VK_FALSE,
+            .lineWidth = 1.0f // required.
+        };
+
+        // Define multisampling state
+        constexpr VkPipelineMultisampleStateCreateInfo samplingInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+            .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT
+        };
+
+        // Define depth info
+        constexpr VkPipelineDepthStencilStateCreateInfo depthInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+            .depthTestEnable = VK_TRUE,
+            .depthWriteEnable = VK_TRUE,
+            .depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL,
+            .minDepthBounds = 0.0f,
+            .maxDepthBounds = 1.0f
+        };
+
+        // Create pipeline
+        const VkGraphicsPipelineCreateInfo pipelineInfo{
+            .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+            .stageCount = stages.size(),
+            .pStages = stages.data(),
+            .pVertexInputState = &inputInfo,
+            .pInputAssemblyState = &assemblyInfo,
+            .pTessellationState = nullptr, // no tessellation
+            .pViewportState = &viewportInfo,
+            .pRasterizationState = &rasterInfo,
+            .pMultisampleState = &samplingInfo,
+            .pDepthStencilState = &depthInfo,
+            .pColorBlendState = nullptr, // no colour
+            .pDynamicState = nullptr, // no dynamic states
+            .layout = pipelineLayout,
+            .renderPass = renderPass,
+            .subpass = 0 // first subpass of renderPass
+        };
+
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        if (const auto res = vkCreateGraphicsPipelines(window.device, VK_NULL_HANDLE,
+                                                       1, &pipelineInfo, nullptr, &pipeline);
+            VK_SUCCESS != res) {
+            throw vkutils::Error("Unable to create opaque depth prepass pipeline\n"
+                                 "vkCreateGraphicsPipelines() returned %s", vkutils::to_string(res).c_str());
+        }
+
+        return vkutils::Pipeline(window.device, pipeline);
+    }
+
+    vkutils::Pipeline create_alpha_pipeline(const vkutils::VulkanWindow& window,
+                                            const VkRenderPass renderPass,
+                                            const VkPipelineLayout pipelineLayout) {
+        // Load only vertex and fragment shader modules
+        const vkutils::ShaderModule vert = vkutils::load_shader_module(window, cfg::depthPrepassAlphaVertPath);
+        const vkutils::ShaderModule frag = vkutils::load_shader_module(window, cfg::alphaShadowFragPath);
+
+        // Define shader stages in the pipeline
+        const std::array stages = {
+            // Vertex shader
+            VkPipelineShaderStageCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_VERTEX_BIT,
+                .module = vert.handle,
+                .pName = "main"
+            },
+            // Fragment shader
+            VkPipelineShaderStageCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+                .module = frag.handle,
+                .pName = "main"
+            }
+        };
+
+        // Create vertex inputs
+        constexpr std::array vertexBindings = {
+            // Positions Binding
+            VkVertexInputBindingDescription{
+                .binding = 0,
+                .stride = sizeof(glm::vec3),
+                .inputRate = VK_VERTEX_INPUT_RATE_VERTEX
+            },
+            // UVs Binding
+            VkVertexInputBindingDescription{
+                .binding = 1,
+                .stride = sizeof(glm::vec2),
+                .inputRate = VK_VERTEX_INPUT_RATE_VERTEX
+            }
+        };
+
+        // Create vertex attributes
+        constexpr std::array vertexAttributes = {
+            // Positions attribute
+            VkVertexInputAttributeDescription{
+                .location = 0, // must match shader
+                .binding = vertexBindings[0].binding,
+                .format = VK_FORMAT_R32G32B32_SFLOAT, // (x, y, z)
+                .offset = 0
+            },
+            // UVs attribute
+            VkVertexInputAttributeDescription{
+                .location = 1, // must match shader
+                .binding = vertexBindings[1].binding,
+                .format = VK_FORMAT_R32G32_SFLOAT, // (u, v)
+                .offset = 0
+            }
+        };
+
+        // Create Pipeline with Vertex input
+        const VkPipelineVertexInputStateCreateInfo inputInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+            .vertexBindingDescriptionCount = vertexBindings.size(),
+            .pVertexBindingDescriptions = vertexBindings.data(),
+            .vertexAttributeDescriptionCount = vertexAttributes.size(),
+            .pVertexAttributeDescriptions = vertexAttributes.data()
+        };
+
+        // Define which primitive (point, line, triangle, ...) the input is assembled into for rasterization.
+        constexpr VkPipelineInputAssemblyStateCreateInfo assemblyInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+            .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+            .primitiveRestartEnable = VK_FALSE
+        };
+
+        // Define viewport and scissor regions, those of the offscreen pass
+        const VkViewport viewport{
+            .x = 0.0f,
+            .y = 0.0f,
+            .width = static_cast<float>(window.swapchainExtent.width),
+            .height = static_cast<float>(window.swapchainExtent.height),
+            .minDepth = 0.0f,
+            .maxDepth = 1.0f
+        };
+
+        const VkRect2D scissor{
+            .offset = VkOffset2D{0, 0},
+            .extent = window.swapchainExtent
+        };
+
+        const VkPipelineViewportStateCreateInfo viewportInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+            .viewportCount = 1,
+            .pViewports = &viewport,
+            .scissorCount = 1,
+            .pScissors = &scissor
+        };
+
+        // Define rasterisation options. Must match the offscreen alpha mask pipeline, which draws both faces.
+        constexpr VkPipelineRasterizationStateCreateInfo rasterInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+            .depthClampEnable = VK_FALSE,
+            .rasterizerDiscardEnable = VK_FALSE,
+            .polygonMode = VK_POLYGON_MODE_FILL,
+            .cullMode = VK_CULL_MODE_NONE,
+            .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+            .depthBiasEnable = VK_FALSE,
+            .lineWidth = 1.0f // required.
+        };
+
+        // Define multisampling state
+        constexpr VkPipelineMultisampleStateCreateInfo samplingInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+            .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT
+        };
+
+        // Define depth info
+        constexpr VkPipelineDepthStencilStateCreateInfo depthInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+            .depthTestEnable = VK_TRUE,
+            .depthWriteEnable = VK_TRUE,
+            .depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL,
+            .minDepthBounds = 0.0f,
+            .maxDepthBounds = 1.0f
+        };
+
+        // Create pipeline
+        const VkGraphicsPipelineCreateInfo pipelineInfo{
+            .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+            .stageCount = stages.size(),
+            .pStages = stages.data(),
+            .pVertexInputState = &inputInfo,
+            .pInputAssemblyState = &assemblyInfo,
+            .pTessellationState = nullptr, // no tessellation
+            .pViewportState = &viewportInfo,
+            .pRasterizationState = &rasterInfo,
+            .pMultisampleState = &samplingInfo,
+            .pDepthStencilState = &depthInfo,
+            .pColorBlendState = nullptr, // no colour
+            .pDynamicState = nullptr, // no dynamic states
+            .layout = pipelineLayout,
+            .renderPass = renderPass,
+            .subpass = 0 // first subpass of renderPass
+        };
+
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        if (const auto res = vkCreateGraphicsPipelines(window.device, VK_NULL_HANDLE,
+                                                       1, &pipelineInfo, nullptr, &pipeline);
+            VK_SUCCESS != res) {
+            throw vkutils::Error("Unable to create alpha mask depth prepass pipeline\n"
+                                 "vkCreateGraphicsPipelines() returned %s", vkutils::to_string(res).c_str());
+        }
+
+        return vkutils::Pipeline(window.device, pipeline);
+    }
+
+    vkutils::Framebuffer create_framebuffer(const vkutils::VulkanWindow& window,
+                                            const VkRenderPass renderPass,
+                                            const VkImageView depthView) {
+        const std::array attachments = {depthView};
+        const VkFramebufferCreateInfo framebufferInfo = {
+            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+            .renderPass = renderPass,
+            .attachmentCount = attachments.size(),
+            .pAttachments = attachments.data(),
+            .width = window.swapchainExtent.width,
+            .height = window.swapchainExtent.height,
+            .layers = 1
+        };
+
+        VkFramebuffer framebuffer;
+        if (const auto res = vkCreateFramebuffer(window.device, &framebufferInfo, nullptr, &framebuffer);
+            VK_SUCCESS != res) {
+            throw vkutils::Error("Unable to create depth prepass framebuffer\n"
+                                 "vkCreateFramebuffer() returned %s", vkutils::to_string(res).c_str()
+            );
+        }
+
+        return vkutils::Framebuffer(window.device, framebuffer);
+    }
+
+    void record_commands(const VkCommandBuffer commandBuffer,
+                         const VkRenderPass renderPass,
+                         const VkFramebuffer framebuffer,
+                         const VkExtent2D& imageExtent,
+                         const std::span<const VkCommandBuffer> drawCommands) {
+        // Begin render pass
+        constexpr std::array clearValues{
+            // Clear depth value
+            VkClearValue{
+                .depthStencil = VkClearDepthStencilValue{
+                    .depth = 1.0f
+                }
+            }
+        };
+
+        // Create render pass command
+        const VkRenderPassBeginInfo passInfo{
+            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+            .renderPass = renderPass,
+            .framebuffer = framebuffer,
+            .renderArea = VkRect2D{
+                .offset = VkOffset2D{0, 0},
+                .extent = imageExtent
+            },
+            .clearValueCount = clearValues.size(),
+            .pClearValues = clearValues.data()
+        };
+
+        // Begin render pass, whose draws were recorded by shadow::append_draw_jobs()
+        vkCmdBeginRenderPass(commandBuffer, &passInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+        if (!drawCommands.empty()) {
+            vkCmdExecuteCommands(commandBuffer, static_cast<std::uint32_t>(drawCommands.size()), drawCommands.data());
+        }
+
+        // End the render pass
+        vkCmdEndRenderPass(commandBuffer);
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <span>
+
+#include "../vkutils/vkobject.hpp"
+#include "../vkutils/vulkan_window.hpp"
+
+/*
+ * Depth prepass of the camera view.
+ *
+ * Draws the meshes visible to the camera into the depth buffer of the
+ * offscreen pass, with the position only and alpha tested shaders of the
+ * shadow pass: the pipeline layouts and draws are those of the shadow pass
+ * (see shadow::append_draw_jobs()), with the camera transform and draws.
+ * The offscreen pass then loads the depth buffer and tests for equality,
+ * without writing it (see offscreen::create_render_pass()), so that the PBR
+ * fragment shaders run once per pixel, however much the meshes overlap.
+ */
+namespace prepass {
+    vkutils::RenderPass create_render_pass(const vkutils::VulkanWindow& window);
+
+    vkutils::Pipeline create_opaque_pipeline(const vkutils::VulkanWindow& window,
+                                             VkRenderPass renderPass,
+                                             VkPipelineLayout pipelineLayout);
+
+    vkutils::Pipeline create_alpha_pipeline(const vkutils::VulkanWindow& window,
+                                            VkRenderPass renderPass,
+                                            VkPipelineLayout pipelineLayout);
+
+    vkutils::Framebuffer create_framebuffer(const vkutils::VulkanWindow& window,
+                                            VkRenderPass renderPass,
+                                            VkImageView depthView);
+
+    // Records the depth prepass, which executes drawCommands, the command buffers of the jobs of
+    // shadow::append_draw_jobs() called with the prepass pipelines
+    void record_commands(VkCommandBuffer commandBuffer,
+                         VkRenderPass renderPass,
+                         VkFramebuffer framebuffer,
+                         const VkExtent2D& imageExtent,
+                         std::span<const VkCommandBuffer> drawCommands);
+}
@@ -19,7 +19,7 @@ namespace scene {
                 // number must match the index of the corresponding
                 // binding = N declaration in the shader(s)!
                 .binding = 0,
-                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
                 .descriptorCount = 1,
                 .stageFlags = VK_SHADER_STAGE_VERTEX_BIT
             }
@@ -42,22 +42,13 @@ namespace scene {
         return vkutils::DescriptorSetLayout(context.device, layout);
     }
 
-    vkutils::Buffer create_scene_ubo(const vkutils::Allocator& allocator) {
-        return vkutils::create_buffer(
-            allocator,
-            sizeof(glsl::SceneUniform),
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            0,
-            VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE
-        );
-    }
-
     void update_descriptor_set(const vkutils::VulkanContext& context,
-                               const vkutils::Buffer& sceneUBO,
+                               const VkBuffer uniformBuffer,
                                const VkDescriptorSet sceneDescriptorSet) {
         const VkDescriptorBufferInfo sceneUboInfo{
-            .buffer = sceneUBO.buffer,
-            .range = VK_WHOLE_SIZE
+            .buffer = uniformBuffer,
+            .offset = 0,
+            .range = sizeof(glsl::SceneUniform)
         };
 
         const std::array writeDescriptor{
@@ -66,7 +57,7 @@ namespace scene {
                 .dstSet = sceneDescriptorSet,
                 .dstBinding = 0,
                 .descriptorCount = 1,
-                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
                 .pBufferInfo = &sceneUboInfo
             }
         };
@@ -109,26 +100,4 @@ namespace scene {
             .SLP = cfg::shadowTransformationMatrix * LP
         };
     }
-
-    void update_scene_ubo(const VkCommandBuffer commandBuffer,
-                          const VkBuffer sceneUBO,
-                          const glsl::SceneUniform& sceneUniform) {
-        vkutils::buffer_barrier(commandBuffer,
-                                sceneUBO,
-                                VK_ACCESS_UNIFORM_READ_BIT,
-                                VK_ACCESS_TRANSFER_WRITE_BIT,
-                                VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
-                                VK_PIPELINE_STAGE_TRANSFER_BIT
-        );
-
-        vkCmdUpdateBuffer(commandBuffer, sceneUBO, 0, sizeof(glsl::SceneUniform), &sceneUniform);
-
-        vkutils::buffer_barrier(commandBuffer,
-                                sceneUBO,
-                                VK_ACCESS_TRANSFER_WRITE_BIT,
-                                VK_ACCESS_UNIFORM_READ_BIT,
-                                VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
-        );
-    }
 }
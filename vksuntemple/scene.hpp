@@ -20,29 +20,18 @@ namespace glsl {
         glm::mat4 SLP;
     };
 
-    // We want to use vkCmdUpdateBuffer() to update the contents of our uniform buffers. vkCmdUpdateBuffer()
-    // has a number of requirements, including the two below. See
-    // https://www.khronos.org/registry/vulkan/specs/1.3-extensions/man/html/vkCmdUpdateBuffer.html
-    static_assert(sizeof(SceneUniform) <= 65536,
-                  "SceneUniform must be less than 65536 bytes for vkCmdUpdateBuffer");
-    static_assert(sizeof(SceneUniform) % 4 == 0, "SceneUniform size must be a multiple of 4 bytes");
 }
 
 // Scene data
 namespace scene {
     vkutils::DescriptorSetLayout create_descriptor_layout(const vkutils::VulkanContext& context);
 
-    vkutils::Buffer create_scene_ubo(const vkutils::Allocator& allocator);
-
+    // Points the set to the SceneUniform at dynamic offset 0 of uniformBuffer, see uniforms::UniformRing
     void update_descriptor_set(const vkutils::VulkanContext& context,
-                               const vkutils::Buffer& sceneUBO,
+                               VkBuffer uniformBuffer,
                                VkDescriptorSet sceneDescriptorSet);
 
     glsl::SceneUniform create_uniform(std::uint32_t framebufferWidth,
                                       std::uint32_t framebufferHeight,
                                       const state::State& state);
-
-    void update_scene_ubo(VkCommandBuffer commandBuffer,
-                          VkBuffer sceneUBO,
-                          const glsl::SceneUniform& sceneUniform);
 }
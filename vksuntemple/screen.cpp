@@ -16,7 +16,7 @@ namespace screen {
             },
             VkDescriptorSetLayoutBinding{
                 .binding = 1, // layout(set = ..., binding = 1)
-                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
                 .descriptorCount = 1,
                 .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
             }
@@ -39,21 +39,11 @@ namespace screen {
         return vkutils::DescriptorSetLayout(context.device, layout);
     }
 
-    vkutils::Buffer create_screen_effects_ubo(const vkutils::Allocator& allocator) {
-        return vkutils::create_buffer(
-            allocator,
-            sizeof(glsl::ScreenEffectsUniform),
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            0,
-            VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE
-        );
-    }
-
     void update_descriptor_set(const vkutils::VulkanContext& context,
                                const VkDescriptorSet screenDescriptorSet,
                                const vkutils::Sampler& offscreenSampler,
                                const VkImageView offscreenView,
-                               const vkutils::Buffer& screenEffectsUBO) {
+                               const VkBuffer uniformBuffer) {
         const VkDescriptorImageInfo descriptorImageInfo{
             .sampler = offscreenSampler.handle,
             .imageView = offscreenView,
@@ -61,8 +51,9 @@ namespace screen {
         };
 
         const VkDescriptorBufferInfo descriptorBufferInfo{
-            .buffer = screenEffectsUBO.buffer,
-            .range = VK_WHOLE_SIZE
+            .buffer = uniformBuffer,
+            .offset = 0,
+            .range = sizeof(glsl::ScreenEffectsUniform)
         };
 
         const std::array writeDescriptor = {
@@ -79,7 +70,7 @@ namespace screen {
                 .dstSet = screenDescriptorSet,
                 .dstBinding = 1,
                 .descriptorCount = 1,
-                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
                 .pBufferInfo = &descriptorBufferInfo
             }
         };
@@ -92,26 +83,4 @@ namespace screen {
             .toneMappingEnabled = static_cast<std::uint32_t>(state.toneMappingEnabled)
         };
     }
-
-    void update_screen_effects_ubo(const VkCommandBuffer commandBuffer,
-                                   const VkBuffer screenEffectsUBO,
-                                   const glsl::ScreenEffectsUniform& screenEffectsUniform) {
-        vkutils::buffer_barrier(commandBuffer,
-                                screenEffectsUBO,
-                                VK_ACCESS_UNIFORM_READ_BIT,
-                                VK_ACCESS_TRANSFER_WRITE_BIT,
-                                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                                VK_PIPELINE_STAGE_TRANSFER_BIT
-        );
-
-        vkCmdUpdateBuffer(commandBuffer, screenEffectsUBO, 0, sizeof(glsl::ScreenEffectsUniform),
-                          &screenEffectsUniform);
-
-        vkutils::buffer_barrier(commandBuffer,
-                                screenEffectsUBO,
-                                VK_ACCESS_TRANSFER_WRITE_BIT,
-                                VK_ACCESS_UNIFORM_READ_BIT,
-                                VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
-    }
 }
@@ -9,21 +9,11 @@
 #include "config.hpp"
 
 namespace shade {
-    vkutils::Buffer create_shade_ubo(const vkutils::Allocator& allocator) {
-        return vkutils::create_buffer(
-            allocator,
-            sizeof(glsl::ShadeUniform),
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            0,
-            VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE
-        );
-    }
-
     vkutils::DescriptorSetLayout create_descriptor_layout(const vkutils::VulkanContext& context) {
         constexpr std::array bindings{
             VkDescriptorSetLayoutBinding{
                 .binding = 0, // layout(set = ..., binding = 0)
-                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
                 .descriptorCount = 1,
                 .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
             },
@@ -53,13 +43,14 @@ namespace shade {
     }
 
     void update_descriptor_set(const vkutils::VulkanContext& context,
-                               const vkutils::Buffer& shadeUBO,
+                               const VkBuffer uniformBuffer,
                                const VkDescriptorSet shadeDescriptorSet,
                                const vkutils::Sampler& shadowSampler,
                                const VkImageView shadowView) {
         const VkDescriptorBufferInfo shadeUboInfo{
-            .buffer = shadeUBO.buffer,
-            .range = VK_WHOLE_SIZE
+            .buffer = uniformBuffer,
+            .offset = 0,
+            .range = sizeof(glsl::ShadeUniform)
         };
 
         const VkDescriptorImageInfo shadowDescriptorInfo{
@@ -74,7 +65,7 @@ namespace shade {
                 .dstSet = shadeDescriptorSet,
                 .dstBinding = 0,
                 .descriptorCount = 1,
-                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
                 .pBufferInfo = &shadeUboInfo
             },
             VkWriteDescriptorSet{
@@ -103,26 +94,4 @@ namespace shade {
             }
         };
     }
-
-    void update_shade_ubo(const VkCommandBuffer commandBuffer,
-                          const VkBuffer shadeUBO,
-                          const glsl::ShadeUniform& shadeUniform) {
-        vkutils::buffer_barrier(commandBuffer,
-                                shadeUBO,
-                                VK_ACCESS_UNIFORM_READ_BIT,
-                                VK_ACCESS_TRANSFER_WRITE_BIT,
-                                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                                VK_PIPELINE_STAGE_TRANSFER_BIT
-        );
-
-        vkCmdUpdateBuffer(commandBuffer, shadeUBO, 0, sizeof(glsl::ShadeUniform), &shadeUniform);
-
-        vkutils::buffer_barrier(commandBuffer,
-                                shadeUBO,
-                                VK_ACCESS_TRANSFER_WRITE_BIT,
-                                VK_ACCESS_UNIFORM_READ_BIT,
-                                VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
-        );
-    }
 }
@@ -20,12 +20,7 @@ namespace glsl {
         PointLightUniform light;
     };
 
-    // We want to use vkCmdUpdateBuffer() to update the contents of our uniform buffers. vkCmdUpdateBuffer()
-    // has a number of requirements, including the two below. See
-    // https://www.khronos.org/registry/vulkan/specs/1.3-extensions/man/html/vkCmdUpdateBuffer.html
-    static_assert(sizeof(ShadeUniform) <= 65536,
-                  "ShadeUniform must be less than 65536 bytes for vkCmdUpdateBuffer");
-    static_assert(sizeof(ShadeUniform) % 4 == 0, "ShadeUniform size must be a multiple of 4 bytes");
+    // Copied as is into the uniform buffer, so it must match the std140 layout of the shaders
     static_assert(offsetof(ShadeUniform, visualisationMode) % 4 == 0, "visualisationMode must be aligned to 4 bytes");
     static_assert(offsetof(ShadeUniform, pbrTerm) % 4 == 0, "pbrTerm must be aligned to 4 bytes");
     static_assert(offsetof(ShadeUniform, detailsMask) % 4 == 0, "detailsMask must be aligned to 4 bytes");
@@ -37,17 +32,12 @@ namespace glsl {
 namespace shade {
     vkutils::DescriptorSetLayout create_descriptor_layout(const vkutils::VulkanContext& context);
 
-    vkutils::Buffer create_shade_ubo(const vkutils::Allocator& allocator);
-
+    // Points the set to the ShadeUniform at dynamic offset 0 of uniformBuffer, see uniforms::UniformRing
     void update_descriptor_set(const vkutils::VulkanContext& context,
-                               const vkutils::Buffer& shadeUBO,
+                               VkBuffer uniformBuffer,
                                VkDescriptorSet shadeDescriptorSet,
                                const vkutils::Sampler& shadowSampler,
                                VkImageView shadowView);
 
     glsl::ShadeUniform create_uniform(const state::State& state);
-
-    void update_shade_ubo(VkCommandBuffer commandBuffer,
-                          VkBuffer shadeUBO,
-                          const glsl::ShadeUniform& shadeUniform);
 }
@@ -1,14 +1,28 @@
 #version 460
+#extension GL_EXT_nonuniform_qualifier : require
 
 const float alphaThreshold = 0.5f;
 
-layout(set = 1, binding = 4) uniform sampler2D alphaMask;
+// Slots of the textures of a material in textures, see glsl::MaterialTextures
+struct MaterialTextures {
+    uint baseColour;
+    uint surface;
+    uint normalMap;
+    uint padding;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer Materials {
+    MaterialTextures materials[];
+};
+
+layout(set = 1, binding = 1) uniform sampler2D textures[];
 
 layout(location = 0) in vec2 uv;
+layout(location = 1) flat in uint materialId;
 
 void main() {
     // Discard fragments with alpha below a threshold
-    float transparency = texture(alphaMask, uv).a;
+    float transparency = texture(textures[nonuniformEXT(materials[materialId].baseColour)], uv).a;
     if (transparency < alphaThreshold) {
         discard; // Don't write to depth buffer and terminate processing
     }
@@ -10,8 +10,11 @@ layout(location = 0) in vec3 vertexPosition_wcs;
 layout(location = 1) in vec2 vertexUV;
 
 layout(location = 0) out vec2 uv;
+layout(location = 1) flat out uint materialId;
 
 void main() {
     gl_Position = scene.LP * vec4(vertexPosition_wcs, 1.0f);
     uv = vertexUV;
+    // Indirect draws carry the material of the mesh in firstInstance, see shaders/cull.comp
+    materialId = gl_InstanceIndex;
 }
@@ -0,0 +1,23 @@
+#version 460
+
+layout(std140, set = 0, binding = 0) uniform Scene {
+    mat4 VP;
+    mat4 LP;
+    mat4 SLP;
+} scene;
+
+layout(location = 0) in vec3 vertexPosition_wcs;
+layout(location = 1) in vec2 vertexUV;
+
+layout(location = 0) out vec2 uv;
+layout(location = 1) flat out uint materialId;
+
+// Computed exactly as in offscreen.vert, whose fragments are depth tested for equality against the prepass
+invariant gl_Position;
+
+void main() {
+    gl_Position = scene.VP * vec4(vertexPosition_wcs, 1.0f);
+    uv = vertexUV;
+    // Indirect draws carry the material of the mesh in firstInstance, see shaders/cull.comp
+    materialId = gl_InstanceIndex;
+}
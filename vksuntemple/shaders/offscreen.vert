@@ -16,6 +16,10 @@ layout(location = 1) out vec2 uv;
 layout(location = 2) out vec3 normal_wcs;
 layout(location = 3) out mat3 TBN;
 layout(location = 6) out vec4 position_lcs;
+layout(location = 7) flat out uint materialId;
+
+// Must match the depth prepass exactly, see depth_prepass.vert
+invariant gl_Position;
 
 void main() {
     gl_Position = scene.VP * vec4(vertexPosition_wcs, 1.0f);
@@ -25,4 +29,6 @@ void main() {
     vec3 vertexBitangent = vertexTangent.w * cross(vertexNormal_wcs, vertexTangent.xyz);
     TBN = mat3(vertexTangent.xyz, vertexBitangent, vertexNormal_wcs);
     position_lcs = scene.SLP * vec4(vertexPosition_wcs, 1.0f);
+    // Indirect draws carry the material of the mesh in firstInstance, see shaders/cull.comp
+    materialId = gl_InstanceIndex;
 }
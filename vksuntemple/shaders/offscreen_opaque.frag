@@ -1,4 +1,5 @@
 #version 460
+#extension GL_EXT_nonuniform_qualifier : require
 
 const float PI = 3.14159265359f;
 const float EPS = 0.0000001f;
@@ -45,10 +46,19 @@ layout (std140, set = 1, binding = 0) uniform Shade {
 
 layout (set = 1, binding = 1) uniform sampler2DShadow shadow;
 
-layout (set = 2, binding = 0) uniform sampler2D baseColour;
-layout (set = 2, binding = 1) uniform sampler2D roughness;
-layout (set = 2, binding = 2) uniform sampler2D metalness;
-layout (set = 2, binding = 3) uniform sampler2D normalMap;
+// Slots of the textures of a material in textures, see glsl::MaterialTextures
+struct MaterialTextures {
+    uint baseColour;
+    uint surface; // r = occlusion, g = roughness, b = metalness
+    uint normalMap;
+    uint padding;
+};
+
+layout (std430, set = 2, binding = 0) readonly buffer Materials {
+    MaterialTextures materials[];
+};
+
+layout (set = 2, binding = 1) uniform sampler2D textures[];
 
 layout (push_constant) uniform MeshPushConstants {
     vec3 colour;
@@ -59,6 +69,7 @@ layout (location = 1) in vec2 uv;
 layout (location = 2) in vec3 normal_wcs;
 layout (location = 3) in mat3 TBN;
 layout (location = 6) in vec4 position_lcs;
+layout (location = 7) flat in uint materialId; // Instance index of the draw
 
 layout (location = 0) out vec3 colour;
 
@@ -66,6 +77,19 @@ float saturate(float value) {
     return clamp(value, 0.0f, 1.0f);
 }
 
+// Fragments of the same indirect draw call may come from draws of different materials, hence nonuniformEXT
+vec4 baseColourTexel() {
+    return texture(textures[nonuniformEXT(materials[materialId].baseColour)], uv);
+}
+
+vec4 surfaceTexel() {
+    return texture(textures[nonuniformEXT(materials[materialId].surface)], uv);
+}
+
+vec4 normalMapTexel() {
+    return texture(textures[nonuniformEXT(materials[materialId].normalMap)], uv);
+}
+
 float pcfShadowFactor() {
     // Average shadow over 9-tiled area
     float shadowFactor = 0.0f;
@@ -123,10 +147,10 @@ float cookTorranceMask(float nh, float nv, float nl, float vh) {
 
 vec3 pbrColour(vec3 fragNormal_wcs) {
     // Parameters
-    float roughness = texture(roughness, uv).r;
+    float roughness = surfaceTexel().g;
     float alpha = roughness * roughness;
-    float M = texture(metalness, uv).r;
-    vec3 cMat = texture(baseColour, uv).rgb;
+    float M = surfaceTexel().b;
+    vec3 cMat = baseColourTexel().rgb;
     vec3 cLight = shade.light.colour;
     vec3 cAmbient = shade.ambient;
     vec3 n = normalize(fragNormal_wcs);
@@ -180,12 +204,19 @@ vec3 pbrColour(vec3 fragNormal_wcs) {
     }
 }
 
+// Normal maps are baked as two channel BC5 (XY only); Z is reconstructed from the unit length
+vec3 tangentSpaceNormal() {
+    vec2 xy = normalMapTexel().rg * 2.0f - 1.0f;
+    float z = sqrt(max(0.0f, 1.0f - dot(xy, xy)));
+    return vec3(xy, z);
+}
+
 void main() {
     // Re-orient normal if Normal Mapping is enabled
     bool normalMappingEnabled = (shade.detailsMask & normalMapping) != 0;
     vec3 fragNormal_wcs = normal_wcs;
     if (normalMappingEnabled) {
-        fragNormal_wcs = TBN * (texture(normalMap, uv).rgb * 2.0 - 1.0);
+        fragNormal_wcs = TBN * tangentSpaceNormal();
     }
 
     switch (shade.visualisationMode) {
@@ -205,17 +236,17 @@ void main() {
             break;
         case roughnessMode:
     // Expands to greyscale colour [r, r, r]
-            colour = texture(roughness, uv).rgb;
+            colour = vec3(surfaceTexel().g);
             break;
         case metalnessMode:
     // Expands to greyscale colour [m, m, m]
-            colour = texture(metalness, uv).rgb;
+            colour = vec3(surfaceTexel().b);
             break;
         case normalMapMode:
-            colour = texture(normalMap, uv).rgb;
+            colour = tangentSpaceNormal() * 0.5f + 0.5f;
             break;
         case baseMode:
-            colour = texture(baseColour, uv).rgb * mesh.colour;
+            colour = baseColourTexel().rgb * mesh.colour;
             break;
         default:
             break;
@@ -462,21 +462,7 @@ namespace shadow {
             .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
         };
 
-        constexpr VmaAllocationCreateInfo allocInfo{
-            .usage = VMA_MEMORY_USAGE_GPU_ONLY
-        };
-
-        VkImage image = VK_NULL_HANDLE;
-        VmaAllocation allocation = VK_NULL_HANDLE;
-
-        if (const auto res = vmaCreateImage(allocator.allocator, &imageInfo, &allocInfo, &image, &allocation, nullptr);
-            VK_SUCCESS != res) {
-            throw vkutils::Error("Unable to allocate shadow map image\n"
-                                 "vmaCreateImage() returned %s", vkutils::to_string(res).c_str()
-            );
-        }
-
-        vkutils::Image shadowImage(allocator.allocator, image, allocation);
+        vkutils::Image shadowImage = vkutils::create_image(allocator, imageInfo, vkutils::MemoryClass::RenderTarget);
 
         const VkImageViewCreateInfo viewInfo{
             .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
@@ -527,19 +513,68 @@ namespace shadow {
         return vkutils::Framebuffer(window.device, framebuffer);
     }
 
+    void append_draw_jobs(std::vector<parallel_recording::SecondaryJob>& jobs,
+                          const VkRenderPass renderPass,
+                          const VkFramebuffer framebuffer,
+                          const VkPipelineLayout opaquePipelineLayout,
+                          const VkPipeline opaqueShadowPipeline,
+                          const VkPipelineLayout alphaPipelineLayout,
+                          const VkPipeline alphaShadowPipeline,
+                          const VkDescriptorSet sceneDescriptorSet,
+                          const std::uint32_t sceneOffset,
+                          const mesh::Geometry& geometry,
+                          const gpu_culling::IndirectDraws& opaqueDraws,
+                          const gpu_culling::IndirectDraws& alphaMaskedDraws,
+                          const VkDescriptorSet materialDescriptorSet) {
+        // Draw the opaque meshes visible to the light
+        for (const auto range : gpu_culling::split_draws(opaqueDraws, cfg::recordingChunkSize)) {
+            jobs.emplace_back(parallel_recording::SecondaryJob{
+                .renderPass = renderPass,
+                .framebuffer = framebuffer,
+                .record = [=, &geometry, &opaqueDraws](const VkCommandBuffer commandBuffer) {
+                    // Bind scene descriptor set into layout(set = 0, ...), at the uniforms of the frame
+                    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                            opaquePipelineLayout, 0, 1,
+                                            &sceneDescriptorSet, 1, &sceneOffset);
+
+                    // Bind scene vertex buffers into layout(location = {1, 2}), and indices. The opaque pipeline only
+                    // reads positions.
+                    mesh::bind_geometry(commandBuffer, geometry, 2);
+
+                    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, opaqueShadowPipeline);
+
+                    gpu_culling::draw(commandBuffer, opaqueDraws, range);
+                }
+            });
+        }
+
+        // Then draw the visible alpha masked meshes
+        for (const auto range : gpu_culling::split_draws(alphaMaskedDraws, cfg::recordingChunkSize)) {
+            jobs.emplace_back(parallel_recording::SecondaryJob{
+                .renderPass = renderPass,
+                .framebuffer = framebuffer,
+                .record = [=, &geometry, &alphaMaskedDraws](const VkCommandBuffer commandBuffer) {
+                    // Bind scene descriptor set into layout(set = 0, ...), and material table into
+                    // layout(set = 1, ...). Draws index it with their instance.
+                    const std::array descriptorSets = {sceneDescriptorSet, materialDescriptorSet};
+                    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                            alphaPipelineLayout, 0, descriptorSets.size(),
+                                            descriptorSets.data(), 1, &sceneOffset);
+
+                    mesh::bind_geometry(commandBuffer, geometry, 2);
+
+                    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, alphaShadowPipeline);
+
+                    gpu_culling::draw(commandBuffer, alphaMaskedDraws, range);
+                }
+            });
+        }
+    }
+
     void record_commands(const VkCommandBuffer commandBuffer,
                          const VkRenderPass renderPass,
                          const VkFramebuffer framebuffer,
-                         const VkPipelineLayout opaquePipelineLayout,
-                         const VkPipeline opaqueShadowPipeline,
-                         const VkPipelineLayout alphaPipelineLayout,
-                         const VkPipeline alphaShadowPipeline,
-                         const VkBuffer sceneUBO,
-                         const glsl::SceneUniform& sceneUniform,
-                         const VkDescriptorSet sceneDescriptorSet,
-                         const std::vector<mesh::Mesh>& opaqueMeshes,
-                         const std::vector<mesh::Mesh>& alphaMaskedMeshes,
-                         const std::vector<VkDescriptorSet>& materialDescriptorSets) {
+                         const std::span<const VkCommandBuffer> drawCommands) {
         // Begin render pass
         constexpr std::array clearValues{
             // Clear depth value
@@ -550,14 +585,6 @@ namespace shadow {
             }
         };
 
-        // Prepare uniforms
-        scene::update_scene_ubo(commandBuffer, sceneUBO, sceneUniform);
-
-        // Bind scene descriptor set into layout(set = 0, ...)
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                opaquePipelineLayout, 0, 1,
-                                &sceneDescriptorSet, 0, nullptr);
-
         // Create render pass command
         const VkRenderPassBeginInfo passInfo{
             .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
@@ -571,46 +598,11 @@ namespace shadow {
             .pClearValues = clearValues.data()
         };
 
-        // Begin render pass
-        vkCmdBeginRenderPass(commandBuffer, &passInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-        // First draw opaque pipeline
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, opaqueShadowPipeline);
-
-        // Draw opaque meshes
-        for (const auto& mesh : opaqueMeshes) {
-            // Bind mesh vertex buffers into layout(location = {1})
-            const std::array vertexBuffers = {mesh.positions.buffer};
-            constexpr std::array<VkDeviceSize, vertexBuffers.size()> offsets{};
-            vkCmdBindVertexBuffers(commandBuffer, 0, vertexBuffers.size(), vertexBuffers.data(), offsets.data());
-
-            // Bind mesh vertex indices
-            vkCmdBindIndexBuffer(commandBuffer, mesh.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-
-            // Draw mesh vertices
-            vkCmdDrawIndexed(commandBuffer, mesh.indexCount, 1, 0, 0, 0);
-        }
-
-        // Then draw alpha pipeline
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, alphaShadowPipeline);
-
-        // Draw meshes
-        for (const auto& mesh : alphaMaskedMeshes) {
-            // Bind mesh descriptor set into layout(set = 1, ...)
-            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                    alphaPipelineLayout, 1, 1,
-                                    &materialDescriptorSets[mesh.materialId], 0, nullptr);
-
-            // Bind mesh vertex buffers into layout(location = {1, 2})
-            const std::array vertexBuffers = {mesh.positions.buffer, mesh.uvs.buffer};
-            constexpr std::array<VkDeviceSize, vertexBuffers.size()> offsets{};
-            vkCmdBindVertexBuffers(commandBuffer, 0, vertexBuffers.size(), vertexBuffers.data(), offsets.data());
-
-            // Bind mesh vertex indices
-            vkCmdBindIndexBuffer(commandBuffer, mesh.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+        // Begin render pass, whose draws were recorded by append_draw_jobs()
+        vkCmdBeginRenderPass(commandBuffer, &passInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-            // Draw mesh vertices
-            vkCmdDrawIndexed(commandBuffer, mesh.indexCount, 1, 0, 0, 0);
+        if (!drawCommands.empty()) {
+            vkCmdExecuteCommands(commandBuffer, static_cast<std::uint32_t>(drawCommands.size()), drawCommands.data());
         }
 
         // End the render pass
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <span>
+#include <vector>
+
+#include "gpu_culling.hpp"
 #include "mesh.hpp"
+#include "parallel_recording.hpp"
 #include "scene.hpp"
 #include "../vkutils/vkimage.hpp"
 #include "../vkutils/vkobject.hpp"
@@ -31,17 +36,25 @@ namespace shadow {
                                                    VkRenderPass shadowRenderPass,
                                                    VkImageView shadowView);
 
+    // Appends the jobs recording the draws of the shadow pass, cfg::recordingChunkSize draws at most per job. Also
+    // records the draws of the depth prepass, with its pipelines and the camera draws, see prepass.hpp.
+    void append_draw_jobs(std::vector<parallel_recording::SecondaryJob>& jobs,
+                          VkRenderPass renderPass,
+                          VkFramebuffer framebuffer,
+                          VkPipelineLayout opaquePipelineLayout,
+                          VkPipeline opaqueShadowPipeline,
+                          VkPipelineLayout alphaPipelineLayout,
+                          VkPipeline alphaShadowPipeline,
+                          VkDescriptorSet sceneDescriptors,
+                          std::uint32_t sceneOffset,
+                          const mesh::Geometry& geometry,
+                          const gpu_culling::IndirectDraws& opaqueDraws,
+                          const gpu_culling::IndirectDraws& alphaMaskedDraws,
+                          VkDescriptorSet materialDescriptorSet);
+
+    // Records the shadow pass, which executes drawCommands, the command buffers of the jobs of append_draw_jobs()
     void record_commands(VkCommandBuffer commandBuffer,
                          VkRenderPass renderPass,
                          VkFramebuffer framebuffer,
-                         VkPipelineLayout opaquePipelineLayout,
-                         VkPipeline opaqueShadowPipeline,
-                         VkPipelineLayout alphaPipelineLayout,
-                         VkPipeline alphaShadowPipeline,
-                         VkBuffer sceneUBO,
-                         const glsl::SceneUniform& sceneUniform,
-                         VkDescriptorSet sceneDescriptors,
-                         const std::vector<mesh::Mesh>& opaqueMeshes,
-                         const std::vector<mesh::Mesh>& alphaMaskedMeshes,
-                         const std::vector<VkDescriptorSet>& materialDescriptorSets);
+                         std::span<const VkCommandBuffer> drawCommands);
 }
@@ -93,6 +93,13 @@ namespace state {
 
         bool toneMappingEnabled = false;
 
+        // See prepass.hpp
+        bool depthPrepassEnabled = cfg::depthPrepass;
+
+        // Set by input, cleared once the report is written
+        bool memoryReportRequested = false;
+        bool passStatsRequested = false;
+
         glm::vec3 cameraPosition() const;
     };
 
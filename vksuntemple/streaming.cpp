@@ -0,0 +1,611 @@
+#include "streaming.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <iostream>
+#include <limits>
+#include <utility>
+
+#include <glm/glm.hpp>
+
+#include "config.hpp"
+#include "../vkutils/defragment.hpp"
+#include "../vkutils/error.hpp"
+#include "../vkutils/memory_report.hpp"
+#include "../vkutils/to_string.hpp"
+#include "../vkutils/vkutil.hpp"
+
+namespace {
+    // Level of a texture of the given size (in texels, largest dimension) at which one texel covers about one pixel.
+    // uvPerPixel is the texture space length covered by one pixel.
+    std::uint32_t mip_level_for(std::uint32_t size, float uvPerPixel, std::uint32_t levelCount);
+
+    // First level whose largest dimension is at most cfg::streamingInitialMipSize
+    std::uint32_t initial_mip_level(const texture::CompressedTexture& texture);
+}
+
+namespace streaming {
+    SceneStreamer::SceneStreamer(const vkutils::VulkanContext& context,
+                                 const vkutils::Allocator& allocator,
+                                 vkutils::StagingRing& stagingRing,
+                                 const VkDescriptorSetLayout materialLayout,
+                                 const vkutils::Sampler& anisotropySampler,
+                                 const vkutils::Sampler& pointSampler,
+                                 const char* modelPath,
+                                 std::function<void()> waitForFrames)
+        : mContext(context),
+          mAllocator(allocator),
+          mWaitForFrames(std::move(waitForFrames)),
+          mAnisotropySampler(anisotropySampler),
+          mPointSampler(pointSampler),
+          mLoadCommandPool(vkutils::create_command_pool(context, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT)),
+          mMipGenerator(context),
+          mMaterialLayout(materialLayout),
+          mMeshBatch(context, stagingRing, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                     VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT),
+          // Textures are sampled by fragment shaders. Uncompressed textures are also read by mip generation, in compute
+          // shaders or blits.
+          mTextureBatch(context, stagingRing,
+                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                        VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT),
+          mWorkers(cfg::streamingWorkerCount) {
+        // The fallback material is tiny, and needed by the first frame that draws anything
+        mFallback = material::create_fallback_material(context, allocator, mTextureBatch);
+        mTextureBatch.submit();
+        mTextureBatch.wait();
+
+        // Only the fallback material until the model is loaded
+        allocate_material_table(1);
+
+        mWorkers.submit([this, path = std::string(modelPath)] {
+            const vkutils::HostMemoryScope memoryScope(vkutils::HostSubsystem::AssetLoading);
+
+            try {
+                auto model = baked::load_baked_model(path.c_str());
+
+                // Needs every vertex, so done here rather than on the render thread
+                std::vector<mesh::MeshBounds> bounds;
+                bounds.reserve(model.meshes.size());
+                for (const auto& modelMesh : model.meshes) {
+                    bounds.emplace_back(mesh::compute_bounds(modelMesh));
+                }
+
+                mCompletions.push(ModelLoaded{std::move(model), std::move(bounds)});
+            } catch (const std::exception& exception) {
+                mCompletions.push(LoadFailed{exception.what()});
+            }
+        });
+    }
+
+    void SceneStreamer::update(const state::State& state, const VkExtent2D viewportExtent) {
+        const vkutils::HostMemoryScope memoryScope(vkutils::HostSubsystem::Streaming);
+
+        mFramesWaited = false;
+
+        for (auto& result : mCompletions.drain()) {
+            if (auto* loaded = std::get_if<ModelLoaded>(&result)) {
+                on_model_loaded(std::move(*loaded));
+            } else if (auto* decoded = std::get_if<TextureDecoded>(&result)) {
+                mDecodedTextures.emplace_back(std::move(*decoded));
+            } else {
+                throw vkutils::Error("%s", std::get<LoadFailed>(result).message.c_str());
+            }
+        }
+
+        if (!mModel) {
+            return;
+        }
+
+        // Spread the uploads over several frames, so that none of them stalls for long
+        std::size_t budget = cfg::streamingBytesPerFrame;
+        upload_meshes(budget);
+        upload_textures(budget);
+        update_residency(state, viewportExtent, budget);
+
+        complete_textures();
+        publish_meshes();
+        publish_materials();
+
+        if (is_fully_loaded() && mFreedTextureBytes >= cfg::defragmentationChurn) {
+            defragment_textures();
+        }
+    }
+
+    bool SceneStreamer::is_fully_loaded() const {
+        return mModel && mNextMesh == mModel->meshes.size() && mPendingMeshes.empty() &&
+               mResidentMaterialCount == mModel->materials.size();
+    }
+
+    const mesh::Geometry& SceneStreamer::geometry() const {
+        return mGeometry;
+    }
+
+    const std::vector<mesh::Mesh>& SceneStreamer::opaque_meshes() const {
+        return mOpaqueMeshes;
+    }
+
+    const std::vector<mesh::Mesh>& SceneStreamer::alpha_masked_meshes() const {
+        return mAlphaMaskedMeshes;
+    }
+
+    const culling::BoundsSoA& SceneStreamer::opaque_bounds() const {
+        return mOpaqueBounds;
+    }
+
+    const culling::BoundsSoA& SceneStreamer::alpha_masked_bounds() const {
+        return mAlphaMaskedBounds;
+    }
+
+    VkDescriptorSet SceneStreamer::material_descriptor_set() const {
+        return mMaterialDescriptorSet;
+    }
+
+    std::uint64_t SceneStreamer::material_table_version() const {
+        return mMaterialTableVersion;
+    }
+
+    void SceneStreamer::on_model_loaded(ModelLoaded loaded) {
+        // The geometry and the material table are replaced
+        wait_for_frames();
+
+        mModel = std::move(loaded.model);
+
+        mGeometry = mesh::create_geometry(mContext, mAllocator, *mModel);
+
+        for (const auto& bounds : loaded.bounds) {
+            mMeshExtents.emplace_back(MeshExtent{
+                .center = 0.5f * (bounds.min + bounds.max),
+                .radius = 0.5f * glm::length(bounds.max - bounds.min),
+                .uvPerUnit = bounds.surfaceArea > 0.0f ? std::sqrt(bounds.uvArea / bounds.surfaceArea) : 0.0f
+            });
+        }
+        mMeshBounds = std::move(loaded.bounds);
+
+        mTextures.resize(mModel->textures.size());
+        mFormats.resize(mModel->textures.size(), VK_FORMAT_UNDEFINED);
+        mTextureStreams.resize(mModel->textures.size());
+
+        // The fallback material, then those of the model
+        const std::size_t slotCount = mModel->materials.size() + 1;
+        if (const std::uint32_t maxSlotCount = material::max_slot_count(mContext); slotCount > maxSlotCount) {
+            throw vkutils::Error("Unable to load model: %zu materials, the material table holds %u on this device",
+                                 mModel->materials.size(), maxSlotCount - 1);
+        }
+        allocate_material_table(static_cast<std::uint32_t>(slotCount));
+
+        mMaterials.resize(mModel->materials.size());
+
+        // Rewritten only when materials become resident, so kept in host visible memory
+        mMaterialTextures = vkutils::create_buffer(
+            mAllocator,
+            std::max<std::size_t>(1, mModel->materials.size()) * sizeof(glsl::MaterialTextures),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT
+        );
+        for (std::uint32_t m = 0; m < mModel->materials.size(); ++m) {
+            write_material_entry(m, material::fallbackSlot);
+        }
+        material::update_table_descriptor(mContext, mMaterialDescriptorSet, mMaterialTextures);
+        ++mMaterialTableVersion;
+
+        // Textures are decoded in the order materials first use them, so that materials become resident early.
+        // Only base colours are sRGB encoded; a texture takes the colour space of its first use.
+        std::vector<std::pair<std::uint32_t, baked::BakedTextureInfo>> decodeOrder;
+        const auto use = [&](const std::uint32_t textureId, const std::uint32_t materialId, const bool srgb) {
+            auto& stream = mTextureStreams[textureId];
+            if (!stream.srgb) {
+                stream.srgb = srgb;
+                decodeOrder.emplace_back(textureId, mModel->textures[textureId]);
+            }
+
+            if (stream.materials.empty() || stream.materials.back() != materialId) {
+                stream.materials.emplace_back(materialId);
+            }
+        };
+
+        for (std::uint32_t m = 0; m < mModel->materials.size(); ++m) {
+            const auto& modelMaterial = mModel->materials[m];
+            use(modelMaterial.baseColorTextureId, m, true /* sRGB */);
+            use(modelMaterial.surfaceTextureId, m, false /* sRGB */);
+            use(modelMaterial.normalMapTextureId, m, false /* sRGB */);
+        }
+
+        std::cout << "Streaming " << mModel->meshes.size() << " meshes and " << decodeOrder.size()
+                << " textures, decoded by " << mWorkers.worker_count() << " workers...\n";
+
+        // One job per texture, so that decoding scales with the number of workers. Jobs start in the order above, and
+        // report in the order they complete. Texture paths are copied, jobs do not touch the model.
+        for (auto& [textureId, bakedTexture] : decodeOrder) {
+            mWorkers.submit([this, textureId, bakedTexture = std::move(bakedTexture)] {
+                const vkutils::HostMemoryScope memoryScope(vkutils::HostSubsystem::AssetLoading);
+
+                try {
+                    mCompletions.push(TextureDecoded{textureId, material::decode_texture(bakedTexture)});
+                } catch (const std::exception& exception) {
+                    mCompletions.push(LoadFailed{exception.what()});
+                }
+            });
+        }
+    }
+
+    void SceneStreamer::upload_meshes(std::size_t& budget) {
+        if (mNextMesh == mModel->meshes.size()) {
+            return;
+        }
+
+        MeshGroup group{};
+
+        do {
+            const auto meshId = static_cast<std::uint32_t>(mNextMesh++);
+            const auto& modelMesh = mModel->meshes[meshId];
+            const auto meshBytes = mesh::mesh_size_in_bytes(modelMesh);
+            budget -= std::min(budget, meshBytes);
+
+            const bool alphaMasked = mModel->materials[modelMesh.materialId].alphaMasked;
+            (alphaMasked ? group.alphaMasked : group.opaque).emplace_back(
+                mesh::upload_mesh(mMeshBatch, mGeometry, mGeometryCursor, modelMesh));
+            (alphaMasked ? group.alphaMaskedIds : group.opaqueIds).emplace_back(meshId);
+        } while (budget > 0 && mNextMesh < mModel->meshes.size());
+
+        group.ticket = mMeshBatch.submit();
+        mPendingMeshes.emplace_back(std::move(group));
+    }
+
+    void SceneStreamer::upload_textures(std::size_t& budget) {
+        if (mDecodedTextures.empty()) {
+            return;
+        }
+
+        std::vector<std::uint32_t> uploaded;
+
+        do {
+            auto decoded = std::move(mDecodedTextures.front());
+            mDecodedTextures.pop_front();
+
+            auto& stream = mTextureStreams[decoded.textureId];
+
+            if (auto* compressed = std::get_if<texture::CompressedTexture>(&decoded.texture)) {
+                // Starts small; update_residency() promotes it as needed
+                const auto level = initial_mip_level(*compressed);
+                budget -= std::min(budget, compressed->sizeInBytes(level));
+
+                stream.pending = PendingImage{
+                    .image = texture::compressed_texture_to_image(mContext, *compressed, mAllocator, mTextureBatch,
+                                                                  level),
+                    .format = compressed->format,
+                    .level = level
+                };
+                stream.source = std::move(*compressed);
+            } else {
+                budget -= std::min(budget, material::decoded_size_in_bytes(decoded.texture));
+
+                auto [image, format] = material::upload_texture(mContext, decoded.texture, *stream.srgb, mAllocator,
+                                                                mTextureBatch, mMipGenerator, mLoadCommandPool);
+                stream.pending = PendingImage{
+                    .image = std::move(image),
+                    .format = format,
+                    .level = 0
+                };
+            }
+
+            uploaded.emplace_back(decoded.textureId);
+        } while (budget > 0 && !mDecodedTextures.empty());
+
+        const auto ticket = mTextureBatch.submit();
+        for (const auto textureId : uploaded) {
+            mTextureStreams[textureId].pending->ticket = ticket;
+        }
+
+        // The mips of all uncompressed textures of this frame are generated at once, from their uploaded base levels
+        if (mMipGenerator.has_pending()) {
+            mTextureBatch.wait();
+            mMipGenerator.generate(mLoadCommandPool);
+        }
+    }
+
+    void SceneStreamer::update_residency(const state::State& state,
+                                         const VkExtent2D viewportExtent,
+                                         std::size_t& budget) {
+        if (0 == viewportExtent.height) {
+            return;
+        }
+
+        // Texture space length covered by one pixel of a material, at its closest mesh. Materials without meshes, or
+        // without texture coordinates, only need the smallest level.
+        const auto cameraPosition = state.cameraPosition();
+        const float pixelsPerUnitAtUnitDistance = static_cast<float>(viewportExtent.height) /
+                                                  (2.0f * std::tan(0.5f * vkutils::Radians(cfg::cameraFov).value()));
+
+        std::vector<float> uvPerPixel(mModel->materials.size(), std::numeric_limits<float>::infinity());
+        for (std::size_t i = 0; i < mModel->meshes.size(); ++i) {
+            const auto& extent = mMeshExtents[i];
+            if (extent.uvPerUnit <= 0.0f) {
+                continue;
+            }
+
+            const float distance = std::max(glm::length(cameraPosition - extent.center) - extent.radius,
+                                            cfg::cameraNear);
+            auto& materialUvPerPixel = uvPerPixel[mModel->meshes[i].materialId];
+            materialUvPerPixel = std::min(materialUvPerPixel,
+                                          extent.uvPerUnit * distance / pixelsPerUnitAtUnitDistance);
+        }
+
+        // Desired first level of every streamed texture, before applying the budget
+        std::vector<std::uint32_t> desired(mTextureStreams.size(), 0);
+        VkDeviceSize residentBytes = 0;
+        for (std::size_t t = 0; t < mTextureStreams.size(); ++t) {
+            const auto& stream = mTextureStreams[t];
+            if (!stream.source) {
+                continue;
+            }
+
+            const auto levelCount = static_cast<std::uint32_t>(stream.source->levels.size());
+            const auto size = std::max(stream.source->width, stream.source->height);
+
+            desired[t] = levelCount - 1;
+            for (const auto materialId : stream.materials) {
+                desired[t] = std::min(desired[t], mip_level_for(size, uvPerPixel[materialId], levelCount));
+            }
+
+            residentBytes += stream.source->sizeInBytes(stream.residentLevel);
+            if (stream.pending) {
+                residentBytes += stream.source->sizeInBytes(stream.pending->level);
+            }
+        }
+
+        // Whatever is left of the device budget, if less than the configured budget
+        const auto memory = vkutils::device_local_budget(mAllocator);
+        const VkDeviceSize available = memory.budget > memory.usage ? memory.budget - memory.usage : 0;
+        const VkDeviceSize textureBudget = std::min(cfg::textureMemoryBudget, residentBytes + available);
+
+        // Drop the same number of levels from every texture until they fit
+        const auto target = [&](const std::size_t t, const std::uint32_t bias) {
+            const auto levelCount = static_cast<std::uint32_t>(mTextureStreams[t].source->levels.size());
+            return std::min(desired[t] + bias, levelCount - 1);
+        };
+
+        const auto bytesAt = [&](const std::uint32_t bias) {
+            VkDeviceSize bytes = 0;
+            for (std::size_t t = 0; t < mTextureStreams.size(); ++t) {
+                if (mTextureStreams[t].source) {
+                    bytes += mTextureStreams[t].source->sizeInBytes(target(t, bias));
+                }
+            }
+            return bytes;
+        };
+
+        std::uint32_t bias = 0;
+        while (bias < cfg::maxMipBias && bytesAt(bias) > textureBudget) {
+            ++bias;
+        }
+
+        if (bias != mMipBias) {
+            std::cout << "Texture budget of " << textureBudget / (1024 * 1024) << " MiB: dropping " << bias
+                    << " mip levels\n";
+            mMipBias = bias;
+        }
+
+        // Demotions free memory, so they go first. A single level of slack avoids moving back and forth on the
+        // boundary between two levels, unless over budget.
+        const bool overBudget = residentBytes > textureBudget;
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> demotions, promotions; // Texture, level
+        for (std::uint32_t t = 0; t < mTextureStreams.size(); ++t) {
+            const auto& stream = mTextureStreams[t];
+            if (!stream.source || stream.pending || VK_NULL_HANDLE == mTextures[t].image) {
+                continue;
+            }
+
+            const auto level = target(t, bias);
+            if (level > stream.residentLevel + 1 || (overBudget && level > stream.residentLevel)) {
+                demotions.emplace_back(t, level);
+            } else if (level < stream.residentLevel) {
+                promotions.emplace_back(t, level);
+            }
+        }
+
+        // The largest deficits first
+        std::sort(promotions.begin(), promotions.end(), [&](const auto& a, const auto& b) {
+            return mTextureStreams[a.first].residentLevel - a.second > mTextureStreams[b.first].residentLevel - b.second;
+        });
+
+        std::vector<std::uint32_t> uploaded;
+        for (const auto* changes : {&demotions, &promotions}) {
+            for (const auto& [t, level] : *changes) {
+                if (0 == budget) {
+                    break;
+                }
+
+                auto& stream = mTextureStreams[t];
+                budget -= std::min<std::size_t>(budget, stream.source->sizeInBytes(level));
+
+                stream.pending = PendingImage{
+                    .image = texture::compressed_texture_to_image(mContext, *stream.source, mAllocator, mTextureBatch,
+                                                                  level),
+                    .format = stream.source->format,
+                    .level = level
+                };
+                uploaded.emplace_back(t);
+            }
+        }
+
+        if (!uploaded.empty()) {
+            const auto ticket = mTextureBatch.submit();
+            for (const auto textureId : uploaded) {
+                mTextureStreams[textureId].pending->ticket = ticket;
+            }
+        }
+    }
+
+    void SceneStreamer::complete_textures() {
+        for (std::uint32_t t = 0; t < mTextureStreams.size(); ++t) {
+            auto& stream = mTextureStreams[t];
+            if (!stream.pending || !mTextureBatch.is_ready(stream.pending->ticket)) {
+                continue;
+            }
+
+            wait_for_frames();
+
+            // The previous image outlives the views of the materials that are recreated below
+            const vkutils::Image previous = std::exchange(mTextures[t], std::move(stream.pending->image));
+            if (VK_NULL_HANDLE != previous.allocation) {
+                VmaAllocationInfo allocationInfo{};
+                vmaGetAllocationInfo(mAllocator.allocator, previous.allocation, &allocationInfo);
+                mFreedTextureBytes += allocationInfo.size;
+            }
+
+            mFormats[t] = stream.pending->format;
+            stream.residentLevel = stream.pending->level;
+            stream.pending.reset();
+
+            for (const auto materialId : stream.materials) {
+                if (mMaterials[materialId]) {
+                    write_material(materialId);
+                }
+            }
+        }
+    }
+
+    void SceneStreamer::publish_meshes() {
+        // Submissions complete in order
+        while (!mPendingMeshes.empty() && mMeshBatch.is_ready(mPendingMeshes.front().ticket)) {
+            auto& group = mPendingMeshes.front();
+            mOpaqueMeshes.insert(mOpaqueMeshes.end(), group.opaque.begin(), group.opaque.end());
+            mAlphaMaskedMeshes.insert(mAlphaMaskedMeshes.end(), group.alphaMasked.begin(), group.alphaMasked.end());
+            for (const auto meshId : group.opaqueIds) {
+                mOpaqueBounds.push_back(mMeshBounds[meshId].min, mMeshBounds[meshId].max);
+            }
+            for (const auto meshId : group.alphaMaskedIds) {
+                mAlphaMaskedBounds.push_back(mMeshBounds[meshId].min, mMeshBounds[meshId].max);
+            }
+            mPendingMeshes.pop_front();
+        }
+    }
+
+    void SceneStreamer::publish_materials() {
+        if (mResidentMaterialCount == mModel->materials.size()) {
+            return;
+        }
+
+        const auto isResident = [&](const std::uint32_t textureId) {
+            return VK_NULL_HANDLE != mTextures[textureId].image;
+        };
+
+        for (std::uint32_t m = 0; m < mModel->materials.size(); ++m) {
+            const auto& modelMaterial = mModel->materials[m];
+
+            if (mMaterials[m] || !isResident(modelMaterial.baseColorTextureId) ||
+                !isResident(modelMaterial.surfaceTextureId) || !isResident(modelMaterial.normalMapTextureId)) {
+                continue;
+            }
+
+            // The fallback slot stays as it is; it is shared by the materials that are not resident yet
+            wait_for_frames();
+            write_material(m);
+            write_material_entry(m, material::material_slot(m));
+            ++mResidentMaterialCount;
+        }
+    }
+
+    void SceneStreamer::defragment_textures() {
+        // Textures being uploaded are left where they are
+        for (const auto& stream : mTextureStreams) {
+            if (stream.pending) {
+                return;
+            }
+        }
+
+        // Moved images are destroyed
+        wait_for_frames();
+
+        std::vector<vkutils::Image*> textures;
+        for (auto& texture : mTextures) {
+            textures.emplace_back(&texture);
+        }
+
+        const auto stats = vkutils::defragment(mContext, mAllocator, vkutils::MemoryClass::Texture, textures,
+                                               mLoadCommandPool.handle);
+        mFreedTextureBytes = 0;
+
+        if (0 == stats.imagesMoved) {
+            return;
+        }
+
+        std::cout << "Defragmented textures: moved " << stats.imagesMoved << " images ("
+                  << stats.bytesMoved / (1024 * 1024) << " MiB), released " << stats.bytesFreed / (1024 * 1024)
+                  << " MiB\n";
+
+        // Views of the moved images refer to the destroyed ones
+        for (std::uint32_t m = 0; m < mMaterials.size(); ++m) {
+            if (mMaterials[m]) {
+                write_material(m);
+            }
+        }
+    }
+
+    void SceneStreamer::write_material(const std::uint32_t materialId) {
+        auto& material = mMaterials[materialId];
+        material = material::create_material(mContext, mModel->materials[materialId], mTextures, mFormats);
+
+        material::update_descriptor_set(mContext, mMaterialDescriptorSet, material::material_slot(materialId), *material,
+                                        mAnisotropySampler, mPointSampler);
+        ++mMaterialTableVersion;
+    }
+
+    void SceneStreamer::allocate_material_table(const std::uint32_t slotCount) {
+        // The material table has a pool of its own, sized for the materials of the model
+        mMaterialPool = vkutils::create_descriptor_pool(mContext, material::texturesPerSlot * slotCount, 1);
+        mMaterialDescriptorSet = material::allocate_descriptor_set(mContext, mMaterialPool.handle, mMaterialLayout,
+                                                                   slotCount);
+
+        material::update_descriptor_set(mContext, mMaterialDescriptorSet, material::fallbackSlot,
+                                        mFallback.materials.front(), mAnisotropySampler, mPointSampler);
+        ++mMaterialTableVersion;
+    }
+
+    void SceneStreamer::wait_for_frames() {
+        if (!mFramesWaited) {
+            mWaitForFrames();
+            mFramesWaited = true;
+        }
+    }
+
+    void SceneStreamer::write_material_entry(const std::uint32_t materialId, const std::uint32_t slot) {
+        const glsl::MaterialTextures entry = material::texture_slots(slot);
+
+        if (const auto res = vmaCopyMemoryToAllocation(mAllocator.allocator, &entry, mMaterialTextures.allocation,
+                                                       materialId * sizeof(glsl::MaterialTextures), sizeof(entry));
+            VK_SUCCESS != res) {
+            throw vkutils::Error("Unable to write material table\n"
+                                 "vmaCopyMemoryToAllocation() returned %s", vkutils::to_string(res).c_str()
+            );
+        }
+    }
+}
+
+namespace {
+    std::uint32_t mip_level_for(const std::uint32_t size, const float uvPerPixel, const std::uint32_t levelCount) {
+        // Texels covered by one pixel at level 0; every level halves it
+        const float texelsPerPixel = static_cast<float>(size) * uvPerPixel;
+        if (!(texelsPerPixel < static_cast<float>(1u << (levelCount - 1)))) {
+            return levelCount - 1;
+        }
+
+        if (texelsPerPixel <= 1.0f) {
+            return 0;
+        }
+
+        return static_cast<std::uint32_t>(std::floor(std::log2(texelsPerPixel)));
+    }
+
+    std::uint32_t initial_mip_level(const texture::CompressedTexture& texture) {
+        std::uint32_t level = 0;
+        while (level + 1 < texture.levels.size() &&
+               std::max(texture.width, texture.height) >> level > cfg::streamingInitialMipSize) {
+            ++level;
+        }
+
+        return level;
+    }
+}
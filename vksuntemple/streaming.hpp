@@ -0,0 +1,242 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "../vkutils/allocator.hpp"
+#include "../vkutils/staging_ring.hpp"
+#include "../vkutils/upload_batch.hpp"
+#include "../vkutils/vkimage.hpp"
+#include "../vkutils/vkobject.hpp"
+#include "../vkutils/vulkan_context.hpp"
+
+#include "baked_model.hpp"
+#include "culling.hpp"
+#include "material.hpp"
+#include "mesh.hpp"
+#include "mipgen.hpp"
+#include "state.hpp"
+#include "texture.hpp"
+#include "thread_pool.hpp"
+
+namespace streaming {
+    /*
+     * Loads the scene in the background, so that the render loop can start
+     * right away.
+     *
+     * The model file and the textures are read and decoded by worker threads,
+     * one job per texture, which report to the render thread through a
+     * lock-free completion queue, in the order they complete.
+     * update() is called by the render thread once per frame: it uploads a
+     * bounded amount of the decoded data, and publishes what has become
+     * resident since the previous frame.
+     *
+     * Meshes are drawn as soon as their upload completes. Until all textures
+     * of a material are resident, its entry of the material table points to
+     * the textures of a 1x1 fallback material.
+     *
+     * Block compressed textures start at a low mip level. Afterwards, the
+     * resident levels of each texture follow the texel density its materials
+     * need on screen: levels are promoted as the camera gets closer, and
+     * demoted as it moves away, or when the textures exceed the memory budget
+     * (see cfg::textureMemoryBudget). Their whole mip chain is kept in host
+     * memory for this. Uncompressed textures are always fully resident.
+     *
+     * The memory freed by replaced textures leaves holes in the texture pool;
+     * once the scene is loaded, the pool is compacted whenever enough memory
+     * has been freed.
+     *
+     * Textures and descriptors of the material table are replaced in place,
+     * so update() waits for the frames in flight before replacing any. Frames
+     * only overlap while nothing is replaced.
+     */
+    class SceneStreamer {
+    public:
+        SceneStreamer(const vkutils::VulkanContext& context,
+                      const vkutils::Allocator& allocator,
+                      vkutils::StagingRing& stagingRing,
+                      VkDescriptorSetLayout materialLayout,
+                      const vkutils::Sampler& anisotropySampler,
+                      const vkutils::Sampler& pointSampler,
+                      const char* modelPath,
+                      std::function<void()> waitForFrames);
+
+        SceneStreamer(const SceneStreamer&) = delete;
+
+        SceneStreamer& operator=(const SceneStreamer&) = delete;
+
+        // Must be called before recording the commands of a frame that use the material table. Waits for the frames in
+        // flight, through waitForFrames, before replacing textures or descriptors.
+        // Throws if loading failed.
+        void update(const state::State& state, VkExtent2D viewportExtent);
+
+        bool is_fully_loaded() const;
+
+        // Empty buffers until the model is loaded
+        const mesh::Geometry& geometry() const;
+
+        // Only the meshes whose upload has completed
+        const std::vector<mesh::Mesh>& opaque_meshes() const;
+
+        const std::vector<mesh::Mesh>& alpha_masked_meshes() const;
+
+        // World space boxes of the meshes, in the order of opaque_meshes() and alpha_masked_meshes()
+        const culling::BoundsSoA& opaque_bounds() const;
+
+        const culling::BoundsSoA& alpha_masked_bounds() const;
+
+        // Material table of the model, see material::create_descriptor_layout()
+        VkDescriptorSet material_descriptor_set() const;
+
+        // Changes whenever descriptors of the material table are written, which invalidates the command buffers that
+        // bind it
+        std::uint64_t material_table_version() const;
+
+    private:
+        struct ModelLoaded {
+            baked::BakedModel model;
+            std::vector<mesh::MeshBounds> bounds; // One per mesh
+        };
+
+        struct TextureDecoded {
+            std::uint32_t textureId;
+            material::DecodedTexture texture;
+        };
+
+        struct LoadFailed {
+            std::string message;
+        };
+
+        using LoadResult = std::variant<ModelLoaded, TextureDecoded, LoadFailed>;
+
+        // Meshes uploaded by the same submission of mMeshBatch
+        struct MeshGroup {
+            std::uint64_t ticket;
+            std::vector<mesh::Mesh> opaque;
+            std::vector<mesh::Mesh> alphaMasked;
+            // Indices of the meshes in the model, for their bounds
+            std::vector<std::uint32_t> opaqueIds;
+            std::vector<std::uint32_t> alphaMaskedIds;
+        };
+
+        // Bounding sphere of a mesh, and how much of its texture it covers per world unit
+        struct MeshExtent {
+            glm::vec3 center;
+            float radius;
+            float uvPerUnit; // 0 without texture coordinates
+        };
+
+        // Image being uploaded, replacing the image of the texture once complete
+        struct PendingImage {
+            vkutils::Image image;
+            VkFormat format;
+            std::uint32_t level; // Of the source chain, which is level 0 of image
+            std::uint64_t ticket;
+        };
+
+        struct TextureStream {
+            std::optional<bool> srgb; // Empty for textures no material uses
+            std::vector<std::uint32_t> materials;
+
+            // Full mip chain of block compressed textures, of which the levels from residentLevel on are resident
+            std::optional<texture::CompressedTexture> source;
+            std::uint32_t residentLevel = 0;
+
+            std::optional<PendingImage> pending;
+        };
+
+        void on_model_loaded(ModelLoaded loaded);
+
+        // Both consume budget, a number of bytes, and upload at least one item if there is any
+        void upload_meshes(std::size_t& budget);
+
+        void upload_textures(std::size_t& budget);
+
+        // Chooses the resident levels of the block compressed textures, and starts the uploads to reach them
+        void update_residency(const state::State& state, VkExtent2D viewportExtent, std::size_t& budget);
+
+        // Swaps in the images whose upload has completed
+        void complete_textures();
+
+        void publish_meshes();
+
+        void publish_materials();
+
+        // Compacts the texture pool once enough memory has been freed by streaming, see cfg::defragmentationChurn
+        void defragment_textures();
+
+        // (Re)creates the views of a resident material, and points its slot of the material table to them
+        void write_material(std::uint32_t materialId);
+
+        // Points the entry of materialId in the material table to the textures of slot
+        void write_material_entry(std::uint32_t materialId, std::uint32_t slot);
+
+        // Replaces the material table with one of slotCount slots, of which only the fallback slot is written
+        void allocate_material_table(std::uint32_t slotCount);
+
+        // Before replacing what the frames in flight use; waits once per update()
+        void wait_for_frames();
+
+        const vkutils::VulkanContext& mContext;
+        const vkutils::Allocator& mAllocator;
+
+        std::function<void()> mWaitForFrames;
+        bool mFramesWaited = false;
+
+        const vkutils::Sampler& mAnisotropySampler;
+        const vkutils::Sampler& mPointSampler;
+
+        // Command pool for the mip generation of uncompressed textures
+        vkutils::CommandPool mLoadCommandPool;
+        mipgen::MipGenerator mMipGenerator;
+
+        VkDescriptorSetLayout mMaterialLayout = VK_NULL_HANDLE;
+
+        std::optional<baked::BakedModel> mModel;
+        std::vector<mesh::MeshBounds> mMeshBounds;
+        std::vector<MeshExtent> mMeshExtents;
+
+        // GPU resources. Declared before the batches, which wait for their uploads when destroyed.
+        material::MaterialStore mFallback;
+        vkutils::DescriptorPool mMaterialPool;
+        VkDescriptorSet mMaterialDescriptorSet = VK_NULL_HANDLE;
+        vkutils::Buffer mMaterialTextures; // glsl::MaterialTextures, one per material of the model
+        std::uint64_t mMaterialTableVersion = 0;
+
+        mesh::Geometry mGeometry;
+        mesh::GeometryCursor mGeometryCursor;
+        std::size_t mNextMesh = 0;
+
+        std::vector<vkutils::Image> mTextures; // Empty until the first upload completes
+        std::vector<VkFormat> mFormats;
+        std::vector<TextureStream> mTextureStreams;
+        std::uint32_t mMipBias = 0; // Levels dropped from every streamed texture to fit the memory budget
+        VkDeviceSize mFreedTextureBytes = 0; // Since the last defragmentation
+
+        std::vector<std::optional<material::Material>> mMaterials; // Empty until resident
+        std::size_t mResidentMaterialCount = 0;
+
+        std::vector<mesh::Mesh> mOpaqueMeshes;
+        std::vector<mesh::Mesh> mAlphaMaskedMeshes;
+        culling::BoundsSoA mOpaqueBounds;
+        culling::BoundsSoA mAlphaMaskedBounds;
+
+        vkutils::UploadBatch mMeshBatch;
+        vkutils::UploadBatch mTextureBatch;
+
+        std::deque<MeshGroup> mPendingMeshes;
+        std::deque<TextureDecoded> mDecodedTextures;
+
+        // Declared before the pool, so that it outlives the workers
+        thread_pool::CompletionQueue<LoadResult> mCompletions;
+
+        // Destroyed first: jobs that have not started yet are dropped
+        thread_pool::ThreadPool mWorkers;
+    };
+}
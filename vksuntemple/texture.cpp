@@ -1,30 +1,49 @@
 #include "texture.hpp"
 
+#include <algorithm>
 #include <iostream>
 #include <utility>
+#include <cassert>
 #include <cstdint>
+#include <cstdio>
 #include <cstring>
+#include <filesystem>
 #include <limits>
 #include <vector>
 
 #include "baked_model.hpp"
 #include "../vkutils/error.hpp"
+#include "../vkutils/ktx2.hpp"
 #include "../vkutils/vkbuffer.hpp"
 #include "../vkutils/to_string.hpp"
 #include "../vkutils/vkutil.hpp"
 
+namespace {
+    // Whole level 0 of texture, tightly packed
+    VkBufferImageCopy base_level_copy(const texture::Texture& texture);
+
+    // Bytes per 4x4 block of the block compressed formats written by assets-bake, or 0 for any other format
+    std::uint64_t block_size_in_bytes(VkFormat format);
+}
+
 namespace texture {
-    Texture::Texture(const std::string& path) : path(path) {
-        std::cout << "Loading " << path << "...\n";
+    Texture::Texture(const std::string& path, const std::uint32_t channelCount) : path(path) {
+        std::cout << "Loading " + path + "...\n";
 
         // Flip images vertically by default. Vulkan expects the first scanline to be the bottom-most scanline. PNG et al.
         // instead define the first scanline to be the top-most one.
-        stbi_set_flip_vertically_on_load(1);
+        // Textures are decoded by several threads at once, so the setting is per thread.
+        stbi_set_flip_vertically_on_load_thread(1);
 
         // Load base image
         int baseWidthi, baseHeighti, baseChannelsi;
         const auto rawPath = path.c_str();
-        data = stbi_load(rawPath, &baseWidthi, &baseHeighti, &baseChannelsi, 4 /* want 4 channels = RGBA */);
+        if (channelCount < 1 || channelCount > 4) {
+            throw vkutils::Error("%s: unsupported channel count %u", rawPath, channelCount);
+        }
+
+        channels = 3 == channelCount ? 4 : channelCount;
+        data = stbi_load(rawPath, &baseWidthi, &baseHeighti, &baseChannelsi, static_cast<int>(channels));
 
         if (data == nullptr) {
             throw vkutils::Error("%s: unable to load texture base image (%s)", rawPath, 0, stbi_failure_reason());
@@ -37,7 +56,8 @@ namespace texture {
     Texture::Texture(Texture&& other) noexcept : path(std::exchange(other.path, "")),
                                                  data(std::exchange(other.data, nullptr)),
                                                  width(std::exchange(other.width, 0)),
-                                                 height(std::exchange(other.height, 0)) {
+                                                 height(std::exchange(other.height, 0)),
+                                                 channels(std::exchange(other.channels, 0)) {
     }
 
     Texture& Texture::operator=(Texture&& other) noexcept {
@@ -46,13 +66,14 @@ namespace texture {
             std::swap(data, other.data);
             std::swap(width, other.width);
             std::swap(height, other.height);
+            std::swap(channels, other.channels);
         }
         return *this;
     }
 
     std::uint32_t Texture::sizeInBytes() const {
-        // width * height * |[r, g, b, a]|
-        return width * height * 4;
+        // width * height * |channels|
+        return width * height * channels;
     }
 
     Texture::~Texture() {
@@ -64,35 +85,138 @@ namespace texture {
 }
 
 namespace texture {
-    vkutils::Image texture_to_image(const vkutils::VulkanContext& context,
-                                    const Texture& texture,
-                                    const VkFormat format,
-                                    const vkutils::Allocator& allocator,
-                                    const vkutils::CommandPool& loadCommandPool) {
-        // Create staging buffer and copy image data to it
-        const auto sizeInBytes = texture.sizeInBytes();
+    void checked_read(FILE* input, const std::size_t bytes, void* buffer) {
+        const auto ret = std::fread(buffer, 1, bytes, input);
 
-        const auto staging = create_buffer(allocator, sizeInBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                           VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
-        void* sptr = nullptr;
-        if (const auto res = vmaMapMemory(allocator.allocator, staging.allocation, &sptr);
-            VK_SUCCESS != res) {
-            throw vkutils::Error("Mapping memory for writing\n"
-                                 "vmaMapMemory() returned %s", vkutils::to_string(res).c_str()
-            );
+        if (bytes != ret) {
+            throw vkutils::Error("checked_read_(): expected %zu bytes, got %zu", bytes, ret);
         }
+    }
 
-        std::memcpy(sptr, texture.data, sizeInBytes);
-        vmaUnmapMemory(allocator.allocator, staging.allocation);
+    void checked_seek(FILE* input, const std::uint64_t offset) {
+        if (0 != std::fseek(input, static_cast<long>(offset), SEEK_SET)) {
+            throw vkutils::Error("checked_seek_(): unable to seek to offset %llu",
+                                 static_cast<unsigned long long>(offset));
+        }
+    }
 
-        // Create image
-        vkutils::Image image = create_texture_image(allocator, texture.width, texture.height,
-                                                    format,
-                                                    VK_IMAGE_USAGE_SAMPLED_BIT |
-                                                    VK_IMAGE_USAGE_TRANSFER_DST_BIT |
-                                                    VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+    CompressedTexture::CompressedTexture(const std::string& path) : path(path) {
+        std::cout << "Loading " + path + "...\n";
+
+        FILE* input = std::fopen(path.c_str(), "rb");
+        if (!input) {
+            throw vkutils::Error("%s: unable to open texture for reading", path.c_str());
+        }
+
+        try {
+            vkutils::ktx2::Header header;
+            checked_read(input, sizeof(header), &header);
+
+            if (0 != std::memcmp(header.identifier, vkutils::ktx2::kIdentifier, sizeof(header.identifier))) {
+                throw vkutils::Error("%s: invalid file signature!", path.c_str());
+            }
+
+            if (header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1) {
+                throw vkutils::Error("%s: only single layer 2D textures are supported", path.c_str());
+            }
 
-        // Create command buffer for data upload and begin recording
+            if (header.supercompressionScheme != vkutils::ktx2::SUPERCOMPRESSION_NONE) {
+                throw vkutils::Error("%s: unsupported supercompression scheme %u", path.c_str(),
+                                     header.supercompressionScheme);
+            }
+
+            format = static_cast<VkFormat>(header.vkFormat);
+            width = header.pixelWidth;
+            height = header.pixelHeight;
+
+            if (header.levelCount != vkutils::compute_mip_level_count(width, height)) {
+                throw vkutils::Error("%s: expected full mip chain, got %u levels", path.c_str(), header.levelCount);
+            }
+
+            const std::uint64_t blockSize = block_size_in_bytes(format);
+            if (0 == blockSize) {
+                throw vkutils::Error("%s: unsupported format %s", path.c_str(), vkutils::to_string(format).c_str());
+            }
+
+            std::vector<vkutils::ktx2::LevelIndex> levelIndex(header.levelCount);
+            checked_read(input, sizeof(vkutils::ktx2::LevelIndex) * levelIndex.size(), levelIndex.data());
+
+            // Levels are used as copy regions of their extent, so their size must be exactly that of their blocks
+            for (std::uint32_t i = 0; i < levelIndex.size(); ++i) {
+                const std::uint64_t levelWidth = std::max(1u, width >> i);
+                const std::uint64_t levelHeight = std::max(1u, height >> i);
+                const std::uint64_t expected = (levelWidth + 3) / 4 * ((levelHeight + 3) / 4) * blockSize;
+
+                if (levelIndex[i].byteLength != expected || levelIndex[i].uncompressedByteLength != expected) {
+                    throw vkutils::Error("%s: level %u is %llu bytes, expected %llu", path.c_str(), i,
+                                         static_cast<unsigned long long>(levelIndex[i].byteLength),
+                                         static_cast<unsigned long long>(expected));
+                }
+            }
+
+            // Level data is one contiguous region (smallest level first), which becomes the staging data as-is.
+            // The baker aligns every level to the block size, so the offsets are valid copy offsets.
+            std::uint64_t regionBegin = std::numeric_limits<std::uint64_t>::max(), regionEnd = 0;
+            for (const auto& level : levelIndex) {
+                regionBegin = std::min(regionBegin, level.byteOffset);
+                regionEnd = std::max(regionEnd, level.byteOffset + level.byteLength);
+            }
+
+            for (const auto& level : levelIndex) {
+                levels.emplace_back(Level{
+                    .offset = static_cast<std::size_t>(level.byteOffset - regionBegin),
+                    .size = static_cast<std::size_t>(level.byteLength)
+                });
+            }
+
+            data.resize(regionEnd - regionBegin);
+            checked_seek(input, regionBegin);
+            checked_read(input, data.size(), data.data());
+        } catch (...) {
+            std::fclose(input);
+            throw;
+        }
+
+        std::fclose(input);
+    }
+
+    std::size_t CompressedTexture::sizeInBytes(const std::uint32_t baseLevel) const {
+        std::size_t ret = 0;
+        for (std::size_t level = baseLevel; level < levels.size(); ++level) {
+            ret += levels[level].size;
+        }
+
+        return ret;
+    }
+
+    bool is_compressed_texture(const std::string& path) {
+        return std::filesystem::path(path).extension() == ".ktx2";
+    }
+
+    VkFormat texture_format(const Texture& texture, const bool srgb) {
+        switch (texture.channels) {
+            case 1:
+                return srgb ? VK_FORMAT_R8_SRGB : VK_FORMAT_R8_UNORM;
+            case 2:
+                return srgb ? VK_FORMAT_R8G8_SRGB : VK_FORMAT_R8G8_UNORM;
+            default:
+                return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+        }
+    }
+
+    VkComponentMapping texture_swizzle(const VkFormat format) {
+        if (VK_FORMAT_R8_UNORM != format && VK_FORMAT_R8_SRGB != format) {
+            return {};
+        }
+
+        constexpr auto r = VK_COMPONENT_SWIZZLE_R;
+        return VkComponentMapping{r, r, r, VK_COMPONENT_SWIZZLE_ONE};
+    }
+}
+
+namespace texture {
+    VkCommandBuffer begin_upload_commands(const vkutils::VulkanContext& context,
+                                          const vkutils::CommandPool& loadCommandPool) {
         VkCommandBuffer commandBuffer = alloc_command_buffer(context, loadCommandPool.handle);
 
         constexpr VkCommandBufferBeginInfo beginInfo{
@@ -108,59 +232,123 @@ namespace texture {
             );
         }
 
-        // Transition whole image layout
-        // When copying data to the image, the image’s layout must be TRANSFER DST OPTIMAL. The current
-        // image layout is UNDEFINED (which is the initial layout the image was created in).
-        const auto mipLevels = vkutils::compute_mip_level_count(texture.width, texture.height);
-        vkutils::image_barrier(commandBuffer, image.image,
-                               0,
-                               VK_ACCESS_TRANSFER_WRITE_BIT,
-                               VK_IMAGE_LAYOUT_UNDEFINED,
-                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                               VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                               VK_PIPELINE_STAGE_TRANSFER_BIT,
-                               VkImageSubresourceRange{
-                                   VK_IMAGE_ASPECT_COLOR_BIT,
-                                   0, mipLevels,
-                                   0, 1
-                               }
-        );
+        return commandBuffer;
+    }
 
-        // Upload data from staging buffer to image
-        const VkBufferImageCopy copy{
-            .bufferOffset = 0,
-            .bufferRowLength = 0,
-            .bufferImageHeight = 0,
-            .imageSubresource = VkImageSubresourceLayers{
-                VK_IMAGE_ASPECT_COLOR_BIT,
-                0,
-                0, 1
-            },
-            .imageOffset = VkOffset3D{0, 0, 0},
-            .imageExtent = VkExtent3D{
-                .width = texture.width,
-                .height = texture.height,
-                .depth = 1
-            }
+    void submit_upload_commands(const vkutils::VulkanContext& context,
+                                const vkutils::CommandPool& loadCommandPool,
+                                VkCommandBuffer commandBuffer) {
+        // End command recording
+        if (const auto res = vkEndCommandBuffer(commandBuffer); VK_SUCCESS != res) {
+            throw vkutils::Error("Ending command buffer recording\n"
+                                 "vkEndCommandBuffer() returned %s", vkutils::to_string(res).c_str()
+            );
+        }
+
+        // Submit command buffer and wait for commands to complete. Commands must have completed before we can
+        // destroy the temporary resources, such as the staging buffers.
+        vkutils::Fence uploadComplete = create_fence(context);
+
+        const VkSubmitInfo submitInfo{
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &commandBuffer
         };
 
-        vkCmdCopyBufferToImage(commandBuffer, staging.buffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
-                               &copy);
+        if (const auto res = vkQueueSubmit(context.graphicsQueue, 1, &submitInfo, uploadComplete.handle);
+            VK_SUCCESS != res) {
+            throw vkutils::Error("Submitting commands\n"
+                                 "vkQueueSubmit() returned %s", vkutils::to_string(res).c_str()
+            );
+        }
+
+        if (const auto res = vkWaitForFences(context.device, 1, &uploadComplete.handle, VK_TRUE,
+                                             std::numeric_limits<std::uint64_t>::max()); VK_SUCCESS != res) {
+            throw vkutils::Error("Waiting for upload to complete\n"
+                                 "vkWaitForFences() returned %s", vkutils::to_string(res).c_str()
+            );
+        }
 
-        // Transition base level to TRANSFER SRC OPTIMAL
-        vkutils::image_barrier(commandBuffer, image.image,
-                               VK_ACCESS_TRANSFER_WRITE_BIT,
-                               VK_ACCESS_TRANSFER_READ_BIT,
-                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                               VK_PIPELINE_STAGE_TRANSFER_BIT,
-                               VK_PIPELINE_STAGE_TRANSFER_BIT,
-                               VkImageSubresourceRange{
-                                   VK_IMAGE_ASPECT_COLOR_BIT,
-                                   0, 1,
-                                   0, 1
-                               }
+        // Most temporary resources are destroyed automatically through their destructors. However, the command
+        // buffer we must free manually.
+        vkFreeCommandBuffers(context.device, loadCommandPool.handle, 1, &commandBuffer);
+    }
+}
+
+namespace texture {
+    vkutils::Image texture_to_image(const vkutils::VulkanContext& context,
+                                    const Texture& texture,
+                                    const VkFormat format,
+                                    const vkutils::Allocator& allocator,
+                                    vkutils::UploadBatch& batch,
+                                    mipgen::MipGenerator& mipGenerator,
+                                    const vkutils::CommandPool& loadCommandPool) {
+        if (mipGenerator.supports(format)) {
+            // sRGB images are written through UNORM views, a usage their own format rarely supports
+            const VkImageCreateFlags createFlags = texture_format(texture, false) != format
+                                                       ? VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT |
+                                                         VK_IMAGE_CREATE_EXTENDED_USAGE_BIT
+                                                       : 0;
+            vkutils::Image image = create_texture_image(allocator, texture.width, texture.height,
+                                                        format,
+                                                        VK_IMAGE_USAGE_SAMPLED_BIT |
+                                                        VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                                                        VK_IMAGE_USAGE_STORAGE_BIT,
+                                                        createFlags);
+
+            batch.upload(image.image, texture.data, texture.sizeInBytes(), {base_level_copy(texture)},
+                         VkImageSubresourceRange{
+                             VK_IMAGE_ASPECT_COLOR_BIT,
+                             0, 1,
+                             0, 1
+                         }
+            );
+            mipGenerator.add(image.image, format, texture.width, texture.height);
+
+            return image;
+        }
+
+        // Fallback: blit each level from the previous one
+        vkutils::Image image = create_texture_image(allocator, texture.width, texture.height,
+                                                    format,
+                                                    VK_IMAGE_USAGE_SAMPLED_BIT |
+                                                    VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                                                    VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+        // Upload the base level through the staging ring. It ends up in TRANSFER SRC OPTIMAL, ready to be blitted from.
+        batch.upload(image.image, texture.data, texture.sizeInBytes(), {base_level_copy(texture)},
+                     VkImageSubresourceRange{
+                         VK_IMAGE_ASPECT_COLOR_BIT,
+                         0, 1,
+                         0, 1
+                     },
+                     VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
         );
+        batch.submit();
+        batch.wait();
+
+        // Blits require the graphics queue. Once the batch is done, the base level is visible to it.
+        VkCommandBuffer commandBuffer = begin_upload_commands(context, loadCommandPool);
+
+        // Transition the remaining levels
+        // When blitting to the image, the levels' layout must be TRANSFER DST OPTIMAL. Their current layout is
+        // UNDEFINED (which is the initial layout the image was created in).
+        const auto mipLevels = vkutils::compute_mip_level_count(texture.width, texture.height);
+        if (mipLevels > 1) {
+            vkutils::image_barrier(commandBuffer, image.image,
+                                   0,
+                                   VK_ACCESS_TRANSFER_WRITE_BIT,
+                                   VK_IMAGE_LAYOUT_UNDEFINED,
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                   VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                   VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                   VkImageSubresourceRange{
+                                       VK_IMAGE_ASPECT_COLOR_BIT,
+                                       1, mipLevels - 1,
+                                       0, 1
+                                   }
+            );
+        }
 
         // Process all mipmap levels
         uint32_t width = texture.width, height = texture.height;
@@ -235,42 +423,109 @@ namespace texture {
                                }
         );
 
-        // End command recording
-        if (const auto res = vkEndCommandBuffer(commandBuffer); VK_SUCCESS != res) {
-            throw vkutils::Error("Ending command buffer recording\n"
-                                 "vkEndCommandBuffer() returned %s", vkutils::to_string(res).c_str()
+        submit_upload_commands(context, loadCommandPool, commandBuffer);
+
+        // Return resulting image
+        return image;
+    }
+
+    vkutils::Image compressed_texture_to_image(const vkutils::VulkanContext& context,
+                                               const CompressedTexture& texture,
+                                               const vkutils::Allocator& allocator,
+                                               vkutils::UploadBatch& batch,
+                                               const std::uint32_t baseLevel) {
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(context.physicalDevice, texture.format, &formatProperties);
+        if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+            throw vkutils::Error("%s: format %s cannot be sampled on this device\n"
+                                 "Re-run assets-bake with --no-bcn", texture.path.c_str(),
+                                 vkutils::to_string(texture.format).c_str()
             );
         }
 
-        // Submit command buffer and wait for commands to complete. Commands must have completed before we can
-        // destroy the temporary resources, such as the staging buffers.
-        vkutils::Fence uploadComplete = create_fence(context);
+        assert(baseLevel < texture.levels.size());
 
-        const VkSubmitInfo submitInfo{
-            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            .commandBufferCount = 1,
-            .pCommandBuffers = &commandBuffer
-        };
+        // The chain is complete, so the remaining levels are exactly the mip chain of the smaller image
+        const auto width = std::max(1u, texture.width >> baseLevel);
+        const auto height = std::max(1u, texture.height >> baseLevel);
+        vkutils::Image image = create_texture_image(allocator, width, height, texture.format,
+                                                    VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
 
-        if (const auto res = vkQueueSubmit(context.graphicsQueue, 1, &submitInfo, uploadComplete.handle);
-            VK_SUCCESS != res) {
-            throw vkutils::Error("Submitting commands\n"
-                                 "vkQueueSubmit() returned %s", vkutils::to_string(res).c_str()
-            );
+        // The levels from baseLevel on are contiguous in data, whichever the order of the levels
+        std::size_t begin = texture.data.size(), end = 0;
+        for (std::size_t level = baseLevel; level < texture.levels.size(); ++level) {
+            begin = std::min(begin, texture.levels[level].offset);
+            end = std::max(end, texture.levels[level].offset + texture.levels[level].size);
         }
 
-        if (const auto res = vkWaitForFences(context.device, 1, &uploadComplete.handle, VK_TRUE,
-                                             std::numeric_limits<std::uint64_t>::max()); VK_SUCCESS != res) {
-            throw vkutils::Error("Waiting for upload to complete\n"
-                                 "vkWaitForFences() returned %s", vkutils::to_string(res).c_str()
-            );
+        // One region per level. Block data is tightly packed, so the buffer row length and image height are implied
+        // by the image extent (rounded up to whole blocks).
+        const auto mipLevels = static_cast<std::uint32_t>(texture.levels.size()) - baseLevel;
+        std::vector<VkBufferImageCopy> copies;
+        copies.reserve(mipLevels);
+        for (std::uint32_t level = 0; level < mipLevels; ++level) {
+            copies.emplace_back(VkBufferImageCopy{
+                .bufferOffset = texture.levels[baseLevel + level].offset - begin,
+                .bufferRowLength = 0,
+                .bufferImageHeight = 0,
+                .imageSubresource = VkImageSubresourceLayers{
+                    VK_IMAGE_ASPECT_COLOR_BIT,
+                    level,
+                    0, 1
+                },
+                .imageOffset = VkOffset3D{0, 0, 0},
+                .imageExtent = VkExtent3D{
+                    .width = std::max(1u, width >> level),
+                    .height = std::max(1u, height >> level),
+                    .depth = 1
+                }
+            });
         }
 
-        // Return resulting image
-        // Most temporary resources are destroyed automatically through their destructors. However, the command
-        // buffer we must free manually.
-        vkFreeCommandBuffers(context.device, loadCommandPool.handle, 1, &commandBuffer);
+        // Layout transitions and queue ownership are handled by the batch
+        batch.upload(image.image, texture.data.data() + begin, end - begin, copies,
+                     VkImageSubresourceRange{
+                         VK_IMAGE_ASPECT_COLOR_BIT,
+                         0, mipLevels,
+                         0, 1
+                     }
+        );
 
         return image;
     }
 }
+
+namespace {
+    VkBufferImageCopy base_level_copy(const texture::Texture& texture) {
+        return VkBufferImageCopy{
+            .bufferOffset = 0,
+            .bufferRowLength = 0,
+            .bufferImageHeight = 0,
+            .imageSubresource = VkImageSubresourceLayers{
+                VK_IMAGE_ASPECT_COLOR_BIT,
+                0,
+                0, 1
+            },
+            .imageOffset = VkOffset3D{0, 0, 0},
+            .imageExtent = VkExtent3D{
+                .width = texture.width,
+                .height = texture.height,
+                .depth = 1
+            }
+        };
+    }
+
+    std::uint64_t block_size_in_bytes(const VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+                return 8;
+            case VK_FORMAT_BC5_UNORM_BLOCK:
+            case VK_FORMAT_BC7_SRGB_BLOCK:
+            case VK_FORMAT_BC7_UNORM_BLOCK:
+                return 16;
+            default:
+                return 0;
+        }
+    }
+}
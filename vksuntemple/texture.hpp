@@ -3,17 +3,23 @@
 #include <cstdint>
 #include <stb_image.h>
 #include <string>
+#include <vector>
 
 #include "../vkutils/allocator.hpp"
+#include "../vkutils/upload_batch.hpp"
 #include "../vkutils/vkimage.hpp"
 #include "../vkutils/vkobject.hpp"
 #include "../vkutils/vulkan_context.hpp"
 
+#include "mipgen.hpp"
+
 namespace texture {
     // Thin wrapper that loads an image texture using stb_image
     // Higher level abstraction used for image loading caching logic in mesh.cpp
     struct Texture {
-        Texture(const std::string& path);
+        // Loads the first channelCount channels of the image. Three channel images are expanded to RGBA, since RGB8
+        // formats are rarely supported for sampling.
+        Texture(const std::string& path, std::uint32_t channelCount);
 
         // Move constructor
         Texture(Texture&& other) noexcept;
@@ -28,14 +34,77 @@ namespace texture {
         std::uint32_t width;
         std::uint32_t height;
 
+        // Channels per texel in data: 1, 2 or 4
+        std::uint32_t channels;
+
         std::uint32_t sizeInBytes() const;
 
         ~Texture();
     };
 
+    // Block compressed texture written by assets-bake, including its full mip chain
+    // Stored in a KTX2 container, see assets-bake/texture_bake.hpp
+    struct CompressedTexture {
+        explicit CompressedTexture(const std::string& path);
+
+        struct Level {
+            std::size_t offset;
+            std::size_t size;
+        };
+
+        std::string path;
+
+        VkFormat format;
+
+        std::uint32_t width;
+        std::uint32_t height;
+
+        std::vector<Level> levels;
+
+        // All levels back to back, starting at level 0
+        std::vector<std::uint8_t> data;
+
+        // Size of the levels from baseLevel on
+        std::size_t sizeInBytes(std::uint32_t baseLevel = 0) const;
+    };
+
+    // Baked textures are either block compressed (.ktx2) or plain images (assets-bake --no-bcn)
+    bool is_compressed_texture(const std::string& path);
+
+    // R8, R8G8 or R8G8B8A8 format matching the channels of texture
+    VkFormat texture_format(const Texture& texture, bool srgb);
+
+    // Replicates the single channel of R8 formats, so that shaders read scalar textures as grey. Identity otherwise.
+    VkComponentMapping texture_swizzle(VkFormat format);
+
+    // One-off command buffer on the graphics queue, allocated from loadCommandPool
+    VkCommandBuffer begin_upload_commands(const vkutils::VulkanContext& context,
+                                          const vkutils::CommandPool& loadCommandPool);
+
+    // Submits commandBuffer to the graphics queue, blocks until it completes, then frees it
+    void submit_upload_commands(const vkutils::VulkanContext& context,
+                                const vkutils::CommandPool& loadCommandPool,
+                                VkCommandBuffer commandBuffer);
+
+    // Queues the upload of the base level into batch, and the generation of the other levels into mipGenerator, when it
+    // supports format; the image must not be used before both are done.
+    // Otherwise, uploads the base level through batch, then generates the mips with blits on the graphics queue. Blocks
+    // until both are complete, including any other upload pending in batch.
+    // batch must make its uploads visible to VK_ACCESS_SHADER_READ_BIT in VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, and to
+    // VK_ACCESS_TRANSFER_READ_BIT in VK_PIPELINE_STAGE_TRANSFER_BIT
     vkutils::Image texture_to_image(const vkutils::VulkanContext& context,
                                     const Texture& texture,
                                     VkFormat format,
                                     const vkutils::Allocator& allocator,
+                                    vkutils::UploadBatch& batch,
+                                    mipgen::MipGenerator& mipGenerator,
                                     const vkutils::CommandPool& loadCommandPool);
+
+    // Queues the levels from baseLevel on as-is into batch, as the levels of a smaller image; no mip generation happens
+    // on the GPU. The image must not be used before batch is submitted.
+    vkutils::Image compressed_texture_to_image(const vkutils::VulkanContext& context,
+                                               const CompressedTexture& texture,
+                                               const vkutils::Allocator& allocator,
+                                               vkutils::UploadBatch& batch,
+                                               std::uint32_t baseLevel = 0);
 }
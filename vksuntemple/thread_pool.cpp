@@ -0,0 +1,62 @@
+#include "thread_pool.hpp"
+
+#include <utility>
+
+namespace thread_pool {
+    ThreadPool::ThreadPool(const std::size_t workerCount) {
+        for (std::size_t i = 0; i < std::max<std::size_t>(1, workerCount); ++i) {
+            mWorkers.emplace_back([this] {
+                run();
+            });
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard lock(mMutex);
+            mStopping = true;
+            mJobs.clear();
+        }
+
+        mWake.notify_all();
+
+        for (auto& worker : mWorkers) {
+            worker.join();
+        }
+    }
+
+    void ThreadPool::submit(std::function<void()> job) {
+        {
+            std::lock_guard lock(mMutex);
+            mJobs.emplace_back(std::move(job));
+        }
+
+        mWake.notify_one();
+    }
+
+    std::size_t ThreadPool::worker_count() const {
+        return mWorkers.size();
+    }
+
+    void ThreadPool::run() {
+        for (;;) {
+            std::function<void()> job;
+
+            {
+                std::unique_lock lock(mMutex);
+                mWake.wait(lock, [this] {
+                    return mStopping || !mJobs.empty();
+                });
+
+                if (mStopping) {
+                    return;
+                }
+
+                job = std::move(mJobs.front());
+                mJobs.pop_front();
+            }
+
+            job();
+        }
+    }
+}
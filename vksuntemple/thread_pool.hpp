@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <cstddef>
+
+namespace thread_pool {
+    // Fixed set of worker threads, running jobs in submission order
+    class ThreadPool {
+    public:
+        explicit ThreadPool(std::size_t workerCount);
+
+        // Waits for the running jobs. Jobs that have not started yet are dropped.
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        void submit(std::function<void()> job);
+
+        std::size_t worker_count() const;
+
+    private:
+        void run();
+
+        std::mutex mMutex;
+        std::condition_variable mWake;
+        std::deque<std::function<void()>> mJobs;
+        bool mStopping = false;
+
+        std::vector<std::thread> mWorkers;
+    };
+
+    // Lock-free queue with many producers and a single consumer. Producers push from any thread, without blocking; the
+    // consumer takes everything pushed so far at once.
+    template<typename T>
+    class CompletionQueue {
+    public:
+        CompletionQueue() = default;
+
+        ~CompletionQueue() {
+            drain();
+        }
+
+        CompletionQueue(const CompletionQueue&) = delete;
+
+        CompletionQueue& operator=(const CompletionQueue&) = delete;
+
+        void push(T value) {
+            auto* node = new Node{std::move(value), mHead.load(std::memory_order_relaxed)};
+
+            // On failure, node->next is updated to the current head
+            while (!mHead.compare_exchange_weak(node->next, node, std::memory_order_release,
+                                                std::memory_order_relaxed)) {
+            }
+        }
+
+        // Oldest first. Nodes are only freed here, after being unlinked all at once, so pushes are free of ABA issues.
+        std::vector<T> drain() {
+            Node* node = mHead.exchange(nullptr, std::memory_order_acquire);
+
+            std::vector<T> ret;
+            while (node) {
+                ret.emplace_back(std::move(node->value));
+
+                const Node* done = node;
+                node = node->next;
+                delete done;
+            }
+
+            std::reverse(ret.begin(), ret.end());
+            return ret;
+        }
+
+    private:
+        struct Node {
+            T value;
+            Node* next;
+        };
+
+        std::atomic<Node*> mHead = nullptr;
+    };
+}
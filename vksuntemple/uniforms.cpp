@@ -0,0 +1,85 @@
+#include "uniforms.hpp"
+
+#include <cassert>
+#include <cstring>
+
+#include "../vkutils/error.hpp"
+#include "../vkutils/to_string.hpp"
+
+namespace {
+    VkDeviceSize align_up(VkDeviceSize offset, VkDeviceSize alignment);
+}
+
+namespace uniforms {
+    UniformRing::UniformRing(const vkutils::VulkanContext& context,
+                             const vkutils::Allocator& allocator,
+                             const std::uint32_t frameCount)
+        : mAllocator(allocator),
+          mFrameCount(frameCount) {
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(context.physicalDevice, &properties);
+        const VkDeviceSize alignment = properties.limits.minUniformBufferOffsetAlignment;
+
+        const VkDeviceSize shade = align_up(sizeof(glsl::SceneUniform), alignment);
+        const VkDeviceSize screen = align_up(shade + sizeof(glsl::ShadeUniform), alignment);
+        mFrameSize = align_up(screen + sizeof(glsl::ScreenEffectsUniform), alignment);
+
+        mLayout = FrameOffsets{
+            .scene = 0,
+            .shade = static_cast<std::uint32_t>(shade),
+            .screen = static_cast<std::uint32_t>(screen)
+        };
+
+        mBuffer = vkutils::create_buffer(
+            allocator,
+            mFrameSize * frameCount,
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT
+        );
+
+        VmaAllocationInfo allocationInfo{};
+        vmaGetAllocationInfo(mAllocator.allocator, mBuffer.allocation, &allocationInfo);
+        mMapped = static_cast<std::byte*>(allocationInfo.pMappedData);
+    }
+
+    VkBuffer UniformRing::buffer() const {
+        return mBuffer.buffer;
+    }
+
+    FrameOffsets UniformRing::offsets(const std::size_t frame) const {
+        assert(frame < mFrameCount);
+        const auto base = static_cast<std::uint32_t>(frame * mFrameSize);
+
+        return FrameOffsets{
+            .scene = base + mLayout.scene,
+            .shade = base + mLayout.shade,
+            .screen = base + mLayout.screen
+        };
+    }
+
+    void UniformRing::write(const std::size_t frame,
+                            const glsl::SceneUniform& sceneUniform,
+                            const glsl::ShadeUniform& shadeUniform,
+                            const glsl::ScreenEffectsUniform& screenEffectsUniform) {
+        const FrameOffsets frameOffsets = offsets(frame);
+
+        std::memcpy(mMapped + frameOffsets.scene, &sceneUniform, sizeof(sceneUniform));
+        std::memcpy(mMapped + frameOffsets.shade, &shadeUniform, sizeof(shadeUniform));
+        std::memcpy(mMapped + frameOffsets.screen, &screenEffectsUniform, sizeof(screenEffectsUniform));
+
+        // No-op on host coherent memory. Made visible to the device by the submission of the frame.
+        if (const auto res = vmaFlushAllocation(mAllocator.allocator, mBuffer.allocation,
+                                                frame * mFrameSize, mFrameSize);
+            VK_SUCCESS != res) {
+            throw vkutils::Error("Unable to flush uniforms\n"
+                                 "vmaFlushAllocation() returned %s", vkutils::to_string(res).c_str()
+            );
+        }
+    }
+}
+
+namespace {
+    VkDeviceSize align_up(const VkDeviceSize offset, const VkDeviceSize alignment) {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+}
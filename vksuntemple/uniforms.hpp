@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <volk/volk.h>
+
+#include "../vkutils/allocator.hpp"
+#include "../vkutils/vkbuffer.hpp"
+#include "../vkutils/vulkan_context.hpp"
+
+#include "scene.hpp"
+#include "screen.hpp"
+#include "shade.hpp"
+
+namespace uniforms {
+    // Offsets of the uniforms of a frame within UniformRing::buffer(), bound as dynamic offsets
+    struct FrameOffsets {
+        std::uint32_t scene;
+        std::uint32_t shade;
+        std::uint32_t screen;
+    };
+
+    /*
+     * Persistently mapped uniform buffer, with a region per frame in flight
+     * (see frames.hpp), which holds the scene, shade and screen uniforms of
+     * the frame.
+     *
+     * The CPU writes the uniforms of a frame once, when recording it; the
+     * descriptor sets refer to the whole buffer, and the draws select the
+     * region of their frame through dynamic offsets. Recorded commands thus
+     * need no transfer, nor barriers, to update the uniforms, and the offsets
+     * of a frame are the same for all its uses.
+     */
+    class UniformRing {
+    public:
+        UniformRing(const vkutils::VulkanContext& context,
+                    const vkutils::Allocator& allocator,
+                    std::uint32_t frameCount);
+
+        UniformRing(const UniformRing&) = delete;
+
+        UniformRing& operator=(const UniformRing&) = delete;
+
+        VkBuffer buffer() const;
+
+        FrameOffsets offsets(std::size_t frame) const;
+
+        // Writes the uniforms of frame, in place: the previous commands of frame must have completed
+        void write(std::size_t frame,
+                   const glsl::SceneUniform& sceneUniform,
+                   const glsl::ShadeUniform& shadeUniform,
+                   const glsl::ScreenEffectsUniform& screenEffectsUniform);
+
+    private:
+        const vkutils::Allocator& mAllocator;
+
+        // Offsets of the uniforms within the region of a frame, aligned to minUniformBufferOffsetAlignment
+        FrameOffsets mLayout{};
+        VkDeviceSize mFrameSize = 0;
+        std::uint32_t mFrameCount;
+
+        vkutils::Buffer mBuffer;
+        std::byte* mMapped = nullptr;
+    };
+}
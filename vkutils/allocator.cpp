@@ -1,15 +1,29 @@
 #include "allocator.hpp"
 
 #include <utility>
+#include <vector>
 
 #include "error.hpp"
+#include "memory_report.hpp"
 #include "to_string.hpp"
 
+namespace {
+    // Memory type VMA picks for the typical resource of memoryClass, UINT32_MAX if there is none
+    std::uint32_t find_pool_memory_type(VmaAllocator allocator, vkutils::MemoryClass memoryClass);
+}
+
 namespace vkutils {
     Allocator::Allocator() noexcept = default;
 
     Allocator::~Allocator() {
         if (VK_NULL_HANDLE != allocator) {
+            // Pools must be empty by now
+            for (const auto pool : pools) {
+                if (VK_NULL_HANDLE != pool) {
+                    vmaDestroyPool(allocator, pool);
+                }
+            }
+
             vmaDestroyAllocator(allocator);
         }
     }
@@ -19,13 +33,22 @@ namespace vkutils {
     }
 
     Allocator::Allocator(Allocator&& other) noexcept
-        : allocator(std::exchange(other.allocator, VK_NULL_HANDLE)) {
+        : allocator(std::exchange(other.allocator, VK_NULL_HANDLE)),
+          pools(std::exchange(other.pools, {})),
+          poolMemoryTypes(other.poolMemoryTypes) {
     }
 
     Allocator& Allocator::operator=(Allocator&& other) noexcept {
         std::swap(allocator, other.allocator);
+        std::swap(pools, other.pools);
+        std::swap(poolMemoryTypes, other.poolMemoryTypes);
         return *this;
     }
+
+    VmaPool Allocator::pool(const MemoryClass memoryClass, const std::uint32_t memoryTypeIndex) const {
+        const auto index = static_cast<std::size_t>(memoryClass);
+        return poolMemoryTypes[index] == memoryTypeIndex ? pools[index] : VK_NULL_HANDLE;
+    }
 }
 
 namespace vkutils {
@@ -39,8 +62,10 @@ namespace vkutils {
         };
 
         const VmaAllocatorCreateInfo allocatorCreateInfo{
+            .flags = aContext.hasMemoryBudget ? VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT : 0u,
             .physicalDevice = aContext.physicalDevice,
             .device = aContext.device,
+            .pAllocationCallbacks = host_allocation_callbacks(HostSubsystem::Vma),
             .pVulkanFunctions = &functions,
             .instance = aContext.instance,
             .vulkanApiVersion = props.apiVersion
@@ -54,6 +79,117 @@ namespace vkutils {
             );
         }
 
-        return Allocator(allocator);
+        Allocator ret(allocator);
+
+        // The block size is left to VMA, which picks it from the size of the heap
+        for (std::size_t i = 0; i < Allocator::poolCount; ++i) {
+            const auto memoryClass = static_cast<MemoryClass>(i);
+            const auto memoryTypeIndex = find_pool_memory_type(allocator, memoryClass);
+            if (MemoryClass::Uniform == memoryClass || UINT32_MAX == memoryTypeIndex) {
+                ret.poolMemoryTypes[i] = UINT32_MAX;
+                continue;
+            }
+
+            const VmaPoolCreateInfo poolInfo{
+                .memoryTypeIndex = memoryTypeIndex
+            };
+
+            if (const auto res = vmaCreatePool(allocator, &poolInfo, &ret.pools[i]);
+                VK_SUCCESS != res) {
+                throw Error("Unable to create memory pool\n"
+                            "vmaCreatePool() returned %s", to_string(res).c_str()
+                );
+            }
+
+            ret.poolMemoryTypes[i] = memoryTypeIndex;
+        }
+
+        return ret;
+    }
+}
+
+namespace vkutils {
+    MemoryBudget device_local_budget(const Allocator& allocator) {
+        const VkPhysicalDeviceMemoryProperties* memoryProperties = nullptr;
+        vmaGetMemoryProperties(allocator.allocator, &memoryProperties);
+
+        std::vector<VmaBudget> budgets(memoryProperties->memoryHeapCount);
+        vmaGetHeapBudgets(allocator.allocator, budgets.data());
+
+        MemoryBudget ret{};
+        for (std::uint32_t heap = 0; heap < memoryProperties->memoryHeapCount; ++heap) {
+            if (memoryProperties->memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+                ret.usage += budgets[heap].usage;
+                ret.budget += budgets[heap].budget;
+            }
+        }
+
+        return ret;
+    }
+}
+
+namespace {
+    std::uint32_t find_pool_memory_type(const VmaAllocator allocator, const vkutils::MemoryClass memoryClass) {
+        // Same parameters as the resources of the class, see create_buffer() and create_image() callers
+        std::uint32_t memoryTypeIndex = UINT32_MAX;
+        VkResult res = VK_ERROR_FEATURE_NOT_PRESENT;
+
+        switch (memoryClass) {
+            case vkutils::MemoryClass::Geometry: {
+                constexpr VkBufferCreateInfo bufferInfo{
+                    .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                    .size = 65536,
+                    .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                             VK_BUFFER_USAGE_TRANSFER_DST_BIT
+                };
+                constexpr VmaAllocationCreateInfo allocInfo{
+                    .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE
+                };
+                res = vmaFindMemoryTypeIndexForBufferInfo(allocator, &bufferInfo, &allocInfo, &memoryTypeIndex);
+                break;
+            }
+            case vkutils::MemoryClass::Staging: {
+                constexpr VkBufferCreateInfo bufferInfo{
+                    .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                    .size = 65536,
+                    .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+                };
+                constexpr VmaAllocationCreateInfo allocInfo{
+                    .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+                    .usage = VMA_MEMORY_USAGE_AUTO
+                };
+                res = vmaFindMemoryTypeIndexForBufferInfo(allocator, &bufferInfo, &allocInfo, &memoryTypeIndex);
+                break;
+            }
+            case vkutils::MemoryClass::Texture:
+            case vkutils::MemoryClass::RenderTarget: {
+                const VkImageUsageFlags usage = vkutils::MemoryClass::Texture == memoryClass
+                                                    ? VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                                                      VK_IMAGE_USAGE_TRANSFER_DST_BIT
+                                                    : VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+                const VkImageCreateInfo imageInfo{
+                    .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                    .imageType = VK_IMAGE_TYPE_2D,
+                    .format = VK_FORMAT_R8G8B8A8_UNORM,
+                    .extent = VkExtent3D{1024, 1024, 1},
+                    .mipLevels = 1,
+                    .arrayLayers = 1,
+                    .samples = VK_SAMPLE_COUNT_1_BIT,
+                    .tiling = VK_IMAGE_TILING_OPTIMAL,
+                    .usage = usage,
+                    .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+                    .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+                };
+                constexpr VmaAllocationCreateInfo allocInfo{
+                    .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE
+                };
+                res = vmaFindMemoryTypeIndexForImageInfo(allocator, &imageInfo, &allocInfo, &memoryTypeIndex);
+                break;
+            }
+            default:
+                break;
+        }
+
+        return VK_SUCCESS == res ? memoryTypeIndex : UINT32_MAX;
     }
 }
@@ -1,11 +1,26 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
+
 #include <volk/volk.h>
 #include <vk_mem_alloc.h>
 
 #include "vulkan_context.hpp"
 
 namespace vkutils {
+    // Resources are allocated from one pool per class, so that the long-lived ones are not scattered between the
+    // short-lived ones of another class, and so that each class can be defragmented on its own
+    enum class MemoryClass : std::uint32_t {
+        Uniform,      // Uniform buffers and other small resources. Default VMA pools.
+        Geometry,     // Vertex and index buffers
+        Texture,
+        RenderTarget, // Attachments, recreated with the swapchain
+        Staging,      // Host visible upload buffers
+
+        Count
+    };
+
     class Allocator {
     public:
         Allocator() noexcept, ~Allocator();
@@ -20,8 +35,25 @@ namespace vkutils {
 
         Allocator& operator =(Allocator&&) noexcept;
 
+        // Pool of memoryClass, if it holds memoryTypeIndex, the type VMA picks for the resource on its own.
+        // VK_NULL_HANDLE otherwise, or for MemoryClass::Uniform: the resource is allocated from the default pools.
+        VmaPool pool(MemoryClass memoryClass, std::uint32_t memoryTypeIndex) const;
+
         VmaAllocator allocator = VK_NULL_HANDLE;
+
+        static constexpr auto poolCount = static_cast<std::size_t>(MemoryClass::Count);
+        std::array<VmaPool, poolCount> pools{};
+        std::array<std::uint32_t, poolCount> poolMemoryTypes{};
     };
 
     Allocator create_allocator(const VulkanContext&);
+
+    // Device local memory of the process, summed over all device local heaps
+    struct MemoryBudget {
+        VkDeviceSize usage;  // Bytes allocated by the process, including other allocators when known
+        VkDeviceSize budget; // Bytes the process may allocate before running into trouble
+    };
+
+    // Queried from the driver with VK_EXT_memory_budget, estimated by VMA otherwise
+    MemoryBudget device_local_budget(const Allocator&);
 }
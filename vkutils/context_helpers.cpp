@@ -1,6 +1,7 @@
 #include "context_helpers.hxx"
 
 #include "error.hpp"
+#include "memory_report.hpp"
 #include "to_string.hpp"
 
 namespace vkutils::detail {
@@ -96,8 +97,10 @@ namespace vkutils::detail {
             instanceInfo.pNext = &debugInfo;
         }
 
+        const VkAllocationCallbacks* callbacks = vkutils::host_allocation_callbacks(vkutils::HostSubsystem::VulkanDriver);
+
         VkInstance instance;
-        if (const auto res = vkCreateInstance(&instanceInfo, nullptr, &instance);
+        if (const auto res = vkCreateInstance(&instanceInfo, callbacks, &instance);
             VK_SUCCESS != res) {
             throw vkutils::Error("Unable to create Vulkan instance\n"
                                  "vkCreateInstance() returned %s", vkutils::to_string(res).c_str()
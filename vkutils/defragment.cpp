@@ -0,0 +1,263 @@
+#include "defragment.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "error.hpp"
+#include "memory_report.hpp"
+#include "to_string.hpp"
+#include "vkutil.hpp"
+
+namespace {
+    // Copies every level of source into destination, and leaves both in SHADER READ ONLY OPTIMAL
+    void record_image_copy(VkCommandBuffer commandBuffer, const VkImageCreateInfo& info,
+                           VkImage source, VkImage destination);
+
+    void submit_and_wait(const vkutils::VulkanContext& context, VkCommandBuffer commandBuffer);
+}
+
+namespace vkutils {
+    DefragmentationStats defragment(const VulkanContext& context,
+                                    const Allocator& allocator,
+                                    const MemoryClass memoryClass,
+                                    const std::span<Image* const> images,
+                                    const VkCommandPool commandPool) {
+        const VmaPool pool = allocator.pools[static_cast<std::size_t>(memoryClass)];
+        if (VK_NULL_HANDLE == pool) {
+            return {};
+        }
+
+        // Images of the pool were created by VMA, with its callbacks
+        const VkAllocationCallbacks* callbacks = host_allocation_callbacks(HostSubsystem::Vma);
+
+        constexpr VkImageUsageFlags copyUsage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+        std::unordered_map<VmaAllocation, Image*> movable;
+        for (auto* image : images) {
+            if (VK_NULL_HANDLE != image->image && copyUsage == (image->info.usage & copyUsage)) {
+                movable.emplace(image->allocation, image);
+            }
+        }
+
+        const VmaDefragmentationInfo defragmentationInfo{
+            .flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT,
+            .pool = pool
+        };
+
+        VmaDefragmentationContext defragmentation = VK_NULL_HANDLE;
+        if (const auto res = vmaBeginDefragmentation(allocator.allocator, &defragmentationInfo, &defragmentation);
+            VK_SUCCESS != res) {
+            throw Error("Unable to begin defragmentation\n"
+                        "vmaBeginDefragmentation() returned %s", to_string(res).c_str()
+            );
+        }
+
+        std::uint32_t imagesMoved = 0;
+
+        // Each pass moves a set of allocations chosen by VMA. Moves that cannot be performed are ignored.
+        for (;;) {
+            VmaDefragmentationPassMoveInfo pass{};
+            if (const auto res = vmaBeginDefragmentationPass(allocator.allocator, defragmentation, &pass);
+                VK_SUCCESS == res) {
+                break;
+            } else if (VK_INCOMPLETE != res) {
+                vmaEndDefragmentation(allocator.allocator, defragmentation, nullptr);
+                throw Error("Unable to begin defragmentation pass\n"
+                            "vmaBeginDefragmentationPass() returned %s", to_string(res).c_str()
+                );
+            }
+
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+
+            // Recreated images, bound to the destination of their move
+            std::vector<std::pair<Image*, VkImage>> moved;
+
+            try {
+                commandBuffer = alloc_command_buffer(context, commandPool);
+
+                constexpr VkCommandBufferBeginInfo beginInfo{
+                    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                    .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+                };
+
+                if (const auto res = vkBeginCommandBuffer(commandBuffer, &beginInfo); VK_SUCCESS != res) {
+                    throw Error("Beginning command buffer recording\n"
+                                "vkBeginCommandBuffer() returned %s", to_string(res).c_str()
+                    );
+                }
+
+                for (std::uint32_t i = 0; i < pass.moveCount; ++i) {
+                    auto& move = pass.pMoves[i];
+
+                    const auto it = movable.find(move.srcAllocation);
+                    if (movable.end() == it) {
+                        move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+                        continue;
+                    }
+
+                    Image* image = it->second;
+
+                    VkImage destination = VK_NULL_HANDLE;
+                    if (const auto res = vkCreateImage(context.device, &image->info, callbacks, &destination);
+                        VK_SUCCESS != res) {
+                        throw Error("Unable to create image\n"
+                                    "vkCreateImage() returned %s", to_string(res).c_str()
+                        );
+                    }
+
+                    if (const auto res = vmaBindImageMemory(allocator.allocator, move.dstTmpAllocation, destination);
+                        VK_SUCCESS != res) {
+                        vkDestroyImage(context.device, destination, callbacks);
+                        throw Error("Unable to bind image memory\n"
+                                    "vmaBindImageMemory() returned %s", to_string(res).c_str()
+                        );
+                    }
+
+                    record_image_copy(commandBuffer, image->info, image->image, destination);
+                    moved.emplace_back(image, destination);
+                }
+
+                if (const auto res = vkEndCommandBuffer(commandBuffer); VK_SUCCESS != res) {
+                    throw Error("Ending command buffer recording\n"
+                                "vkEndCommandBuffer() returned %s", to_string(res).c_str()
+                    );
+                }
+
+                submit_and_wait(context, commandBuffer);
+            } catch (...) {
+                // No image has moved: the sources keep their allocation, and the temporary destinations are released
+                for (const auto& [image, destination] : moved) {
+                    vkDestroyImage(context.device, destination, callbacks);
+                }
+
+                if (VK_NULL_HANDLE != commandBuffer) {
+                    vkFreeCommandBuffers(context.device, commandPool, 1, &commandBuffer);
+                }
+
+                for (std::uint32_t i = 0; i < pass.moveCount; ++i) {
+                    pass.pMoves[i].operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+                }
+
+                vmaEndDefragmentationPass(allocator.allocator, defragmentation, &pass);
+                vmaEndDefragmentation(allocator.allocator, defragmentation, nullptr);
+                throw;
+            }
+
+            vkFreeCommandBuffers(context.device, commandPool, 1, &commandBuffer);
+
+            // The allocations keep their handle, and point to the new place once the pass ends
+            for (const auto& [image, destination] : moved) {
+                vkDestroyImage(context.device, image->image, callbacks);
+                image->image = destination;
+            }
+
+            imagesMoved += static_cast<std::uint32_t>(moved.size());
+
+            if (VK_SUCCESS == vmaEndDefragmentationPass(allocator.allocator, defragmentation, &pass)) {
+                break;
+            }
+        }
+
+        VmaDefragmentationStats stats{};
+        vmaEndDefragmentation(allocator.allocator, defragmentation, &stats);
+
+        return DefragmentationStats{
+            .bytesMoved = stats.bytesMoved,
+            .bytesFreed = stats.bytesFreed,
+            .imagesMoved = imagesMoved
+        };
+    }
+}
+
+namespace {
+    void record_image_copy(const VkCommandBuffer commandBuffer, const VkImageCreateInfo& info,
+                           const VkImage source, const VkImage destination) {
+        const VkImageSubresourceRange range{
+            VK_IMAGE_ASPECT_COLOR_BIT,
+            0, info.mipLevels,
+            0, info.arrayLayers
+        };
+
+        vkutils::image_barrier(commandBuffer, source,
+                               VK_ACCESS_SHADER_READ_BIT,
+                               VK_ACCESS_TRANSFER_READ_BIT,
+                               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                               VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                               VK_PIPELINE_STAGE_TRANSFER_BIT,
+                               range
+        );
+        vkutils::image_barrier(commandBuffer, destination,
+                               0,
+                               VK_ACCESS_TRANSFER_WRITE_BIT,
+                               VK_IMAGE_LAYOUT_UNDEFINED,
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                               VK_PIPELINE_STAGE_TRANSFER_BIT,
+                               range
+        );
+
+        // Whole levels, which is valid for block compressed formats as well
+        std::vector<VkImageCopy> copies;
+        for (std::uint32_t level = 0; level < info.mipLevels; ++level) {
+            const VkImageSubresourceLayers subresource{
+                VK_IMAGE_ASPECT_COLOR_BIT,
+                level,
+                0, info.arrayLayers
+            };
+
+            copies.emplace_back(VkImageCopy{
+                .srcSubresource = subresource,
+                .dstSubresource = subresource,
+                .extent = VkExtent3D{
+                    .width = std::max(1u, info.extent.width >> level),
+                    .height = std::max(1u, info.extent.height >> level),
+                    .depth = std::max(1u, info.extent.depth >> level)
+                }
+            });
+        }
+
+        vkCmdCopyImage(commandBuffer,
+                       source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       destination, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       static_cast<std::uint32_t>(copies.size()), copies.data()
+        );
+
+        vkutils::image_barrier(commandBuffer, destination,
+                               VK_ACCESS_TRANSFER_WRITE_BIT,
+                               VK_ACCESS_SHADER_READ_BIT,
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                               VK_PIPELINE_STAGE_TRANSFER_BIT,
+                               VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                               range
+        );
+    }
+
+    void submit_and_wait(const vkutils::VulkanContext& context, const VkCommandBuffer commandBuffer) {
+        const vkutils::Fence done = vkutils::create_fence(context);
+
+        const VkSubmitInfo submitInfo{
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &commandBuffer
+        };
+
+        if (const auto res = vkQueueSubmit(context.graphicsQueue, 1, &submitInfo, done.handle);
+            VK_SUCCESS != res) {
+            throw vkutils::Error("Submitting commands\n"
+                                 "vkQueueSubmit() returned %s", vkutils::to_string(res).c_str()
+            );
+        }
+
+        if (const auto res = vkWaitForFences(context.device, 1, &done.handle, VK_TRUE,
+                                             std::numeric_limits<std::uint64_t>::max()); VK_SUCCESS != res) {
+            throw vkutils::Error("Waiting for defragmentation copies\n"
+                                 "vkWaitForFences() returned %s", vkutils::to_string(res).c_str()
+            );
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+#include <volk/volk.h>
+
+#include "allocator.hpp"
+#include "vkimage.hpp"
+#include "vulkan_context.hpp"
+
+namespace vkutils {
+    struct DefragmentationStats {
+        VkDeviceSize bytesMoved;
+        VkDeviceSize bytesFreed; // Memory blocks released to the driver
+        std::uint32_t imagesMoved;
+    };
+
+    // Compacts the pool of memoryClass: images are moved into the holes left by freed allocations, and the memory
+    // blocks that end up empty are released.
+    // Only the given images are moved, other allocations of the pool stay in place. A moved image gets a new VkImage,
+    // so its views must be recreated. Images need VK_IMAGE_USAGE_TRANSFER_SRC_BIT and VK_IMAGE_USAGE_TRANSFER_DST_BIT
+    // to be moved.
+    // All levels of the images must be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, and not in use by the GPU. The
+    // copies are submitted to the graphics queue, from commandPool; blocks until they are complete.
+    DefragmentationStats defragment(const VulkanContext& context,
+                                    const Allocator& allocator,
+                                    MemoryClass memoryClass,
+                                    std::span<Image* const> images,
+                                    VkCommandPool commandPool);
+}
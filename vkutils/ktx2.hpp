@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+
+namespace vkutils::ktx2 {
+    /*
+     * On-disk layout of the KTX 2.0 subset shared by assets-bake (writer) and
+     * vksuntemple (reader). See
+     * https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html
+     *
+     * Only single layer, single face 2D textures are used. The file starts with
+     * Header, followed by one LevelIndex entry per mip level (level 0 first)
+     * and the data format descriptor (DFD). Level data is stored smallest level
+     * first, each level aligned to lcm(texel block size, 4) bytes. Levels are
+     * never supercompressed.
+     */
+    constexpr std::uint8_t kIdentifier[12] = {
+        0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A // «KTX 20»\r\n\x1A\n
+    };
+
+    enum SupercompressionScheme : std::uint32_t {
+        SUPERCOMPRESSION_NONE = 0
+    };
+
+    struct Header {
+        std::uint8_t identifier[12];
+        std::uint32_t vkFormat;
+        std::uint32_t typeSize;
+        std::uint32_t pixelWidth;
+        std::uint32_t pixelHeight;
+        std::uint32_t pixelDepth;
+        std::uint32_t layerCount;
+        std::uint32_t faceCount;
+        std::uint32_t levelCount;
+        std::uint32_t supercompressionScheme;
+
+        // Index
+        std::uint32_t dfdByteOffset;
+        std::uint32_t dfdByteLength;
+        std::uint32_t kvdByteOffset;
+        std::uint32_t kvdByteLength;
+        std::uint64_t sgdByteOffset;
+        std::uint64_t sgdByteLength;
+    };
+
+    static_assert(sizeof(Header) == 80, "KTX2 header must be 80 bytes; level index starts at offset 80");
+
+    struct LevelIndex {
+        std::uint64_t byteOffset;
+        std::uint64_t byteLength;
+        std::uint64_t uncompressedByteLength;
+    };
+
+    static_assert(sizeof(LevelIndex) == 24, "KTX2 level index entries must be 24 bytes");
+
+    /*
+     * Basic descriptor block of the DFD, see
+     * https://registry.khronos.org/DataFormat/specs/1.3/dataformat.1.3.html
+     *
+     * The DFD is its total size in bytes (std::uint32_t, itself included),
+     * followed by a DfdBasicBlock and one DfdSample per channel. Only the
+     * values describing the BCn formats of assets-bake are listed.
+     */
+    enum DfdColorModel : std::uint8_t {
+        DF_MODEL_BC1A = 128,
+        DF_MODEL_BC4 = 131,
+        DF_MODEL_BC5 = 132,
+        DF_MODEL_BC7 = 134
+    };
+
+    enum DfdTransferFunction : std::uint8_t {
+        DF_TRANSFER_LINEAR = 1,
+        DF_TRANSFER_SRGB = 2
+    };
+
+    constexpr std::uint8_t DF_PRIMARIES_BT709 = 1;
+    constexpr std::uint16_t DF_VERSION_1_3 = 2;
+
+    // Sample channels of the BCn colour models; BC1A_COLOR, BC4_DATA and BC7_COLOR are all 0
+    constexpr std::uint8_t DF_CHANNEL_BC_COLOR = 0;
+    constexpr std::uint8_t DF_CHANNEL_BC5_RED = 0;
+    constexpr std::uint8_t DF_CHANNEL_BC5_GREEN = 1;
+
+    struct DfdBasicBlock {
+        std::uint32_t vendorIdAndType; // vendorId (17 bits) and descriptorType (15 bits), both 0 for Khronos basic
+        std::uint16_t versionNumber;
+        std::uint16_t descriptorBlockSize;
+        std::uint8_t colorModel;
+        std::uint8_t colorPrimaries;
+        std::uint8_t transferFunction;
+        std::uint8_t flags;
+        std::uint8_t texelBlockDimension[4]; // Minus one
+        std::uint8_t bytesPlane[8];
+    };
+
+    static_assert(sizeof(DfdBasicBlock) == 24, "DFD basic blocks must be 24 bytes before their samples");
+
+    struct DfdSample {
+        std::uint16_t bitOffset;
+        std::uint8_t bitLength;   // Minus one
+        std::uint8_t channelType; // Channel in the low 4 bits, qualifiers in the high 4 bits
+        std::uint8_t samplePosition[4];
+        std::uint32_t sampleLower;
+        std::uint32_t sampleUpper;
+    };
+
+    static_assert(sizeof(DfdSample) == 16, "DFD samples must be 16 bytes");
+}
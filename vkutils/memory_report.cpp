@@ -0,0 +1,281 @@
+#include "memory_report.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include "error.hpp"
+
+namespace {
+    struct Usage {
+        std::atomic<std::int64_t> bytes = 0;
+        std::atomic<std::int64_t> allocations = 0;
+        std::atomic<std::int64_t> peakBytes = 0;
+    };
+
+    constexpr auto hostSubsystemCount = static_cast<std::size_t>(vkutils::HostSubsystem::Count);
+    constexpr auto memoryClassCount = static_cast<std::size_t>(vkutils::MemoryClass::Count);
+
+    std::array<Usage, hostSubsystemCount> hostUsage;
+    std::array<Usage, memoryClassCount> deviceUsage;
+
+    constinit thread_local vkutils::HostSubsystem currentSubsystem = vkutils::HostSubsystem::Other;
+
+    // Both negative for frees
+    void record(Usage& usage, std::ptrdiff_t size, std::int64_t allocations);
+
+    const char* name_of(vkutils::HostSubsystem subsystem);
+
+    const char* name_of(vkutils::MemoryClass memoryClass);
+
+    // VkAllocationCallbacks functions. pUserData points to the HostSubsystem the allocations are counted under.
+    void* VKAPI_PTR allocate_memory(void* userData, std::size_t size, std::size_t alignment,
+                                    VkSystemAllocationScope);
+
+    void* VKAPI_PTR reallocate_memory(void* userData, void* original, std::size_t size, std::size_t alignment,
+                                      VkSystemAllocationScope scope);
+
+    void VKAPI_PTR free_memory(void* userData, void* memory);
+
+    void VKAPI_PTR internal_allocation(void* userData, std::size_t size, VkInternalAllocationType,
+                                       VkSystemAllocationScope);
+
+    void VKAPI_PTR internal_free(void* userData, std::size_t size, VkInternalAllocationType,
+                                 VkSystemAllocationScope);
+
+    std::array<vkutils::HostSubsystem, hostSubsystemCount> callbackSubsystems = [] {
+        std::array<vkutils::HostSubsystem, hostSubsystemCount> ret{};
+        for (std::size_t i = 0; i < hostSubsystemCount; ++i) {
+            ret[i] = static_cast<vkutils::HostSubsystem>(i);
+        }
+        return ret;
+    }();
+
+    std::array<VkAllocationCallbacks, hostSubsystemCount> callbacks = [] {
+        std::array<VkAllocationCallbacks, hostSubsystemCount> ret{};
+        for (std::size_t i = 0; i < hostSubsystemCount; ++i) {
+            ret[i] = VkAllocationCallbacks{
+                .pUserData = &callbackSubsystems[i],
+                .pfnAllocation = allocate_memory,
+                .pfnReallocation = reallocate_memory,
+                .pfnFree = free_memory,
+                .pfnInternalAllocation = internal_allocation,
+                .pfnInternalFree = internal_free
+            };
+        }
+        return ret;
+    }();
+}
+
+namespace vkutils {
+    HostMemoryScope::HostMemoryScope(const HostSubsystem subsystem)
+        : mPrevious(std::exchange(currentSubsystem, subsystem)) {
+    }
+
+    HostMemoryScope::~HostMemoryScope() {
+        currentSubsystem = mPrevious;
+    }
+
+    HostSubsystem current_host_subsystem() {
+        return currentSubsystem;
+    }
+
+    void record_host_allocation(const HostSubsystem subsystem, const std::size_t size) {
+        record(hostUsage[static_cast<std::size_t>(subsystem)], static_cast<std::ptrdiff_t>(size), 1);
+    }
+
+    void record_host_free(const HostSubsystem subsystem, const std::size_t size) {
+        record(hostUsage[static_cast<std::size_t>(subsystem)], -static_cast<std::ptrdiff_t>(size), -1);
+    }
+
+    const VkAllocationCallbacks* host_allocation_callbacks(const HostSubsystem subsystem) {
+        return &callbacks[static_cast<std::size_t>(subsystem)];
+    }
+
+    void track_allocation(const VmaAllocator allocator, const VmaAllocation allocation, const MemoryClass memoryClass) {
+        // The class is kept in the user data, off by one so that untracked allocations are told apart
+        vmaSetAllocationUserData(allocator, allocation,
+                                 reinterpret_cast<void*>(static_cast<std::uintptr_t>(memoryClass) + 1));
+        vmaSetAllocationName(allocator, allocation, name_of(memoryClass));
+
+        VmaAllocationInfo allocationInfo{};
+        vmaGetAllocationInfo(allocator, allocation, &allocationInfo);
+        record(deviceUsage[static_cast<std::size_t>(memoryClass)], static_cast<std::ptrdiff_t>(allocationInfo.size), 1);
+    }
+
+    void untrack_allocation(const VmaAllocator allocator, const VmaAllocation allocation) {
+        VmaAllocationInfo allocationInfo{};
+        vmaGetAllocationInfo(allocator, allocation, &allocationInfo);
+
+        if (const auto tag = reinterpret_cast<std::uintptr_t>(allocationInfo.pUserData); 0 != tag) {
+            record(deviceUsage[tag - 1], -static_cast<std::ptrdiff_t>(allocationInfo.size), -1);
+        }
+    }
+
+    void write_memory_report(const Allocator& allocator, const char* basePath) {
+        const std::string jsonPath = std::string(basePath) + ".json";
+        const std::string csvPath = std::string(basePath) + ".csv";
+
+        std::FILE* json = std::fopen(jsonPath.c_str(), "w");
+        if (!json) {
+            throw Error("Unable to open %s for writing", jsonPath.c_str());
+        }
+
+        std::FILE* csv = std::fopen(csvPath.c_str(), "w");
+        if (!csv) {
+            std::fclose(json);
+            throw Error("Unable to open %s for writing", csvPath.c_str());
+        }
+
+        const auto write = [&](const char* section, const char* category, const Usage& usage, const bool last) {
+            const auto bytes = usage.bytes.load(std::memory_order_relaxed);
+            const auto allocations = usage.allocations.load(std::memory_order_relaxed);
+            const auto peakBytes = usage.peakBytes.load(std::memory_order_relaxed);
+
+            std::fprintf(json, "    \"%s\": {\"bytes\": %lld, \"allocations\": %lld, \"peakBytes\": %lld}%s\n",
+                         category, static_cast<long long>(bytes), static_cast<long long>(allocations),
+                         static_cast<long long>(peakBytes), last ? "" : ",");
+            std::fprintf(csv, "%s,%s,%lld,%lld,%lld\n", section, category, static_cast<long long>(bytes),
+                         static_cast<long long>(allocations), static_cast<long long>(peakBytes));
+        };
+
+        std::fprintf(csv, "section,category,bytes,allocations,peak_bytes\n");
+
+        std::fprintf(json, "{\n  \"device\": {\n");
+        for (std::size_t i = 0; i < memoryClassCount; ++i) {
+            write("device", name_of(static_cast<MemoryClass>(i)), deviceUsage[i], i + 1 == memoryClassCount);
+        }
+
+        std::fprintf(json, "  },\n  \"host\": {\n");
+        for (std::size_t i = 0; i < hostSubsystemCount; ++i) {
+            write("host", name_of(static_cast<HostSubsystem>(i)), hostUsage[i], i + 1 == hostSubsystemCount);
+        }
+
+        const auto budget = device_local_budget(allocator);
+        std::fprintf(json, "  },\n  \"deviceLocalBudget\": {\"usage\": %llu, \"budget\": %llu},\n",
+                     static_cast<unsigned long long>(budget.usage), static_cast<unsigned long long>(budget.budget));
+
+        // Already JSON, including the individual allocations and their names
+        char* vmaStats = nullptr;
+        vmaBuildStatsString(allocator.allocator, &vmaStats, VK_TRUE);
+        std::fprintf(json, "  \"vma\": %s\n}\n", vmaStats);
+        vmaFreeStatsString(allocator.allocator, vmaStats);
+
+        std::fclose(csv);
+        std::fclose(json);
+    }
+}
+
+namespace {
+    void record(Usage& usage, const std::ptrdiff_t size, const std::int64_t allocations) {
+        const auto bytes = usage.bytes.fetch_add(size, std::memory_order_relaxed) + size;
+        usage.allocations.fetch_add(allocations, std::memory_order_relaxed);
+
+        auto peak = usage.peakBytes.load(std::memory_order_relaxed);
+        while (bytes > peak && !usage.peakBytes.compare_exchange_weak(peak, bytes, std::memory_order_relaxed)) {
+        }
+    }
+
+    const char* name_of(const vkutils::HostSubsystem subsystem) {
+        switch (subsystem) {
+            case vkutils::HostSubsystem::VulkanDriver:
+                return "vulkan_driver";
+            case vkutils::HostSubsystem::Vma:
+                return "vma";
+            case vkutils::HostSubsystem::AssetLoading:
+                return "asset_loading";
+            case vkutils::HostSubsystem::Streaming:
+                return "streaming";
+            default:
+                return "other";
+        }
+    }
+
+    const char* name_of(const vkutils::MemoryClass memoryClass) {
+        switch (memoryClass) {
+            case vkutils::MemoryClass::Uniform:
+                return "uniform";
+            case vkutils::MemoryClass::Geometry:
+                return "geometry";
+            case vkutils::MemoryClass::Texture:
+                return "texture";
+            case vkutils::MemoryClass::RenderTarget:
+                return "render_target";
+            case vkutils::MemoryClass::Staging:
+                return "staging";
+            default:
+                return "unknown";
+        }
+    }
+
+    // Precedes every block returned by allocate_memory()
+    struct alignas(std::max_align_t) CallbackHeader {
+        void* block;
+        std::size_t size;
+    };
+
+    void* VKAPI_PTR allocate_memory(void* userData, const std::size_t size, std::size_t alignment,
+                                    VkSystemAllocationScope) {
+        alignment = std::max(alignment, alignof(CallbackHeader));
+
+        auto* block = static_cast<std::byte*>(std::malloc(size + alignment + sizeof(CallbackHeader)));
+        if (!block) {
+            return nullptr;
+        }
+
+        auto address = reinterpret_cast<std::uintptr_t>(block + sizeof(CallbackHeader));
+        address = (address + alignment - 1) & ~(alignment - 1);
+
+        auto* header = reinterpret_cast<CallbackHeader*>(address) - 1;
+        header->block = block;
+        header->size = size;
+
+        vkutils::record_host_allocation(*static_cast<vkutils::HostSubsystem*>(userData), size);
+        return reinterpret_cast<void*>(address);
+    }
+
+    void* VKAPI_PTR reallocate_memory(void* userData, void* original, const std::size_t size,
+                                      const std::size_t alignment, const VkSystemAllocationScope scope) {
+        if (!original) {
+            return allocate_memory(userData, size, alignment, scope);
+        }
+
+        if (0 == size) {
+            free_memory(userData, original);
+            return nullptr;
+        }
+
+        void* memory = allocate_memory(userData, size, alignment, scope);
+        if (memory) {
+            std::memcpy(memory, original, std::min(size, (static_cast<CallbackHeader*>(original) - 1)->size));
+            free_memory(userData, original);
+        }
+
+        return memory;
+    }
+
+    void VKAPI_PTR free_memory(void* userData, void* memory) {
+        if (!memory) {
+            return;
+        }
+
+        const auto* header = static_cast<CallbackHeader*>(memory) - 1;
+        vkutils::record_host_free(*static_cast<vkutils::HostSubsystem*>(userData), header->size);
+        std::free(header->block);
+    }
+
+    void VKAPI_PTR internal_allocation(void* userData, const std::size_t size, VkInternalAllocationType,
+                                       VkSystemAllocationScope) {
+        vkutils::record_host_allocation(*static_cast<vkutils::HostSubsystem*>(userData), size);
+    }
+
+    void VKAPI_PTR internal_free(void* userData, const std::size_t size, VkInternalAllocationType,
+                                 VkSystemAllocationScope) {
+        vkutils::record_host_free(*static_cast<vkutils::HostSubsystem*>(userData), size);
+    }
+}
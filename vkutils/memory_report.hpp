@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <volk/volk.h>
+#include <vk_mem_alloc.h>
+
+#include "allocator.hpp"
+
+namespace vkutils {
+    // Parts of the program host allocations are attributed to
+    enum class HostSubsystem : std::uint32_t {
+        Other,
+        VulkanDriver, // Instance and device, through host_allocation_callbacks()
+        Vma,          // VMA itself, and the Vulkan objects it creates
+        AssetLoading, // Reading and decoding the model and textures
+        Streaming,    // Uploads and residency, on the render thread
+
+        Count
+    };
+
+    // Attributes the operator new allocations of the current thread to subsystem until destroyed. Scopes nest.
+    class HostMemoryScope {
+    public:
+        explicit HostMemoryScope(HostSubsystem subsystem);
+
+        ~HostMemoryScope();
+
+        HostMemoryScope(const HostMemoryScope&) = delete;
+
+        HostMemoryScope& operator=(const HostMemoryScope&) = delete;
+
+    private:
+        HostSubsystem mPrevious;
+    };
+
+    HostSubsystem current_host_subsystem();
+
+    // Count the allocations of subsystem. Called by the operator new and delete of the program.
+    void record_host_allocation(HostSubsystem subsystem, std::size_t size);
+
+    void record_host_free(HostSubsystem subsystem, std::size_t size);
+
+    // Callbacks counting the allocations made through them under subsystem. Objects must be destroyed with the
+    // callbacks they were created with.
+    const VkAllocationCallbacks* host_allocation_callbacks(HostSubsystem subsystem);
+
+    // Tags allocation with memoryClass, in the report and in the statistics of VMA (as its name)
+    void track_allocation(VmaAllocator allocator, VmaAllocation allocation, MemoryClass memoryClass);
+
+    // Called before freeing allocation. No-op for allocations that were not tracked.
+    void untrack_allocation(VmaAllocator allocator, VmaAllocation allocation);
+
+    // Writes the device memory by class and the host memory by subsystem, both as <basePath>.json, along with the
+    // detailed statistics of VMA, and as <basePath>.csv
+    void write_memory_report(const Allocator& allocator, const char* basePath);
+}
@@ -0,0 +1,186 @@
+#include "staging_ring.hpp"
+
+#include <limits>
+#include <cassert>
+
+#include "error.hpp"
+#include "to_string.hpp"
+#include "vkutil.hpp"
+
+namespace {
+    VkDeviceSize align_up(VkDeviceSize offset, VkDeviceSize alignment);
+}
+
+namespace vkutils {
+    StagingRing::StagingRing(const VulkanContext& context, const Allocator& allocator, const VkDeviceSize size)
+        : mContext(context),
+          mAllocator(allocator),
+          mBuffer(create_buffer(allocator, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                                VMA_ALLOCATION_CREATE_MAPPED_BIT,
+                                VMA_MEMORY_USAGE_AUTO, {}, MemoryClass::Staging)),
+          mSize(size) {
+        VmaAllocationInfo allocationInfo{};
+        vmaGetAllocationInfo(mAllocator.allocator, mBuffer.allocation, &allocationInfo);
+        mMapped = static_cast<std::byte*>(allocationInfo.pMappedData);
+    }
+
+    StagingRing::~StagingRing() {
+        // The buffer may still be read by the GPU
+        std::vector<VkFence> fences;
+        for (const auto& region : mInFlight) {
+            fences.emplace_back(region.fence.handle);
+        }
+
+        if (!fences.empty()) {
+            vkWaitForFences(mContext.device, static_cast<std::uint32_t>(fences.size()), fences.data(), VK_TRUE,
+                            std::numeric_limits<std::uint64_t>::max());
+        }
+    }
+
+    VkBuffer StagingRing::buffer() const {
+        return mBuffer.buffer;
+    }
+
+    VkDeviceSize StagingRing::size() const {
+        return mSize;
+    }
+
+    std::optional<StagingRing::Block> StagingRing::allocate(const VkDeviceSize size, const VkDeviceSize alignment) {
+        if (size > mSize) {
+            throw Error("Staging %llu bytes, but the staging ring only holds %llu bytes",
+                        static_cast<unsigned long long>(size), static_cast<unsigned long long>(mSize)
+            );
+        }
+
+        // Positions within the buffer keep the alignment of the offsets
+        assert(0 == mSize % alignment);
+
+        for (;;) {
+            reclaim();
+
+            // Blocks are contiguous: skip the end of the buffer if the block does not fit there
+            auto start = align_up(mHead, alignment);
+            if (start % mSize + size > mSize) {
+                start = align_up(start, mSize);
+            }
+
+            if (start + size - mTail <= mSize) {
+                mHead = start + size;
+                return Block{
+                    .offset = start % mSize,
+                    .mapped = mMapped + start % mSize
+                };
+            }
+
+            if (mInFlight.empty()) {
+                return {};
+            }
+
+            wait_oldest();
+        }
+    }
+
+    StagingRing::Seal StagingRing::seal() {
+        // Staging memory may not be host coherent
+        const auto flush = [&](const VkDeviceSize offset, const VkDeviceSize size) {
+            if (const auto res = vmaFlushAllocation(mAllocator.allocator, mBuffer.allocation, offset, size);
+                VK_SUCCESS != res) {
+                throw Error("Flushing staging memory\n"
+                            "vmaFlushAllocation() returned %s", to_string(res).c_str()
+                );
+            }
+        };
+
+        const auto begin = mOpenBegin % mSize;
+        const auto size = mHead - mOpenBegin;
+        if (size >= mSize) {
+            flush(0, mSize);
+        } else if (begin + size > mSize) {
+            flush(begin, mSize - begin);
+            flush(0, begin + size - mSize);
+        } else if (size > 0) {
+            flush(begin, size);
+        }
+
+        Fence fence;
+        if (mFreeFences.empty()) {
+            fence = create_fence(mContext);
+        } else {
+            fence = std::move(mFreeFences.back());
+            mFreeFences.pop_back();
+        }
+
+        const Seal ret{
+            .ticket = ++mLastTicket,
+            .fence = fence.handle
+        };
+
+        mInFlight.emplace_back(Region{
+            .ticket = ret.ticket,
+            .fence = std::move(fence),
+            .end = mHead
+        });
+        mOpenBegin = mHead;
+
+        return ret;
+    }
+
+    bool StagingRing::is_complete(const std::uint64_t ticket) {
+        reclaim();
+        return ticket <= mCompletedTicket;
+    }
+
+    void StagingRing::wait(const std::uint64_t ticket) {
+        assert(ticket <= mLastTicket);
+
+        while (!is_complete(ticket)) {
+            wait_oldest();
+        }
+    }
+
+    void StagingRing::reclaim() {
+        while (!mInFlight.empty()) {
+            auto& region = mInFlight.front();
+
+            if (const auto res = vkGetFenceStatus(mContext.device, region.fence.handle); VK_NOT_READY == res) {
+                return;
+            } else if (VK_SUCCESS != res) {
+                throw Error("Querying staging fence\n"
+                            "vkGetFenceStatus() returned %s", to_string(res).c_str()
+                );
+            }
+
+            if (const auto res = vkResetFences(mContext.device, 1, &region.fence.handle); VK_SUCCESS != res) {
+                throw Error("Resetting staging fence\n"
+                            "vkResetFences() returned %s", to_string(res).c_str()
+                );
+            }
+
+            mTail = region.end;
+            mCompletedTicket = region.ticket;
+            mFreeFences.emplace_back(std::move(region.fence));
+            mInFlight.pop_front();
+        }
+    }
+
+    void StagingRing::wait_oldest() {
+        assert(!mInFlight.empty());
+
+        if (const auto res = vkWaitForFences(mContext.device, 1, &mInFlight.front().fence.handle, VK_TRUE,
+                                             std::numeric_limits<std::uint64_t>::max());
+            VK_SUCCESS != res) {
+            throw Error("Waiting for staging memory\n"
+                        "vkWaitForFences() returned %s", to_string(res).c_str()
+            );
+        }
+
+        reclaim();
+    }
+}
+
+namespace {
+    VkDeviceSize align_up(const VkDeviceSize offset, const VkDeviceSize alignment) {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+}
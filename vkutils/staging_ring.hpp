@@ -0,0 +1,100 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include <volk/volk.h>
+#include <vk_mem_alloc.h>
+
+#include "allocator.hpp"
+#include "vkbuffer.hpp"
+#include "vkobject.hpp"
+#include "vulkan_context.hpp"
+
+namespace vkutils {
+    /*
+     * Fixed size, persistently mapped staging buffer shared by all host to
+     * device uploads.
+     *
+     * Space is handed out front to back and wraps around at the end. Blocks
+     * handed out since the last seal() are open: they belong to the commands
+     * being recorded. seal() closes them and returns a fence, which the
+     * submission reading them must signal. Sealed space is reclaimed once its
+     * fence is signalled, so the staging memory in use never exceeds the size
+     * of the ring, however much data is uploaded.
+     *
+     * Only one user (see UploadBatch) may hold open blocks at a time.
+     */
+    class StagingRing {
+    public:
+        static constexpr VkDeviceSize DEFAULT_SIZE = 64 * 1024 * 1024;
+
+        struct Block {
+            VkDeviceSize offset; // Within buffer()
+            std::byte* mapped;
+        };
+
+        struct Seal {
+            std::uint64_t ticket;
+            VkFence fence;
+        };
+
+        StagingRing(const VulkanContext&, const Allocator&, VkDeviceSize size = DEFAULT_SIZE);
+
+        ~StagingRing();
+
+        StagingRing(const StagingRing&) = delete;
+
+        StagingRing& operator=(const StagingRing&) = delete;
+
+        VkBuffer buffer() const;
+
+        VkDeviceSize size() const;
+
+        // Waits for sealed blocks to be released as needed. Returns nothing if the space is held by open blocks only;
+        // these must be submitted first. Throws if size exceeds the ring.
+        std::optional<Block> allocate(VkDeviceSize size, VkDeviceSize alignment);
+
+        // Flushes the open blocks, and ties them to the returned fence. The fence must be passed to vkQueueSubmit().
+        Seal seal();
+
+        // Whether the submission of a seal() has completed
+        bool is_complete(std::uint64_t ticket);
+
+        void wait(std::uint64_t ticket);
+
+    private:
+        struct Region {
+            std::uint64_t ticket;
+            Fence fence;
+            VkDeviceSize end;
+        };
+
+        // Release regions whose fence is signalled
+        void reclaim();
+
+        void wait_oldest();
+
+        const VulkanContext& mContext;
+        const Allocator& mAllocator;
+
+        Buffer mBuffer;
+        std::byte* mMapped = nullptr;
+        VkDeviceSize mSize;
+
+        // Offsets only grow; the position within the buffer is offset % mSize
+        VkDeviceSize mHead = 0;      // End of the newest block
+        VkDeviceSize mOpenBegin = 0; // Start of the open blocks, end of the sealed ones
+
+        std::deque<Region> mInFlight;
+        VkDeviceSize mTail = 0; // Start of the oldest region in flight
+
+        std::vector<Fence> mFreeFences;
+
+        std::uint64_t mLastTicket = 0;
+        std::uint64_t mCompletedTicket = 0;
+    };
+}
@@ -130,8 +130,16 @@ namespace vkutils {
         switch (format) {
 #			define CASE_(x) case VK_##x: return #x
             CASE_(FORMAT_UNDEFINED);
+            CASE_(FORMAT_R8_UNORM);
+            CASE_(FORMAT_R8G8_UNORM);
+            CASE_(FORMAT_R8G8B8A8_UNORM);
             CASE_(FORMAT_R8G8B8A8_SRGB);
             CASE_(FORMAT_B8G8R8A8_SRGB);
+            CASE_(FORMAT_BC1_RGB_SRGB_BLOCK);
+            CASE_(FORMAT_BC4_UNORM_BLOCK);
+            CASE_(FORMAT_BC5_UNORM_BLOCK);
+            CASE_(FORMAT_BC7_SRGB_BLOCK);
+            CASE_(FORMAT_BC7_UNORM_BLOCK);
 #			undef CASE_
 
             case VK_FORMAT_MAX_ENUM: break;
@@ -0,0 +1,367 @@
+#include "upload_batch.hpp"
+
+#include <limits>
+#include <cstring>
+#include <algorithm>
+
+#include "error.hpp"
+#include "to_string.hpp"
+#include "vkutil.hpp"
+
+namespace {
+    // Alignment of every upload within the staging ring. Covers the texel block size of all formats used by the images,
+    // as required by vkCmdCopyBufferToImage(), and keeps memcpy() on aligned addresses.
+    constexpr VkDeviceSize kStagingAlignment = 16;
+
+    VkCommandBuffer begin_commands(const vkutils::VulkanContext& context, const vkutils::CommandPool& pool);
+
+    void end_commands(VkCommandBuffer);
+}
+
+namespace vkutils {
+    std::vector<std::uint32_t> upload_queue_families(const VulkanContext& context) {
+        if (context.has_dedicated_transfer_queue()) {
+            return {context.graphicsFamilyIndex, context.transferFamilyIndex};
+        }
+
+        return {context.graphicsFamilyIndex};
+    }
+
+    UploadBatch::UploadBatch(const VulkanContext& context,
+                             StagingRing& ring,
+                             const VkPipelineStageFlags dstStageMask,
+                             const VkAccessFlags dstAccessMask)
+        : mContext(context),
+          mRing(ring),
+          mDstStageMask(dstStageMask),
+          mDstAccessMask(dstAccessMask),
+          mTransferPool(create_command_pool(context, context.transferFamilyIndex,
+                                            VK_COMMAND_POOL_CREATE_TRANSIENT_BIT)) {
+        if (context.has_dedicated_transfer_queue()) {
+            mGraphicsPool = create_command_pool(context, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+        }
+    }
+
+    UploadBatch::~UploadBatch() {
+        // Command buffers and semaphores may still be in use
+        wait();
+    }
+
+    void UploadBatch::upload(const VkBuffer dstBuffer,
+                             const void* data,
+                             const VkDeviceSize size,
+                             const VkDeviceSize dstOffset) {
+        // Uploads larger than the ring are split
+        const auto* bytes = static_cast<const std::byte*>(data);
+        for (VkDeviceSize done = 0; done < size;) {
+            const auto pieceSize = std::min(size - done, mRing.size());
+            const auto offset = stage(bytes + done, pieceSize);
+
+            mCopies.emplace_back(Copy{
+                .dstBuffer = dstBuffer,
+                .region = VkBufferCopy{
+                    .srcOffset = offset,
+                    .dstOffset = dstOffset + done,
+                    .size = pieceSize
+                }
+            });
+
+            done += pieceSize;
+        }
+    }
+
+    void UploadBatch::upload(const VkImage dstImage,
+                             const void* data,
+                             const VkDeviceSize size,
+                             const std::vector<VkBufferImageCopy>& regions,
+                             const VkImageSubresourceRange& range,
+                             const VkImageLayout finalLayout) {
+        // Images are staged in one piece, so that the layout transitions happen in a single submission
+        const auto offset = stage(data, size);
+
+        auto& imageCopy = mImageCopies.emplace_back(ImageCopy{
+            .dstImage = dstImage,
+            .regions = regions,
+            .range = range,
+            .finalLayout = finalLayout
+        });
+
+        for (auto& region : imageCopy.regions) {
+            region.bufferOffset += offset;
+        }
+    }
+
+    VkDeviceSize UploadBatch::stage(const void* data, const VkDeviceSize size) {
+        auto block = mRing.allocate(size, kStagingAlignment);
+
+        if (!block) {
+            // The ring is full of pending uploads: submit them, then wait for them to free up space
+            submit();
+            block = mRing.allocate(size, kStagingAlignment);
+        }
+
+        if (!block) {
+            throw Error("Staging ring is held by another upload batch");
+        }
+
+        std::memcpy(block->mapped, data, size);
+        return block->offset;
+    }
+
+    std::uint64_t UploadBatch::submit() {
+        poll();
+
+        if (mCopies.empty() && mImageCopies.empty()) {
+            return 0;
+        }
+
+        const bool dedicated = mContext.has_dedicated_transfer_queue();
+
+        Submission submission{
+            .transferCommands = begin_commands(mContext, mTransferPool),
+            .graphicsCommands = VK_NULL_HANDLE
+        };
+
+        record_copies(submission.transferCommands);
+        record_ownership_transfer(submission.transferCommands, true);
+        end_commands(submission.transferCommands);
+
+        if (dedicated) {
+            // Recorded now, submitted by poll() once the copies are complete
+            submission.graphicsCommands = begin_commands(mContext, mGraphicsPool);
+            record_ownership_transfer(submission.graphicsCommands, false);
+            end_commands(submission.graphicsCommands);
+
+            submission.transferComplete = create_semaphore(mContext);
+        }
+
+        // The copies are the only reads of the staging memory
+        const auto [ticket, copiesComplete] = mRing.seal();
+        submission.ticket = ticket;
+
+        const VkSubmitInfo transferSubmit{
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &submission.transferCommands,
+            .signalSemaphoreCount = dedicated ? 1u : 0u,
+            .pSignalSemaphores = &submission.transferComplete.handle
+        };
+
+        if (const auto res = vkQueueSubmit(mContext.transferQueue, 1, &transferSubmit, copiesComplete);
+            VK_SUCCESS != res) {
+            throw Error("Submitting upload commands\n"
+                        "vkQueueSubmit() returned %s", to_string(res).c_str()
+            );
+        }
+
+        mSubmissions.emplace_back(std::move(submission));
+
+        mCopies.clear();
+        mImageCopies.clear();
+
+        return ticket;
+    }
+
+    bool UploadBatch::is_ready(const std::uint64_t ticket) {
+        if (0 == ticket) {
+            return true;
+        }
+
+        // Copies complete in order, and poll() submits the acquire commands of every completed copy
+        const bool complete = mRing.is_complete(ticket);
+        poll();
+        return complete;
+    }
+
+    void UploadBatch::wait() {
+        if (!mSubmissions.empty()) {
+            mRing.wait(mSubmissions.back().ticket);
+        }
+
+        poll();
+
+        std::vector<VkFence> fences;
+        for (const auto& submission : mSubmissions) {
+            if (VK_NULL_HANDLE != submission.acquireComplete.handle) {
+                fences.emplace_back(submission.acquireComplete.handle);
+            }
+        }
+
+        if (!fences.empty()) {
+            if (const auto res = vkWaitForFences(mContext.device, static_cast<std::uint32_t>(fences.size()),
+                                                 fences.data(), VK_TRUE, std::numeric_limits<std::uint64_t>::max());
+                VK_SUCCESS != res) {
+                throw Error("Waiting for ownership acquire commands\n"
+                            "vkWaitForFences() returned %s", to_string(res).c_str()
+                );
+            }
+        }
+
+        poll();
+    }
+
+    void UploadBatch::poll() {
+        // Submit acquire commands, in order
+        for (auto& submission : mSubmissions) {
+            if (VK_NULL_HANDLE == submission.graphicsCommands || VK_NULL_HANDLE != submission.acquireComplete.handle) {
+                continue;
+            }
+
+            if (!mRing.is_complete(submission.ticket)) {
+                break;
+            }
+
+            // The semaphore is already signalled; waiting on it makes the copies visible to the graphics queue
+            submission.acquireComplete = create_fence(mContext);
+
+            const VkSubmitInfo acquireSubmit{
+                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                .waitSemaphoreCount = 1,
+                .pWaitSemaphores = &submission.transferComplete.handle,
+                .pWaitDstStageMask = &mDstStageMask,
+                .commandBufferCount = 1,
+                .pCommandBuffers = &submission.graphicsCommands
+            };
+
+            if (const auto res = vkQueueSubmit(mContext.graphicsQueue, 1, &acquireSubmit,
+                                               submission.acquireComplete.handle);
+                VK_SUCCESS != res) {
+                throw Error("Submitting ownership acquire commands\n"
+                            "vkQueueSubmit() returned %s", to_string(res).c_str()
+                );
+            }
+        }
+
+        // Release completed submissions
+        while (!mSubmissions.empty()) {
+            auto& submission = mSubmissions.front();
+
+            if (!mRing.is_complete(submission.ticket)) {
+                return;
+            }
+
+            if (VK_NULL_HANDLE != submission.graphicsCommands) {
+                if (VK_NULL_HANDLE == submission.acquireComplete.handle ||
+                    VK_SUCCESS != vkGetFenceStatus(mContext.device, submission.acquireComplete.handle)) {
+                    return;
+                }
+
+                vkFreeCommandBuffers(mContext.device, mGraphicsPool.handle, 1, &submission.graphicsCommands);
+            }
+
+            vkFreeCommandBuffers(mContext.device, mTransferPool.handle, 1, &submission.transferCommands);
+            mSubmissions.pop_front();
+        }
+    }
+
+    void UploadBatch::record_copies(const VkCommandBuffer commandBuffer) const {
+        // Consecutive uploads to the same buffer share one vkCmdCopyBuffer()
+        std::vector<VkBufferCopy> regions;
+        for (std::size_t i = 0; i < mCopies.size();) {
+            const auto dstBuffer = mCopies[i].dstBuffer;
+
+            regions.clear();
+            for (; i < mCopies.size() && mCopies[i].dstBuffer == dstBuffer; ++i) {
+                regions.emplace_back(mCopies[i].region);
+            }
+
+            vkCmdCopyBuffer(commandBuffer, mRing.buffer(), dstBuffer, static_cast<std::uint32_t>(regions.size()),
+                            regions.data());
+        }
+
+        for (const auto& imageCopy : mImageCopies) {
+            image_barrier(commandBuffer, imageCopy.dstImage,
+                          0,
+                          VK_ACCESS_TRANSFER_WRITE_BIT,
+                          VK_IMAGE_LAYOUT_UNDEFINED,
+                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                          VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                          VK_PIPELINE_STAGE_TRANSFER_BIT,
+                          imageCopy.range
+            );
+
+            vkCmdCopyBufferToImage(commandBuffer, mRing.buffer(), imageCopy.dstImage,
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                   static_cast<std::uint32_t>(imageCopy.regions.size()), imageCopy.regions.data());
+        }
+    }
+
+    void UploadBatch::record_ownership_transfer(const VkCommandBuffer commandBuffer, const bool release) const {
+        if (!mContext.has_dedicated_transfer_queue()) {
+            // Single queue: plain barriers, no ownership transfer
+            const VkMemoryBarrier barrier{
+                .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstAccessMask = mDstAccessMask
+            };
+
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, mDstStageMask, 0, 1, &barrier, 0,
+                                 nullptr, 0, nullptr);
+
+            for (const auto& imageCopy : mImageCopies) {
+                image_barrier(commandBuffer, imageCopy.dstImage,
+                              VK_ACCESS_TRANSFER_WRITE_BIT,
+                              mDstAccessMask,
+                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                              imageCopy.finalLayout,
+                              VK_PIPELINE_STAGE_TRANSFER_BIT,
+                              mDstStageMask,
+                              imageCopy.range
+                );
+            }
+
+            return;
+        }
+
+        // Buffers are shared concurrently: the semaphore alone makes the copies visible. Images are exclusive to one
+        // family at a time. Release and acquire barriers must match, apart from the access masks and stages. The layout
+        // transition happens once, between the two.
+        const auto srcAccess = release ? VK_ACCESS_TRANSFER_WRITE_BIT : 0;
+        const auto dstAccess = release ? 0 : mDstAccessMask;
+        const auto srcStage = release ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        const auto dstStage = release ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : mDstStageMask;
+
+        for (const auto& imageCopy : mImageCopies) {
+            image_barrier(commandBuffer, imageCopy.dstImage,
+                          srcAccess,
+                          dstAccess,
+                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                          imageCopy.finalLayout,
+                          srcStage,
+                          dstStage,
+                          imageCopy.range,
+                          mContext.transferFamilyIndex,
+                          mContext.graphicsFamilyIndex
+            );
+        }
+    }
+}
+
+namespace {
+    VkCommandBuffer begin_commands(const vkutils::VulkanContext& context, const vkutils::CommandPool& pool) {
+        VkCommandBuffer commandBuffer = vkutils::alloc_command_buffer(context, pool.handle);
+
+        constexpr VkCommandBufferBeginInfo beginInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+            .pInheritanceInfo = nullptr
+        };
+
+        if (const auto res = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+            VK_SUCCESS != res) {
+            throw vkutils::Error("Beginning command buffer recording\n"
+                                 "vkBeginCommandBuffer() returned %s", vkutils::to_string(res).c_str()
+            );
+        }
+
+        return commandBuffer;
+    }
+
+    void end_commands(const VkCommandBuffer commandBuffer) {
+        if (const auto res = vkEndCommandBuffer(commandBuffer); VK_SUCCESS != res) {
+            throw vkutils::Error("Ending command buffer recording\n"
+                                 "vkEndCommandBuffer() returned %s", vkutils::to_string(res).c_str()
+            );
+        }
+    }
+}
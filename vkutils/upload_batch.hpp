@@ -0,0 +1,124 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include <volk/volk.h>
+
+#include "staging_ring.hpp"
+#include "vkobject.hpp"
+#include "vulkan_context.hpp"
+
+namespace vkutils {
+    // Queue families that must share the buffers uploaded through an UploadBatch
+    std::vector<std::uint32_t> upload_queue_families(const VulkanContext&);
+
+    /*
+     * Collects many small buffer and image uploads and performs them with a
+     * single submission.
+     *
+     * Data is copied into the staging ring as soon as upload() is called, so
+     * the source memory may be released right after. submit() records every
+     * copy into one command buffer, followed by one set of barriers, and
+     * submits once. It does not wait: staging space is reclaimed by the ring
+     * once the copies complete. If the ring runs out of space, the pending
+     * uploads are submitted early.
+     *
+     * Copies run on the transfer queue of the context. If it belongs to a
+     * dedicated family, ownership of the uploaded images is released by the
+     * transfer queue and acquired by the graphics queue (see "Queue Family
+     * Ownership Transfer" in the Vulkan specification). The acquire is only
+     * submitted once the copies have completed, so that the graphics queue
+     * never stalls on the transfer queue. Buffers are shared concurrently by
+     * both families instead, see upload_queue_families(). Without a dedicated
+     * family, everything runs on the graphics queue.
+     *
+     * Uploads are visible to dstAccessMask in dstStageMask of graphics queue
+     * submissions made after is_ready() returns true for their submission,
+     * or after wait().
+     */
+    class UploadBatch {
+    public:
+        UploadBatch(const VulkanContext&, StagingRing&, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask);
+
+        // Waits for the submitted uploads. Uploads that were never submitted are discarded.
+        ~UploadBatch();
+
+        UploadBatch(const UploadBatch&) = delete;
+
+        UploadBatch& operator=(const UploadBatch&) = delete;
+
+        // Upload size bytes from data to dstBuffer at dstOffset. dstBuffer needs VK_BUFFER_USAGE_TRANSFER_DST_BIT, and
+        // must be shared by upload_queue_families().
+        void upload(VkBuffer dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+
+        // Upload size bytes from data to the whole subresource range of dstImage, which must be in the UNDEFINED layout.
+        // The bufferOffset of the regions is relative to data. dstImage ends up in finalLayout.
+        void upload(VkImage dstImage,
+                    const void* data,
+                    VkDeviceSize size,
+                    const std::vector<VkBufferImageCopy>& regions,
+                    const VkImageSubresourceRange& range,
+                    VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+        // Submit all pending uploads. Returns the ticket of the submission, or 0 if there was nothing to submit.
+        std::uint64_t submit();
+
+        // Whether the uploads of the submission are visible to the graphics queue. Ticket 0 is always ready.
+        bool is_ready(std::uint64_t ticket);
+
+        // Block until all submitted uploads are visible to the graphics queue
+        void wait();
+
+    private:
+        struct Copy {
+            VkBuffer dstBuffer;
+            VkBufferCopy region;
+        };
+
+        struct ImageCopy {
+            VkImage dstImage;
+            std::vector<VkBufferImageCopy> regions;
+            VkImageSubresourceRange range;
+            VkImageLayout finalLayout;
+        };
+
+        // Command buffers and synchronisation of a submit(). The copies are complete once the ring reports the ticket
+        // complete. With a dedicated transfer queue, the acquire commands are submitted after that, and complete once
+        // acquireComplete is signalled.
+        struct Submission {
+            std::uint64_t ticket;
+            VkCommandBuffer transferCommands;
+            VkCommandBuffer graphicsCommands;
+            Semaphore transferComplete;
+            Fence acquireComplete;
+        };
+
+        // Copies data into the staging ring, returns its offset in the ring buffer
+        VkDeviceSize stage(const void* data, VkDeviceSize size);
+
+        void record_copies(VkCommandBuffer) const;
+
+        // Release (on the transfer queue) or acquire (on the graphics queue) barriers; both are required
+        void record_ownership_transfer(VkCommandBuffer, bool release) const;
+
+        // Submit the acquire commands of completed copies, and release completed submissions
+        void poll();
+
+        const VulkanContext& mContext;
+        StagingRing& mRing;
+
+        VkPipelineStageFlags mDstStageMask;
+        VkAccessFlags mDstAccessMask;
+
+        CommandPool mTransferPool;
+        CommandPool mGraphicsPool; // Only used with a dedicated transfer queue
+
+        std::vector<Copy> mCopies;
+        std::vector<ImageCopy> mImageCopies;
+
+        std::deque<Submission> mSubmissions;
+    };
+}
@@ -4,6 +4,7 @@
 #include <utility>
 
 #include "error.hpp"
+#include "memory_report.hpp"
 #include "to_string.hpp"
 
 namespace vkutils {
@@ -13,6 +14,7 @@ namespace vkutils {
         if (VK_NULL_HANDLE != buffer) {
             assert(VK_NULL_HANDLE != mAllocator);
             assert(VK_NULL_HANDLE != allocation);
+            untrack_allocation(mAllocator, allocation);
             vmaDestroyBuffer(mAllocator, buffer, allocation);
         }
     }
@@ -42,18 +44,29 @@ namespace vkutils {
                          const VkDeviceSize deviceSize,
                          const VkBufferUsageFlags bufferUsageFlag,
                          const VmaAllocationCreateFlags memoryFlags,
-                         const VmaMemoryUsage memoryUsage) {
+                         const VmaMemoryUsage memoryUsage,
+                         const std::vector<std::uint32_t>& queueFamilies,
+                         const MemoryClass memoryClass) {
         const VkBufferCreateInfo bufferInfo{
             .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
             .size = deviceSize,
-            .usage = bufferUsageFlag
+            .usage = bufferUsageFlag,
+            .sharingMode = queueFamilies.size() > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = queueFamilies.size() > 1 ? static_cast<std::uint32_t>(queueFamilies.size()) : 0,
+            .pQueueFamilyIndices = queueFamilies.size() > 1 ? queueFamilies.data() : nullptr
         };
 
-        const VmaAllocationCreateInfo allocInfo{
+        VmaAllocationCreateInfo allocInfo{
             .flags = memoryFlags,
             .usage = memoryUsage
         };
 
+        if (std::uint32_t memoryTypeIndex = 0;
+            VK_SUCCESS == vmaFindMemoryTypeIndexForBufferInfo(allocator.allocator, &bufferInfo, &allocInfo,
+                                                              &memoryTypeIndex)) {
+            allocInfo.pool = allocator.pool(memoryClass, memoryTypeIndex);
+        }
+
         VkBuffer buffer = VK_NULL_HANDLE;
         VmaAllocation allocation = VK_NULL_HANDLE;
 
@@ -65,6 +78,8 @@ namespace vkutils {
             );
         }
 
+        track_allocation(allocator.allocator, allocation, memoryClass);
+
         return Buffer(allocator.allocator, buffer, allocation);
     }
 }
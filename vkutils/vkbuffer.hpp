@@ -1,5 +1,8 @@
 #pragma once
 
+#include <vector>
+#include <cstdint>
+
 #include <volk/volk.h>
 #include <vk_mem_alloc.h>
 
@@ -27,6 +30,8 @@ namespace vkutils {
         VmaAllocator mAllocator = VK_NULL_HANDLE;
     };
 
+    // The buffer is shared concurrently by queueFamilies if there are several, so that it needs no ownership transfers
     Buffer create_buffer(const Allocator&, VkDeviceSize, VkBufferUsageFlags, VmaAllocationCreateFlags,
-                         VmaMemoryUsage = VMA_MEMORY_USAGE_AUTO);
+                         VmaMemoryUsage = VMA_MEMORY_USAGE_AUTO, const std::vector<std::uint32_t>& queueFamilies = {},
+                         MemoryClass = MemoryClass::Uniform);
 }
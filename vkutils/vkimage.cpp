@@ -9,6 +9,7 @@
 #include "error.hpp"
 #include "vkutil.hpp"
 #include "vkbuffer.hpp"
+#include "memory_report.hpp"
 #include "to_string.hpp"
 
 namespace vkutils {
@@ -18,38 +19,79 @@ namespace vkutils {
         if (VK_NULL_HANDLE != image) {
             assert(VK_NULL_HANDLE != mAllocator);
             assert(VK_NULL_HANDLE != allocation);
+            untrack_allocation(mAllocator, allocation);
             vmaDestroyImage(mAllocator, image, allocation);
         }
     }
 
-    Image::Image(const VmaAllocator allocator, const VkImage image, const VmaAllocation allocation) noexcept
-        : image(image), allocation(allocation), mAllocator(allocator) {
+    Image::Image(const VmaAllocator allocator,
+                 const VkImage image,
+                 const VmaAllocation allocation,
+                 const VkImageCreateInfo& info) noexcept
+        : image(image), allocation(allocation), info(info), mAllocator(allocator) {
+        this->info.pNext = nullptr;
+        this->info.queueFamilyIndexCount = 0;
+        this->info.pQueueFamilyIndices = nullptr;
     }
 
     Image::Image(Image&& other) noexcept
         : image(std::exchange(other.image, VK_NULL_HANDLE)),
           allocation(std::exchange(other.allocation, VK_NULL_HANDLE)),
+          info(other.info),
           mAllocator(std::exchange(other.mAllocator, VK_NULL_HANDLE)) {
     }
 
     Image& Image::operator=(Image&& other) noexcept {
         std::swap(image, other.image);
         std::swap(allocation, other.allocation);
+        std::swap(info, other.info);
         std::swap(mAllocator, other.mAllocator);
         return *this;
     }
 }
 
 namespace vkutils {
+    Image create_image(const Allocator& allocator,
+                       const VkImageCreateInfo& imageInfo,
+                       const MemoryClass memoryClass,
+                       const VmaAllocationCreateFlags memoryFlags) {
+        VmaAllocationCreateInfo allocInfo{
+            .flags = memoryFlags,
+            .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE
+        };
+
+        if (std::uint32_t memoryTypeIndex = 0;
+            VK_SUCCESS == vmaFindMemoryTypeIndexForImageInfo(allocator.allocator, &imageInfo, &allocInfo,
+                                                             &memoryTypeIndex)) {
+            allocInfo.pool = allocator.pool(memoryClass, memoryTypeIndex);
+        }
+
+        VkImage image = VK_NULL_HANDLE;
+        VmaAllocation allocation = VK_NULL_HANDLE;
+
+        if (const auto res = vmaCreateImage(allocator.allocator, &imageInfo, &allocInfo, &image, &allocation, nullptr);
+            VK_SUCCESS != res) {
+            throw Error("Unable to allocate image.\n"
+                        "vmaCreateImage() returned %s", to_string(res).c_str()
+            );
+        }
+
+        track_allocation(allocator.allocator, allocation, memoryClass);
+
+        return Image(allocator.allocator, image, allocation, imageInfo);
+    }
+
     Image create_texture_image(const Allocator& allocator,
                                const std::uint32_t width,
                                const std::uint32_t height,
                                const VkFormat format,
-                               const VkImageUsageFlags usageFlags) {
+                               const VkImageUsageFlags usageFlags,
+                               const VkImageCreateFlags createFlags) {
         const auto mipLevels = compute_mip_level_count(width, height);
 
         const VkImageCreateInfo imageInfo{
             .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .flags = createFlags,
             .imageType = VK_IMAGE_TYPE_2D,
             .format = format,
             .extent = {
@@ -61,27 +103,13 @@ namespace vkutils {
             .arrayLayers = 1,
             .samples = VK_SAMPLE_COUNT_1_BIT,
             .tiling = VK_IMAGE_TILING_OPTIMAL,
-            .usage = usageFlags,
+            // Textures can be moved elsewhere in memory by defragment(), which copies them
+            .usage = usageFlags | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
             .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
             .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
         };
 
-        constexpr VmaAllocationCreateInfo allocInfo{
-            .flags = 0,
-            .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE
-        };
-
-        VkImage image = VK_NULL_HANDLE;
-        VmaAllocation allocation = VK_NULL_HANDLE;
-
-        if (const auto res = vmaCreateImage(allocator.allocator, &imageInfo, &allocInfo, &image, &allocation, nullptr);
-            VK_SUCCESS != res) {
-            throw Error("Unable to allocate image.\n"
-                        "vmaCreateImage() returned %s", to_string(res).c_str()
-            );
-        }
-
-        return Image(allocator.allocator, image, allocation);
+        return create_image(allocator, imageInfo, MemoryClass::Texture);
     }
 
     std::uint32_t compute_mip_level_count(const std::uint32_t width, const std::uint32_t height) {
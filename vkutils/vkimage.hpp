@@ -10,7 +10,8 @@ namespace vkutils {
     public:
         Image() noexcept, ~Image();
 
-        explicit Image(VmaAllocator, VkImage = VK_NULL_HANDLE, VmaAllocation = VK_NULL_HANDLE) noexcept;
+        explicit Image(VmaAllocator, VkImage = VK_NULL_HANDLE, VmaAllocation = VK_NULL_HANDLE,
+                       const VkImageCreateInfo& = {}) noexcept;
 
         Image(const Image&) = delete;
 
@@ -23,14 +24,26 @@ namespace vkutils {
         VkImage image = VK_NULL_HANDLE;
         VmaAllocation allocation = VK_NULL_HANDLE;
 
+        // Parameters image was created with, so that it can be recreated elsewhere, see defragment().
+        // Without pNext and queue family indices.
+        VkImageCreateInfo info{};
+
     private:
         VmaAllocator mAllocator = VK_NULL_HANDLE;
     };
 
+    // Allocates from the pool of memoryClass when possible, see Allocator::pool()
+    Image create_image(const Allocator& allocator,
+                       const VkImageCreateInfo& imageInfo,
+                       MemoryClass memoryClass,
+                       VmaAllocationCreateFlags = 0);
+
+    // Full mip chain, in the MemoryClass::Texture pool
     Image create_texture_image(const Allocator& allocator,
                                std::uint32_t width, std::uint32_t height,
                                VkFormat format,
-                               VkImageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+                               VkImageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                               VkImageCreateFlags = 0);
 
     std::uint32_t compute_mip_level_count(std::uint32_t width, std::uint32_t height);
 }
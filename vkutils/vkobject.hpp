@@ -96,6 +96,8 @@ namespace vkutils {
 
     using CommandPool = UniqueHandle<VkCommandPool, VkDevice, vkDestroyCommandPool>;
 
+    using QueryPool = UniqueHandle<VkQueryPool, VkDevice, vkDestroyQueryPool>;
+
     using Fence = UniqueHandle<VkFence, VkDevice, vkDestroyFence>;
     using Semaphore = UniqueHandle<VkSemaphore, VkDevice, vkDestroySemaphore>;
 
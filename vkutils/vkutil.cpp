@@ -67,10 +67,16 @@ namespace vkutils {
     }
 
     CommandPool create_command_pool(const VulkanContext& context, const VkCommandPoolCreateFlags flags) {
+        return create_command_pool(context, context.graphicsFamilyIndex, flags);
+    }
+
+    CommandPool create_command_pool(const VulkanContext& context,
+                                    const std::uint32_t queueFamilyIndex,
+                                    const VkCommandPoolCreateFlags flags) {
         const VkCommandPoolCreateInfo poolInfo{
             .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
             .flags = flags,
-            .queueFamilyIndex = context.graphicsFamilyIndex
+            .queueFamilyIndex = queueFamilyIndex
         };
 
         VkCommandPool cpool = VK_NULL_HANDLE;
@@ -169,9 +175,21 @@ namespace vkutils {
                 .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
                 .descriptorCount = maxDescriptors
             },
+            VkDescriptorPoolSize{
+                .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                .descriptorCount = maxDescriptors
+            },
             VkDescriptorPoolSize{
                 .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                 .descriptorCount = maxDescriptors
+            },
+            VkDescriptorPoolSize{
+                .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .descriptorCount = maxDescriptors
+            },
+            VkDescriptorPoolSize{
+                .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = maxDescriptors
             }
         };
 
@@ -240,13 +258,14 @@ namespace vkutils {
 
     ImageView image_to_view(const VulkanContext& context,
                             const VkImage image,
-                            const VkFormat format) {
+                            const VkFormat format,
+                            const VkComponentMapping components) {
         const VkImageViewCreateInfo viewInfo{
             .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
             .image = image,
             .viewType = VK_IMAGE_VIEW_TYPE_2D,
             .format = format,
-            .components = VkComponentMapping{}, // == identity
+            .components = components,
             .subresourceRange = VkImageSubresourceRange{
                 VK_IMAGE_ASPECT_COLOR_BIT,
                 0, VK_REMAINING_MIP_LEVELS,
@@ -265,6 +284,33 @@ namespace vkutils {
         return ImageView(context.device, view);
     }
 
+    ImageView image_level_to_view(const VulkanContext& context,
+                                  const VkImage image,
+                                  const VkFormat format,
+                                  const std::uint32_t level) {
+        const VkImageViewCreateInfo viewInfo{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = image,
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = format,
+            .subresourceRange = VkImageSubresourceRange{
+                VK_IMAGE_ASPECT_COLOR_BIT,
+                level, 1,
+                0, 1
+            }
+        };
+
+        VkImageView view = VK_NULL_HANDLE;
+        if (const auto res = vkCreateImageView(context.device, &viewInfo, nullptr, &view);
+            VK_SUCCESS != res) {
+            throw Error("Unable to create image view\n"
+                        "vkCreateImageView() returned %s", to_string(res).c_str()
+            );
+        }
+
+        return ImageView(context.device, view);
+    }
+
     void image_barrier(const VkCommandBuffer commandBuffer, const VkImage image,
                        const VkAccessFlags srcAccessMask, const VkAccessFlags dstAccessMask,
                        const VkImageLayout srcLayout, const VkImageLayout dstLayout,
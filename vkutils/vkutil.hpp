@@ -11,6 +11,9 @@ namespace vkutils {
 
     CommandPool create_command_pool(const VulkanContext&, VkCommandPoolCreateFlags = 0);
 
+    // Command pool for a queue family other than the graphics one
+    CommandPool create_command_pool(const VulkanContext&, std::uint32_t queueFamilyIndex, VkCommandPoolCreateFlags);
+
     VkCommandBuffer alloc_command_buffer(const VulkanContext&, VkCommandPool);
 
     Fence create_fence(const VulkanContext&, VkFenceCreateFlags = 0);
@@ -40,7 +43,10 @@ namespace vkutils {
                                                           VkDescriptorSetLayout setLayout,
                                                           std::uint32_t count);
 
-    ImageView image_to_view(const VulkanContext&, VkImage, VkFormat);
+    ImageView image_to_view(const VulkanContext&, VkImage, VkFormat, VkComponentMapping = {} /* identity */);
+
+    // View of a single mip level. format may differ from the one of image if it was created mutable.
+    ImageView image_level_to_view(const VulkanContext&, VkImage, VkFormat, std::uint32_t level);
 
     void image_barrier(
         VkCommandBuffer,
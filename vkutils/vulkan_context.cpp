@@ -3,6 +3,7 @@
 #include <vector>
 #include <utility>
 
+#include "memory_report.hpp"
 #include "to_string.hpp"
 
 namespace vkutils {
@@ -12,7 +13,7 @@ namespace vkutils {
     VulkanContext::~VulkanContext() {
         // Device-related objects
         if (VK_NULL_HANDLE != device) {
-            vkDestroyDevice(device, nullptr);
+            vkDestroyDevice(device, host_allocation_callbacks(HostSubsystem::VulkanDriver));
         }
 
         // Instance-related objects
@@ -21,7 +22,7 @@ namespace vkutils {
         }
 
         if (VK_NULL_HANDLE != instance) {
-            vkDestroyInstance(instance, nullptr);
+            vkDestroyInstance(instance, host_allocation_callbacks(HostSubsystem::VulkanDriver));
         }
     }
 
@@ -32,6 +33,10 @@ namespace vkutils {
           device(std::exchange(other.device, VK_NULL_HANDLE)),
           graphicsFamilyIndex(other.graphicsFamilyIndex),
           graphicsQueue(std::exchange(other.graphicsQueue, VK_NULL_HANDLE)),
+          transferFamilyIndex(other.transferFamilyIndex),
+          transferQueue(std::exchange(other.transferQueue, VK_NULL_HANDLE)),
+          hasMemoryBudget(other.hasMemoryBudget),
+          hasPipelineStatistics(other.hasPipelineStatistics),
           debugMessenger(std::exchange(other.debugMessenger, VK_NULL_HANDLE)) {
     }
 
@@ -52,7 +57,15 @@ namespace vkutils {
         std::swap(device, other.device);
         std::swap(graphicsFamilyIndex, other.graphicsFamilyIndex);
         std::swap(graphicsQueue, other.graphicsQueue);
+        std::swap(transferFamilyIndex, other.transferFamilyIndex);
+        std::swap(transferQueue, other.transferQueue);
+        std::swap(hasMemoryBudget, other.hasMemoryBudget);
+        std::swap(hasPipelineStatistics, other.hasPipelineStatistics);
         std::swap(debugMessenger, other.debugMessenger);
         return *this;
     }
+
+    bool VulkanContext::has_dedicated_transfer_queue() const {
+        return transferFamilyIndex != graphicsFamilyIndex;
+    }
 }
@@ -26,6 +26,18 @@ namespace vkutils {
         std::uint32_t graphicsFamilyIndex = 0;
         VkQueue graphicsQueue = VK_NULL_HANDLE;
 
+        // Dedicated transfer queue if the device has one; otherwise equal to the graphics queue and family
+        std::uint32_t transferFamilyIndex = 0;
+        VkQueue transferQueue = VK_NULL_HANDLE;
+
+        bool has_dedicated_transfer_queue() const;
+
+        // VK_EXT_memory_budget is enabled; VMA then reports the budget of the driver instead of an estimate
+        bool hasMemoryBudget = false;
+
+        // Pipeline statistics queries are enabled, including within secondary command buffers (inherited queries)
+        bool hasPipelineStatistics = false;
+
         VkDebugUtilsMessengerEXT debugMessenger = VK_NULL_HANDLE;
     };
 
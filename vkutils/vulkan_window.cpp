@@ -14,6 +14,7 @@
 #include <vulkan/vulkan_core.h>
 
 #include "error.hpp"
+#include "memory_report.hpp"
 #include "to_string.hpp"
 #include "context_helpers.hxx"
 #include "../vksuntemple/config.hpp"
@@ -27,6 +28,8 @@ namespace {
 
     std::optional<std::uint32_t> find_queue_family(VkPhysicalDevice, VkQueueFlags, VkSurfaceKHR = VK_NULL_HANDLE);
 
+    std::optional<std::uint32_t> find_transfer_queue_family(VkPhysicalDevice);
+
     VkDevice create_device(
         VkPhysicalDevice physicalDevice,
         const std::vector<std::uint32_t>& queueFamilies,
@@ -243,6 +246,13 @@ namespace vkutils {
 
         enabledDevExensions.emplace_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 
+        // Optional: lets the allocator track the actual memory budget of the process
+        const auto supportedDeviceExtensions = detail::get_device_extensions(vulkanWindow.physicalDevice);
+        if (supportedDeviceExtensions.contains(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+            enabledDevExensions.emplace_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+            vulkanWindow.hasMemoryBudget = true;
+        }
+
         for (const auto& ext : enabledDevExensions) {
             std::printf("Enabling device extension: %s\n", ext);
         }
@@ -270,7 +280,30 @@ namespace vkutils {
             queueFamilyIndices.emplace_back(*present);
         }
 
-        vulkanWindow.device = create_device(vulkanWindow.physicalDevice, queueFamilyIndices, enabledDevExensions);
+        // Uploads prefer a transfer-only family (usually DMA engines), so that they can run alongside rendering
+        std::vector<std::uint32_t> deviceQueueFamilyIndices = queueFamilyIndices;
+        vulkanWindow.transferFamilyIndex = vulkanWindow.graphicsFamilyIndex;
+
+        if (const auto transfer = find_transfer_queue_family(vulkanWindow.physicalDevice)) {
+            vulkanWindow.transferFamilyIndex = *transfer;
+
+            if (deviceQueueFamilyIndices.end() == std::find(deviceQueueFamilyIndices.begin(),
+                                                            deviceQueueFamilyIndices.end(), *transfer)) {
+                deviceQueueFamilyIndices.emplace_back(*transfer);
+            }
+        }
+
+        std::printf("Transfer queue family: %u (%s)\n", vulkanWindow.transferFamilyIndex,
+                    vulkanWindow.has_dedicated_transfer_queue() ? "dedicated" : "shared with graphics");
+
+        // Optional: pipeline statistics of the passes, whose draws are recorded into secondary command buffers
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(vulkanWindow.physicalDevice, &supportedFeatures);
+        vulkanWindow.hasPipelineStatistics = supportedFeatures.pipelineStatisticsQuery &&
+                                             supportedFeatures.inheritedQueries;
+
+        vulkanWindow.device = create_device(vulkanWindow.physicalDevice, deviceQueueFamilyIndices,
+                                            enabledDevExensions);
 
         // Retrieve VkQueues
         vkGetDeviceQueue(vulkanWindow.device, vulkanWindow.graphicsFamilyIndex, 0, &vulkanWindow.graphicsQueue);
@@ -284,6 +317,10 @@ namespace vkutils {
             vulkanWindow.presentQueue = vulkanWindow.graphicsQueue;
         }
 
+        vkGetDeviceQueue(vulkanWindow.device, vulkanWindow.transferFamilyIndex, 0, &vulkanWindow.transferQueue);
+
+        assert(VK_NULL_HANDLE != vulkanWindow.transferQueue);
+
         // Create swap chain
         std::tie(vulkanWindow.swapchain, vulkanWindow.swapchainFormat, vulkanWindow.swapchainExtent) = create_swapchain(
             vulkanWindow.physicalDevice, vulkanWindow.surface, vulkanWindow.device, vulkanWindow.window,
@@ -586,6 +623,35 @@ namespace {
         return {};
     }
 
+    std::optional<std::uint32_t> find_transfer_queue_family(const VkPhysicalDevice physicalDevice) {
+        std::uint32_t numQueues = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &numQueues, nullptr);
+
+        std::vector<VkQueueFamilyProperties> families(numQueues);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &numQueues, families.data());
+
+        // Best case: TRANSFER only. Otherwise: TRANSFER without GRAPHICS (e.g. async compute). GRAPHICS and COMPUTE
+        // queues support transfers implicitly, but never count as dedicated.
+        std::optional<std::uint32_t> fallback;
+        for (std::uint32_t i = 0; i < numQueues; ++i) {
+            const auto flags = families[i].queueFlags;
+
+            if (!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT)) {
+                continue;
+            }
+
+            if (!(flags & VK_QUEUE_COMPUTE_BIT)) {
+                return i;
+            }
+
+            if (!fallback) {
+                fallback = i;
+            }
+        }
+
+        return fallback;
+    }
+
     VkDevice create_device(const VkPhysicalDevice physicalDevice,
                            const std::vector<std::uint32_t>& queueFamilies,
                            const std::vector<char const*>& enabledDeviceExtensions) {
@@ -604,12 +670,44 @@ namespace {
             queueInfo.pQueuePriorities = queuePriorities;
         }
 
-        constexpr VkPhysicalDeviceFeatures deviceFeatures{
-            .samplerAnisotropy = VK_TRUE
+        // Block compressed textures are enabled when available; loading BCn textures on devices without support
+        // fails with an error instead
+        // Storage image writes without a format are used by compute mip generation, which falls back to blits
+        // Indirect draw counts and multiple indirect draws are used by GPU culling, which falls back to fixed counts
+        // and single draws
+        // Descriptor indexing and indirect first instances are required by the material table, see score_device()
+        // Pipeline statistics and inherited queries are used to measure the passes, which skip the statistics otherwise
+        VkPhysicalDeviceVulkan12Features supportedFeatures12{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES
+        };
+        VkPhysicalDeviceFeatures2 supportedFeatures{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &supportedFeatures12
+        };
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures);
+
+        VkPhysicalDeviceVulkan12Features deviceFeatures12{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+            .drawIndirectCount = supportedFeatures12.drawIndirectCount,
+            .shaderSampledImageArrayNonUniformIndexing = VK_TRUE,
+            .descriptorBindingPartiallyBound = VK_TRUE,
+            .descriptorBindingVariableDescriptorCount = VK_TRUE,
+            .runtimeDescriptorArray = VK_TRUE
+        };
+
+        const VkPhysicalDeviceFeatures deviceFeatures{
+            .multiDrawIndirect = supportedFeatures.features.multiDrawIndirect,
+            .drawIndirectFirstInstance = VK_TRUE,
+            .samplerAnisotropy = VK_TRUE,
+            .textureCompressionBC = supportedFeatures.features.textureCompressionBC,
+            .pipelineStatisticsQuery = supportedFeatures.features.pipelineStatisticsQuery,
+            .shaderStorageImageWriteWithoutFormat = supportedFeatures.features.shaderStorageImageWriteWithoutFormat,
+            .inheritedQueries = supportedFeatures.features.inheritedQueries
         };
 
         const VkDeviceCreateInfo deviceInfo{
             .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+            .pNext = &deviceFeatures12,
             .queueCreateInfoCount = static_cast<std::uint32_t>(queueInfos.size()),
             .pQueueCreateInfos = queueInfos.data(),
             .enabledExtensionCount = static_cast<std::uint32_t>(enabledDeviceExtensions.size()),
@@ -617,8 +715,10 @@ namespace {
             .pEnabledFeatures = &deviceFeatures
         };
 
+        const VkAllocationCallbacks* callbacks = vkutils::host_allocation_callbacks(vkutils::HostSubsystem::VulkanDriver);
+
         VkDevice device = VK_NULL_HANDLE;
-        if (const auto res = vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &device); VK_SUCCESS != res) {
+        if (const auto res = vkCreateDevice(physicalDevice, &deviceInfo, callbacks, &device); VK_SUCCESS != res) {
             throw vkutils::Error("Unable to create logical device\n"
                                  "vkCreateDevice() returned %s", vkutils::to_string(res).c_str()
             );
@@ -662,6 +762,23 @@ namespace {
             return -1.0f;
         }
 
+        // Materials are indexed per draw, from the instance index of indirect draws
+        VkPhysicalDeviceVulkan12Features features12{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES
+        };
+        VkPhysicalDeviceFeatures2 features{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &features12
+        };
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+        if (!features12.runtimeDescriptorArray || !features12.shaderSampledImageArrayNonUniformIndexing ||
+            !features12.descriptorBindingPartiallyBound || !features12.descriptorBindingVariableDescriptorCount ||
+            !features.features.drawIndirectFirstInstance) {
+            std::fprintf(stderr, "Info: Discarding device ’%s’: descriptor indexing unsupported\n", props.deviceName);
+            return -1.0f;
+        }
+
         // Discrete GPU > Integrated GPU > others
         float score = 0.f;
 